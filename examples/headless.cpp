@@ -0,0 +1,192 @@
+#include <kuro/gfx.h>
+#include <kuro/gfx_soft.h>
+#include <kuro/kuro_os.h>
+#include <kuro/kuro_math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// renders a grid of ~100k triangles with the software backend at 1080p into an offscreen render
+// target, the frame is recorded once into a kr_stream_t and replayed, prints the frame times and
+// writes the last frame to headless.ppm
+
+struct Pass_Constants
+{
+    kuro::mat4 view_proj;
+    char padding[192];
+};
+
+struct Vertex
+{
+    kuro::vec3 position;
+    kuro::vec3 color;
+};
+
+static void
+vs_main(const Kuro_Gfx_Soft_Vertex *vertex, float position[4], float *varyings)
+{
+    const Pass_Constants *pass = (const Pass_Constants *)vertex->constants[0];
+    kuro::vec4 p = kuro::vec4{vertex->attributes[0], vertex->attributes[1], vertex->attributes[2], 1.0f} * pass->view_proj;
+    position[0] = p.x;
+    position[1] = p.y;
+    position[2] = p.z;
+    position[3] = p.w;
+    varyings[0] = vertex->attributes[3];
+    varyings[1] = vertex->attributes[4];
+    varyings[2] = vertex->attributes[5];
+}
+
+static void
+ps_main(const Kuro_Gfx_Soft_Pixels *pixels, float *color)
+{
+    memcpy(color, pixels->varyings, 3 * 8 * sizeof(float));
+    kuro::f32x8_storeu(color + 3 * 8, kuro::f32x8_splat(1.0f));
+}
+
+static void
+cube_push(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, kuro::vec3 center, float half)
+{
+    // face normal, and two axes so that u x v == normal
+    const kuro::vec3 faces[6][3] = {
+        {{+1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+        {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0, +1, 0}, {0, 0, 1}, {1, 0, 0}},
+        {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0, +1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}},
+    };
+
+    for (int f = 0; f < 6; ++f)
+    {
+        kuro::vec3 n = faces[f][0], u = faces[f][1], v = faces[f][2];
+        kuro::vec3 color = n * 0.35f + kuro::vec3{0.5f, 0.5f, 0.5f};
+        uint32_t base = (uint32_t)vertices.size();
+        vertices.push_back({center + (n - u - v) * half, color});
+        vertices.push_back({center + (n + u - v) * half, color});
+        vertices.push_back({center + (n + u + v) * half, color});
+        vertices.push_back({center + (n - u + v) * half, color});
+
+        const uint32_t quad[] = {0, 1, 2, 0, 2, 3};
+        for (uint32_t i : quad)
+            indices.push_back(base + i);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const int frame_count = argc > 1 ? atoi(argv[1]) : 30;
+
+    kr_gfx_t gfx = kuro_gfx_soft_create(0);
+    kuro_gfx_soft_vertex_shader_register(gfx, "vs_main", vs_main, 3);
+    kuro_gfx_soft_pixel_shader_register(gfx, "ps_main", ps_main);
+
+    kr_commands_t commands = kuro_gfx_commands_create(gfx);
+    kr_image_t render_target = kuro_gfx_render_target_create(gfx, width, height);
+    kr_readback_t readback = kuro_gfx_readback_create(gfx, width, height);
+    kr_image_t depth_target = kuro_gfx_image_create(gfx, width, height);
+
+    kr_vshader_t vertex_shader = kuro_gfx_vertex_shader_create(gfx, nullptr, "vs_main");
+    kr_pshader_t pixel_shader = kuro_gfx_pixel_shader_create(gfx, nullptr, "ps_main");
+
+    Kuro_Gfx_Pipeline_Desc pipeline_desc = {};
+    pipeline_desc.vertex_shader = vertex_shader;
+    pipeline_desc.pixel_shader = pixel_shader;
+    pipeline_desc.vertex_attribures[0].format = KURO_GFX_FORMAT_R32G32B32_FLOAT;
+    pipeline_desc.vertex_attribures[1].format = KURO_GFX_FORMAT_R32G32B32_FLOAT;
+    kr_pipeline_t pipeline = kuro_gfx_pipeline_create(gfx, pipeline_desc);
+
+    // 21 x 20 x 20 cubes, 100800 triangles
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    for (int z = 0; z < 20; ++z)
+        for (int y = 0; y < 20; ++y)
+            for (int x = 0; x < 21; ++x)
+                cube_push(vertices, indices, kuro::vec3{x - 10.0f, y - 9.5f, z - 9.5f}, 0.3f);
+
+    kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Vertex)));
+    kr_buffer_t index_buffer = kuro_gfx_buffer_create(gfx, KURO_GFX_ACCESS_NONE, indices.data(), (uint32_t)(indices.size() * sizeof(uint32_t)));
+    kr_buffer_t pass_constants_buffer = kuro_gfx_buffer_create(gfx, KURO_GFX_ACCESS_WRITE, nullptr, sizeof(Pass_Constants));
+
+    // the frame is recorded once, only the pass constants change between replays
+    Kuro_Gfx_Draw_Desc draw_desc = {};
+    draw_desc.vertex_buffers[0].buffer = vertex_buffer;
+    draw_desc.vertex_buffers[0].stride = sizeof(Vertex);
+    draw_desc.index_buffer.buffer = index_buffer;
+    draw_desc.index_buffer.format = KURO_GFX_FORMAT_R32_UINT;
+    draw_desc.count = (uint32_t)indices.size();
+
+    kr_stream_t stream = kuro_gfx_stream_create();
+    kuro_gfx_stream_set_pipeline(stream, pipeline);
+    kuro_gfx_stream_viewport(stream, width, height);
+    kuro_gfx_stream_clear(stream, {0.1f, 0.1f, 0.1f, 1.0f}, 1.0f);
+    uint32_t pass_constants_write = kuro_gfx_stream_buffer_write(stream, pass_constants_buffer, nullptr, sizeof(Pass_Constants));
+    kuro_gfx_stream_buffer_bind(stream, pass_constants_buffer, 0);
+    kuro_gfx_stream_draw(stream, draw_desc);
+    kuro_gfx_stream_optimize(stream);
+
+    double total_time = 0.0;
+    double min_time = 1e9;
+    for (int frame = 0; frame < frame_count; ++frame)
+    {
+        double begin_time = kuro::os_seconds();
+
+        float angle = frame * 0.02f;
+        kuro::vec3 eye = {30.0f * kuro::sin(angle), 12.0f, 30.0f * kuro::cos(angle)};
+        Pass_Constants *pass_constants = (Pass_Constants *)kuro_gfx_stream_write_data(stream, pass_constants_write);
+        pass_constants->view_proj =
+            kuro::mat4_look_at(eye, kuro::vec3{0.0f, 0.0f, 0.0f}, kuro::vec3{0.0f, 1.0f, 0.0f}) *
+            kuro::mat4_prespective(0.9f, (float)width / (float)height, 0.1f, 100.0f);
+
+        Kuro_Gfx_Pass_Desc pass_desc = {};
+        pass_desc.color_targets[0] = render_target;
+        pass_desc.depth_target = depth_target;
+        kuro_gfx_commands_begin_pass(gfx, commands, pass_desc);
+        {
+            kuro_gfx_stream_replay(stream, commands);
+
+            if (frame == frame_count - 1)
+                kuro_gfx_readback(commands, render_target, readback);
+        }
+        kuro_gfx_commands_end(gfx, commands);
+
+        double frame_time = kuro::os_seconds() - begin_time;
+        total_time += frame_time;
+        min_time = frame_time < min_time ? frame_time : min_time;
+        printf("frame %3d: %7.3f ms\n", frame, frame_time * 1000.0);
+    }
+    printf("%u triangles, average: %7.3f ms, best: %7.3f ms\n", (uint32_t)indices.size() / 3, total_time / frame_count * 1000.0, min_time * 1000.0);
+
+    uint32_t row_pitch = 0;
+    const uint8_t *pixels = (const uint8_t *)kuro_gfx_readback_map(gfx, readback, &row_pitch);
+    FILE *file = fopen("headless.ppm", "wb");
+    if (file)
+    {
+        fprintf(file, "P6\n%u %u\n255\n", width, height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+                fwrite(pixels + y * row_pitch + x * 4, 1, 3, file);
+        }
+        fclose(file);
+    }
+    kuro_gfx_readback_unmap(gfx, readback);
+
+    // release resources
+    kuro_gfx_stream_destroy(stream);
+    kuro_gfx_buffer_destroy(gfx, pass_constants_buffer);
+    kuro_gfx_buffer_destroy(gfx, index_buffer);
+    kuro_gfx_buffer_destroy(gfx, vertex_buffer);
+    kuro_gfx_pipeline_destroy(gfx, pipeline);
+    kuro_gfx_pixel_shader_destroy(gfx, pixel_shader);
+    kuro_gfx_vertex_shader_destroy(gfx, vertex_shader);
+    kuro_gfx_image_destroy(gfx, depth_target);
+    kuro_gfx_readback_destroy(gfx, readback);
+    kuro_gfx_image_destroy(gfx, render_target);
+    kuro_gfx_commands_destroy(gfx, commands);
+    kuro_gfx_destroy(gfx);
+
+    return 0;
+}
@@ -84,8 +84,11 @@ int main()
         }
     )";
 
-    kr_vshader_t vertex_shader = kuro_gfx_vertex_shader_create(gfx, shader, "vs_main");
-    kr_pshader_t pixel_shader = kuro_gfx_pixel_shader_create(gfx, shader, "ps_main");
+    // both entry points compile at the same time
+    kr_compile_t vertex_compile = kuro_gfx_vertex_shader_compile(gfx, shader, "vs_main");
+    kr_compile_t pixel_compile = kuro_gfx_pixel_shader_compile(gfx, shader, "ps_main");
+    kr_vshader_t vertex_shader = kuro_gfx_vertex_shader_get(gfx, vertex_compile);
+    kr_pshader_t pixel_shader = kuro_gfx_pixel_shader_get(gfx, pixel_compile);
 
     Kuro_Gfx_Pipeline_Desc pipeline_desc = {};
     pipeline_desc.vertex_shader = vertex_shader;
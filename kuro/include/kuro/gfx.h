@@ -10,15 +10,22 @@ extern "C" {
 typedef struct _kr_gfx_t *kr_gfx_t;
 typedef struct _kr_swapchain_t *kr_swapchain_t;
 typedef struct _kr_image_t *kr_image_t;
+typedef struct _kr_heap_t *kr_heap_t;
 typedef struct _kr_buffer_t *kr_buffer_t;
 typedef struct _kr_vshader_t *kr_vshader_t;
 typedef struct _kr_pshader_t *kr_pshader_t;
+typedef struct _kr_compile_t *kr_compile_t;
 typedef struct _kr_pipeline_t *kr_pipeline_t;
 typedef struct _kr_commands_t *kr_commands_t;
+typedef struct _kr_readback_t *kr_readback_t;
+typedef struct _kr_stream_t *kr_stream_t;
+typedef struct _kr_fence_t *kr_fence_t;
 
 typedef enum KURO_CONSTANT {
     KURO_CONSTANT_MAX_RENDER_TARGETS = 8,
-    KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES = 16
+    KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES = 16,
+    KURO_CONSTANT_MAX_CONSTANT_BUFFERS = 8,
+    KURO_CONSTANT_MAX_RECORDERS = 64
 } KURO_CONSTANT;
 
 typedef enum KURO_GFX_ACCESS {
@@ -40,6 +47,11 @@ typedef enum KURO_GFX_CLASS {
     KURO_GFX_CLASS_PER_INSTANCE,
 } KURO_GFX_CLASS;
 
+typedef enum KURO_GFX_STREAM_HANDLE {
+    KURO_GFX_STREAM_HANDLE_PIPELINE,
+    KURO_GFX_STREAM_HANDLE_BUFFER
+} KURO_GFX_STREAM_HANDLE;
+
 typedef enum KURO_GFX_PRIMITIVE {
     KURO_GFX_PRIMITIVE_TRIANGLE
 } KURO_GFX_PRIMITIVE;
@@ -64,19 +76,61 @@ typedef struct Kuro_Gfx_Index_Buffer_Desc {
     KURO_GFX_FORMAT format;
 } Kuro_Gfx_Index_Buffer_Desc;
 
+// render_target_count is the number of color targets the pixel shader writes, 0 is treated as 1
 typedef struct Kuro_Gfx_Pipeline_Desc {
     kr_vshader_t vertex_shader;
     kr_pshader_t pixel_shader;
     Kuro_Gfx_Vertex_Attribure vertex_attribures[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES];
+    uint32_t render_target_count;
 } Kuro_Gfx_Pipeline_Desc;
 
+// color_targets are packed from index 0, the first null entry ends the list
+typedef struct Kuro_Gfx_Pass_Desc {
+    kr_image_t color_targets[KURO_CONSTANT_MAX_RENDER_TARGETS];
+    kr_image_t depth_target;
+} Kuro_Gfx_Pass_Desc;
+
+// count vertices or indices per instance, instance_count 0 is treated as 1. first is the first index
+// of indexed draws and the first vertex of the others, base_vertex is added to every index and per
+// instance attributes start at element first_instance
 typedef struct Kuro_Gfx_Draw_Desc {
     KURO_GFX_PRIMITIVE primitive;
     Kuro_Gfx_Vertex_Buffer_Desc vertex_buffers[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES];
     Kuro_Gfx_Index_Buffer_Desc index_buffer;
     uint32_t count;
+    uint32_t instance_count;
+    uint32_t first;
+    int32_t base_vertex;
+    uint32_t first_instance;
 } Kuro_Gfx_Draw_Desc;
 
+// the records of an indirect arguments buffer, laid out like D3D12_DRAW_ARGUMENTS and
+// D3D12_DRAW_INDEXED_ARGUMENTS, fields mean what they mean in Kuro_Gfx_Draw_Desc
+typedef struct Kuro_Gfx_Draw_Arguments {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first;
+    uint32_t first_instance;
+} Kuro_Gfx_Draw_Arguments;
+
+typedef struct Kuro_Gfx_Draw_Indexed_Arguments {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first;
+    int32_t base_vertex;
+    uint32_t first_instance;
+} Kuro_Gfx_Draw_Indexed_Arguments;
+
+// input assembler calls of a command list, vertex_buffer_sets counts set calls and
+// vertex_buffer_views the slots they set
+typedef struct Kuro_Gfx_Input_Stats {
+    uint64_t draws;
+    uint64_t topology_sets;
+    uint64_t vertex_buffer_sets;
+    uint64_t vertex_buffer_views;
+    uint64_t index_buffer_sets;
+} Kuro_Gfx_Input_Stats;
+
 kr_gfx_t kuro_gfx_create();
 void kuro_gfx_destroy(kr_gfx_t gfx);
 
@@ -85,34 +139,151 @@ void kuro_gfx_swapchain_destroy(kr_gfx_t gfx, kr_swapchain_t swapchain);
 void kuro_gfx_swapchain_resize(kr_gfx_t gfx, kr_swapchain_t swapchain, uint32_t width, uint32_t height);
 
 kr_image_t kuro_gfx_image_create(kr_gfx_t gfx, uint32_t width, uint32_t height);
+kr_image_t kuro_gfx_render_target_create(kr_gfx_t gfx, uint32_t width, uint32_t height);
 void kuro_gfx_image_destroy(kr_gfx_t gfx, kr_image_t image);
 
+// placed images live at an offset in a heap and may share its memory with other placed images, which
+// is how the transients of a frame graph (gfx_graph.h) alias. they are created in the state they rest
+// in, kuro_gfx_image_alias hands the memory from before (may be nullptr) to after whose content is
+// undefined until it is cleared. placed images have to be destroyed before their heap
+kr_heap_t kuro_gfx_heap_create(kr_gfx_t gfx, uint64_t size_in_bytes);
+void kuro_gfx_heap_destroy(kr_gfx_t gfx, kr_heap_t heap);
+void kuro_gfx_image_memory(kr_gfx_t gfx, uint32_t width, uint32_t height, bool render_target, uint64_t *size_in_bytes, uint64_t *alignment);
+kr_image_t kuro_gfx_image_place(kr_gfx_t gfx, kr_heap_t heap, uint64_t offset, uint32_t width, uint32_t height, bool render_target);
+void kuro_gfx_image_alias(kr_commands_t commands, kr_image_t before, kr_image_t after);
+
+// a readback receives a copy of a render target (R8G8B8A8_UNORM rows) once the commands that
+// recorded kuro_gfx_readback complete, map waits for them if they are still in flight. map only
+// after kuro_gfx_commands_end of that list, before it there is nothing to wait for
+kr_readback_t kuro_gfx_readback_create(kr_gfx_t gfx, uint32_t width, uint32_t height);
+void kuro_gfx_readback_destroy(kr_gfx_t gfx, kr_readback_t readback);
+bool kuro_gfx_readback_ready(kr_gfx_t gfx, kr_readback_t readback);
+const void *kuro_gfx_readback_map(kr_gfx_t gfx, kr_readback_t readback, uint32_t *row_pitch);
+void kuro_gfx_readback_unmap(kr_gfx_t gfx, kr_readback_t readback);
+
 kr_buffer_t kuro_gfx_buffer_create(kr_gfx_t gfx, KURO_GFX_ACCESS cpu_access, void *data, uint32_t size_in_bytes);
 void kuro_gfx_buffer_destroy(kr_gfx_t gfx, kr_buffer_t buffer);
 
+// uploads stage the contents of KURO_GFX_ACCESS_NONE buffers and render targets in a shared staging
+// arena, kuro_gfx_upload_submit copies everything staged since the last submit in one batch off the
+// graphics queue and returns its token, tokens complete in submission order. kuro_gfx_commands_end
+// submits what is still staged and its commands wait for every submitted upload, so uploaded
+// resources can be used right away. kuro_gfx_buffer_create goes through the same path
+kr_buffer_t kuro_gfx_upload_buffer(kr_gfx_t gfx, const void *data, uint32_t size_in_bytes);
+// pixels are R8G8B8A8_UNORM rows of width * 4 bytes, row_pitch bytes apart
+void kuro_gfx_upload_image(kr_gfx_t gfx, kr_image_t render_target, const void *pixels, uint32_t row_pitch);
+uint64_t kuro_gfx_upload_submit(kr_gfx_t gfx);
+bool kuro_gfx_upload_complete(kr_gfx_t gfx, uint64_t token);
+void kuro_gfx_upload_wait(kr_gfx_t gfx, uint64_t token);
+
 kr_vshader_t kuro_gfx_vertex_shader_create(kr_gfx_t gfx, const char *shader, const char *entry_point);
 void kuro_gfx_vertex_shader_destroy(kr_gfx_t gfx, kr_vshader_t vertex_shader);
 kr_pshader_t kuro_gfx_pixel_shader_create(kr_gfx_t gfx, const char *shader, const char *entry_point);
 void kuro_gfx_pixel_shader_destroy(kr_gfx_t gfx, kr_pshader_t pixel_shader);
+// compiles on the shader compile threads and returns a future, kuro_gfx_*_shader_get waits for it,
+// hands out the shader and releases the compile. compiled code is cached by source, entry point and
+// compile flags, with a shader cache open it comes from the cache file on later runs.
+// kuro_gfx_*_shader_create is a compile followed by a get
+kr_compile_t kuro_gfx_vertex_shader_compile(kr_gfx_t gfx, const char *shader, const char *entry_point);
+kr_compile_t kuro_gfx_pixel_shader_compile(kr_gfx_t gfx, const char *shader, const char *entry_point);
+bool kuro_gfx_shader_ready(kr_compile_t compile);
+kr_vshader_t kuro_gfx_vertex_shader_get(kr_gfx_t gfx, kr_compile_t compile);
+kr_pshader_t kuro_gfx_pixel_shader_get(kr_gfx_t gfx, kr_compile_t compile);
+void kuro_gfx_shader_cache_open(kr_gfx_t gfx, const char *path);
+bool kuro_gfx_shader_cache_save(kr_gfx_t gfx);
 
+// pipelines with the same desc and shader code are created once and shared, every create needs its
+// destroy. with a pipeline cache open, pipelines missing from memory are looked up in the cache file
+// before they are compiled and kuro_gfx_pipeline_cache_save writes the ones compiled since back, a
+// missing or stale file just starts empty
 kr_pipeline_t kuro_gfx_pipeline_create(kr_gfx_t gfx, Kuro_Gfx_Pipeline_Desc desc);
 void kuro_gfx_pipeline_destroy(kr_gfx_t gfx, kr_pipeline_t pipeline);
+void kuro_gfx_pipeline_cache_open(kr_gfx_t gfx, const char *path);
+bool kuro_gfx_pipeline_cache_save(kr_gfx_t gfx);
 
 kr_commands_t kuro_gfx_commands_create(kr_gfx_t gfx);
 void kuro_gfx_commands_destroy(kr_gfx_t gfx, kr_commands_t commands);
 
 void kuro_gfx_commands_begin(kr_gfx_t gfx, kr_commands_t commands, kr_swapchain_t swapchain, kr_image_t depth_target);
+void kuro_gfx_commands_begin_pass(kr_gfx_t gfx, kr_commands_t commands, Kuro_Gfx_Pass_Desc desc);
+// hands out recorder_count recorders that other threads fill concurrently, one thread per recorder,
+// kuro_gfx_commands_end submits what commands recorded before the split, then the recorders in index
+// order, then what commands recorded after the split. a recorder starts with the targets of the pass
+// bound but no pipeline, viewport or buffers, the same goes for commands after the split. recorders
+// belong to commands and are only valid until kuro_gfx_commands_end. they do not transition resources,
+// their barriers would race on the shared states and land in recording order instead of submission
+// order, so readbacks go to commands before or after the split
+void kuro_gfx_commands_split(kr_gfx_t gfx, kr_commands_t commands, uint32_t recorder_count, kr_commands_t *recorders);
 void kuro_gfx_commands_end(kr_gfx_t gfx, kr_commands_t commands);
+// whether kuro_gfx_commands_begin can start recording without waiting for the GPU
+bool kuro_gfx_commands_ready(kr_gfx_t gfx, kr_commands_t commands);
+// draws only set the topology, vertex buffers and index buffer that changed since the previous draw
+// of the list (gfx_input.h), the stats add up every draw commands recorded since it was created,
+// recorders keep their own
+Kuro_Gfx_Input_Stats kuro_gfx_commands_input_stats(kr_commands_t commands);
 
 void kuro_gfx_set_pipeline(kr_commands_t commands, kr_pipeline_t pipeline);
 void kuro_gfx_viewport(kr_commands_t commands, uint32_t width, uint32_t height);
 void kuro_gfx_clear(kr_commands_t commands, Kuro_Gfx_Color color, float depth);
 void kuro_gfx_buffer_write(kr_commands_t commands, kr_buffer_t buffer, void *data, uint32_t size_in_bytes);
+// slot is below KURO_CONSTANT_MAX_CONSTANT_BUFFERS, the shader register b<slot>
 void kuro_gfx_buffer_bind(kr_commands_t commands, kr_buffer_t buffer, uint32_t slot);
 void kuro_gfx_draw(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc);
+// draw_count draws with the buffers of desc and the arguments read from arguments at offset when the
+// commands execute, Kuro_Gfx_Draw_Indexed_Arguments if desc has an index buffer and
+// Kuro_Gfx_Draw_Arguments otherwise, the draw fields of desc are ignored
+void kuro_gfx_draw_indirect(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc, kr_buffer_t arguments, uint32_t offset, uint32_t draw_count);
+void kuro_gfx_readback(kr_commands_t commands, kr_image_t render_target, kr_readback_t readback);
 
 void kuro_gfx_sync(kr_gfx_t gfx);
 
+// a fence is a timeline of increasing values, kuro_gfx_fence_signal sets value once everything
+// submitted before it executed. a callback runs once its value completed, on the thread that first
+// sees it in kuro_gfx_fence_complete, kuro_gfx_fence_wait or kuro_gfx_commands_begin, or right away
+// when the value already completed. callbacks run in value order and must not create or destroy
+// fences, the ones still pending are dropped with their fence
+typedef void (*Kuro_Gfx_Fence_Callback)(void *user_data, uint64_t value);
+
+kr_fence_t kuro_gfx_fence_create(kr_gfx_t gfx);
+void kuro_gfx_fence_destroy(kr_gfx_t gfx, kr_fence_t fence);
+void kuro_gfx_fence_signal(kr_gfx_t gfx, kr_fence_t fence, uint64_t value);
+uint64_t kuro_gfx_fence_value(kr_gfx_t gfx, kr_fence_t fence);
+bool kuro_gfx_fence_complete(kr_gfx_t gfx, kr_fence_t fence, uint64_t value);
+// timeout_ns UINT64_MAX waits forever, returns whether value completed in time
+bool kuro_gfx_fence_wait(kr_gfx_t gfx, kr_fence_t fence, uint64_t value, uint64_t timeout_ns);
+void kuro_gfx_fence_callback(kr_gfx_t gfx, kr_fence_t fence, uint64_t value, Kuro_Gfx_Fence_Callback callback, void *user_data);
+
+// a stream is a backend independent, linear recording of the commands above, it is recorded once
+// and replayed into any kr_commands_t, it does not need a kr_gfx_t and holds no backend state
+kr_stream_t kuro_gfx_stream_create(void);
+void kuro_gfx_stream_destroy(kr_stream_t stream);
+void kuro_gfx_stream_reset(kr_stream_t stream);
+
+void kuro_gfx_stream_set_pipeline(kr_stream_t stream, kr_pipeline_t pipeline);
+void kuro_gfx_stream_viewport(kr_stream_t stream, uint32_t width, uint32_t height);
+void kuro_gfx_stream_clear(kr_stream_t stream, Kuro_Gfx_Color color, float depth);
+// the data is copied into the stream, returns the index of the write for kuro_gfx_stream_write_data
+uint32_t kuro_gfx_stream_buffer_write(kr_stream_t stream, kr_buffer_t buffer, const void *data, uint32_t size_in_bytes);
+void kuro_gfx_stream_buffer_bind(kr_stream_t stream, kr_buffer_t buffer, uint32_t slot);
+void kuro_gfx_stream_draw(kr_stream_t stream, Kuro_Gfx_Draw_Desc desc);
+
+// the copy of a recorded buffer write, it can be updated between replays, valid until the next recording call
+void *kuro_gfx_stream_write_data(kr_stream_t stream, uint32_t write);
+// checks the encoding, that every handle is set and that every draw has a pipeline and a viewport
+bool kuro_gfx_stream_validate(kr_stream_t stream);
+// removes state changes that set what is already set, returns the number of removed commands
+uint32_t kuro_gfx_stream_optimize(kr_stream_t stream);
+void kuro_gfx_stream_replay(kr_stream_t stream, kr_commands_t commands);
+
+// handles are stored in a table in order of first use and saved as indices, a loaded stream has
+// null handles that have to be set before it is replayed
+uint32_t kuro_gfx_stream_save(kr_stream_t stream, void *data, uint32_t capacity);
+kr_stream_t kuro_gfx_stream_load(const void *data, uint32_t size_in_bytes);
+uint32_t kuro_gfx_stream_handle_count(kr_stream_t stream);
+KURO_GFX_STREAM_HANDLE kuro_gfx_stream_handle_kind(kr_stream_t stream, uint32_t index);
+void kuro_gfx_stream_pipeline_set(kr_stream_t stream, uint32_t index, kr_pipeline_t pipeline);
+void kuro_gfx_stream_buffer_set(kr_stream_t stream, uint32_t index, kr_buffer_t buffer);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
\ No newline at end of file
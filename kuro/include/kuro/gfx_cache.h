@@ -0,0 +1,39 @@
+#pragma once
+
+// backend independent store of compiled pipelines (src/kuro/gfx_cache.cpp) the backends use for
+// kuro_gfx_pipeline_cache_open
+//
+//     * keys are 64 bit content hashes, kuro_gfx_pipeline_hash covers a Kuro_Gfx_Pipeline_Desc and the
+//       code of its shaders but not the shader handles, so the same pipeline built from shaders that
+//       were created again gets the same key
+//     * the file is mapped read only and lookups are served from the mapping, entries inserted after
+//       opening stay in memory until kuro_gfx_cache_save rewrites the file with both
+
+#include "kuro/gfx.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _kr_cache_t *kr_cache_t;
+
+uint64_t kuro_gfx_cache_hash(const void *data, size_t size_in_bytes, uint64_t seed);
+// only the attributes up to the first KURO_GFX_FORMAT_NONE count, render_target_count 0 is 1
+uint64_t kuro_gfx_pipeline_hash(Kuro_Gfx_Pipeline_Desc desc, const void *vertex_code, size_t vertex_code_size, const void *pixel_code, size_t pixel_code_size);
+
+// a missing or invalid file opens an empty cache, saving replaces it. a null path keeps the cache
+// in memory only and saving it fails
+kr_cache_t kuro_gfx_cache_open(const char *path);
+void kuro_gfx_cache_close(kr_cache_t cache);
+// the data stays valid until the cache is saved or closed
+const void *kuro_gfx_cache_find(kr_cache_t cache, uint64_t key, size_t *size_in_bytes);
+// replaces the data of a key that is already present, e.g. a blob the driver no longer accepts
+void kuro_gfx_cache_insert(kr_cache_t cache, uint64_t key, const void *data, size_t size_in_bytes);
+uint32_t kuro_gfx_cache_count(kr_cache_t cache);
+bool kuro_gfx_cache_save(kr_cache_t cache);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
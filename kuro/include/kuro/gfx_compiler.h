@@ -0,0 +1,53 @@
+#pragma once
+
+// backend independent shader compile threads and compile cache (src/kuro/gfx_compiler.cpp), the
+// backends plug their compiler in as a Kuro_Gfx_Shader_Compile
+//
+//     * compiled code is cached by kuro_gfx_shader_hash of the source, entry point, profile and flags,
+//       in memory until kuro_gfx_compiler_cache_open swaps in a cache file that is kept across runs
+//     * a submit that hits the cache is ready right away, a submit of a key that is still compiling
+//       shares that compile, everything else is queued for the compile threads
+//     * a kr_compile_t is a future, kuro_gfx_compile_wait blocks until its code is there and every
+//       submit needs its kuro_gfx_compile_release
+
+#include "kuro/gfx.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _kr_compiler_t *kr_compiler_t;
+
+typedef struct Kuro_Gfx_Shader_Source {
+    const char *source;
+    size_t source_size;
+    const char *entry_point;
+    const char *profile;
+    uint32_t flags;
+} Kuro_Gfx_Shader_Source;
+
+// runs on the compile threads, returns malloc'ed code that the compiler frees or nullptr on errors
+typedef void *(*Kuro_Gfx_Shader_Compile)(void *user_data, Kuro_Gfx_Shader_Source source, size_t *code_size);
+
+uint64_t kuro_gfx_shader_hash(Kuro_Gfx_Shader_Source source);
+
+// thread_count 0 uses every core but one
+kr_compiler_t kuro_gfx_compiler_create(Kuro_Gfx_Shader_Compile compile, void *user_data, uint32_t thread_count);
+// finishes the queued compiles first, every compile has to be released before
+void kuro_gfx_compiler_destroy(kr_compiler_t compiler);
+// replaces the cache, open it before the first submit
+void kuro_gfx_compiler_cache_open(kr_compiler_t compiler, const char *path);
+bool kuro_gfx_compiler_cache_save(kr_compiler_t compiler);
+
+// the strings of source are copied
+kr_compile_t kuro_gfx_compile_submit(kr_compiler_t compiler, Kuro_Gfx_Shader_Source source);
+bool kuro_gfx_compile_ready(kr_compile_t compile);
+// returns nullptr if the compile failed, the code belongs to compile
+const void *kuro_gfx_compile_wait(kr_compile_t compile, size_t *code_size);
+void kuro_gfx_compile_release(kr_compile_t compile);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,228 @@
+#pragma once
+
+// descriptor slot allocator the backends use to share a few large descriptor heaps, it only hands
+// out indices into [0, capacity) so it knows nothing about D3D12
+//
+//     * a buddy allocator, ranges are rounded up to a power of two size class and start at a
+//       multiple of their size, every class has its own free list and a bit in free_mask, so alloc
+//       and free are a handful of operations
+//     * a class with no free range splits the smallest larger free range, the back halves go to the
+//       classes in between
+//     * a range that becomes free merges with its buddy (index ^ size) while the buddy is free and
+//       of the same class, so a heap whose ranges are all freed is back to its initial ranges
+//     * kuro_gfx_descriptor_free with a fence keeps the range pending until
+//       kuro_gfx_descriptor_retire sees that fence completed, the GPU may still read it until then
+//
+// the bookkeeping of a range lives in blocks[first slot of the range], free lists are doubly linked
+// so a buddy can be taken out of the middle of one, pending ranges form a FIFO in fence order
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum KURO_GFX_DESCRIPTOR_CONSTANT {
+    KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES = 32,
+    KURO_GFX_DESCRIPTOR_CONSTANT_NONE = -1
+} KURO_GFX_DESCRIPTOR_CONSTANT;
+
+typedef struct Kuro_Gfx_Descriptor_Block {
+    uint32_t next;
+    uint32_t prev;
+    uint32_t size_class;
+    uint32_t free;
+    uint64_t fence;
+} Kuro_Gfx_Descriptor_Block;
+
+typedef struct Kuro_Gfx_Descriptor_Allocator {
+    uint32_t capacity;
+    uint32_t free_mask;
+    uint32_t free_lists[KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES];
+    uint32_t pending_first;
+    uint32_t pending_last;
+    uint32_t used;
+    Kuro_Gfx_Descriptor_Block *blocks;
+} Kuro_Gfx_Descriptor_Allocator;
+
+inline static uint32_t
+_kuro_gfx_descriptor_size_class(uint32_t count)
+{
+    uint32_t size_class = 0;
+    while ((1u << size_class) < count)
+        ++size_class;
+    return size_class;
+}
+
+inline static uint32_t
+_kuro_gfx_descriptor_lowest_bit(uint32_t mask)
+{
+    uint32_t bit = 0;
+    while ((mask & (1u << bit)) == 0)
+        ++bit;
+    return bit;
+}
+
+inline static void
+_kuro_gfx_descriptor_push(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t index, uint32_t size_class)
+{
+    Kuro_Gfx_Descriptor_Block *block = &allocator->blocks[index];
+    block->next = allocator->free_lists[size_class];
+    block->prev = (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE;
+    block->size_class = size_class;
+    block->free = 1;
+    if (block->next != (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE)
+        allocator->blocks[block->next].prev = index;
+    allocator->free_lists[size_class] = index;
+    allocator->free_mask |= 1u << size_class;
+}
+
+inline static void
+_kuro_gfx_descriptor_unlink(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t index)
+{
+    Kuro_Gfx_Descriptor_Block *block = &allocator->blocks[index];
+    if (block->prev == (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE)
+        allocator->free_lists[block->size_class] = block->next;
+    else
+        allocator->blocks[block->prev].next = block->next;
+    if (block->next != (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE)
+        allocator->blocks[block->next].prev = block->prev;
+
+    if (allocator->free_lists[block->size_class] == (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE)
+        allocator->free_mask &= ~(1u << block->size_class);
+    block->free = 0;
+}
+
+inline static uint32_t
+_kuro_gfx_descriptor_pop(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t size_class)
+{
+    uint32_t index = allocator->free_lists[size_class];
+    _kuro_gfx_descriptor_unlink(allocator, index);
+    return index;
+}
+
+// merges the range with its free buddies before it goes back to a free list
+inline static void
+_kuro_gfx_descriptor_release(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t index, uint32_t size_class)
+{
+    while (size_class + 1 < KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES - 1)
+    {
+        uint32_t buddy = index ^ (1u << size_class);
+        if (buddy > allocator->capacity - (1u << size_class))
+            break;
+        Kuro_Gfx_Descriptor_Block *block = &allocator->blocks[buddy];
+        if (!block->free || block->size_class != size_class)
+            break;
+
+        _kuro_gfx_descriptor_unlink(allocator, buddy);
+        index &= buddy;
+        ++size_class;
+    }
+    _kuro_gfx_descriptor_push(allocator, index, size_class);
+}
+
+inline static void
+kuro_gfx_descriptor_init(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t capacity)
+{
+    assert(capacity < (1u << (KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES - 1)));
+    allocator->capacity = capacity;
+    allocator->free_mask = 0;
+    for (int i = 0; i < KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES; ++i)
+        allocator->free_lists[i] = (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE;
+    allocator->pending_first = (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE;
+    allocator->pending_last = (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE;
+    allocator->used = 0;
+    allocator->blocks = (Kuro_Gfx_Descriptor_Block *)malloc(capacity * sizeof(Kuro_Gfx_Descriptor_Block));
+
+    // one initial range per set bit of capacity, largest first so every one is aligned to its size
+    uint32_t index = 0;
+    for (uint32_t c = KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES - 1; c-- > 0;)
+    {
+        if (capacity & (1u << c))
+        {
+            _kuro_gfx_descriptor_push(allocator, index, c);
+            index += 1u << c;
+        }
+    }
+}
+
+inline static void
+kuro_gfx_descriptor_destroy(Kuro_Gfx_Descriptor_Allocator *allocator)
+{
+    free(allocator->blocks);
+    allocator->blocks = NULL;
+}
+
+// finds count contiguous slots, returns false when no free range is large enough
+inline static bool
+kuro_gfx_descriptor_alloc(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t count, uint32_t *index)
+{
+    assert(count > 0);
+    uint32_t size_class = _kuro_gfx_descriptor_size_class(count);
+    if (size_class >= KURO_GFX_DESCRIPTOR_CONSTANT_SIZE_CLASSES - 1)
+        return false;
+
+    uint32_t fits = allocator->free_mask & ~((1u << size_class) - 1);
+    if (fits == 0)
+        return false;
+
+    // keep the front of the range, its back halves go to the classes in between
+    uint32_t split_class = _kuro_gfx_descriptor_lowest_bit(fits);
+    *index = _kuro_gfx_descriptor_pop(allocator, split_class);
+    for (uint32_t c = size_class; c < split_class; ++c)
+        _kuro_gfx_descriptor_push(allocator, *index + (1u << c), c);
+
+    allocator->blocks[*index].size_class = size_class;
+    allocator->used += 1u << size_class;
+    return true;
+}
+
+// fence 0 makes the range available right away
+inline static void
+kuro_gfx_descriptor_free(Kuro_Gfx_Descriptor_Allocator *allocator, uint32_t index, uint64_t fence)
+{
+    assert(index < allocator->capacity);
+    Kuro_Gfx_Descriptor_Block *block = &allocator->blocks[index];
+    assert(!block->free);
+    allocator->used -= 1u << block->size_class;
+
+    if (fence == 0)
+    {
+        _kuro_gfx_descriptor_release(allocator, index, block->size_class);
+        return;
+    }
+
+    block->fence = fence;
+    block->next = (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE;
+    if (allocator->pending_last == (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE)
+    {
+        allocator->pending_first = index;
+    }
+    else
+    {
+        assert(fence >= allocator->blocks[allocator->pending_last].fence);
+        allocator->blocks[allocator->pending_last].next = index;
+    }
+    allocator->pending_last = index;
+}
+
+inline static void
+kuro_gfx_descriptor_retire(Kuro_Gfx_Descriptor_Allocator *allocator, uint64_t completed_fence)
+{
+    while (allocator->pending_first != (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE &&
+           allocator->blocks[allocator->pending_first].fence <= completed_fence)
+    {
+        uint32_t index = allocator->pending_first;
+        allocator->pending_first = allocator->blocks[index].next;
+        if (allocator->pending_first == (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE)
+            allocator->pending_last = (uint32_t)KURO_GFX_DESCRIPTOR_CONSTANT_NONE;
+        _kuro_gfx_descriptor_release(allocator, index, allocator->blocks[index].size_class);
+    }
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
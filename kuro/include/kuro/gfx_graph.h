@@ -0,0 +1,78 @@
+#pragma once
+
+// backend independent frame graph (src/kuro/gfx_graph.cpp), passes declare how they use resources
+// and compiling the graph works out which passes run, the barriers between them and where transient
+// resources live
+//
+//     * a use writes when its usage has a KURO_GFX_GRAPH_USAGE_WRITE bit, writes keep the content, so a
+//       pass drawing over an earlier one depends on it
+//     * a pass survives when it has side effects, writes an imported resource or writes something a
+//       surviving pass uses later, the rest are culled
+//     * every surviving pass gets one batch of barriers, reads that follow each other without a write
+//       in between are merged into one combined state so the resource only moves once
+//     * transient resources that are never alive at the same time share memory, the first use of a
+//       transient always gets a barrier from usage 0 which is marked aliasing when another transient
+//       used the memory before, its content is undefined then and the pass has to clear it
+//     * the graph is rebuilt every frame, kuro_gfx_graph_reset keeps its allocations
+
+#include "kuro/gfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _kr_graph_t *kr_graph_t;
+
+typedef enum KURO_GFX_GRAPH_USAGE {
+    KURO_GFX_GRAPH_USAGE_RENDER_TARGET = 1 << 0,
+    KURO_GFX_GRAPH_USAGE_DEPTH_WRITE = 1 << 1,
+    KURO_GFX_GRAPH_USAGE_COPY_DEST = 1 << 2,
+    KURO_GFX_GRAPH_USAGE_DEPTH_READ = 1 << 3,
+    KURO_GFX_GRAPH_USAGE_SHADER_READ = 1 << 4,
+    KURO_GFX_GRAPH_USAGE_COPY_SOURCE = 1 << 5,
+    KURO_GFX_GRAPH_USAGE_VERTEX_BUFFER = 1 << 6,
+    KURO_GFX_GRAPH_USAGE_INDEX_BUFFER = 1 << 7,
+    KURO_GFX_GRAPH_USAGE_PRESENT = 1 << 8,
+    KURO_GFX_GRAPH_USAGE_WRITE = KURO_GFX_GRAPH_USAGE_RENDER_TARGET | KURO_GFX_GRAPH_USAGE_DEPTH_WRITE | KURO_GFX_GRAPH_USAGE_COPY_DEST
+} KURO_GFX_GRAPH_USAGE;
+
+// before and after are KURO_GFX_GRAPH_USAGE bits
+typedef struct Kuro_Gfx_Graph_Barrier {
+    uint32_t resource;
+    uint32_t before;
+    uint32_t after;
+    bool aliasing;
+} Kuro_Gfx_Graph_Barrier;
+
+// context is what kuro_gfx_graph_execute was given, usually the kr_commands_t the frame records into
+typedef void (*Kuro_Gfx_Graph_Pass)(void *user_data, void *context);
+typedef void (*Kuro_Gfx_Graph_Barriers)(void *context, const Kuro_Gfx_Graph_Barrier *barriers, uint32_t barrier_count);
+
+kr_graph_t kuro_gfx_graph_create(void);
+void kuro_gfx_graph_destroy(kr_graph_t graph);
+void kuro_gfx_graph_reset(kr_graph_t graph);
+
+// resources and passes are numbered in the order they are added
+uint32_t kuro_gfx_graph_transient(kr_graph_t graph, uint64_t size_in_bytes, uint64_t alignment);
+// final_usage 0 leaves an imported resource in whatever state its last use left it
+uint32_t kuro_gfx_graph_import(kr_graph_t graph, uint32_t initial_usage, uint32_t final_usage);
+uint32_t kuro_gfx_graph_pass(kr_graph_t graph, Kuro_Gfx_Graph_Pass execute, void *user_data, bool side_effects);
+// uses of the same resource in one pass are combined
+void kuro_gfx_graph_use(kr_graph_t graph, uint32_t pass, uint32_t resource, uint32_t usage);
+
+void kuro_gfx_graph_compile(kr_graph_t graph);
+bool kuro_gfx_graph_culled(kr_graph_t graph, uint32_t pass);
+const Kuro_Gfx_Graph_Barrier *kuro_gfx_graph_barriers(kr_graph_t graph, uint32_t pass, uint32_t *barrier_count);
+// the barriers that move imported resources to their final usage after the last pass
+const Kuro_Gfx_Graph_Barrier *kuro_gfx_graph_final_barriers(kr_graph_t graph, uint32_t *barrier_count);
+uint32_t kuro_gfx_graph_barrier_count(kr_graph_t graph);
+// the memory all transients need together and where each one lives in it
+uint64_t kuro_gfx_graph_memory_size(kr_graph_t graph);
+uint64_t kuro_gfx_graph_offset(kr_graph_t graph, uint32_t resource);
+
+// runs the surviving passes in order, each one after its barriers, and then the final barriers
+void kuro_gfx_graph_execute(kr_graph_t graph, Kuro_Gfx_Graph_Barriers barriers, void *context);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
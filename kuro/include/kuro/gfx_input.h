@@ -0,0 +1,121 @@
+#pragma once
+
+// input assembler state cache, the backends diff the topology and buffers of every draw against what
+// their list already has bound and only set what changed. views are opaque (the D3D12 backend uses
+// GPU virtual addresses, the soft backend buffer handles), so it knows nothing about D3D12
+//
+//     * kuro_gfx_input_reset matches a list that was just reset, no topology and no buffers bound
+//     * the vertex slots that changed are handed out as runs of consecutive slots, one set call per
+//       run, unchanged slots between two runs are not set again
+//     * a null vertex slot or a null index buffer keeps what is bound, a draw never reads the slots
+//       its pipeline has no attributes for and a draw without indices never reads the index buffer
+//
+// the stats are kept since kuro_gfx_input_init, kuro_gfx_input_reset keeps them
+
+#include "kuro/gfx.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum KURO_GFX_INPUT_CONSTANT {
+    // every other slot changed
+    KURO_GFX_INPUT_CONSTANT_MAX_RANGES = KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES / 2
+} KURO_GFX_INPUT_CONSTANT;
+
+// address 0 is no buffer
+typedef struct Kuro_Gfx_Input_View {
+    uint64_t address;
+    uint32_t size_in_bytes;
+    // the stride of vertex buffers, the KURO_GFX_FORMAT of index buffers
+    uint32_t layout;
+} Kuro_Gfx_Input_View;
+
+typedef struct Kuro_Gfx_Input_Range {
+    uint32_t start;
+    uint32_t count;
+} Kuro_Gfx_Input_Range;
+
+typedef struct Kuro_Gfx_Input_Changes {
+    bool topology;
+    bool index_buffer;
+    uint32_t range_count;
+    Kuro_Gfx_Input_Range ranges[KURO_GFX_INPUT_CONSTANT_MAX_RANGES];
+} Kuro_Gfx_Input_Changes;
+
+typedef struct Kuro_Gfx_Input_Cache {
+    uint32_t topology;
+    Kuro_Gfx_Input_View vertex_buffers[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES];
+    Kuro_Gfx_Input_View index_buffer;
+    Kuro_Gfx_Input_Stats stats;
+} Kuro_Gfx_Input_Cache;
+
+inline static void
+kuro_gfx_input_init(Kuro_Gfx_Input_Cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+inline static void
+kuro_gfx_input_reset(Kuro_Gfx_Input_Cache *cache)
+{
+    Kuro_Gfx_Input_Stats stats = cache->stats;
+    memset(cache, 0, sizeof(*cache));
+    cache->stats = stats;
+}
+
+inline static bool
+_kuro_gfx_input_view_equal(const Kuro_Gfx_Input_View *a, const Kuro_Gfx_Input_View *b)
+{
+    return a->address == b->address && a->size_in_bytes == b->size_in_bytes && a->layout == b->layout;
+}
+
+// topology 0 is no topology, vertex_buffers holds KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES views,
+// index_buffer may be NULL. the cache holds the new state once it returns
+inline static void
+kuro_gfx_input_draw(Kuro_Gfx_Input_Cache *cache, uint32_t topology, const Kuro_Gfx_Input_View *vertex_buffers, const Kuro_Gfx_Input_View *index_buffer, Kuro_Gfx_Input_Changes *changes)
+{
+    ++cache->stats.draws;
+
+    changes->topology = topology != cache->topology;
+    cache->topology = topology;
+    if (changes->topology)
+        ++cache->stats.topology_sets;
+
+    changes->range_count = 0;
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+    {
+        const Kuro_Gfx_Input_View *view = &vertex_buffers[i];
+        if (view->address == 0 || _kuro_gfx_input_view_equal(view, &cache->vertex_buffers[i]))
+            continue;
+
+        cache->vertex_buffers[i] = *view;
+        ++cache->stats.vertex_buffer_views;
+
+        Kuro_Gfx_Input_Range *last = changes->range_count ? &changes->ranges[changes->range_count - 1] : NULL;
+        if (last && last->start + last->count == i)
+        {
+            ++last->count;
+        }
+        else
+        {
+            changes->ranges[changes->range_count].start = i;
+            changes->ranges[changes->range_count].count = 1;
+            ++changes->range_count;
+        }
+    }
+    cache->stats.vertex_buffer_sets += changes->range_count;
+
+    changes->index_buffer = index_buffer && index_buffer->address && !_kuro_gfx_input_view_equal(index_buffer, &cache->index_buffer);
+    if (changes->index_buffer)
+    {
+        cache->index_buffer = *index_buffer;
+        ++cache->stats.index_buffer_sets;
+    }
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,137 @@
+#pragma once
+
+// fence guarded ring allocator the backends use to suballocate per frame upload memory, it only
+// hands out offsets into [0, capacity) so it works the same over a mapped D3D12 upload heap or plain
+// memory. head and tail count every byte ever allocated, the offset of a position is position %
+// capacity, so the bytes in flight are simply head - tail
+//
+//     kuro_gfx_ring_alloc      bump head, fails when the allocation would reach memory still in flight
+//     kuro_gfx_ring_frame_end  everything allocated so far is in flight until fence completes
+//     kuro_gfx_ring_frame_end_at  the same up to a position, for allocations of several open lists
+//     kuro_gfx_ring_retire     releases the frames whose fence completed
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum KURO_GFX_RING_CONSTANT {
+    KURO_GFX_RING_CONSTANT_MAX_FRAMES = 16
+} KURO_GFX_RING_CONSTANT;
+
+typedef struct Kuro_Gfx_Ring_Frame {
+    uint64_t fence;
+    uint64_t end;
+} Kuro_Gfx_Ring_Frame;
+
+typedef struct Kuro_Gfx_Ring {
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    Kuro_Gfx_Ring_Frame frames[KURO_GFX_RING_CONSTANT_MAX_FRAMES];
+    uint32_t frame_first;
+    uint32_t frame_count;
+} Kuro_Gfx_Ring;
+
+inline static uint64_t
+_kuro_gfx_ring_align(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+inline static void
+kuro_gfx_ring_init(Kuro_Gfx_Ring *ring, uint64_t capacity)
+{
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->frame_first = 0;
+    ring->frame_count = 0;
+}
+
+// alignment has to divide the capacity, an allocation never wraps around the end of the range
+inline static bool
+kuro_gfx_ring_alloc(Kuro_Gfx_Ring *ring, uint64_t size, uint64_t alignment, uint64_t *offset)
+{
+    assert(alignment && ring->capacity % alignment == 0);
+
+    // nothing in flight, start over so an empty ring never pays for the padding of a wrap
+    if (ring->head == ring->tail)
+    {
+        ring->head = 0;
+        ring->tail = 0;
+    }
+
+    uint64_t start = _kuro_gfx_ring_align(ring->head, alignment);
+    if (start % ring->capacity + size > ring->capacity)
+        start = _kuro_gfx_ring_align(start, ring->capacity);
+
+    if (size > ring->capacity || start + size - ring->tail > ring->capacity)
+        return false;
+
+    ring->head = start + size;
+    *offset = start % ring->capacity;
+    return true;
+}
+
+// fences have to increase, frames without allocations are skipped and when every frame slot is
+// taken the newest frame is extended instead. end is the position the frame reaches, between the end
+// of the newest frame and head, what lies after it still belongs to the next frame
+inline static void
+kuro_gfx_ring_frame_end_at(Kuro_Gfx_Ring *ring, uint64_t fence, uint64_t end)
+{
+    assert(end <= ring->head);
+    if (ring->frame_count)
+    {
+        Kuro_Gfx_Ring_Frame *last = &ring->frames[(ring->frame_first + ring->frame_count - 1) % KURO_GFX_RING_CONSTANT_MAX_FRAMES];
+        assert(fence >= last->fence && end >= last->end);
+        if (last->end == end)
+            return;
+        if (ring->frame_count == KURO_GFX_RING_CONSTANT_MAX_FRAMES)
+        {
+            last->fence = fence;
+            last->end = end;
+            return;
+        }
+    }
+    else if (ring->tail == end)
+    {
+        return;
+    }
+
+    Kuro_Gfx_Ring_Frame *frame = &ring->frames[(ring->frame_first + ring->frame_count) % KURO_GFX_RING_CONSTANT_MAX_FRAMES];
+    frame->fence = fence;
+    frame->end = end;
+    ring->frame_count++;
+}
+
+inline static void
+kuro_gfx_ring_frame_end(Kuro_Gfx_Ring *ring, uint64_t fence)
+{
+    kuro_gfx_ring_frame_end_at(ring, fence, ring->head);
+}
+
+inline static void
+kuro_gfx_ring_retire(Kuro_Gfx_Ring *ring, uint64_t completed_fence)
+{
+    while (ring->frame_count && ring->frames[ring->frame_first].fence <= completed_fence)
+    {
+        ring->tail = ring->frames[ring->frame_first].end;
+        ring->frame_first = (ring->frame_first + 1) % KURO_GFX_RING_CONSTANT_MAX_FRAMES;
+        ring->frame_count--;
+    }
+}
+
+// the fence to wait on before retiring frees any memory, 0 when nothing is in flight
+inline static uint64_t
+kuro_gfx_ring_oldest_fence(const Kuro_Gfx_Ring *ring)
+{
+    return ring->frame_count ? ring->frames[ring->frame_first].fence : 0;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+// extensions of the CPU software backend (src/kuro/linux/gfx_soft.cpp), shaders are plain
+// callbacks registered by entry point name, kuro_gfx_vertex_shader_create and
+// kuro_gfx_pixel_shader_create look them up and ignore the shader source
+
+#include "kuro/gfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum KURO_GFX_SOFT_CONSTANT {
+    KURO_GFX_SOFT_CONSTANT_PIXEL_LANES = 8,
+    KURO_GFX_SOFT_CONSTANT_MAX_CONSTANT_BUFFERS = KURO_CONSTANT_MAX_CONSTANT_BUFFERS,
+    KURO_GFX_SOFT_CONSTANT_MAX_VARYINGS = 32,
+    KURO_GFX_SOFT_CONSTANT_MAX_ATTRIBUTE_FLOATS = 64
+} KURO_GFX_SOFT_CONSTANT;
+
+// attributes are the pipeline vertex attributes converted to floats and packed in order, vertex_id
+// and instance_id follow SV_VertexID (first vertex and base vertex included) and SV_InstanceID (first
+// instance not included)
+typedef struct Kuro_Gfx_Soft_Vertex {
+    const float *attributes;
+    const void *const *constants;
+    uint32_t vertex_id;
+    uint32_t instance_id;
+} Kuro_Gfx_Soft_Vertex;
+
+// a span of up to 8 horizontally adjacent pixels, lane i is pixel (x + i, y) and is covered when bit
+// i of mask is set, values are stored per lane so shaders can use the kuro_math f32x8 kernels:
+// depth[i] and varyings[j * 8 + i], varyings are interpolated with perspective correction
+typedef struct Kuro_Gfx_Soft_Pixels {
+    uint32_t x, y;
+    uint32_t mask;
+    const float *depth;
+    const float *varyings;
+    const void *const *constants;
+} Kuro_Gfx_Soft_Pixels;
+
+// writes the clip space position (D3D conventions, 0 <= z <= w) and varying_count varyings
+typedef void (*Kuro_Gfx_Soft_Vertex_Shader)(const Kuro_Gfx_Soft_Vertex *vertex, float position[4], float *varyings);
+// writes color[(t * 4 + c) * 8 + i] of render target t for the covered lanes, the swapchain is
+// target 0, colors are clamped to [0, 1] and stored as R8G8B8A8_UNORM
+typedef void (*Kuro_Gfx_Soft_Pixel_Shader)(const Kuro_Gfx_Soft_Pixels *pixels, float *color);
+
+// thread_count 0 uses all the hardware threads
+kr_gfx_t kuro_gfx_soft_create(uint32_t thread_count);
+
+void kuro_gfx_soft_vertex_shader_register(kr_gfx_t gfx, const char *entry_point, Kuro_Gfx_Soft_Vertex_Shader shader, uint32_t varying_count);
+void kuro_gfx_soft_pixel_shader_register(kr_gfx_t gfx, const char *entry_point, Kuro_Gfx_Soft_Pixel_Shader shader);
+
+// copies width * height R8G8B8A8 pixels of the last presented image
+void kuro_gfx_soft_swapchain_read(kr_gfx_t gfx, kr_swapchain_t swapchain, uint32_t *pixels);
+// copies width * height depth values
+void kuro_gfx_soft_image_read(kr_gfx_t gfx, kr_image_t image, float *depth);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,221 @@
+#pragma once
+
+// resource state tracker the backends batch their barriers with, states are opaque bit masks (the
+// D3D12 backend uses D3D12_RESOURCE_STATES as they are, 0 is the common state) and resources are
+// opaque handles, so it knows nothing about D3D12
+//
+//     * a resource holds the state it is in once the pending barriers are flushed, requesting that
+//       state again adds nothing
+//     * two states inside read_mask combine into their union, a read the current read state already
+//       covers adds nothing
+//     * a request for a subresource that already has a barrier in the batch retargets that barrier, no
+//       work ran in between, a barrier that ends where it started is dropped
+//     * resources start out uniform, a request for one subresource splits them, a request for all of
+//       them transitions every subresource that differs and makes them uniform again
+//     * kuro_gfx_state_flush hands the batch over at the boundaries where work uses the states, draws,
+//       copies and the end of a list
+//
+// the requested, elided, emitted and flushes counters are kept since kuro_gfx_state_init
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum KURO_GFX_STATE_CONSTANT {
+    KURO_GFX_STATE_CONSTANT_ALL_SUBRESOURCES = -1
+} KURO_GFX_STATE_CONSTANT;
+
+typedef struct Kuro_Gfx_State_Resource {
+    void *handle;
+    uint32_t subresource_count;
+    uint32_t state;
+    // NULL while every subresource is in state
+    uint32_t *subresource_states;
+} Kuro_Gfx_State_Resource;
+
+typedef struct Kuro_Gfx_State_Barrier {
+    Kuro_Gfx_State_Resource *resource;
+    uint32_t subresource;
+    uint32_t before;
+    uint32_t after;
+} Kuro_Gfx_State_Barrier;
+
+typedef struct Kuro_Gfx_State_Tracker {
+    uint32_t read_mask;
+    Kuro_Gfx_State_Barrier *barriers;
+    uint32_t barrier_count;
+    uint32_t barrier_capacity;
+    uint64_t requested;
+    uint64_t elided;
+    uint64_t emitted;
+    uint64_t flushes;
+} Kuro_Gfx_State_Tracker;
+
+inline static void
+kuro_gfx_state_resource_init(Kuro_Gfx_State_Resource *resource, void *handle, uint32_t subresource_count, uint32_t state)
+{
+    assert(subresource_count > 0);
+    resource->handle = handle;
+    resource->subresource_count = subresource_count;
+    resource->state = state;
+    resource->subresource_states = NULL;
+}
+
+inline static void
+kuro_gfx_state_resource_destroy(Kuro_Gfx_State_Resource *resource)
+{
+    free(resource->subresource_states);
+    resource->subresource_states = NULL;
+}
+
+inline static uint32_t
+kuro_gfx_state_get(const Kuro_Gfx_State_Resource *resource, uint32_t subresource)
+{
+    if (resource->subresource_states == NULL)
+        return resource->state;
+    assert(subresource < resource->subresource_count && "a split resource has no single state");
+    return resource->subresource_states[subresource];
+}
+
+inline static void
+kuro_gfx_state_init(Kuro_Gfx_State_Tracker *tracker, uint32_t read_mask)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->read_mask = read_mask;
+}
+
+inline static void
+kuro_gfx_state_destroy(Kuro_Gfx_State_Tracker *tracker)
+{
+    assert(tracker->barrier_count == 0 && "pending barriers were never flushed");
+    free(tracker->barriers);
+    tracker->barriers = NULL;
+}
+
+// the state a subresource in current ends up in when state is requested
+inline static uint32_t
+_kuro_gfx_state_target(const Kuro_Gfx_State_Tracker *tracker, uint32_t current, uint32_t state)
+{
+    bool current_read = current != 0 && (current & ~tracker->read_mask) == 0;
+    bool read = state != 0 && (state & ~tracker->read_mask) == 0;
+    return current_read && read ? current | state : state;
+}
+
+// moves one subresource from current to state, returns true if that added a barrier to the batch
+inline static bool
+_kuro_gfx_state_transition(Kuro_Gfx_State_Tracker *tracker, Kuro_Gfx_State_Resource *resource, uint32_t subresource, uint32_t current, uint32_t state)
+{
+    if (state == current)
+        return false;
+
+    for (uint32_t i = tracker->barrier_count; i-- > 0;)
+    {
+        Kuro_Gfx_State_Barrier *barrier = &tracker->barriers[i];
+        if (barrier->resource != resource || barrier->subresource != subresource)
+            continue;
+
+        barrier->after = state;
+        if (barrier->before == barrier->after)
+        {
+            memmove(barrier, barrier + 1, (tracker->barrier_count - i - 1) * sizeof(Kuro_Gfx_State_Barrier));
+            --tracker->barrier_count;
+        }
+        return false;
+    }
+
+    if (tracker->barrier_count == tracker->barrier_capacity)
+    {
+        tracker->barrier_capacity = tracker->barrier_capacity ? tracker->barrier_capacity * 2 : 16;
+        tracker->barriers = (Kuro_Gfx_State_Barrier *)realloc(tracker->barriers, tracker->barrier_capacity * sizeof(Kuro_Gfx_State_Barrier));
+    }
+    Kuro_Gfx_State_Barrier *barrier = &tracker->barriers[tracker->barrier_count++];
+    barrier->resource = resource;
+    barrier->subresource = subresource;
+    barrier->before = current;
+    barrier->after = state;
+    return true;
+}
+
+// subresource KURO_GFX_STATE_CONSTANT_ALL_SUBRESOURCES requests the state for the whole resource
+inline static void
+kuro_gfx_state_request(Kuro_Gfx_State_Tracker *tracker, Kuro_Gfx_State_Resource *resource, uint32_t subresource, uint32_t state)
+{
+    const uint32_t all = (uint32_t)KURO_GFX_STATE_CONSTANT_ALL_SUBRESOURCES;
+    ++tracker->requested;
+    if (resource->subresource_count == 1)
+        subresource = all;
+
+    bool added = false;
+    if (resource->subresource_states == NULL)
+    {
+        uint32_t target = _kuro_gfx_state_target(tracker, resource->state, state);
+        if (subresource == all)
+        {
+            added = _kuro_gfx_state_transition(tracker, resource, all, resource->state, target);
+            resource->state = target;
+        }
+        else if (target != resource->state)
+        {
+            assert(subresource < resource->subresource_count);
+            resource->subresource_states = (uint32_t *)malloc(resource->subresource_count * sizeof(uint32_t));
+            for (uint32_t i = 0; i < resource->subresource_count; ++i)
+                resource->subresource_states[i] = resource->state;
+            added = _kuro_gfx_state_transition(tracker, resource, subresource, resource->state, target);
+            resource->subresource_states[subresource] = target;
+        }
+    }
+    else if (subresource != all)
+    {
+        assert(subresource < resource->subresource_count);
+        uint32_t current = resource->subresource_states[subresource];
+        uint32_t target = _kuro_gfx_state_target(tracker, current, state);
+        added = _kuro_gfx_state_transition(tracker, resource, subresource, current, target);
+        resource->subresource_states[subresource] = target;
+    }
+    else
+    {
+        // every subresource moves on its own, the resource is uniform again if they agree after
+        bool uniform = true;
+        for (uint32_t i = 0; i < resource->subresource_count; ++i)
+        {
+            uint32_t current = resource->subresource_states[i];
+            uint32_t target = _kuro_gfx_state_target(tracker, current, state);
+            added = _kuro_gfx_state_transition(tracker, resource, i, current, target) || added;
+            resource->subresource_states[i] = target;
+            uniform = uniform && target == resource->subresource_states[0];
+        }
+        if (uniform)
+        {
+            resource->state = resource->subresource_states[0];
+            free(resource->subresource_states);
+            resource->subresource_states = NULL;
+        }
+    }
+
+    if (!added)
+        ++tracker->elided;
+}
+
+// returns the pending barriers in request order, they stay valid until the next request
+inline static const Kuro_Gfx_State_Barrier *
+kuro_gfx_state_flush(Kuro_Gfx_State_Tracker *tracker, uint32_t *barrier_count)
+{
+    *barrier_count = tracker->barrier_count;
+    if (tracker->barrier_count)
+    {
+        tracker->emitted += tracker->barrier_count;
+        ++tracker->flushes;
+    }
+    tracker->barrier_count = 0;
+    return tracker->barriers;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
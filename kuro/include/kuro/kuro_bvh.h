@@ -0,0 +1,80 @@
+#pragma once
+
+// bounding volume hierarchy over a set of primitive boxes (src/kuro/kuro_bvh.cpp), for picking,
+// occlusion and overlap queries that would otherwise scan every primitive
+//
+//     * nodes are 4 wide, the boxes of the 4 children of a node sit in one aabb3_x4 so a ray or a box
+//       is tested against all of them with the packet kernels of kuro_math.h
+//     * the builder splits with a binned surface area heuristic on the primitive centroids, a node
+//       is split in two and its largest children again until it has 4, ranges of up to
+//       BVH_MAX_LEAF_SIZE primitives become leaves
+//     * subtrees are built concurrently on thread_count threads (0 uses all the hardware threads),
+//       the splits near the root bin on the calling thread
+//     * refit keeps the topology and only recomputes the boxes, it is cheap enough for animated
+//       geometry every frame but the tree degrades when the primitives move a lot, rebuild then
+//     * the queries walk the tree with an explicit stack, closest hit visits the nearest child first
+
+#include "kuro/kuro_math.h"
+
+#include <vector>
+
+namespace kuro
+{
+    // =================================================================================================
+    // == BVH ==========================================================================================
+    // =================================================================================================
+
+    static constexpr u32 BVH_MAX_LEAF_SIZE = 4;
+
+    // a lane is a leaf when its count isn't 0, child is then the first of its primitives in
+    // bvh.primitives, otherwise child is a node index. unused lanes have an empty box and child
+    // U32_MAX, they never hit
+    struct bvh_node
+    {
+        aabb3_x4 bounds;
+        u32 child[4];
+        u32 count[4];
+    };
+
+    // nodes[0] is the root, boxes are the primitive boxes in primitive order
+    struct bvh
+    {
+        std::vector<bvh_node> nodes;
+        std::vector<u32> primitives;
+        std::vector<aabb3> boxes;
+        aabb3 bounds;
+    };
+
+    struct bvh_hit
+    {
+        u32 primitive;
+        f32 t, u, v;
+    };
+
+    void
+    bvh_build(bvh &tree, const aabb3 *boxes, u32 count, u32 thread_count = 0);
+
+    // triangle i is vertices[indices[3 * i + 0..2]]
+    void
+    bvh_build(bvh &tree, const vec3 *vertices, const u32 *indices, u32 triangle_count, u32 thread_count = 0);
+
+    // boxes holds the new box of every primitive the tree was built with
+    void
+    bvh_refit(bvh &tree, const aabb3 *boxes);
+
+    void
+    bvh_refit(bvh &tree, const vec3 *vertices, const u32 *indices);
+
+    // closest triangle hit with 0 <= t <= t_max, same conventions as ray_triangle_intersect
+    bool
+    bvh_closest_hit(const bvh &tree, const vec3 *vertices, const u32 *indices, const ray3 &ray, f32 t_max, bvh_hit &hit);
+
+    // any triangle hit with 0 <= t <= t_max, for occlusion, stops at the first one it finds
+    bool
+    bvh_any_hit(const bvh &tree, const vec3 *vertices, const u32 *indices, const ray3 &ray, f32 t_max);
+
+    // writes the primitives whose box overlaps box (touching counts) up to capacity and returns how
+    // many there are in total
+    u32
+    bvh_overlap(const bvh &tree, const aabb3 &box, u32 *primitives, u32 capacity);
+}
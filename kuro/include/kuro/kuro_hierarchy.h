@@ -0,0 +1,89 @@
+#pragma once
+
+// transform hierarchy (src/kuro/kuro_hierarchy.cpp), local translation, rotation and scale of every
+// node in arrays ordered parent before child, world matrices come out of one pass in array order
+//
+//     * a node is added after its parent so parent < child always holds, the pass never looks back
+//       further than the parent's world matrix which is already done
+//     * setting a local transform marks the node dirty, the pass recomputes the dirty nodes and
+//       everything below them and flags them in changed, clean subtrees keep their world matrices
+//     * transform_hierarchy_sort reorders the nodes depth first so every subtree is one contiguous
+//       range, the pass can then hand whole subtrees to threads, the nodes above them are done first
+//     * worlds is one contiguous array of row vector matrices, the layout of Object_Constants::model,
+//       so it can be uploaded as is (or only the changed ones)
+
+#include "kuro/kuro_math.h"
+
+#include <vector>
+
+namespace kuro
+{
+    // =================================================================================================
+    // == HIERARCHY ====================================================================================
+    // =================================================================================================
+
+    static constexpr u32 TRANSFORM_NONE = U32_MAX;
+
+    struct transform_hierarchy
+    {
+        std::vector<u32> parents;
+        std::vector<vec3> translations;
+        std::vector<quat> rotations;
+        std::vector<vec3> scales;
+        std::vector<mat4> worlds;
+        // dirty is set by the setters, changed by the last update for the nodes it recomputed
+        std::vector<u8> dirty;
+        std::vector<u8> changed;
+        // node count of the subtree of every node, only valid while sorted. adding nodes depth first
+        // (a node after the last node of its parent's subtree) keeps the hierarchy sorted
+        std::vector<u32> subtree_sizes;
+        bool sorted = true;
+    };
+
+    // parent is TRANSFORM_NONE for roots, returns the index of the new node
+    u32
+    transform_hierarchy_add(transform_hierarchy &hierarchy, u32 parent, const vec3 &translation, const quat &rotation, const vec3 &scale);
+
+    void
+    transform_hierarchy_clear(transform_hierarchy &hierarchy);
+
+    // depth first order, children keep their relative order. remap may be nullptr, otherwise it gets
+    // the new index of every old one
+    void
+    transform_hierarchy_sort(transform_hierarchy &hierarchy, u32 *remap);
+
+    // updates worlds in one pass, thread_count > 1 splits a sorted hierarchy by subtrees (0 uses all
+    // the hardware threads), unsorted ones always run on the calling thread
+    void
+    transform_hierarchy_update(transform_hierarchy &hierarchy, u32 thread_count = 1);
+
+    inline static void
+    transform_hierarchy_set(transform_hierarchy &hierarchy, u32 node, const vec3 &translation, const quat &rotation, const vec3 &scale)
+    {
+        hierarchy.translations[node] = translation;
+        hierarchy.rotations[node] = rotation;
+        hierarchy.scales[node] = scale;
+        hierarchy.dirty[node] = 1;
+    }
+
+    inline static void
+    transform_hierarchy_set_translation(transform_hierarchy &hierarchy, u32 node, const vec3 &translation)
+    {
+        hierarchy.translations[node] = translation;
+        hierarchy.dirty[node] = 1;
+    }
+
+    inline static void
+    transform_hierarchy_set_rotation(transform_hierarchy &hierarchy, u32 node, const quat &rotation)
+    {
+        hierarchy.rotations[node] = rotation;
+        hierarchy.dirty[node] = 1;
+    }
+
+    inline static void
+    transform_hierarchy_set_scale(transform_hierarchy &hierarchy, u32 node, const vec3 &scale)
+    {
+        hierarchy.scales[node] = scale;
+        hierarchy.dirty[node] = 1;
+    }
+}
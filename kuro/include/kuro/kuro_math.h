@@ -3,9 +3,6 @@
 //
 // Copyright (c) 2020-2021 Waleed Yaser
 //
-// TODO[Waleed]:
-// * SIMD
-// * implement sqrt, sin, cos, tan
 
 #pragma once
 
@@ -31,6 +28,19 @@ extern "C" {
 #endif
 }
 
+// define KURO_MATH_NO_SIMD before including this file to force the scalar fallback of the SIMD
+// section, it is also the reference path the SIMD kernels are tested against
+#if !defined(KURO_MATH_NO_SIMD)
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define KURO_MATH_SSE2 1
+        #include <emmintrin.h>
+    #endif
+    #if defined(__AVX__)
+        #define KURO_MATH_AVX 1
+        #include <immintrin.h>
+    #endif
+#endif
+
 namespace kuro
 {
     // =================================================================================================
@@ -124,14 +134,65 @@ namespace kuro
         f32 m30, m31, m32, m33;
     };
 
+    struct quat
+    {
+        f32 x, y, z, w;
+    };
+
+    struct ray3
+    {
+        vec3 origin;
+        vec3 direction;
+    };
+
+    struct aabb3
+    {
+        vec3 min;
+        vec3 max;
+    };
+
+    struct sphere3
+    {
+        vec3 center;
+        f32 radius;
+    };
+
+    // the rows of axes are the box axes in world space (orthonormal), extents are the half sizes
+    // along them
+    struct obb3
+    {
+        vec3 center;
+        vec3 extents;
+        mat3 axes;
+    };
+
+    // points p on the plane satisfy dot(normal, p) + d == 0
+    struct plane3
+    {
+        vec3 normal;
+        f32 d;
+    };
+
     // =================================================================================================
     // == MATH =========================================================================================
     // =================================================================================================
 
+    // f32 versions are evaluated natively in single precision with minimax polynomials (cephes)
+    // after a Cody-Waite range reduction, measured against the double precision libm:
+    // * sin, cos: max abs error 7.8e-8 for |x| < 8192, larger arguments fall back to libm
+    // * tan: sin / cos, max rel error 1.1e-6 for |x| < 10 growing to 3e-5 near |x| = 8192
+    // * asin: max abs error 1.7e-7, arguments outside [-1, 1] are clamped
+    // * atan2: max abs error 2.9e-7, signed zeros aren't distinguished (atan2(-0, -1) is +pi)
+    // f64 versions still forward to libm
+
     inline static f32
     sqrt(f32 f)
     {
+    #if defined(KURO_MATH_SSE2)
+        return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(f)));
+    #else
         return (f32)::sqrt(f);
+    #endif
     }
 
     inline static f64
@@ -140,10 +201,54 @@ namespace kuro
         return ::sqrt(f);
     }
 
+    // theta must already be reduced to [-pi/4, pi/4]
+    inline static void
+    _sincos_poly(f32 x, f32 &s, f32 &c)
+    {
+        f32 z = x * x;
+        s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+        c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    }
+
+    inline static void
+    sincos(f32 theta, f32 &s, f32 &c)
+    {
+        if (!(theta > -8192.0f && theta < 8192.0f))
+        {
+            s = (f32)::sin(theta);
+            c = (f32)::cos(theta);
+            return;
+        }
+
+        // theta = k * pi/2 + x, pi/2 is split in 3 parts so k * part is exact
+        f32 k = (theta * 0.636619772367581f + 12582912.0f) - 12582912.0f;
+        f32 x = ((theta - k * 1.5703125f) - k * 4.837512969970703125e-4f) - k * 7.54978995489188216e-8f;
+
+        f32 ps, pc;
+        _sincos_poly(x, ps, pc);
+
+        switch ((i32)k & 3)
+        {
+            case 0: s =  ps; c =  pc; break;
+            case 1: s =  pc; c = -ps; break;
+            case 2: s = -ps; c = -pc; break;
+            default: s = -pc; c =  ps; break;
+        }
+    }
+
+    inline static void
+    sincos(f64 theta, f64 &s, f64 &c)
+    {
+        s = ::sin(theta);
+        c = ::cos(theta);
+    }
+
     inline static f32
     sin(f32 f)
     {
-        return (f32)::sin(f);
+        f32 s, c;
+        sincos(f, s, c);
+        return s;
     }
 
     inline static f64
@@ -155,7 +260,9 @@ namespace kuro
     inline static f32
     cos(f32 f)
     {
-        return (f32)::cos(f);
+        f32 s, c;
+        sincos(f, s, c);
+        return c;
     }
 
     inline static f64
@@ -167,7 +274,9 @@ namespace kuro
     inline static f32
     tan(f32 f)
     {
-        return (f32)::tan(f);
+        f32 s, c;
+        sincos(f, s, c);
+        return s / c;
     }
 
     inline static f64
@@ -179,7 +288,20 @@ namespace kuro
     inline static f32
     asin(f32 f)
     {
-        return (f32)::asin(f);
+        f32 a = f < 0.0f ? -f : f;
+        if (a > 1.0f)
+            a = 1.0f;
+
+        // asin(a) = pi/2 - 2 * asin(sqrt((1 - a) / 2)) keeps the polynomial on [0, 0.5]
+        bool big = a > 0.5f;
+        f32 z = big ? 0.5f * (1.0f - a) : a * a;
+        f32 x = big ? sqrt(z) : a;
+
+        f32 r = ((((4.2163199048e-2f * z + 2.4181311049e-2f) * z + 4.5470025998e-2f) * z + 7.4953002686e-2f) * z + 1.6666752422e-1f) * z * x + x;
+        if (big)
+            r = 1.5707963267948966f - (r + r);
+
+        return f < 0.0f ? -r : r;
     }
 
     inline static f64
@@ -188,10 +310,51 @@ namespace kuro
         return ::asin(f);
     }
 
+    inline static f32
+    _atan(f32 f)
+    {
+        f32 a = f < 0.0f ? -f : f;
+
+        // reduce to |x| <= tan(pi/8)
+        f32 x, y;
+        if (a > 2.414213562373095f)
+        {
+            x = -1.0f / a;
+            y = 1.5707963267948966f;
+        }
+        else if (a > 0.4142135623730950f)
+        {
+            x = (a - 1.0f) / (a + 1.0f);
+            y = 0.7853981633974483f;
+        }
+        else
+        {
+            x = a;
+            y = 0.0f;
+        }
+
+        f32 z = x * x;
+        y = y + (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * x + x;
+
+        return f < 0.0f ? -y : y;
+    }
+
     inline static f32
     atan2(f32 y, f32 x)
     {
-        return (f32)::atan2(y, x);
+        if (x == 0.0f)
+        {
+            if (y > 0.0f)
+                return 1.5707963267948966f;
+            if (y < 0.0f)
+                return -1.5707963267948966f;
+            return 0.0f;
+        }
+
+        f32 r = _atan(y / x);
+        if (x < 0.0f)
+            r += y < 0.0f ? -3.14159265358979323846f : 3.14159265358979323846f;
+        return r;
     }
 
     inline static f64
@@ -704,8 +867,8 @@ namespace kuro
     inline static mat2
     mat2_rotation(f32 theta)
     {
-        f32 c = cos(theta);
-        f32 s = sin(theta);
+        f32 s, c;
+        sincos(theta, s, c);
 
         return mat2{
              c, s,
@@ -951,14 +1114,41 @@ namespace kuro
         return mat3_det(M) != 0.0f;
     }
 
+    // the first column of the adjugate is the first row of cofactors, the determinant is expanded
+    // along it so nothing is computed twice. m holds the 9 elements row by row, T is f32 or a SIMD
+    // register for the batch kernels
+    template <typename T>
+    inline static T
+    _mat3_adj_det(const T *m, T *adj)
+    {
+        adj[0] = m[4] * m[8] - m[5] * m[7];
+        adj[3] = m[5] * m[6] - m[3] * m[8];
+        adj[6] = m[3] * m[7] - m[4] * m[6];
+
+        adj[1] = m[2] * m[7] - m[1] * m[8];
+        adj[4] = m[0] * m[8] - m[2] * m[6];
+        adj[7] = m[1] * m[6] - m[0] * m[7];
+
+        adj[2] = m[1] * m[5] - m[2] * m[4];
+        adj[5] = m[2] * m[3] - m[0] * m[5];
+        adj[8] = m[0] * m[4] - m[1] * m[3];
+
+        return m[0] * adj[0] + m[1] * adj[3] + m[2] * adj[6];
+    }
+
     inline static mat3
     mat3_inverse(const mat3 &M)
     {
-        f32 d = mat3_det(M);
+        mat3 R;
+        f32 *r = &R.m00;
+        f32 d = _mat3_adj_det(&M.m00, r);
         if (d == 0)
             return mat3{};
 
-        return (1.0f / d) * mat3_adj(M);
+        f32 inv = 1.0f / d;
+        for (int i = 0; i < 9; ++i)
+            r[i] *= inv;
+        return R;
     }
 
     inline static mat3
@@ -980,8 +1170,8 @@ namespace kuro
     inline static mat3
     mat3_rotation_2d(f32 theta)
     {
-        f32 c = cos(theta);
-        f32 s = sin(theta);
+        f32 s, c;
+        sincos(theta, s, c);
 
         return mat3{
              c, s, 0,
@@ -1009,8 +1199,8 @@ namespace kuro
     inline static mat3
     mat3_rotation_x(f32 pitch)
     {
-        f32 c = cos(pitch);
-        f32 s = sin(pitch);
+        f32 s, c;
+        sincos(pitch, s, c);
 
         return mat3{
             1,  0, 0,
@@ -1021,8 +1211,8 @@ namespace kuro
     inline static mat3
     mat3_rotation_y(f32 yaw)
     {
-        f32 c = cos(yaw);
-        f32 s = sin(yaw);
+        f32 s, c;
+        sincos(yaw, s, c);
 
         return mat3{
             c, 0, -s,
@@ -1033,8 +1223,8 @@ namespace kuro
     inline static mat3
     mat3_rotation_z(f32 roll)
     {
-        f32 c = cos(roll);
-        f32 s = sin(roll);
+        f32 s, c;
+        sincos(roll, s, c);
 
         return mat3{
              c, s, 0,
@@ -1045,8 +1235,8 @@ namespace kuro
     inline static mat3
     mat3_rotation_axis(const vec3 &axis, float angle)
     {
-        f32 c = cos(angle);
-        f32 s = sin(angle);
+        f32 s, c;
+        sincos(angle, s, c);
 
         f32 x = axis.x;
         f32 y = axis.y;
@@ -1062,12 +1252,10 @@ namespace kuro
     inline static mat3
     mat3_euler(f32 pitch, f32 head, f32 roll)
     {
-        f32 sh = sin(head);
-        f32 ch = cos(head);
-        f32 sp = sin(pitch);
-        f32 cp = cos(pitch);
-        f32 sr = sin(roll);
-        f32 cr = cos(roll);
+        f32 sh, ch, sp, cp, sr, cr;
+        sincos(head, sh, ch);
+        sincos(pitch, sp, cp);
+        sincos(roll, sr, cr);
 
         // order yxz
         return mat3{
@@ -1462,14 +1650,161 @@ namespace kuro
         return mat4_det(M) != 0.0f;
     }
 
+    // Laplace expansion along the two top rows, the 2x2 minors of the top rows (s) and of the bottom
+    // rows (c) are computed once and shared by the determinant and every cofactor. m holds the 16
+    // elements row by row, T is f32 or a SIMD register for the batch kernels
+    template <typename T>
+    inline static void
+    _mat4_minors(const T *m, T s[6], T c[6])
+    {
+        s[0] = m[0] * m[5] - m[4] * m[1];
+        s[1] = m[0] * m[6] - m[4] * m[2];
+        s[2] = m[0] * m[7] - m[4] * m[3];
+        s[3] = m[1] * m[6] - m[5] * m[2];
+        s[4] = m[1] * m[7] - m[5] * m[3];
+        s[5] = m[2] * m[7] - m[6] * m[3];
+
+        c[0] = m[8] * m[13] - m[12] * m[9];
+        c[1] = m[8] * m[14] - m[12] * m[10];
+        c[2] = m[8] * m[15] - m[12] * m[11];
+        c[3] = m[9] * m[14] - m[13] * m[10];
+        c[4] = m[9] * m[15] - m[13] * m[11];
+        c[5] = m[10] * m[15] - m[14] * m[11];
+    }
+
+    template <typename T>
+    inline static T
+    _mat4_det(const T s[6], const T c[6])
+    {
+        return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+    }
+
+    template <typename T>
+    inline static void
+    _mat4_adj(const T *m, const T s[6], const T c[6], T *adj)
+    {
+        adj[0]  = m[5] * c[5] - m[6] * c[4] + m[7] * c[3];
+        adj[1]  = m[2] * c[4] - m[1] * c[5] - m[3] * c[3];
+        adj[2]  = m[13] * s[5] - m[14] * s[4] + m[15] * s[3];
+        adj[3]  = m[10] * s[4] - m[9] * s[5] - m[11] * s[3];
+
+        adj[4]  = m[6] * c[2] - m[4] * c[5] - m[7] * c[1];
+        adj[5]  = m[0] * c[5] - m[2] * c[2] + m[3] * c[1];
+        adj[6]  = m[14] * s[2] - m[12] * s[5] - m[15] * s[1];
+        adj[7]  = m[8] * s[5] - m[10] * s[2] + m[11] * s[1];
+
+        adj[8]  = m[4] * c[4] - m[5] * c[2] + m[7] * c[0];
+        adj[9]  = m[1] * c[2] - m[0] * c[4] - m[3] * c[0];
+        adj[10] = m[12] * s[4] - m[13] * s[2] + m[15] * s[0];
+        adj[11] = m[9] * s[2] - m[8] * s[4] - m[11] * s[0];
+
+        adj[12] = m[5] * c[1] - m[4] * c[3] - m[6] * c[0];
+        adj[13] = m[0] * c[3] - m[1] * c[1] + m[2] * c[0];
+        adj[14] = m[13] * s[1] - m[12] * s[3] - m[14] * s[0];
+        adj[15] = m[8] * s[3] - m[9] * s[1] + m[10] * s[0];
+    }
+
     inline static mat4
     mat4_inverse(const mat4 &M)
     {
-        f32 d = mat4_det(M);
+        const f32 *m = &M.m00;
+        f32 s[6], c[6];
+        _mat4_minors(m, s, c);
+        f32 d = _mat4_det(s, c);
+        if (d == 0)
+            return mat4{};
+
+        mat4 R;
+        f32 *r = &R.m00;
+        _mat4_adj(m, s, c, r);
+        f32 inv = 1.0f / d;
+        for (int i = 0; i < 16; ++i)
+            r[i] *= inv;
+        return R;
+    }
+
+    // affine fast paths, M must have (0, 0, 0, 1) as its last column like everything built out of
+    // mat4_translation, mat4_rotation_*, mat4_euler and mat4_scaling
+    // 36 multiplies instead of the 64 of the general product
+    inline static mat4
+    mat4_affine_mul(const mat4 &A, const mat4 &B)
+    {
+        mat4 C;
+
+        C.m00 = A.m00 * B.m00 + A.m01 * B.m10 + A.m02 * B.m20;
+        C.m01 = A.m00 * B.m01 + A.m01 * B.m11 + A.m02 * B.m21;
+        C.m02 = A.m00 * B.m02 + A.m01 * B.m12 + A.m02 * B.m22;
+        C.m03 = 0.0f;
+
+        C.m10 = A.m10 * B.m00 + A.m11 * B.m10 + A.m12 * B.m20;
+        C.m11 = A.m10 * B.m01 + A.m11 * B.m11 + A.m12 * B.m21;
+        C.m12 = A.m10 * B.m02 + A.m11 * B.m12 + A.m12 * B.m22;
+        C.m13 = 0.0f;
+
+        C.m20 = A.m20 * B.m00 + A.m21 * B.m10 + A.m22 * B.m20;
+        C.m21 = A.m20 * B.m01 + A.m21 * B.m11 + A.m22 * B.m21;
+        C.m22 = A.m20 * B.m02 + A.m21 * B.m12 + A.m22 * B.m22;
+        C.m23 = 0.0f;
+
+        C.m30 = A.m30 * B.m00 + A.m31 * B.m10 + A.m32 * B.m20 + B.m30;
+        C.m31 = A.m30 * B.m01 + A.m31 * B.m11 + A.m32 * B.m21 + B.m31;
+        C.m32 = A.m30 * B.m02 + A.m31 * B.m12 + A.m32 * B.m22 + B.m32;
+        C.m33 = 1.0f;
+
+        return C;
+    }
+
+    // inverts the upper 3x3 through its cofactors and moves the translation back through it
+    inline static mat4
+    mat4_affine_inverse(const mat4 &M)
+    {
+        f32 c00 = M.m11 * M.m22 - M.m12 * M.m21;
+        f32 c01 = M.m12 * M.m20 - M.m10 * M.m22;
+        f32 c02 = M.m10 * M.m21 - M.m11 * M.m20;
+
+        f32 d = M.m00 * c00 + M.m01 * c01 + M.m02 * c02;
         if (d == 0)
             return mat4{};
 
-        return (1.0f / d) * mat4_adj(M);
+        f32 i = 1.0f / d;
+
+        mat4 R;
+        R.m00 = c00 * i;
+        R.m01 = (M.m02 * M.m21 - M.m01 * M.m22) * i;
+        R.m02 = (M.m01 * M.m12 - M.m02 * M.m11) * i;
+        R.m03 = 0.0f;
+
+        R.m10 = c01 * i;
+        R.m11 = (M.m00 * M.m22 - M.m02 * M.m20) * i;
+        R.m12 = (M.m02 * M.m10 - M.m00 * M.m12) * i;
+        R.m13 = 0.0f;
+
+        R.m20 = c02 * i;
+        R.m21 = (M.m01 * M.m20 - M.m00 * M.m21) * i;
+        R.m22 = (M.m00 * M.m11 - M.m01 * M.m10) * i;
+        R.m23 = 0.0f;
+
+        R.m30 = -(M.m30 * R.m00 + M.m31 * R.m10 + M.m32 * R.m20);
+        R.m31 = -(M.m30 * R.m01 + M.m31 * R.m11 + M.m32 * R.m21);
+        R.m32 = -(M.m30 * R.m02 + M.m31 * R.m12 + M.m32 * R.m22);
+        R.m33 = 1.0f;
+
+        return R;
+    }
+
+    // rotation and translation only (no scaling or shearing), the rotation is inverted by transposing it
+    inline static mat4
+    mat4_rigid_inverse(const mat4 &M)
+    {
+        return mat4{
+            M.m00, M.m10, M.m20, 0.0f,
+            M.m01, M.m11, M.m21, 0.0f,
+            M.m02, M.m12, M.m22, 0.0f,
+            -(M.m30 * M.m00 + M.m31 * M.m01 + M.m32 * M.m02),
+            -(M.m30 * M.m10 + M.m31 * M.m11 + M.m32 * M.m12),
+            -(M.m30 * M.m20 + M.m31 * M.m21 + M.m32 * M.m22),
+            1.0f
+        };
     }
 
     inline static mat4
@@ -1492,8 +1827,8 @@ namespace kuro
     inline static mat4
     mat4_rotation_x(f32 pitch)
     {
-        f32 c = cos(pitch);
-        f32 s = sin(pitch);
+        f32 s, c;
+        sincos(pitch, s, c);
 
         return mat4{
             1,  0, 0, 0,
@@ -1506,8 +1841,8 @@ namespace kuro
     inline static mat4
     mat4_rotation_y(f32 head)
     {
-        f32 c = cos(head);
-        f32 s = sin(head);
+        f32 s, c;
+        sincos(head, s, c);
 
         return mat4{
             c, 0, -s, 0,
@@ -1520,8 +1855,8 @@ namespace kuro
     inline static mat4
     mat4_rotation_z(f32 roll)
     {
-        f32 c = cos(roll);
-        f32 s = sin(roll);
+        f32 s, c;
+        sincos(roll, s, c);
 
         return mat4{
              c, s, 0, 0,
@@ -1534,8 +1869,8 @@ namespace kuro
     inline static mat4
     mat4_rotation_axis(const vec3 &axis, float angle)
     {
-        f32 c = cos(angle);
-        f32 s = sin(angle);
+        f32 s, c;
+        sincos(angle, s, c);
 
         f32 x = axis.x;
         f32 y = axis.y;
@@ -1552,12 +1887,10 @@ namespace kuro
     inline static mat4
     mat4_euler(f32 pitch, f32 head, f32 roll)
     {
-        f32 sh = sin(head);
-        f32 ch = cos(head);
-        f32 sp = sin(pitch);
-        f32 cp = cos(pitch);
-        f32 sr = sin(roll);
-        f32 cr = cos(roll);
+        f32 sh, ch, sp, cp, sr, cr;
+        sincos(head, sh, ch);
+        sincos(pitch, sp, cp);
+        sincos(roll, sr, cr);
 
         // order yxz
         return mat4{
@@ -1734,10 +2067,2759 @@ namespace kuro
     }
 
     // =================================================================================================
-    // == SIMD =========================================================================================
+    // == QUAT =========================================================================================
     // =================================================================================================
 
+    // quaternions compose in the same order as matrices, v * (a * b) rotates by a then by b so
+    // mat4_from_quat(a * b) == mat4_from_quat(a) * mat4_from_quat(b)
+
+    inline static bool
+    operator==(const quat &a, const quat &b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+    }
+
+    inline static bool
+    operator!=(const quat &a, const quat &b)
+    {
+        return !(a == b);
+    }
+
+    inline static quat
+    operator+(const quat &a, const quat &b)
+    {
+        return quat{a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+    }
+
+    inline static quat
+    operator-(const quat &q)
+    {
+        return quat{-q.x, -q.y, -q.z, -q.w};
+    }
+
+    inline static quat
+    operator-(const quat &a, const quat &b)
+    {
+        return quat{a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+    }
+
+    inline static quat
+    operator*(const quat &q, f32 f)
+    {
+        return quat{q.x * f, q.y * f, q.z * f, q.w * f};
+    }
+
+    inline static quat
+    operator*(f32 f, const quat &q)
+    {
+        return q * f;
+    }
+
+    inline static quat
+    operator*(const quat &a, const quat &b)
+    {
+        // hamilton product b a
+        return quat{
+            b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+            b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+            b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+            b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z
+        };
+    }
+
+    inline static quat &
+    operator*=(quat &a, const quat &b)
+    {
+        a = a * b;
+        return a;
+    }
+
+    inline static vec3
+    operator*(const vec3 &v, const quat &q)
+    {
+        // v + w t + cross(u, t) with t = 2 cross(u, v)
+        vec3 u = vec3{q.x, q.y, q.z};
+        vec3 t = cross(u, v);
+        t = t + t;
+        return v + q.w * t + cross(u, t);
+    }
+
+    inline static f32
+    dot(const quat &a, const quat &b)
+    {
+        return (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+    }
+
+    inline static f32
+    norm(const quat &q)
+    {
+        return sqrt(dot(q, q));
+    }
+
+    inline static f32
+    length(const quat &q)
+    {
+        return norm(q);
+    }
+
+    inline static quat
+    normalize(const quat &q)
+    {
+        return q * (1.0f / length(q));
+    }
+
+    inline static quat
+    quat_identity()
+    {
+        return quat{0.0f, 0.0f, 0.0f, 1.0f};
+    }
+
+    inline static quat
+    quat_conjugate(const quat &q)
+    {
+        return quat{-q.x, -q.y, -q.z, q.w};
+    }
+
+    inline static quat
+    quat_inverse(const quat &q)
+    {
+        return quat_conjugate(q) * (1.0f / dot(q, q));
+    }
+
+    // axis must be normalized, same rotation as mat4_rotation_axis
+    inline static quat
+    quat_from_axis_angle(const vec3 &axis, f32 angle)
+    {
+        f32 s, c;
+        sincos(0.5f * angle, s, c);
+        return quat{axis.x * s, axis.y * s, axis.z * s, c};
+    }
+
+    // same rotation as mat4_euler
+    inline static quat
+    quat_from_euler(f32 pitch, f32 head, f32 roll)
+    {
+        f32 sh, ch, sp, cp, sr, cr;
+        sincos(0.5f * head, sh, ch);
+        sincos(0.5f * pitch, sp, cp);
+        sincos(0.5f * roll, sr, cr);
+
+        // order yxz
+        return quat{
+            cr*sp*ch - sr*cp*sh,
+            cr*cp*sh + sr*sp*ch,
+            cr*sp*sh + sr*cp*ch,
+            cr*cp*ch - sr*sp*sh
+        };
+    }
+
+    inline static quat
+    quat_from_euler(const vec3 &rotation)
+    {
+        return quat_from_euler(rotation.x, rotation.y, rotation.z);
+    }
+
+    // q must be normalized
+    inline static mat3
+    mat3_from_quat(const quat &q)
+    {
+        f32 x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+        f32 xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+        f32 xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+        f32 wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+        return mat3{
+            1.0f - (yy + zz), xy + wz         , xz - wy,
+            xy - wz         , 1.0f - (xx + zz), yz + wx,
+            xz + wy         , yz - wx         , 1.0f - (xx + yy)
+        };
+    }
+
+    // q must be normalized
+    inline static mat4
+    mat4_from_quat(const quat &q)
+    {
+        mat3 R = mat3_from_quat(q);
+        return mat4{
+            R.m00, R.m01, R.m02, 0.0f,
+            R.m10, R.m11, R.m12, 0.0f,
+            R.m20, R.m21, R.m22, 0.0f,
+            0.0f , 0.0f , 0.0f , 1.0f
+        };
+    }
+
+    // scaling, then rotation, then translation, the same as
+    // mat4_scaling(s) * mat4_from_quat(r) * mat4_translation(t) without the products, r must be normalized
+    inline static mat4
+    mat4_trs(const vec3 &t, const quat &r, const vec3 &s)
+    {
+        mat3 R = mat3_from_quat(r);
+        return mat4{
+            R.m00 * s.x, R.m01 * s.x, R.m02 * s.x, 0.0f,
+            R.m10 * s.y, R.m11 * s.y, R.m12 * s.y, 0.0f,
+            R.m20 * s.z, R.m21 * s.z, R.m22 * s.z, 0.0f,
+            t.x        , t.y        , t.z        , 1.0f
+        };
+    }
+
+    // a and b must be normalized, takes the shortest path
+    inline static quat
+    quat_nlerp(const quat &a, const quat &b, f32 t)
+    {
+        quat c = dot(a, b) < 0.0f ? -b : b;
+        return normalize(a * (1.0f - t) + c * t);
+    }
+
+    // a and b must be normalized, takes the shortest path and falls back to a linear blend when
+    // a and b are nearly equal
+    inline static quat
+    quat_slerp(const quat &a, const quat &b, f32 t)
+    {
+        f32 d = dot(a, b);
+        quat c = d < 0.0f ? -b : b;
+        d = d < 0.0f ? -d : d;
+
+        f32 s = 1.0f - d * d;
+        s = sqrt(s < 0.0f ? 0.0f : s);
+        f32 theta = atan2(s, d);
+
+        f32 wa = 1.0f - t;
+        f32 wb = t;
+        if (s >= 1e-4f)
+        {
+            wa = sin(wa * theta) / s;
+            wb = sin(wb * theta) / s;
+        }
+        return a * wa + c * wb;
+    }
+
     // =================================================================================================
-    // == INTERSECTIONS ================================================================================
+    // == SIMD =========================================================================================
     // =================================================================================================
-}
\ No newline at end of file
+
+    // f32x4 is a 4 lanes float register, it maps to SSE2 when it's available and falls back to plain
+    // scalar code otherwise, every kernel below is written on top of it so it compiles on both paths
+    struct f32x4
+    {
+    #if defined(KURO_MATH_SSE2)
+        __m128 v;
+    #else
+        f32 v[4];
+    #endif
+    };
+
+    inline static f32x4
+    f32x4_splat(f32 f)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_set1_ps(f)};
+    #else
+        return f32x4{{f, f, f, f}};
+    #endif
+    }
+
+    inline static f32x4
+    f32x4_set(f32 x, f32 y, f32 z, f32 w)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_setr_ps(x, y, z, w)};
+    #else
+        return f32x4{{x, y, z, w}};
+    #endif
+    }
+
+    // ptr must be 16 bytes aligned
+    inline static f32x4
+    f32x4_load(const f32 *ptr)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_load_ps(ptr)};
+    #else
+        return f32x4{{ptr[0], ptr[1], ptr[2], ptr[3]}};
+    #endif
+    }
+
+    inline static f32x4
+    f32x4_loadu(const f32 *ptr)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_loadu_ps(ptr)};
+    #else
+        return f32x4{{ptr[0], ptr[1], ptr[2], ptr[3]}};
+    #endif
+    }
+
+    // ptr must be 16 bytes aligned
+    inline static void
+    f32x4_store(f32 *ptr, const f32x4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        _mm_store_ps(ptr, a.v);
+    #else
+        for (int i = 0; i < 4; ++i)
+            ptr[i] = a.v[i];
+    #endif
+    }
+
+    inline static void
+    f32x4_storeu(f32 *ptr, const f32x4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        _mm_storeu_ps(ptr, a.v);
+    #else
+        for (int i = 0; i < 4; ++i)
+            ptr[i] = a.v[i];
+    #endif
+    }
+
+    inline static f32
+    f32x4_lane(const f32x4 &a, int i)
+    {
+    #if defined(KURO_MATH_SSE2)
+        alignas(16) f32 lanes[4];
+        _mm_store_ps(lanes, a.v);
+        return lanes[i];
+    #else
+        return a.v[i];
+    #endif
+    }
+
+    inline static f32x4
+    operator+(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_add_ps(a.v, b.v)};
+    #else
+        return f32x4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+    #endif
+    }
+
+    inline static f32x4
+    operator-(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_sub_ps(a.v, b.v)};
+    #else
+        return f32x4{{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+    #endif
+    }
+
+    inline static f32x4
+    operator-(const f32x4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))};
+    #else
+        return f32x4{{-a.v[0], -a.v[1], -a.v[2], -a.v[3]}};
+    #endif
+    }
+
+    inline static f32x4
+    operator*(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_mul_ps(a.v, b.v)};
+    #else
+        return f32x4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+    #endif
+    }
+
+    inline static f32x4
+    operator/(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_div_ps(a.v, b.v)};
+    #else
+        return f32x4{{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}};
+    #endif
+    }
+
+    inline static f32x4
+    f32x4_min(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_min_ps(a.v, b.v)};
+    #else
+        f32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    #endif
+    }
+
+    inline static f32x4
+    f32x4_max(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_max_ps(a.v, b.v)};
+    #else
+        f32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    #endif
+    }
+
+    inline static f32x4
+    f32x4_sqrt(const f32x4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_sqrt_ps(a.v)};
+    #else
+        return f32x4{{sqrt(a.v[0]), sqrt(a.v[1]), sqrt(a.v[2]), sqrt(a.v[3])}};
+    #endif
+    }
+
+    // sums the lanes in order ((x + y) + z) + w so it matches the scalar code bit by bit
+    inline static f32
+    f32x4_sum(const f32x4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        __m128 r = _mm_add_ss(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 1, 1, 1)));
+        r = _mm_add_ss(r, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 2, 2, 2)));
+        r = _mm_add_ss(r, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 3, 3, 3)));
+        return _mm_cvtss_f32(r);
+    #else
+        return a.v[0] + a.v[1] + a.v[2] + a.v[3];
+    #endif
+    }
+
+    inline static bool
+    f32x4_equal(const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return _mm_movemask_ps(_mm_cmpeq_ps(a.v, b.v)) == 0xF;
+    #else
+        return a.v[0] == b.v[0] && a.v[1] == b.v[1] && a.v[2] == b.v[2] && a.v[3] == b.v[3];
+    #endif
+    }
+
+    // f32x8 is 8 lanes wide, it maps to AVX when it's enabled and to a pair of f32x4 otherwise
+    struct f32x8
+    {
+    #if defined(KURO_MATH_AVX)
+        __m256 v;
+    #else
+        f32x4 lo, hi;
+    #endif
+    };
+
+    inline static f32x8
+    f32x8_splat(f32 f)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_set1_ps(f)};
+    #else
+        return f32x8{f32x4_splat(f), f32x4_splat(f)};
+    #endif
+    }
+
+    inline static f32x8
+    f32x8_loadu(const f32 *ptr)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_loadu_ps(ptr)};
+    #else
+        return f32x8{f32x4_loadu(ptr), f32x4_loadu(ptr + 4)};
+    #endif
+    }
+
+    inline static void
+    f32x8_storeu(f32 *ptr, const f32x8 &a)
+    {
+    #if defined(KURO_MATH_AVX)
+        _mm256_storeu_ps(ptr, a.v);
+    #else
+        f32x4_storeu(ptr, a.lo);
+        f32x4_storeu(ptr + 4, a.hi);
+    #endif
+    }
+
+    inline static f32
+    f32x8_lane(const f32x8 &a, int i)
+    {
+    #if defined(KURO_MATH_AVX)
+        alignas(32) f32 lanes[8];
+        _mm256_store_ps(lanes, a.v);
+        return lanes[i];
+    #else
+        return i < 4 ? f32x4_lane(a.lo, i) : f32x4_lane(a.hi, i - 4);
+    #endif
+    }
+
+    inline static f32x8
+    operator+(const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_add_ps(a.v, b.v)};
+    #else
+        return f32x8{a.lo + b.lo, a.hi + b.hi};
+    #endif
+    }
+
+    inline static f32x8
+    operator-(const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_sub_ps(a.v, b.v)};
+    #else
+        return f32x8{a.lo - b.lo, a.hi - b.hi};
+    #endif
+    }
+
+    inline static f32x8
+    operator-(const f32x8 &a)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))};
+    #else
+        return f32x8{-a.lo, -a.hi};
+    #endif
+    }
+
+    inline static f32x8
+    operator*(const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_mul_ps(a.v, b.v)};
+    #else
+        return f32x8{a.lo * b.lo, a.hi * b.hi};
+    #endif
+    }
+
+    inline static f32x8
+    operator/(const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_div_ps(a.v, b.v)};
+    #else
+        return f32x8{a.lo / b.lo, a.hi / b.hi};
+    #endif
+    }
+
+    inline static f32x8
+    f32x8_min(const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_min_ps(a.v, b.v)};
+    #else
+        return f32x8{f32x4_min(a.lo, b.lo), f32x4_min(a.hi, b.hi)};
+    #endif
+    }
+
+    inline static f32x8
+    f32x8_max(const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_max_ps(a.v, b.v)};
+    #else
+        return f32x8{f32x4_max(a.lo, b.lo), f32x4_max(a.hi, b.hi)};
+    #endif
+    }
+
+    inline static f32x8
+    f32x8_sqrt(const f32x8 &a)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_sqrt_ps(a.v)};
+    #else
+        return f32x8{f32x4_sqrt(a.lo), f32x4_sqrt(a.hi)};
+    #endif
+    }
+
+    // lane masks produced by comparing registers, they select between two registers per lane
+    struct mask4
+    {
+    #if defined(KURO_MATH_SSE2)
+        __m128 v;
+    #else
+        bool v[4];
+    #endif
+    };
+
+    struct mask8
+    {
+    #if defined(KURO_MATH_AVX)
+        __m256 v;
+    #else
+        mask4 lo, hi;
+    #endif
+    };
+
+    // mixed register/scalar arithmetic so kernels can be written with plain constants
+    inline static f32x4 operator+(const f32x4 &a, f32 f) { return a + f32x4_splat(f); }
+    inline static f32x4 operator+(f32 f, const f32x4 &a) { return f32x4_splat(f) + a; }
+    inline static f32x4 operator-(const f32x4 &a, f32 f) { return a - f32x4_splat(f); }
+    inline static f32x4 operator-(f32 f, const f32x4 &a) { return f32x4_splat(f) - a; }
+    inline static f32x4 operator*(const f32x4 &a, f32 f) { return a * f32x4_splat(f); }
+    inline static f32x4 operator*(f32 f, const f32x4 &a) { return f32x4_splat(f) * a; }
+    inline static f32x4 operator/(const f32x4 &a, f32 f) { return a / f32x4_splat(f); }
+    inline static f32x4 operator/(f32 f, const f32x4 &a) { return f32x4_splat(f) / a; }
+
+    inline static f32x8 operator+(const f32x8 &a, f32 f) { return a + f32x8_splat(f); }
+    inline static f32x8 operator+(f32 f, const f32x8 &a) { return f32x8_splat(f) + a; }
+    inline static f32x8 operator-(const f32x8 &a, f32 f) { return a - f32x8_splat(f); }
+    inline static f32x8 operator-(f32 f, const f32x8 &a) { return f32x8_splat(f) - a; }
+    inline static f32x8 operator*(const f32x8 &a, f32 f) { return a * f32x8_splat(f); }
+    inline static f32x8 operator*(f32 f, const f32x8 &a) { return f32x8_splat(f) * a; }
+    inline static f32x8 operator/(const f32x8 &a, f32 f) { return a / f32x8_splat(f); }
+    inline static f32x8 operator/(f32 f, const f32x8 &a) { return f32x8_splat(f) / a; }
+
+    #if defined(KURO_MATH_SSE2)
+        #define KURO_MATH_CMP4(OP, INTRINSIC)                                        \
+        inline static mask4 operator OP(const f32x4 &a, const f32x4 &b)              \
+        {                                                                            \
+            return mask4{INTRINSIC(a.v, b.v)};                                       \
+        }
+    #else
+        #define KURO_MATH_CMP4(OP, INTRINSIC)                                        \
+        inline static mask4 operator OP(const f32x4 &a, const f32x4 &b)              \
+        {                                                                            \
+            return mask4{{a.v[0] OP b.v[0], a.v[1] OP b.v[1], a.v[2] OP b.v[2], a.v[3] OP b.v[3]}}; \
+        }
+    #endif
+
+    #if defined(KURO_MATH_AVX)
+        #define KURO_MATH_CMP8(OP, PREDICATE)                                        \
+        inline static mask8 operator OP(const f32x8 &a, const f32x8 &b)              \
+        {                                                                            \
+            return mask8{_mm256_cmp_ps(a.v, b.v, PREDICATE)};                        \
+        }
+    #else
+        #define KURO_MATH_CMP8(OP, PREDICATE)                                        \
+        inline static mask8 operator OP(const f32x8 &a, const f32x8 &b)              \
+        {                                                                            \
+            return mask8{a.lo OP b.lo, a.hi OP b.hi};                                \
+        }
+    #endif
+
+    KURO_MATH_CMP4(==, _mm_cmpeq_ps)
+    KURO_MATH_CMP4(!=, _mm_cmpneq_ps)
+    KURO_MATH_CMP4(<,  _mm_cmplt_ps)
+    KURO_MATH_CMP4(<=, _mm_cmple_ps)
+    KURO_MATH_CMP4(>,  _mm_cmpgt_ps)
+    KURO_MATH_CMP4(>=, _mm_cmpge_ps)
+
+    KURO_MATH_CMP8(==, _CMP_EQ_OQ)
+    KURO_MATH_CMP8(!=, _CMP_NEQ_UQ)
+    KURO_MATH_CMP8(<,  _CMP_LT_OQ)
+    KURO_MATH_CMP8(<=, _CMP_LE_OQ)
+    KURO_MATH_CMP8(>,  _CMP_GT_OQ)
+    KURO_MATH_CMP8(>=, _CMP_GE_OQ)
+
+    #undef KURO_MATH_CMP4
+    #undef KURO_MATH_CMP8
+
+    inline static mask4 operator==(const f32x4 &a, f32 f) { return a == f32x4_splat(f); }
+    inline static mask4 operator!=(const f32x4 &a, f32 f) { return a != f32x4_splat(f); }
+    inline static mask4 operator<(const f32x4 &a, f32 f)  { return a <  f32x4_splat(f); }
+    inline static mask4 operator<=(const f32x4 &a, f32 f) { return a <= f32x4_splat(f); }
+    inline static mask4 operator>(const f32x4 &a, f32 f)  { return a >  f32x4_splat(f); }
+    inline static mask4 operator>=(const f32x4 &a, f32 f) { return a >= f32x4_splat(f); }
+
+    inline static mask8 operator==(const f32x8 &a, f32 f) { return a == f32x8_splat(f); }
+    inline static mask8 operator!=(const f32x8 &a, f32 f) { return a != f32x8_splat(f); }
+    inline static mask8 operator<(const f32x8 &a, f32 f)  { return a <  f32x8_splat(f); }
+    inline static mask8 operator<=(const f32x8 &a, f32 f) { return a <= f32x8_splat(f); }
+    inline static mask8 operator>(const f32x8 &a, f32 f)  { return a >  f32x8_splat(f); }
+    inline static mask8 operator>=(const f32x8 &a, f32 f) { return a >= f32x8_splat(f); }
+
+    inline static mask4
+    operator&(const mask4 &a, const mask4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return mask4{_mm_and_ps(a.v, b.v)};
+    #else
+        return mask4{{a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3]}};
+    #endif
+    }
+
+    inline static mask4
+    operator|(const mask4 &a, const mask4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return mask4{_mm_or_ps(a.v, b.v)};
+    #else
+        return mask4{{a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3]}};
+    #endif
+    }
+
+    inline static mask4
+    operator~(const mask4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return mask4{_mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1)))};
+    #else
+        return mask4{{!a.v[0], !a.v[1], !a.v[2], !a.v[3]}};
+    #endif
+    }
+
+    // bit i is set when lane i is set
+    inline static u32
+    bitmask(const mask4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return (u32)_mm_movemask_ps(a.v);
+    #else
+        return (u32)a.v[0] | ((u32)a.v[1] << 1) | ((u32)a.v[2] << 2) | ((u32)a.v[3] << 3);
+    #endif
+    }
+
+    inline static bool
+    any(const mask4 &a)
+    {
+        return bitmask(a) != 0;
+    }
+
+    inline static bool
+    all(const mask4 &a)
+    {
+        return bitmask(a) == 0xF;
+    }
+
+    // per lane m ? a : b
+    inline static f32x4
+    select(const mask4 &m, const f32x4 &a, const f32x4 &b)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))};
+    #else
+        f32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = m.v[i] ? a.v[i] : b.v[i];
+        return r;
+    #endif
+    }
+
+    inline static mask8
+    operator&(const mask8 &a, const mask8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return mask8{_mm256_and_ps(a.v, b.v)};
+    #else
+        return mask8{a.lo & b.lo, a.hi & b.hi};
+    #endif
+    }
+
+    inline static mask8
+    operator|(const mask8 &a, const mask8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return mask8{_mm256_or_ps(a.v, b.v)};
+    #else
+        return mask8{a.lo | b.lo, a.hi | b.hi};
+    #endif
+    }
+
+    inline static mask8
+    operator~(const mask8 &a)
+    {
+    #if defined(KURO_MATH_AVX)
+        return mask8{_mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))};
+    #else
+        return mask8{~a.lo, ~a.hi};
+    #endif
+    }
+
+    inline static u32
+    bitmask(const mask8 &a)
+    {
+    #if defined(KURO_MATH_AVX)
+        return (u32)_mm256_movemask_ps(a.v);
+    #else
+        return bitmask(a.lo) | (bitmask(a.hi) << 4);
+    #endif
+    }
+
+    inline static bool
+    any(const mask8 &a)
+    {
+        return bitmask(a) != 0;
+    }
+
+    inline static bool
+    all(const mask8 &a)
+    {
+        return bitmask(a) == 0xFF;
+    }
+
+    inline static f32x8
+    select(const mask8 &m, const f32x8 &a, const f32x8 &b)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_blendv_ps(b.v, a.v, m.v)};
+    #else
+        return f32x8{select(m.lo, a.lo, b.lo), select(m.hi, a.hi, b.hi)};
+    #endif
+    }
+
+    inline static f32x4
+    sqrt(const f32x4 &a)
+    {
+        return f32x4_sqrt(a);
+    }
+
+    inline static f32x8
+    sqrt(const f32x8 &a)
+    {
+        return f32x8_sqrt(a);
+    }
+
+    inline static f32x4
+    abs(const f32x4 &a)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return f32x4{_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)};
+    #else
+        return select(a < 0.0f, -a, a);
+    #endif
+    }
+
+    inline static f32x8
+    abs(const f32x8 &a)
+    {
+    #if defined(KURO_MATH_AVX)
+        return f32x8{_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+    #else
+        return f32x8{abs(a.lo), abs(a.hi)};
+    #endif
+    }
+
+    // splats f into a register of the same width as the first argument, lets templated kernels
+    // build constants without knowing their lane count
+    inline static f32x4
+    _splat(const f32x4 &, f32 f)
+    {
+        return f32x4_splat(f);
+    }
+
+    inline static f32x8
+    _splat(const f32x8 &, f32 f)
+    {
+        return f32x8_splat(f);
+    }
+
+    // round to nearest even by pushing the fraction out of the mantissa, |a| must be below 2^22
+    template <typename F>
+    inline static F
+    _round_small(const F &a)
+    {
+        return (a + 12582912.0f) - 12582912.0f;
+    }
+
+    template <typename F>
+    inline static F
+    _floor_small(const F &a)
+    {
+        F r = _round_small(a);
+        return r - select(r > a, _splat(a, 1.0f), _splat(a, 0.0f));
+    }
+
+    // vectorised transcendentals, same polynomials and reductions as the f32 versions so every lane
+    // matches the scalar result, sin, cos and tan are only accurate for |x| < 8192 (no libm fallback)
+    template <typename F>
+    inline static void
+    _sincos(const F &theta, F &s, F &c)
+    {
+        F k = _round_small(theta * 0.636619772367581f);
+        F x = ((theta - k * 1.5703125f) - k * 4.837512969970703125e-4f) - k * 7.54978995489188216e-8f;
+
+        F z = x * x;
+        F ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+        F pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+
+        // quadrant k mod 4
+        F q = k - 4.0f * _floor_small(k * 0.25f);
+        auto odd = (q == 1.0f) | (q == 3.0f);
+        F sb = select(odd, pc, ps);
+        F cb = select(odd, ps, pc);
+        s = select(q >= 2.0f, -sb, sb);
+        c = select((q == 1.0f) | (q == 2.0f), -cb, cb);
+    }
+
+    template <typename F>
+    inline static F
+    _asin(const F &f)
+    {
+        F a = abs(f);
+        a = select(a > 1.0f, _splat(a, 1.0f), a);
+
+        auto big = a > 0.5f;
+        F z = select(big, 0.5f * (1.0f - a), a * a);
+        F x = select(big, sqrt(z), a);
+
+        F r = ((((4.2163199048e-2f * z + 2.4181311049e-2f) * z + 4.5470025998e-2f) * z + 7.4953002686e-2f) * z + 1.6666752422e-1f) * z * x + x;
+        r = select(big, 1.5707963267948966f - (r + r), r);
+
+        return select(f < 0.0f, -r, r);
+    }
+
+    template <typename F>
+    inline static F
+    _atan(const F &f)
+    {
+        F a = abs(f);
+
+        auto big = a > 2.414213562373095f;
+        auto mid = ~big & (a > 0.4142135623730950f);
+        F x = select(big, -1.0f / a, select(mid, (a - 1.0f) / (a + 1.0f), a));
+        F y = select(big, _splat(a, 1.5707963267948966f), select(mid, _splat(a, 0.7853981633974483f), _splat(a, 0.0f)));
+
+        F z = x * x;
+        y = y + (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * x + x;
+
+        return select(f < 0.0f, -y, y);
+    }
+
+    template <typename F>
+    inline static F
+    _atan2(const F &y, const F &x)
+    {
+        F zero = _splat(x, 0.0f);
+
+        F r = _atan(y / x);
+        r = r + select(x < 0.0f, select(y < 0.0f, _splat(x, -3.14159265358979323846f), _splat(x, 3.14159265358979323846f)), zero);
+
+        F on_axis = select(y > 0.0f, _splat(x, 1.5707963267948966f), select(y < 0.0f, _splat(x, -1.5707963267948966f), zero));
+        return select(x == 0.0f, on_axis, r);
+    }
+
+    inline static void sincos(const f32x4 &theta, f32x4 &s, f32x4 &c) { _sincos(theta, s, c); }
+    inline static void sincos(const f32x8 &theta, f32x8 &s, f32x8 &c) { _sincos(theta, s, c); }
+
+    inline static f32x4 sin(const f32x4 &a) { f32x4 s, c; _sincos(a, s, c); return s; }
+    inline static f32x8 sin(const f32x8 &a) { f32x8 s, c; _sincos(a, s, c); return s; }
+
+    inline static f32x4 cos(const f32x4 &a) { f32x4 s, c; _sincos(a, s, c); return c; }
+    inline static f32x8 cos(const f32x8 &a) { f32x8 s, c; _sincos(a, s, c); return c; }
+
+    inline static f32x4 tan(const f32x4 &a) { f32x4 s, c; _sincos(a, s, c); return s / c; }
+    inline static f32x8 tan(const f32x8 &a) { f32x8 s, c; _sincos(a, s, c); return s / c; }
+
+    inline static f32x4 asin(const f32x4 &a) { return _asin(a); }
+    inline static f32x8 asin(const f32x8 &a) { return _asin(a); }
+
+    inline static f32x4 atan2(const f32x4 &y, const f32x4 &x) { return _atan2(y, x); }
+    inline static f32x8 atan2(const f32x8 &y, const f32x8 &x) { return _atan2(y, x); }
+
+    // 16 bytes aligned variants of vec4 and mat4, they share the same memory layout as the unaligned
+    // types so converting between them is just a copy
+    struct alignas(16) vec4a
+    {
+        f32 x, y, z, w;
+    };
+
+    struct alignas(16) mat4a
+    {
+        f32 m00, m01, m02, m03;
+        f32 m10, m11, m12, m13;
+        f32 m20, m21, m22, m23;
+        f32 m30, m31, m32, m33;
+    };
+
+    inline static vec4a
+    vec4a_from(const vec4 &v)
+    {
+        return vec4a{v.x, v.y, v.z, v.w};
+    }
+
+    inline static vec4
+    vec4_from(const vec4a &v)
+    {
+        return vec4{v.x, v.y, v.z, v.w};
+    }
+
+    inline static mat4a
+    mat4a_from(const mat4 &M)
+    {
+        mat4a R;
+        f32x4_store(&R.m00, f32x4_loadu(&M.m00));
+        f32x4_store(&R.m10, f32x4_loadu(&M.m10));
+        f32x4_store(&R.m20, f32x4_loadu(&M.m20));
+        f32x4_store(&R.m30, f32x4_loadu(&M.m30));
+        return R;
+    }
+
+    inline static mat4
+    mat4_from(const mat4a &M)
+    {
+        mat4 R;
+        f32x4_storeu(&R.m00, f32x4_load(&M.m00));
+        f32x4_storeu(&R.m10, f32x4_load(&M.m10));
+        f32x4_storeu(&R.m20, f32x4_load(&M.m20));
+        f32x4_storeu(&R.m30, f32x4_load(&M.m30));
+        return R;
+    }
+
+    inline static f32x4
+    _mat4a_row(const mat4a &M, int i)
+    {
+        return f32x4_load(&M.m00 + 4 * i);
+    }
+
+    inline static vec4a
+    _vec4a(const f32x4 &a)
+    {
+        vec4a r;
+        f32x4_store(&r.x, a);
+        return r;
+    }
+
+    inline static mat4a
+    _mat4a(const f32x4 &r0, const f32x4 &r1, const f32x4 &r2, const f32x4 &r3)
+    {
+        mat4a R;
+        f32x4_store(&R.m00, r0);
+        f32x4_store(&R.m10, r1);
+        f32x4_store(&R.m20, r2);
+        f32x4_store(&R.m30, r3);
+        return R;
+    }
+
+    inline static bool
+    operator==(const vec4a &a, const vec4a &b)
+    {
+        return f32x4_equal(f32x4_load(&a.x), f32x4_load(&b.x));
+    }
+
+    inline static bool
+    operator!=(const vec4a &a, const vec4a &b)
+    {
+        return !(a == b);
+    }
+
+    inline static vec4a
+    operator+(const vec4a &a, const vec4a &b)
+    {
+        return _vec4a(f32x4_load(&a.x) + f32x4_load(&b.x));
+    }
+
+    inline static vec4a &
+    operator+=(vec4a &a, const vec4a &b)
+    {
+        a = a + b;
+        return a;
+    }
+
+    inline static vec4a
+    operator-(const vec4a &v)
+    {
+        return _vec4a(-f32x4_load(&v.x));
+    }
+
+    inline static vec4a
+    operator-(const vec4a &a, const vec4a &b)
+    {
+        return _vec4a(f32x4_load(&a.x) - f32x4_load(&b.x));
+    }
+
+    inline static vec4a &
+    operator-=(vec4a &a, const vec4a &b)
+    {
+        a = a - b;
+        return a;
+    }
+
+    inline static vec4a
+    operator*(const vec4a &v, f32 f)
+    {
+        return _vec4a(f32x4_load(&v.x) * f32x4_splat(f));
+    }
+
+    inline static vec4a
+    operator*(f32 f, const vec4a &v)
+    {
+        return v * f;
+    }
+
+    inline static vec4a &
+    operator*=(vec4a &v, f32 f)
+    {
+        v = v * f;
+        return v;
+    }
+
+    inline static vec4a
+    operator/(const vec4a &v, f32 f)
+    {
+        return v * (1.0f / f);
+    }
+
+    inline static vec4a &
+    operator/=(vec4a &v, f32 f)
+    {
+        v = v / f;
+        return v;
+    }
+
+    inline static f32
+    dot(const vec4a &a, const vec4a &b)
+    {
+        return f32x4_sum(f32x4_load(&a.x) * f32x4_load(&b.x));
+    }
+
+    inline static f32
+    norm(const vec4a &v)
+    {
+        return sqrt(dot(v, v));
+    }
+
+    inline static f32
+    length(const vec4a &v)
+    {
+        return norm(v);
+    }
+
+    inline static vec4a
+    normalize(const vec4a &v)
+    {
+        return v / length(v);
+    }
+
+    inline static bool
+    operator==(const mat4a &A, const mat4a &B)
+    {
+        return
+            f32x4_equal(_mat4a_row(A, 0), _mat4a_row(B, 0)) &&
+            f32x4_equal(_mat4a_row(A, 1), _mat4a_row(B, 1)) &&
+            f32x4_equal(_mat4a_row(A, 2), _mat4a_row(B, 2)) &&
+            f32x4_equal(_mat4a_row(A, 3), _mat4a_row(B, 3));
+    }
+
+    inline static bool
+    operator!=(const mat4a &A, const mat4a &B)
+    {
+        return !(A == B);
+    }
+
+    inline static mat4a
+    operator+(const mat4a &A, const mat4a &B)
+    {
+        return _mat4a(
+            _mat4a_row(A, 0) + _mat4a_row(B, 0),
+            _mat4a_row(A, 1) + _mat4a_row(B, 1),
+            _mat4a_row(A, 2) + _mat4a_row(B, 2),
+            _mat4a_row(A, 3) + _mat4a_row(B, 3));
+    }
+
+    inline static mat4a &
+    operator+=(mat4a &A, const mat4a &B)
+    {
+        A = A + B;
+        return A;
+    }
+
+    inline static mat4a
+    operator-(const mat4a &M)
+    {
+        return _mat4a(-_mat4a_row(M, 0), -_mat4a_row(M, 1), -_mat4a_row(M, 2), -_mat4a_row(M, 3));
+    }
+
+    inline static mat4a
+    operator-(const mat4a &A, const mat4a &B)
+    {
+        return _mat4a(
+            _mat4a_row(A, 0) - _mat4a_row(B, 0),
+            _mat4a_row(A, 1) - _mat4a_row(B, 1),
+            _mat4a_row(A, 2) - _mat4a_row(B, 2),
+            _mat4a_row(A, 3) - _mat4a_row(B, 3));
+    }
+
+    inline static mat4a &
+    operator-=(mat4a &A, const mat4a &B)
+    {
+        A = A - B;
+        return A;
+    }
+
+    inline static mat4a
+    operator*(const mat4a &M, f32 f)
+    {
+        f32x4 s = f32x4_splat(f);
+        return _mat4a(_mat4a_row(M, 0) * s, _mat4a_row(M, 1) * s, _mat4a_row(M, 2) * s, _mat4a_row(M, 3) * s);
+    }
+
+    inline static mat4a
+    operator*(f32 f, const mat4a &M)
+    {
+        return M * f;
+    }
+
+    inline static mat4a &
+    operator*=(mat4a &M, f32 f)
+    {
+        M = M * f;
+        return M;
+    }
+
+    // linear combination of the rows of M, evaluated in the same order as the scalar
+    // operator*(vec4, mat4) so both paths give identical results
+    inline static f32x4
+    _mul_rows(const f32x4 &x, const f32x4 &y, const f32x4 &z, const f32x4 &w, const mat4a &M)
+    {
+        return x * _mat4a_row(M, 0) + y * _mat4a_row(M, 1) + z * _mat4a_row(M, 2) + w * _mat4a_row(M, 3);
+    }
+
+    inline static vec4a
+    operator*(const vec4a &v, const mat4a &M)
+    {
+        return _vec4a(_mul_rows(
+            f32x4_splat(v.x), f32x4_splat(v.y), f32x4_splat(v.z), f32x4_splat(v.w), M));
+    }
+
+    inline static mat4a
+    operator*(const mat4a &A, const mat4a &B)
+    {
+    #if defined(KURO_MATH_AVX)
+        // two rows of C per iteration, the low half of each register works on row i and the
+        // high half on row i + 1
+        __m256 b0 = _mm256_broadcast_ps((const __m128 *)&B.m00);
+        __m256 b1 = _mm256_broadcast_ps((const __m128 *)&B.m10);
+        __m256 b2 = _mm256_broadcast_ps((const __m128 *)&B.m20);
+        __m256 b3 = _mm256_broadcast_ps((const __m128 *)&B.m30);
+
+        mat4a C;
+        for (int i = 0; i < 2; ++i)
+        {
+            __m256 a = _mm256_loadu_ps(&A.m00 + 8 * i);
+            __m256 c = _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+            c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+            c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+            c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+            _mm256_storeu_ps(&C.m00 + 8 * i, c);
+        }
+        return C;
+    #else
+        return _mat4a(
+            _mul_rows(f32x4_splat(A.m00), f32x4_splat(A.m01), f32x4_splat(A.m02), f32x4_splat(A.m03), B),
+            _mul_rows(f32x4_splat(A.m10), f32x4_splat(A.m11), f32x4_splat(A.m12), f32x4_splat(A.m13), B),
+            _mul_rows(f32x4_splat(A.m20), f32x4_splat(A.m21), f32x4_splat(A.m22), f32x4_splat(A.m23), B),
+            _mul_rows(f32x4_splat(A.m30), f32x4_splat(A.m31), f32x4_splat(A.m32), f32x4_splat(A.m33), B));
+    #endif
+    }
+
+    inline static mat4a &
+    operator*=(mat4a &A, const mat4a &B)
+    {
+        A = A * B;
+        return A;
+    }
+
+    inline static mat4a
+    mat4a_identity()
+    {
+        return mat4a{
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+            0, 0, 0, 1
+        };
+    }
+
+    inline static mat4a
+    mat4a_transpose(const mat4a &M)
+    {
+    #if defined(KURO_MATH_SSE2)
+        __m128 r0 = _mm_load_ps(&M.m00);
+        __m128 r1 = _mm_load_ps(&M.m10);
+        __m128 r2 = _mm_load_ps(&M.m20);
+        __m128 r3 = _mm_load_ps(&M.m30);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        return _mat4a(f32x4{r0}, f32x4{r1}, f32x4{r2}, f32x4{r3});
+    #else
+        return mat4a_from(mat4_transpose(mat4_from(M)));
+    #endif
+    }
+
+    #if defined(KURO_MATH_SSE2)
+    // 2x2 matrix helpers for the block inverse, a 2x2 matrix is stored row major in one register
+    // A * B
+    inline static __m128
+    _mat2_mul(__m128 a, __m128 b)
+    {
+        return _mm_add_ps(
+            _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+            _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+    }
+
+    // adj(A) * B
+    inline static __m128
+    _mat2_adj_mul(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+            _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+
+    // A * adj(B)
+    inline static __m128
+    _mat2_mul_adj(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(
+            _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+            _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+    }
+
+    // splits M into the 2x2 blocks | A B | and returns det(M), the intermediate terms are kept so
+    //                              | C D |
+    // mat4a_inverse can reuse them
+    struct _mat4a_blocks
+    {
+        __m128 A, B, C, D;
+        __m128 det_A, det_B, det_C, det_D;
+        __m128 D_C, A_B;
+        __m128 det;
+    };
+
+    inline static _mat4a_blocks
+    _mat4a_blocks_compute(const mat4a &M)
+    {
+        __m128 r0 = _mm_load_ps(&M.m00);
+        __m128 r1 = _mm_load_ps(&M.m10);
+        __m128 r2 = _mm_load_ps(&M.m20);
+        __m128 r3 = _mm_load_ps(&M.m30);
+
+        _mat4a_blocks b;
+        b.A = _mm_movelh_ps(r0, r1);
+        b.B = _mm_movehl_ps(r1, r0);
+        b.C = _mm_movelh_ps(r2, r3);
+        b.D = _mm_movehl_ps(r3, r2);
+
+        // determinants of the four blocks in one go
+        __m128 det_sub = _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+        b.det_A = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(0, 0, 0, 0));
+        b.det_B = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(1, 1, 1, 1));
+        b.det_C = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(2, 2, 2, 2));
+        b.det_D = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(3, 3, 3, 3));
+
+        b.D_C = _mat2_adj_mul(b.D, b.C);
+        b.A_B = _mat2_adj_mul(b.A, b.B);
+
+        // det(M) = det(A) * det(D) + det(B) * det(C) - tr(adj(A) * B * adj(D) * C)
+        __m128 tr = _mm_mul_ps(b.A_B, _mm_shuffle_ps(b.D_C, b.D_C, _MM_SHUFFLE(3, 1, 2, 0)));
+        tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+        tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+        b.det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(b.det_A, b.det_D), _mm_mul_ps(b.det_B, b.det_C)), tr);
+        return b;
+    }
+    #endif
+
+    inline static f32
+    mat4a_det(const mat4a &M)
+    {
+    #if defined(KURO_MATH_SSE2)
+        return _mm_cvtss_f32(_mat4a_blocks_compute(M).det);
+    #else
+        return mat4_det(mat4_from(M));
+    #endif
+    }
+
+    inline static bool
+    mat4a_invertible(const mat4a &M)
+    {
+        return mat4a_det(M) != 0.0f;
+    }
+
+    // the SSE2 path evaluates the inverse blockwise, it isn't bit exact with mat4_inverse because
+    // the products are summed in a different order, for well conditioned matrices both agree to a
+    // few ULPs relative to the largest element of the result
+    inline static mat4a
+    mat4a_inverse(const mat4a &M)
+    {
+    #if defined(KURO_MATH_SSE2)
+        _mat4a_blocks b = _mat4a_blocks_compute(M);
+        if (_mm_cvtss_f32(b.det) == 0.0f)
+            return mat4a{};
+
+        __m128 X = _mm_sub_ps(_mm_mul_ps(b.det_D, b.A), _mat2_mul(b.B, b.D_C));
+        __m128 W = _mm_sub_ps(_mm_mul_ps(b.det_A, b.D), _mat2_mul(b.C, b.A_B));
+        __m128 Y = _mm_sub_ps(_mm_mul_ps(b.det_B, b.C), _mat2_mul_adj(b.D, b.A_B));
+        __m128 Z = _mm_sub_ps(_mm_mul_ps(b.det_C, b.B), _mat2_mul_adj(b.A, b.D_C));
+
+        __m128 det_inv = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), b.det);
+        X = _mm_mul_ps(X, det_inv);
+        Y = _mm_mul_ps(Y, det_inv);
+        Z = _mm_mul_ps(Z, det_inv);
+        W = _mm_mul_ps(W, det_inv);
+
+        // the blocks come out as adjugates, shuffling them back also transposes each of them
+        return _mat4a(
+            f32x4{_mm_shuffle_ps(X, Y, _MM_SHUFFLE(1, 3, 1, 3))},
+            f32x4{_mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2))},
+            f32x4{_mm_shuffle_ps(Z, W, _MM_SHUFFLE(1, 3, 1, 3))},
+            f32x4{_mm_shuffle_ps(Z, W, _MM_SHUFFLE(0, 2, 0, 2))});
+    #else
+        return mat4a_from(mat4_inverse(mat4_from(M)));
+    #endif
+    }
+
+    // structure of arrays view over a set of vec3 (positions, normals, ...), it doesn't own the
+    // memory, the three arrays must hold at least count elements each
+    struct vec3_soa
+    {
+        f32 *x;
+        f32 *y;
+        f32 *z;
+        u32 count;
+    };
+
+    inline static vec3
+    vec3_soa_get(const vec3_soa &s, u32 i)
+    {
+        return vec3{s.x[i], s.y[i], s.z[i]};
+    }
+
+    inline static void
+    vec3_soa_set(vec3_soa &s, u32 i, const vec3 &v)
+    {
+        s.x[i] = v.x;
+        s.y[i] = v.y;
+        s.z[i] = v.z;
+    }
+
+    // the arrays of s must hold count elements, s then views exactly those
+    inline static void
+    vec3_soa_from_aos(vec3_soa &s, const vec3 *vs, u32 count)
+    {
+        for (u32 i = 0; i < count; ++i)
+            vec3_soa_set(s, i, vs[i]);
+        s.count = count;
+    }
+
+    inline static void
+    vec3_soa_to_aos(const vec3_soa &s, vec3 *vs)
+    {
+        for (u32 i = 0; i < s.count; ++i)
+            vs[i] = vec3_soa_get(s, i);
+    }
+
+    // batch transform kernels, they process 16 elements per iteration (two f32x8 to hide latency),
+    // then 8, then 4 and finish the tail with scalar code, every lane is evaluated in the same order
+    // as vec4 * mat4 so the result matches the single value path bit by bit
+    // output arrays may alias the input arrays but must not partially overlap them
+
+    // (x, y, z, 1) * M, the w component is dropped so M is expected to be affine
+    inline static void
+    transform_points(const mat4 &M,
+        const f32 *xs, const f32 *ys, const f32 *zs,
+        f32 *out_xs, f32 *out_ys, f32 *out_zs, u32 count)
+    {
+        u32 i = 0;
+
+        f32x8 m00 = f32x8_splat(M.m00), m01 = f32x8_splat(M.m01), m02 = f32x8_splat(M.m02);
+        f32x8 m10 = f32x8_splat(M.m10), m11 = f32x8_splat(M.m11), m12 = f32x8_splat(M.m12);
+        f32x8 m20 = f32x8_splat(M.m20), m21 = f32x8_splat(M.m21), m22 = f32x8_splat(M.m22);
+        f32x8 m30 = f32x8_splat(M.m30), m31 = f32x8_splat(M.m31), m32 = f32x8_splat(M.m32);
+
+        for (; i + 16 <= count; i += 16)
+        {
+            f32x8 x0 = f32x8_loadu(xs + i), x1 = f32x8_loadu(xs + i + 8);
+            f32x8 y0 = f32x8_loadu(ys + i), y1 = f32x8_loadu(ys + i + 8);
+            f32x8 z0 = f32x8_loadu(zs + i), z1 = f32x8_loadu(zs + i + 8);
+
+            f32x8_storeu(out_xs + i,     x0 * m00 + y0 * m10 + z0 * m20 + m30);
+            f32x8_storeu(out_xs + i + 8, x1 * m00 + y1 * m10 + z1 * m20 + m30);
+            f32x8_storeu(out_ys + i,     x0 * m01 + y0 * m11 + z0 * m21 + m31);
+            f32x8_storeu(out_ys + i + 8, x1 * m01 + y1 * m11 + z1 * m21 + m31);
+            f32x8_storeu(out_zs + i,     x0 * m02 + y0 * m12 + z0 * m22 + m32);
+            f32x8_storeu(out_zs + i + 8, x1 * m02 + y1 * m12 + z1 * m22 + m32);
+        }
+
+        for (; i + 8 <= count; i += 8)
+        {
+            f32x8 x = f32x8_loadu(xs + i);
+            f32x8 y = f32x8_loadu(ys + i);
+            f32x8 z = f32x8_loadu(zs + i);
+
+            f32x8_storeu(out_xs + i, x * m00 + y * m10 + z * m20 + m30);
+            f32x8_storeu(out_ys + i, x * m01 + y * m11 + z * m21 + m31);
+            f32x8_storeu(out_zs + i, x * m02 + y * m12 + z * m22 + m32);
+        }
+
+        for (; i + 4 <= count; i += 4)
+        {
+            f32x4 x = f32x4_loadu(xs + i);
+            f32x4 y = f32x4_loadu(ys + i);
+            f32x4 z = f32x4_loadu(zs + i);
+
+            f32x4_storeu(out_xs + i, x * f32x4_splat(M.m00) + y * f32x4_splat(M.m10) + z * f32x4_splat(M.m20) + f32x4_splat(M.m30));
+            f32x4_storeu(out_ys + i, x * f32x4_splat(M.m01) + y * f32x4_splat(M.m11) + z * f32x4_splat(M.m21) + f32x4_splat(M.m31));
+            f32x4_storeu(out_zs + i, x * f32x4_splat(M.m02) + y * f32x4_splat(M.m12) + z * f32x4_splat(M.m22) + f32x4_splat(M.m32));
+        }
+
+        for (; i < count; ++i)
+        {
+            f32 x = xs[i], y = ys[i], z = zs[i];
+            out_xs[i] = x * M.m00 + y * M.m10 + z * M.m20 + M.m30;
+            out_ys[i] = x * M.m01 + y * M.m11 + z * M.m21 + M.m31;
+            out_zs[i] = x * M.m02 + y * M.m12 + z * M.m22 + M.m32;
+        }
+    }
+
+    // (x, y, z, 0) * M, directions and normals (pass the inverse transpose for non uniform scaling)
+    inline static void
+    transform_vectors(const mat4 &M,
+        const f32 *xs, const f32 *ys, const f32 *zs,
+        f32 *out_xs, f32 *out_ys, f32 *out_zs, u32 count)
+    {
+        u32 i = 0;
+
+        f32x8 m00 = f32x8_splat(M.m00), m01 = f32x8_splat(M.m01), m02 = f32x8_splat(M.m02);
+        f32x8 m10 = f32x8_splat(M.m10), m11 = f32x8_splat(M.m11), m12 = f32x8_splat(M.m12);
+        f32x8 m20 = f32x8_splat(M.m20), m21 = f32x8_splat(M.m21), m22 = f32x8_splat(M.m22);
+
+        for (; i + 16 <= count; i += 16)
+        {
+            f32x8 x0 = f32x8_loadu(xs + i), x1 = f32x8_loadu(xs + i + 8);
+            f32x8 y0 = f32x8_loadu(ys + i), y1 = f32x8_loadu(ys + i + 8);
+            f32x8 z0 = f32x8_loadu(zs + i), z1 = f32x8_loadu(zs + i + 8);
+
+            f32x8_storeu(out_xs + i,     x0 * m00 + y0 * m10 + z0 * m20);
+            f32x8_storeu(out_xs + i + 8, x1 * m00 + y1 * m10 + z1 * m20);
+            f32x8_storeu(out_ys + i,     x0 * m01 + y0 * m11 + z0 * m21);
+            f32x8_storeu(out_ys + i + 8, x1 * m01 + y1 * m11 + z1 * m21);
+            f32x8_storeu(out_zs + i,     x0 * m02 + y0 * m12 + z0 * m22);
+            f32x8_storeu(out_zs + i + 8, x1 * m02 + y1 * m12 + z1 * m22);
+        }
+
+        for (; i + 8 <= count; i += 8)
+        {
+            f32x8 x = f32x8_loadu(xs + i);
+            f32x8 y = f32x8_loadu(ys + i);
+            f32x8 z = f32x8_loadu(zs + i);
+
+            f32x8_storeu(out_xs + i, x * m00 + y * m10 + z * m20);
+            f32x8_storeu(out_ys + i, x * m01 + y * m11 + z * m21);
+            f32x8_storeu(out_zs + i, x * m02 + y * m12 + z * m22);
+        }
+
+        for (; i + 4 <= count; i += 4)
+        {
+            f32x4 x = f32x4_loadu(xs + i);
+            f32x4 y = f32x4_loadu(ys + i);
+            f32x4 z = f32x4_loadu(zs + i);
+
+            f32x4_storeu(out_xs + i, x * f32x4_splat(M.m00) + y * f32x4_splat(M.m10) + z * f32x4_splat(M.m20));
+            f32x4_storeu(out_ys + i, x * f32x4_splat(M.m01) + y * f32x4_splat(M.m11) + z * f32x4_splat(M.m21));
+            f32x4_storeu(out_zs + i, x * f32x4_splat(M.m02) + y * f32x4_splat(M.m12) + z * f32x4_splat(M.m22));
+        }
+
+        for (; i < count; ++i)
+        {
+            f32 x = xs[i], y = ys[i], z = zs[i];
+            out_xs[i] = x * M.m00 + y * M.m10 + z * M.m20;
+            out_ys[i] = x * M.m01 + y * M.m11 + z * M.m21;
+            out_zs[i] = x * M.m02 + y * M.m12 + z * M.m22;
+        }
+    }
+
+    // (x, y, z, 1) * M keeping w, used to go to clip space
+    inline static void
+    transform_points_homogeneous(const mat4 &M,
+        const f32 *xs, const f32 *ys, const f32 *zs,
+        f32 *out_xs, f32 *out_ys, f32 *out_zs, f32 *out_ws, u32 count)
+    {
+        u32 i = 0;
+
+        f32x8 m00 = f32x8_splat(M.m00), m01 = f32x8_splat(M.m01), m02 = f32x8_splat(M.m02), m03 = f32x8_splat(M.m03);
+        f32x8 m10 = f32x8_splat(M.m10), m11 = f32x8_splat(M.m11), m12 = f32x8_splat(M.m12), m13 = f32x8_splat(M.m13);
+        f32x8 m20 = f32x8_splat(M.m20), m21 = f32x8_splat(M.m21), m22 = f32x8_splat(M.m22), m23 = f32x8_splat(M.m23);
+        f32x8 m30 = f32x8_splat(M.m30), m31 = f32x8_splat(M.m31), m32 = f32x8_splat(M.m32), m33 = f32x8_splat(M.m33);
+
+        for (; i + 8 <= count; i += 8)
+        {
+            f32x8 x = f32x8_loadu(xs + i);
+            f32x8 y = f32x8_loadu(ys + i);
+            f32x8 z = f32x8_loadu(zs + i);
+
+            f32x8 rx = x * m00 + y * m10 + z * m20 + m30;
+            f32x8 ry = x * m01 + y * m11 + z * m21 + m31;
+            f32x8 rz = x * m02 + y * m12 + z * m22 + m32;
+            f32x8 rw = x * m03 + y * m13 + z * m23 + m33;
+
+            f32x8_storeu(out_xs + i, rx);
+            f32x8_storeu(out_ys + i, ry);
+            f32x8_storeu(out_zs + i, rz);
+            f32x8_storeu(out_ws + i, rw);
+        }
+
+        for (; i < count; ++i)
+        {
+            f32 x = xs[i], y = ys[i], z = zs[i];
+            out_xs[i] = x * M.m00 + y * M.m10 + z * M.m20 + M.m30;
+            out_ys[i] = x * M.m01 + y * M.m11 + z * M.m21 + M.m31;
+            out_zs[i] = x * M.m02 + y * M.m12 + z * M.m22 + M.m32;
+            out_ws[i] = x * M.m03 + y * M.m13 + z * M.m23 + M.m33;
+        }
+    }
+
+    inline static void
+    transform_points(const mat4 &M, const vec3_soa &in, vec3_soa &out)
+    {
+        transform_points(M, in.x, in.y, in.z, out.x, out.y, out.z, in.count);
+    }
+
+    inline static void
+    transform_vectors(const mat4 &M, const vec3_soa &in, vec3_soa &out)
+    {
+        transform_vectors(M, in.x, in.y, in.z, out.x, out.y, out.z, in.count);
+    }
+
+    // 4 quaternions are transposed into x, y, z, w registers so the blends run without horizontal
+    // adds, the results match quat_nlerp and quat_slerp exactly
+    inline static void
+    _quat_load4(const quat *q, f32x4 &x, f32x4 &y, f32x4 &z, f32x4 &w)
+    {
+    #if defined(KURO_MATH_SSE2)
+        __m128 r0 = _mm_loadu_ps(&q[0].x);
+        __m128 r1 = _mm_loadu_ps(&q[1].x);
+        __m128 r2 = _mm_loadu_ps(&q[2].x);
+        __m128 r3 = _mm_loadu_ps(&q[3].x);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        x = f32x4{r0}; y = f32x4{r1}; z = f32x4{r2}; w = f32x4{r3};
+    #else
+        x = f32x4_set(q[0].x, q[1].x, q[2].x, q[3].x);
+        y = f32x4_set(q[0].y, q[1].y, q[2].y, q[3].y);
+        z = f32x4_set(q[0].z, q[1].z, q[2].z, q[3].z);
+        w = f32x4_set(q[0].w, q[1].w, q[2].w, q[3].w);
+    #endif
+    }
+
+    inline static void
+    _quat_store4(quat *q, f32x4 x, f32x4 y, f32x4 z, f32x4 w)
+    {
+    #if defined(KURO_MATH_SSE2)
+        _MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+        _mm_storeu_ps(&q[0].x, x.v);
+        _mm_storeu_ps(&q[1].x, y.v);
+        _mm_storeu_ps(&q[2].x, z.v);
+        _mm_storeu_ps(&q[3].x, w.v);
+    #else
+        for (int i = 0; i < 4; ++i)
+            q[i] = quat{x.v[i], y.v[i], z.v[i], w.v[i]};
+    #endif
+    }
+
+    // t_stride is 0 when all the pairs share the same t
+    template <bool SLERP>
+    inline static void
+    _quat_blend(const quat *a, const quat *b, const f32 *t, u32 t_stride, quat *out, u32 count)
+    {
+        u32 i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            f32x4 ax, ay, az, aw, bx, by, bz, bw;
+            _quat_load4(a + i, ax, ay, az, aw);
+            _quat_load4(b + i, bx, by, bz, bw);
+            f32x4 wb = t_stride ? f32x4_loadu(t + i) : f32x4_splat(t[0]);
+
+            f32x4 zero = f32x4_splat(0.0f);
+            f32x4 d = ax * bx + ay * by + az * bz + aw * bw;
+            mask4 flip = d < 0.0f;
+            bx = select(flip, -bx, bx);
+            by = select(flip, -by, by);
+            bz = select(flip, -bz, bz);
+            bw = select(flip, -bw, bw);
+
+            f32x4 wa = 1.0f - wb;
+            if (SLERP)
+            {
+                d = select(flip, -d, d);
+                f32x4 s = 1.0f - d * d;
+                s = sqrt(select(s < 0.0f, zero, s));
+                f32x4 theta = _atan2(s, d);
+
+                mask4 curved = s >= 1e-4f;
+                wa = select(curved, sin(wa * theta) / s, wa);
+                wb = select(curved, sin(wb * theta) / s, wb);
+            }
+
+            f32x4 rx = ax * wa + bx * wb;
+            f32x4 ry = ay * wa + by * wb;
+            f32x4 rz = az * wa + bz * wb;
+            f32x4 rw = aw * wa + bw * wb;
+            if (!SLERP)
+            {
+                f32x4 inv = 1.0f / sqrt(rx * rx + ry * ry + rz * rz + rw * rw);
+                rx = rx * inv; ry = ry * inv; rz = rz * inv; rw = rw * inv;
+            }
+            _quat_store4(out + i, rx, ry, rz, rw);
+        }
+
+        for (; i < count; ++i)
+            out[i] = SLERP ? quat_slerp(a[i], b[i], t[i * t_stride]) : quat_nlerp(a[i], b[i], t[i * t_stride]);
+    }
+
+    inline static void
+    quat_nlerp(const quat *a, const quat *b, f32 t, quat *out, u32 count)
+    {
+        _quat_blend<false>(a, b, &t, 0, out, count);
+    }
+
+    inline static void
+    quat_nlerp(const quat *a, const quat *b, const f32 *t, quat *out, u32 count)
+    {
+        _quat_blend<false>(a, b, t, 1, out, count);
+    }
+
+    inline static void
+    quat_slerp(const quat *a, const quat *b, f32 t, quat *out, u32 count)
+    {
+        _quat_blend<true>(a, b, &t, 0, out, count);
+    }
+
+    inline static void
+    quat_slerp(const quat *a, const quat *b, const f32 *t, quat *out, u32 count)
+    {
+        _quat_blend<true>(a, b, t, 1, out, count);
+    }
+
+    // batches of matrices, 8 at a time with one matrix per lane. the elements are moved to and from
+    // the lanes through a small transposed copy, then it's the same cofactor expansion as the scalar
+    // functions. singular matrices come out as zero matrices like the scalar mat3/mat4_inverse
+    template <u32 N>
+    inline static void
+    _mat_load8(const f32 *ms, f32x8 *rows)
+    {
+        f32 t[N][8];
+        for (u32 j = 0; j < 8; ++j)
+            for (u32 k = 0; k < N; ++k)
+                t[k][j] = ms[j * N + k];
+        for (u32 k = 0; k < N; ++k)
+            rows[k] = f32x8_loadu(t[k]);
+    }
+
+    template <u32 N>
+    inline static void
+    _mat_store8(f32 *ms, const f32x8 *rows)
+    {
+        f32 t[N][8];
+        for (u32 k = 0; k < N; ++k)
+            f32x8_storeu(t[k], rows[k]);
+        for (u32 j = 0; j < 8; ++j)
+            for (u32 k = 0; k < N; ++k)
+                ms[j * N + k] = t[k][j];
+    }
+
+    inline static void
+    mat4_det(const mat4 *Ms, f32 *out, u32 count)
+    {
+        u32 i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            f32x8 m[16], s[6], c[6];
+            _mat_load8<16>(&Ms[i].m00, m);
+            _mat4_minors(m, s, c);
+            f32x8_storeu(out + i, _mat4_det(s, c));
+        }
+
+        for (; i < count; ++i)
+            out[i] = mat4_det(Ms[i]);
+    }
+
+    inline static void
+    mat4_inverse(const mat4 *Ms, mat4 *out, u32 count)
+    {
+        u32 i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            f32x8 m[16], s[6], c[6], r[16];
+            _mat_load8<16>(&Ms[i].m00, m);
+            _mat4_minors(m, s, c);
+            f32x8 d = _mat4_det(s, c);
+            _mat4_adj(m, s, c, r);
+
+            mask8 singular = d == 0.0f;
+            f32x8 zero = f32x8_splat(0.0f);
+            f32x8 inv = 1.0f / select(singular, f32x8_splat(1.0f), d);
+            for (int k = 0; k < 16; ++k)
+                r[k] = select(singular, zero, r[k] * inv);
+            _mat_store8<16>(&out[i].m00, r);
+        }
+
+        for (; i < count; ++i)
+            out[i] = mat4_inverse(Ms[i]);
+    }
+
+    inline static void
+    mat3_inverse(const mat3 *Ms, mat3 *out, u32 count)
+    {
+        u32 i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            f32x8 m[9], r[9];
+            _mat_load8<9>(&Ms[i].m00, m);
+            f32x8 d = _mat3_adj_det(m, r);
+
+            mask8 singular = d == 0.0f;
+            f32x8 zero = f32x8_splat(0.0f);
+            f32x8 inv = 1.0f / select(singular, f32x8_splat(1.0f), d);
+            for (int k = 0; k < 9; ++k)
+                r[k] = select(singular, zero, r[k] * inv);
+            _mat_store8<9>(&out[i].m00, r);
+        }
+
+        for (; i < count; ++i)
+            out[i] = mat3_inverse(Ms[i]);
+    }
+
+    // =================================================================================================
+    // == BOUNDS =======================================================================================
+    // =================================================================================================
+
+    // an empty box has min > max, merging anything into it gives that thing back
+    inline static aabb3
+    aabb3_empty()
+    {
+        return aabb3{{F32_MAX, F32_MAX, F32_MAX}, {-F32_MAX, -F32_MAX, -F32_MAX}};
+    }
+
+    inline static bool
+    aabb3_is_empty(const aabb3 &box)
+    {
+        return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+    }
+
+    inline static vec3
+    aabb3_center(const aabb3 &box)
+    {
+        return (box.min + box.max) * 0.5f;
+    }
+
+    // half sizes
+    inline static vec3
+    aabb3_extents(const aabb3 &box)
+    {
+        return (box.max - box.min) * 0.5f;
+    }
+
+    inline static aabb3
+    aabb3_merge(const aabb3 &a, const aabb3 &b)
+    {
+        return aabb3{
+            {a.min.x < b.min.x ? a.min.x : b.min.x, a.min.y < b.min.y ? a.min.y : b.min.y, a.min.z < b.min.z ? a.min.z : b.min.z},
+            {a.max.x > b.max.x ? a.max.x : b.max.x, a.max.y > b.max.y ? a.max.y : b.max.y, a.max.z > b.max.z ? a.max.z : b.max.z}};
+    }
+
+    inline static aabb3
+    aabb3_merge(const aabb3 &box, const vec3 &p)
+    {
+        return aabb3_merge(box, aabb3{p, p});
+    }
+
+    // Arvo, each output axis is the translation plus the smaller and the larger of the two products
+    // of every matrix element with the input extremes, the tightest box around the 8 transformed
+    // corners for a third of the work. M is affine (row vectors), empty boxes stay empty
+    inline static aabb3
+    aabb3_transform(const aabb3 &box, const mat4 &M)
+    {
+        if (aabb3_is_empty(box))
+            return box;
+
+        const f32 *lo = &box.min.x;
+        const f32 *hi = &box.max.x;
+        const f32 *m = &M.m00;
+
+        aabb3 r;
+        f32 *r_lo = &r.min.x;
+        f32 *r_hi = &r.max.x;
+        for (int j = 0; j < 3; ++j)
+        {
+            r_lo[j] = m[12 + j];
+            r_hi[j] = m[12 + j];
+            for (int i = 0; i < 3; ++i)
+            {
+                f32 a = m[i * 4 + j] * lo[i];
+                f32 b = m[i * 4 + j] * hi[i];
+                r_lo[j] += a < b ? a : b;
+                r_hi[j] += a < b ? b : a;
+            }
+        }
+        return r;
+    }
+
+    inline static aabb3
+    aabb3_from(const sphere3 &sphere)
+    {
+        vec3 r = {sphere.radius, sphere.radius, sphere.radius};
+        return aabb3{sphere.center - r, sphere.center + r};
+    }
+
+    inline static f32
+    _absf(f32 f)
+    {
+        return f < 0.0f ? -f : f;
+    }
+
+    inline static aabb3
+    aabb3_from(const obb3 &box)
+    {
+        const mat3 &A = box.axes;
+        vec3 e = {
+            _absf(A.m00) * box.extents.x + _absf(A.m10) * box.extents.y + _absf(A.m20) * box.extents.z,
+            _absf(A.m01) * box.extents.x + _absf(A.m11) * box.extents.y + _absf(A.m21) * box.extents.z,
+            _absf(A.m02) * box.extents.x + _absf(A.m12) * box.extents.y + _absf(A.m22) * box.extents.z};
+        return aabb3{box.center - e, box.center + e};
+    }
+
+    inline static obb3
+    obb3_from(const aabb3 &box)
+    {
+        return obb3{aabb3_center(box), aabb3_extents(box), mat3_identity()};
+    }
+
+    // the axes are transformed and renormalized, the extents take their scaling, exact for rigid
+    // transforms and for scaling along the box axes (a shear leaves the axes non orthogonal)
+    inline static obb3
+    obb3_transform(const obb3 &box, const mat4 &M)
+    {
+        mat3 L = {
+            M.m00, M.m01, M.m02,
+            M.m10, M.m11, M.m12,
+            M.m20, M.m21, M.m22};
+        vec3 x = vec3{box.axes.m00, box.axes.m01, box.axes.m02} * L;
+        vec3 y = vec3{box.axes.m10, box.axes.m11, box.axes.m12} * L;
+        vec3 z = vec3{box.axes.m20, box.axes.m21, box.axes.m22} * L;
+        // an axis M collapses keeps its direction, the box is flat along it
+        f32 sx = length(x), sy = length(y), sz = length(z);
+        x = sx > 0.0f ? x / sx : vec3{box.axes.m00, box.axes.m01, box.axes.m02};
+        y = sy > 0.0f ? y / sy : vec3{box.axes.m10, box.axes.m11, box.axes.m12};
+        z = sz > 0.0f ? z / sz : vec3{box.axes.m20, box.axes.m21, box.axes.m22};
+
+        obb3 r;
+        r.center = box.center * L + vec3{M.m30, M.m31, M.m32};
+        r.extents = vec3{box.extents.x * sx, box.extents.y * sy, box.extents.z * sz};
+        r.axes = mat3{
+            x.x, x.y, x.z,
+            y.x, y.y, y.z,
+            z.x, z.y, z.z};
+        return r;
+    }
+
+    inline static sphere3
+    sphere3_from(const aabb3 &box)
+    {
+        return sphere3{aabb3_center(box), length(aabb3_extents(box))};
+    }
+
+    // the smallest sphere holding both
+    inline static sphere3
+    sphere3_merge(const sphere3 &a, const sphere3 &b)
+    {
+        vec3 d = b.center - a.center;
+        f32 distance = length(d);
+        if (distance + b.radius <= a.radius)
+            return a;
+        if (distance + a.radius <= b.radius)
+            return b;
+
+        f32 radius = (distance + a.radius + b.radius) * 0.5f;
+        return sphere3{a.center + d * ((radius - a.radius) / distance), radius};
+    }
+
+    // the radius grows by the largest scaling of M, M is affine (row vectors)
+    inline static sphere3
+    sphere3_transform(const sphere3 &sphere, const mat4 &M)
+    {
+        f32 sx = M.m00 * M.m00 + M.m01 * M.m01 + M.m02 * M.m02;
+        f32 sy = M.m10 * M.m10 + M.m11 * M.m11 + M.m12 * M.m12;
+        f32 sz = M.m20 * M.m20 + M.m21 * M.m21 + M.m22 * M.m22;
+        f32 s = sx > sy ? sx : sy;
+        s = s > sz ? s : sz;
+
+        vec4 c = vec4{sphere.center.x, sphere.center.y, sphere.center.z, 1.0f} * M;
+        return sphere3{vec3{c.x, c.y, c.z}, sphere.radius * sqrt(s)};
+    }
+
+    inline static f32
+    _hmin(const f32x8 &a)
+    {
+        f32 v[8];
+        f32x8_storeu(v, a);
+        f32 r = v[0];
+        for (int i = 1; i < 8; ++i)
+            r = v[i] < r ? v[i] : r;
+        return r;
+    }
+
+    inline static f32
+    _hmax(const f32x8 &a)
+    {
+        f32 v[8];
+        f32x8_storeu(v, a);
+        f32 r = v[0];
+        for (int i = 1; i < 8; ++i)
+            r = v[i] > r ? v[i] : r;
+        return r;
+    }
+
+    inline static f32
+    _hsum(const f32x8 &a)
+    {
+        f32 v[8];
+        f32x8_storeu(v, a);
+        return ((v[0] + v[1]) + (v[2] + v[3])) + ((v[4] + v[5]) + (v[6] + v[7]));
+    }
+
+    // fitting and merging kernels over structure of arrays, they reduce 8 lanes per iteration and
+    // finish the tail with scalar code, a set of 0 points gives an empty box
+
+    inline static aabb3
+    aabb3_fit(const vec3_soa &points)
+    {
+        aabb3 box = aabb3_empty();
+
+        u32 i = 0;
+        if (points.count >= 8)
+        {
+            f32x8 lo_x = f32x8_loadu(points.x), lo_y = f32x8_loadu(points.y), lo_z = f32x8_loadu(points.z);
+            f32x8 hi_x = lo_x, hi_y = lo_y, hi_z = lo_z;
+            for (i = 8; i + 8 <= points.count; i += 8)
+            {
+                f32x8 x = f32x8_loadu(points.x + i);
+                f32x8 y = f32x8_loadu(points.y + i);
+                f32x8 z = f32x8_loadu(points.z + i);
+                lo_x = f32x8_min(lo_x, x); hi_x = f32x8_max(hi_x, x);
+                lo_y = f32x8_min(lo_y, y); hi_y = f32x8_max(hi_y, y);
+                lo_z = f32x8_min(lo_z, z); hi_z = f32x8_max(hi_z, z);
+            }
+            box = aabb3{{_hmin(lo_x), _hmin(lo_y), _hmin(lo_z)}, {_hmax(hi_x), _hmax(hi_y), _hmax(hi_z)}};
+        }
+
+        for (; i < points.count; ++i)
+            box = aabb3_merge(box, vec3_soa_get(points, i));
+        return box;
+    }
+
+    // the union of a set of boxes given by their corners
+    inline static aabb3
+    aabb3_merge(const vec3_soa &mins, const vec3_soa &maxs)
+    {
+        aabb3 lo = aabb3_fit(mins);
+        aabb3 hi = aabb3_fit(maxs);
+        return aabb3{lo.min, hi.max};
+    }
+
+    // centered on the bounding box of the points, within sqrt(3) of the smallest sphere
+    inline static sphere3
+    sphere3_fit(const vec3_soa &points)
+    {
+        vec3 c = aabb3_center(aabb3_fit(points));
+        if (points.count == 0)
+            return sphere3{vec3{0.0f, 0.0f, 0.0f}, 0.0f};
+
+        f32 r2 = 0.0f;
+        u32 i = 0;
+        if (points.count >= 8)
+        {
+            f32x8 cx = f32x8_splat(c.x), cy = f32x8_splat(c.y), cz = f32x8_splat(c.z);
+            f32x8 r2s = f32x8_splat(0.0f);
+            for (; i + 8 <= points.count; i += 8)
+            {
+                f32x8 dx = f32x8_loadu(points.x + i) - cx;
+                f32x8 dy = f32x8_loadu(points.y + i) - cy;
+                f32x8 dz = f32x8_loadu(points.z + i) - cz;
+                r2s = f32x8_max(r2s, dx * dx + dy * dy + dz * dz);
+            }
+            r2 = _hmax(r2s);
+        }
+
+        for (; i < points.count; ++i)
+        {
+            vec3 d = vec3_soa_get(points, i) - c;
+            f32 d2 = dot(d, d);
+            r2 = d2 > r2 ? d2 : r2;
+        }
+        return sphere3{c, sqrt(r2)};
+    }
+
+    // cyclic Jacobi rotations of a symmetric 3x3 matrix, the columns of V come out as its
+    // eigenvectors, a handful of sweeps is enough in single precision
+    inline static void
+    _sym3_eigenvectors(f32 A[3][3], f32 V[3][3])
+    {
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                V[i][j] = i == j ? 1.0f : 0.0f;
+
+        static constexpr int PAIRS[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+        for (int sweep = 0; sweep < 8; ++sweep)
+        {
+            f32 off = A[0][1] * A[0][1] + A[0][2] * A[0][2] + A[1][2] * A[1][2];
+            f32 diagonal = A[0][0] * A[0][0] + A[1][1] * A[1][1] + A[2][2] * A[2][2];
+            if (off <= 1e-14f * diagonal)
+                break;
+
+            for (const auto &pair : PAIRS)
+            {
+                int p = pair[0], q = pair[1];
+                if (A[p][q] == 0.0f)
+                    continue;
+
+                f32 theta = (A[q][q] - A[p][p]) / (2.0f * A[p][q]);
+                f32 t = 1.0f / (_absf(theta) + sqrt(theta * theta + 1.0f));
+                t = theta < 0.0f ? -t : t;
+                f32 c = 1.0f / sqrt(t * t + 1.0f);
+                f32 s = t * c;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    f32 kp = A[k][p], kq = A[k][q];
+                    A[k][p] = c * kp - s * kq;
+                    A[k][q] = s * kp + c * kq;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    f32 pk = A[p][k], qk = A[q][k];
+                    A[p][k] = c * pk - s * qk;
+                    A[q][k] = s * pk + c * qk;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    f32 kp = V[k][p], kq = V[k][q];
+                    V[k][p] = c * kp - s * kq;
+                    V[k][q] = s * kp + c * kq;
+                }
+            }
+        }
+    }
+
+    // the axes are the principal axes of the points (eigenvectors of their covariance), the
+    // extents are the range of the points projected on them. points.count must not be 0
+    inline static obb3
+    obb3_fit(const vec3_soa &points)
+    {
+        u32 count = points.count;
+
+        // mean
+        f32 sum[3] = {};
+        u32 i = 0;
+        if (count >= 8)
+        {
+            f32x8 sx = f32x8_splat(0.0f), sy = sx, sz = sx;
+            for (; i + 8 <= count; i += 8)
+            {
+                sx = sx + f32x8_loadu(points.x + i);
+                sy = sy + f32x8_loadu(points.y + i);
+                sz = sz + f32x8_loadu(points.z + i);
+            }
+            sum[0] = _hsum(sx); sum[1] = _hsum(sy); sum[2] = _hsum(sz);
+        }
+        for (; i < count; ++i)
+        {
+            sum[0] += points.x[i]; sum[1] += points.y[i]; sum[2] += points.z[i];
+        }
+        vec3 mean = vec3{sum[0], sum[1], sum[2]} / (f32)count;
+
+        // covariance of the centered points
+        f32 c[6] = {};
+        i = 0;
+        if (count >= 8)
+        {
+            f32x8 mx = f32x8_splat(mean.x), my = f32x8_splat(mean.y), mz = f32x8_splat(mean.z);
+            f32x8 cxx = f32x8_splat(0.0f), cxy = cxx, cxz = cxx, cyy = cxx, cyz = cxx, czz = cxx;
+            for (; i + 8 <= count; i += 8)
+            {
+                f32x8 dx = f32x8_loadu(points.x + i) - mx;
+                f32x8 dy = f32x8_loadu(points.y + i) - my;
+                f32x8 dz = f32x8_loadu(points.z + i) - mz;
+                cxx = cxx + dx * dx; cxy = cxy + dx * dy; cxz = cxz + dx * dz;
+                cyy = cyy + dy * dy; cyz = cyz + dy * dz; czz = czz + dz * dz;
+            }
+            c[0] = _hsum(cxx); c[1] = _hsum(cxy); c[2] = _hsum(cxz);
+            c[3] = _hsum(cyy); c[4] = _hsum(cyz); c[5] = _hsum(czz);
+        }
+        for (; i < count; ++i)
+        {
+            vec3 d = vec3_soa_get(points, i) - mean;
+            c[0] += d.x * d.x; c[1] += d.x * d.y; c[2] += d.x * d.z;
+            c[3] += d.y * d.y; c[4] += d.y * d.z; c[5] += d.z * d.z;
+        }
+
+        f32 A[3][3] = {{c[0], c[1], c[2]}, {c[1], c[3], c[4]}, {c[2], c[4], c[5]}};
+        f32 V[3][3];
+        _sym3_eigenvectors(A, V);
+
+        vec3 axes[3];
+        axes[0] = normalize(vec3{V[0][0], V[1][0], V[2][0]});
+        axes[1] = normalize(vec3{V[0][1], V[1][1], V[2][1]});
+        axes[2] = cross(axes[0], axes[1]);
+
+        // range of the points along every axis, relative to the mean
+        f32 lo[3], hi[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            lo[a] = F32_MAX;
+            hi[a] = -F32_MAX;
+            i = 0;
+            if (count >= 8)
+            {
+                f32x8 ax = f32x8_splat(axes[a].x), ay = f32x8_splat(axes[a].y), az = f32x8_splat(axes[a].z);
+                f32x8 m = f32x8_splat(dot(mean, axes[a]));
+                f32x8 lo8 = f32x8_splat(F32_MAX), hi8 = f32x8_splat(-F32_MAX);
+                for (; i + 8 <= count; i += 8)
+                {
+                    f32x8 d = f32x8_loadu(points.x + i) * ax + f32x8_loadu(points.y + i) * ay + f32x8_loadu(points.z + i) * az - m;
+                    lo8 = f32x8_min(lo8, d);
+                    hi8 = f32x8_max(hi8, d);
+                }
+                lo[a] = _hmin(lo8);
+                hi[a] = _hmax(hi8);
+            }
+            for (; i < count; ++i)
+            {
+                f32 d = dot(vec3_soa_get(points, i), axes[a]) - dot(mean, axes[a]);
+                lo[a] = d < lo[a] ? d : lo[a];
+                hi[a] = d > hi[a] ? d : hi[a];
+            }
+        }
+
+        obb3 box;
+        box.center = mean + axes[0] * ((lo[0] + hi[0]) * 0.5f) + axes[1] * ((lo[1] + hi[1]) * 0.5f) + axes[2] * ((lo[2] + hi[2]) * 0.5f);
+        box.extents = vec3{(hi[0] - lo[0]) * 0.5f, (hi[1] - lo[1]) * 0.5f, (hi[2] - lo[2]) * 0.5f};
+        box.axes = mat3{
+            axes[0].x, axes[0].y, axes[0].z,
+            axes[1].x, axes[1].y, axes[1].z,
+            axes[2].x, axes[2].y, axes[2].z};
+        return box;
+    }
+
+    // refits a set of local boxes with one matrix each (animated objects), every box is an Arvo
+    // transform on whole matrix rows, out may alias boxes and matches aabb3_transform exactly
+    inline static void
+    aabb3_transform(const aabb3 *boxes, const mat4 *Ms, aabb3 *out, u32 count)
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            const aabb3 &box = boxes[i];
+            if (aabb3_is_empty(box))
+            {
+                out[i] = box;
+                continue;
+            }
+
+            const mat4 &M = Ms[i];
+            f32x4 lo = f32x4_loadu(&M.m30);
+            f32x4 hi = lo;
+
+            const f32 *box_lo = &box.min.x;
+            const f32 *box_hi = &box.max.x;
+            for (int r = 0; r < 3; ++r)
+            {
+                f32x4 row = f32x4_loadu(&M.m00 + r * 4);
+                f32x4 a = row * f32x4_splat(box_lo[r]);
+                f32x4 b = row * f32x4_splat(box_hi[r]);
+                lo = lo + f32x4_min(a, b);
+                hi = hi + f32x4_max(a, b);
+            }
+
+            f32 r_lo[4], r_hi[4];
+            f32x4_storeu(r_lo, lo);
+            f32x4_storeu(r_hi, hi);
+            out[i] = aabb3{{r_lo[0], r_lo[1], r_lo[2]}, {r_hi[0], r_hi[1], r_hi[2]}};
+        }
+    }
+
+    // =================================================================================================
+    // == INTERSECTIONS ================================================================================
+    // =================================================================================================
+
+    // ray queries report the distance t along the ray direction of the first hit (t >= 0, a ray that
+    // starts inside a volume hits it at t = 0), the direction doesn't have to be normalized, t is
+    // then in multiples of its length
+
+    // boxes entered past t_max miss, like ray_aabb_intersect_x4
+    inline static bool
+    ray_aabb_intersect(const ray3 &ray, const aabb3 &box, f32 t_max, f32 &t)
+    {
+        // slab test, the near and far planes are picked from the direction sign so empty boxes
+        // (min > max) never hit, NaNs coming from 0 * inf on axis aligned rays fail the comparisons
+        // and leave the interval untouched
+        f32 t_near = 0.0f;
+        f32 t_far = t_max;
+
+        const f32 *o = &ray.origin.x;
+        const f32 *d = &ray.direction.x;
+        const f32 *lo = &box.min.x;
+        const f32 *hi = &box.max.x;
+        for (int i = 0; i < 3; ++i)
+        {
+            f32 inv = 1.0f / d[i];
+            f32 t0 = ((inv < 0.0f ? hi[i] : lo[i]) - o[i]) * inv;
+            f32 t1 = ((inv < 0.0f ? lo[i] : hi[i]) - o[i]) * inv;
+
+            t_near = t0 > t_near ? t0 : t_near;
+            t_far = t1 < t_far ? t1 : t_far;
+            if (t_near > t_far)
+                return false;
+        }
+
+        t = t_near;
+        return true;
+    }
+
+    // Moller-Trumbore, both faces are hit, u and v are the barycentric weights of v1 and v2. rays
+    // closer than about 1e-7 radians to the plane of the triangle miss, the bound scales with the
+    // edge and direction lengths so it holds for tiny and huge triangles alike
+    inline static bool
+    ray_triangle_intersect(const ray3 &ray, const vec3 &v0, const vec3 &v1, const vec3 &v2, f32 &t, f32 &u, f32 &v)
+    {
+        vec3 e1 = v1 - v0;
+        vec3 e2 = v2 - v0;
+
+        vec3 p = cross(ray.direction, e2);
+        f32 det = dot(e1, p);
+        if (!(det * det > 1e-14f * dot(e1, e1) * dot(e2, e2) * dot(ray.direction, ray.direction)))
+            return false;
+
+        f32 det_inv = 1.0f / det;
+        vec3 s = ray.origin - v0;
+        f32 bu = dot(s, p) * det_inv;
+        if (bu < 0.0f || bu > 1.0f)
+            return false;
+
+        vec3 q = cross(s, e1);
+        f32 bv = dot(ray.direction, q) * det_inv;
+        if (bv < 0.0f || bu + bv > 1.0f)
+            return false;
+
+        f32 bt = dot(e2, q) * det_inv;
+        if (bt < 0.0f)
+            return false;
+
+        t = bt;
+        u = bu;
+        v = bv;
+        return true;
+    }
+
+    inline static bool
+    ray_triangle_intersect(const ray3 &ray, const vec3 &v0, const vec3 &v1, const vec3 &v2, f32 &t)
+    {
+        f32 u, v;
+        return ray_triangle_intersect(ray, v0, v1, v2, t, u, v);
+    }
+
+    inline static bool
+    ray_sphere_intersect(const ray3 &ray, const sphere3 &sphere, f32 &t)
+    {
+        vec3 m = ray.origin - sphere.center;
+        f32 a = dot(ray.direction, ray.direction);
+        f32 b = dot(m, ray.direction);
+        f32 c = dot(m, m) - sphere.radius * sphere.radius;
+
+        // origin outside and pointing away
+        if (c > 0.0f && b > 0.0f)
+            return false;
+
+        f32 disc = b * b - a * c;
+        if (disc < 0.0f)
+            return false;
+
+        f32 bt = (-b - sqrt(disc)) / a;
+        t = bt < 0.0f ? 0.0f : bt;
+        return true;
+    }
+
+    inline static bool
+    ray_plane_intersect(const ray3 &ray, const plane3 &plane, f32 &t)
+    {
+        f32 denom = dot(plane.normal, ray.direction);
+        if (denom == 0.0f)
+            return false;
+
+        f32 bt = -(dot(plane.normal, ray.origin) + plane.d) / denom;
+        if (bt < 0.0f)
+            return false;
+
+        t = bt;
+        return true;
+    }
+
+    // packets hold 4 or 8 shapes in structure of arrays layout so one ray is tested against all of
+    // them at once, the packet queries return a bitmask (bit i set when shape i is hit with
+    // 0 <= t <= t_max) and write t of every lane (F32_MAX for the lanes that miss)
+    // unused lanes should be filled with empty boxes (min > max) or degenerate triangles
+
+    struct alignas(16) aabb3_x4
+    {
+        f32 min_x[4], min_y[4], min_z[4];
+        f32 max_x[4], max_y[4], max_z[4];
+    };
+
+    struct alignas(32) aabb3_x8
+    {
+        f32 min_x[8], min_y[8], min_z[8];
+        f32 max_x[8], max_y[8], max_z[8];
+    };
+
+    // triangles are stored as v0 and the two edges v1 - v0, v2 - v0
+    struct alignas(16) triangle3_x4
+    {
+        f32 v0_x[4], v0_y[4], v0_z[4];
+        f32 e1_x[4], e1_y[4], e1_z[4];
+        f32 e2_x[4], e2_y[4], e2_z[4];
+    };
+
+    struct alignas(32) triangle3_x8
+    {
+        f32 v0_x[8], v0_y[8], v0_z[8];
+        f32 e1_x[8], e1_y[8], e1_z[8];
+        f32 e2_x[8], e2_y[8], e2_z[8];
+    };
+
+    struct alignas(16) sphere3_x4
+    {
+        f32 center_x[4], center_y[4], center_z[4];
+        f32 radius[4];
+    };
+
+    struct alignas(32) sphere3_x8
+    {
+        f32 center_x[8], center_y[8], center_z[8];
+        f32 radius[8];
+    };
+
+    template <typename P>
+    inline static void
+    _aabb3_packet_set(P &packet, u32 lane, const aabb3 &box)
+    {
+        packet.min_x[lane] = box.min.x;
+        packet.min_y[lane] = box.min.y;
+        packet.min_z[lane] = box.min.z;
+        packet.max_x[lane] = box.max.x;
+        packet.max_y[lane] = box.max.y;
+        packet.max_z[lane] = box.max.z;
+    }
+
+    template <typename P>
+    inline static void
+    _triangle3_packet_set(P &packet, u32 lane, const vec3 &v0, const vec3 &v1, const vec3 &v2)
+    {
+        vec3 e1 = v1 - v0;
+        vec3 e2 = v2 - v0;
+        packet.v0_x[lane] = v0.x; packet.v0_y[lane] = v0.y; packet.v0_z[lane] = v0.z;
+        packet.e1_x[lane] = e1.x; packet.e1_y[lane] = e1.y; packet.e1_z[lane] = e1.z;
+        packet.e2_x[lane] = e2.x; packet.e2_y[lane] = e2.y; packet.e2_z[lane] = e2.z;
+    }
+
+    template <typename P>
+    inline static void
+    _sphere3_packet_set(P &packet, u32 lane, const sphere3 &sphere)
+    {
+        packet.center_x[lane] = sphere.center.x;
+        packet.center_y[lane] = sphere.center.y;
+        packet.center_z[lane] = sphere.center.z;
+        packet.radius[lane] = sphere.radius;
+    }
+
+    inline static void aabb3_x4_set(aabb3_x4 &packet, u32 lane, const aabb3 &box) { _aabb3_packet_set(packet, lane, box); }
+    inline static void aabb3_x8_set(aabb3_x8 &packet, u32 lane, const aabb3 &box) { _aabb3_packet_set(packet, lane, box); }
+
+    inline static void triangle3_x4_set(triangle3_x4 &packet, u32 lane, const vec3 &v0, const vec3 &v1, const vec3 &v2) { _triangle3_packet_set(packet, lane, v0, v1, v2); }
+    inline static void triangle3_x8_set(triangle3_x8 &packet, u32 lane, const vec3 &v0, const vec3 &v1, const vec3 &v2) { _triangle3_packet_set(packet, lane, v0, v1, v2); }
+
+    inline static void sphere3_x4_set(sphere3_x4 &packet, u32 lane, const sphere3 &sphere) { _sphere3_packet_set(packet, lane, sphere); }
+    inline static void sphere3_x8_set(sphere3_x8 &packet, u32 lane, const sphere3 &sphere) { _sphere3_packet_set(packet, lane, sphere); }
+
+    inline static f32x4 _loadu(const f32x4 &, const f32 *ptr) { return f32x4_loadu(ptr); }
+    inline static f32x8 _loadu(const f32x8 &, const f32 *ptr) { return f32x8_loadu(ptr); }
+    inline static void _storeu(f32 *ptr, const f32x4 &a) { f32x4_storeu(ptr, a); }
+    inline static void _storeu(f32 *ptr, const f32x8 &a) { f32x8_storeu(ptr, a); }
+
+    template <typename F, typename P>
+    inline static u32
+    _ray_aabb_packet(const ray3 &ray, const P &packet, f32 t_max, f32 *t)
+    {
+        F zero = _splat(F{}, 0.0f);
+
+        F t_near = zero;
+        F t_far = _splat(zero, t_max);
+
+        const f32 *o = &ray.origin.x;
+        const f32 *d = &ray.direction.x;
+        const f32 *lo[3] = {packet.min_x, packet.min_y, packet.min_z};
+        const f32 *hi[3] = {packet.max_x, packet.max_y, packet.max_z};
+        for (int i = 0; i < 3; ++i)
+        {
+            // the ray is shared by all lanes so near/far planes are picked once per axis
+            f32 inv = 1.0f / d[i];
+            F origin = _splat(zero, o[i]);
+            F t0 = (_loadu(zero, inv < 0.0f ? hi[i] : lo[i]) - origin) * inv;
+            F t1 = (_loadu(zero, inv < 0.0f ? lo[i] : hi[i]) - origin) * inv;
+
+            t_near = select(t0 > t_near, t0, t_near);
+            t_far = select(t1 < t_far, t1, t_far);
+        }
+
+        auto hit = t_near <= t_far;
+        _storeu(t, select(hit, t_near, _splat(zero, F32_MAX)));
+        return bitmask(hit);
+    }
+
+    template <typename F, typename P>
+    inline static u32
+    _ray_triangle_packet(const ray3 &ray, const P &packet, f32 t_max, f32 *t)
+    {
+        F zero = _splat(F{}, 0.0f);
+
+        F dx = _splat(zero, ray.direction.x), dy = _splat(zero, ray.direction.y), dz = _splat(zero, ray.direction.z);
+        F e1x = _loadu(zero, packet.e1_x), e1y = _loadu(zero, packet.e1_y), e1z = _loadu(zero, packet.e1_z);
+        F e2x = _loadu(zero, packet.e2_x), e2y = _loadu(zero, packet.e2_y), e2z = _loadu(zero, packet.e2_z);
+
+        // p = cross(d, e2)
+        F px = dy * e2z - dz * e2y;
+        F py = dz * e2x - dx * e2z;
+        F pz = dx * e2y - dy * e2x;
+        F det = e1x * px + e1y * py + e1z * pz;
+        F det_inv = 1.0f / det;
+
+        F sx = _splat(zero, ray.origin.x) - _loadu(zero, packet.v0_x);
+        F sy = _splat(zero, ray.origin.y) - _loadu(zero, packet.v0_y);
+        F sz = _splat(zero, ray.origin.z) - _loadu(zero, packet.v0_z);
+        F u = (sx * px + sy * py + sz * pz) * det_inv;
+
+        // q = cross(s, e1)
+        F qx = sy * e1z - sz * e1y;
+        F qy = sz * e1x - sx * e1z;
+        F qz = sx * e1y - sy * e1x;
+        F v = (dx * qx + dy * qy + dz * qz) * det_inv;
+        F bt = (e2x * qx + e2y * qy + e2z * qz) * det_inv;
+
+        // the same parallel bound as ray_triangle_intersect
+        F e1_e1 = e1x * e1x + e1y * e1y + e1z * e1z;
+        F e2_e2 = e2x * e2x + e2y * e2y + e2z * e2z;
+        F bound = _splat(zero, 1e-14f) * e1_e1 * e2_e2 * dot(ray.direction, ray.direction);
+
+        auto hit = (det * det > bound) & (u >= 0.0f) & (v >= 0.0f) & (u + v <= 1.0f) & (bt >= 0.0f) & (bt <= t_max);
+        _storeu(t, select(hit, bt, _splat(zero, F32_MAX)));
+        return bitmask(hit);
+    }
+
+    template <typename F, typename P>
+    inline static u32
+    _ray_sphere_packet(const ray3 &ray, const P &packet, f32 t_max, f32 *t)
+    {
+        F zero = _splat(F{}, 0.0f);
+
+        F dx = _splat(zero, ray.direction.x), dy = _splat(zero, ray.direction.y), dz = _splat(zero, ray.direction.z);
+        F mx = _splat(zero, ray.origin.x) - _loadu(zero, packet.center_x);
+        F my = _splat(zero, ray.origin.y) - _loadu(zero, packet.center_y);
+        F mz = _splat(zero, ray.origin.z) - _loadu(zero, packet.center_z);
+        F r = _loadu(zero, packet.radius);
+
+        f32 a = dot(ray.direction, ray.direction);
+        F b = mx * dx + my * dy + mz * dz;
+        F c = (mx * mx + my * my + mz * mz) - r * r;
+        F disc = b * b - a * c;
+
+        F bt = (-b - sqrt(select(disc < 0.0f, zero, disc))) / a;
+        bt = select(bt < 0.0f, zero, bt);
+
+        auto hit = ~((c > 0.0f) & (b > 0.0f)) & (disc >= 0.0f) & (bt <= t_max);
+        _storeu(t, select(hit, bt, _splat(zero, F32_MAX)));
+        return bitmask(hit);
+    }
+
+    inline static u32
+    ray_aabb_intersect_x4(const ray3 &ray, const aabb3_x4 &boxes, f32 t_max, f32 t[4])
+    {
+        return _ray_aabb_packet<f32x4>(ray, boxes, t_max, t);
+    }
+
+    inline static u32
+    ray_aabb_intersect_x8(const ray3 &ray, const aabb3_x8 &boxes, f32 t_max, f32 t[8])
+    {
+        return _ray_aabb_packet<f32x8>(ray, boxes, t_max, t);
+    }
+
+    inline static u32
+    ray_triangle_intersect_x4(const ray3 &ray, const triangle3_x4 &triangles, f32 t_max, f32 t[4])
+    {
+        return _ray_triangle_packet<f32x4>(ray, triangles, t_max, t);
+    }
+
+    inline static u32
+    ray_triangle_intersect_x8(const ray3 &ray, const triangle3_x8 &triangles, f32 t_max, f32 t[8])
+    {
+        return _ray_triangle_packet<f32x8>(ray, triangles, t_max, t);
+    }
+
+    inline static u32
+    ray_sphere_intersect_x4(const ray3 &ray, const sphere3_x4 &spheres, f32 t_max, f32 t[4])
+    {
+        return _ray_sphere_packet<f32x4>(ray, spheres, t_max, t);
+    }
+
+    inline static u32
+    ray_sphere_intersect_x8(const ray3 &ray, const sphere3_x8 &spheres, f32 t_max, f32 t[8])
+    {
+        return _ray_sphere_packet<f32x8>(ray, spheres, t_max, t);
+    }
+
+    // =================================================================================================
+    // == CULLING ======================================================================================
+    // =================================================================================================
+
+    // the six planes of a view projection matrix, normals point inside and are normalized so the
+    // distances tested against are in world units, planes are ordered left, right, bottom, top, near,
+    // far. the tests are conservative: a shape that is outside no single plane is visible, even if it
+    // only passes a frustum corner
+    struct frustum
+    {
+        plane3 planes[6];
+    };
+
+    // VP maps world space to clip space with the conventions of mat4_prespective and mat4_ortho, row
+    // vectors and 0 <= z <= w, so VP = view * projection
+    inline static frustum
+    frustum_from(const mat4 &VP)
+    {
+        // a plane of clip space is a combination of the columns of VP
+        vec4 x = {VP.m00, VP.m10, VP.m20, VP.m30};
+        vec4 y = {VP.m01, VP.m11, VP.m21, VP.m31};
+        vec4 z = {VP.m02, VP.m12, VP.m22, VP.m32};
+        vec4 w = {VP.m03, VP.m13, VP.m23, VP.m33};
+        vec4 planes[6] = {w + x, w - x, w + y, w - y, z, w - z};
+
+        frustum F;
+        for (int i = 0; i < 6; ++i)
+        {
+            vec3 normal = {planes[i].x, planes[i].y, planes[i].z};
+            f32 inv = 1.0f / length(normal);
+            F.planes[i] = plane3{normal * inv, planes[i].w * inv};
+        }
+        return F;
+    }
+
+    inline static bool
+    frustum_sphere_visible(const frustum &F, const sphere3 &sphere)
+    {
+        for (const plane3 &plane : F.planes)
+        {
+            if (plane.normal.x * sphere.center.x + plane.normal.y * sphere.center.y + plane.normal.z * sphere.center.z + plane.d < -sphere.radius)
+                return false;
+        }
+        return true;
+    }
+
+    // only the corner furthest along each normal is tested
+    inline static bool
+    frustum_aabb_visible(const frustum &F, const aabb3 &box)
+    {
+        for (const plane3 &plane : F.planes)
+        {
+            f32 x = plane.normal.x > 0.0f ? box.max.x : box.min.x;
+            f32 y = plane.normal.y > 0.0f ? box.max.y : box.min.y;
+            f32 z = plane.normal.z > 0.0f ? box.max.z : box.min.z;
+            if (plane.normal.x * x + plane.normal.y * y + plane.normal.z * z + plane.d < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    template <typename F>
+    inline static u32
+    _frustum_spheres_packet(const frustum &view, const f32 *xs, const f32 *ys, const f32 *zs, const f32 *radii)
+    {
+        F zero = _splat(F{}, 0.0f);
+        F x = _loadu(zero, xs), y = _loadu(zero, ys), z = _loadu(zero, zs);
+        F neg_r = zero - _loadu(zero, radii);
+
+        auto visible = zero == zero;
+        for (const plane3 &plane : view.planes)
+            visible = visible & (x * plane.normal.x + y * plane.normal.y + z * plane.normal.z + plane.d >= neg_r);
+        return bitmask(visible);
+    }
+
+    template <typename F>
+    inline static u32
+    _frustum_aabbs_packet(const frustum &view, const f32 *min_xs, const f32 *min_ys, const f32 *min_zs, const f32 *max_xs, const f32 *max_ys, const f32 *max_zs)
+    {
+        F zero = _splat(F{}, 0.0f);
+        F min_x = _loadu(zero, min_xs), min_y = _loadu(zero, min_ys), min_z = _loadu(zero, min_zs);
+        F max_x = _loadu(zero, max_xs), max_y = _loadu(zero, max_ys), max_z = _loadu(zero, max_zs);
+
+        // the planes are shared by all lanes so the corner is picked once per plane
+        auto visible = zero == zero;
+        for (const plane3 &plane : view.planes)
+        {
+            const F &x = plane.normal.x > 0.0f ? max_x : min_x;
+            const F &y = plane.normal.y > 0.0f ? max_y : min_y;
+            const F &z = plane.normal.z > 0.0f ? max_z : min_z;
+            visible = visible & (x * plane.normal.x + y * plane.normal.y + z * plane.normal.z + plane.d >= 0.0f);
+        }
+        return bitmask(visible);
+    }
+
+    // batch culling over structure of arrays, 8 shapes per iteration and scalar code for the tail.
+    // bit i % 32 of visible[i / 32] is set when shape i is visible, visible must hold
+    // (count + 31) / 32 words, the bits past count are cleared
+
+    inline static void
+    frustum_cull_spheres(const frustum &F, const vec3_soa &centers, const f32 *radii, u32 *visible)
+    {
+        u32 count = centers.count;
+        for (u32 i = 0; i < (count + 31) / 32; ++i)
+            visible[i] = 0;
+
+        u32 i = 0;
+        for (; i + 8 <= count; i += 8)
+            visible[i / 32] |= _frustum_spheres_packet<f32x8>(F, centers.x + i, centers.y + i, centers.z + i, radii + i) << (i % 32);
+        for (; i < count; ++i)
+        {
+            if (frustum_sphere_visible(F, sphere3{vec3_soa_get(centers, i), radii[i]}))
+                visible[i / 32] |= 1u << (i % 32);
+        }
+    }
+
+    inline static void
+    frustum_cull_aabbs(const frustum &F, const vec3_soa &mins, const vec3_soa &maxs, u32 *visible)
+    {
+        u32 count = mins.count;
+        for (u32 i = 0; i < (count + 31) / 32; ++i)
+            visible[i] = 0;
+
+        u32 i = 0;
+        for (; i + 8 <= count; i += 8)
+            visible[i / 32] |= _frustum_aabbs_packet<f32x8>(F, mins.x + i, mins.y + i, mins.z + i, maxs.x + i, maxs.y + i, maxs.z + i) << (i % 32);
+        for (; i < count; ++i)
+        {
+            if (frustum_aabb_visible(F, aabb3{vec3_soa_get(mins, i), vec3_soa_get(maxs, i)}))
+                visible[i / 32] |= 1u << (i % 32);
+        }
+    }
+
+    // bits must not be 0, de Bruijn multiply so it needs no compiler intrinsic
+    inline static u32
+    _trailing_zeros(u32 bits)
+    {
+        static constexpr u32 TABLE[32] = {
+             0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+            31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+        };
+        return TABLE[((bits & (0u - bits)) * 0x077CB531u) >> 27];
+    }
+
+    // writes the indices of the set bits of the first count bits of visible in increasing order and
+    // returns how many there are, indices must hold count elements
+    inline static u32
+    visibility_compact(const u32 *visible, u32 count, u32 *indices)
+    {
+        u32 n = 0;
+        for (u32 word = 0; word < (count + 31) / 32; ++word)
+        {
+            u32 bits = visible[word];
+            if (word == count / 32)
+                bits &= (1u << (count % 32)) - 1u;
+            while (bits)
+            {
+                indices[n++] = word * 32 + _trailing_zeros(bits);
+                bits &= bits - 1u;
+            }
+        }
+        return n;
+    }
+}
@@ -0,0 +1,377 @@
+/*
+    backend independent pipeline cache of gfx_cache.h
+
+    * the file is a _Cache_File header, entry_count _Cache_Entry records sorted by key and the blobs
+      they point at, each one CACHE_ALIGNMENT aligned, lookups binary search the mapped records
+    * offsets are from the start of the file, every record is checked against the file size on open
+      and a file that fails any check is treated as missing, saving then replaces it
+    * inserted entries live in memory and shadow mapped ones with the same key
+    * saving builds the whole file in memory, writes it next to the old one and renames it over,
+      so a crash while saving leaves the old file intact, the new file is mapped afterwards
+    * the file uses the byte order of the machine that saved it, the blobs are only meaningful to
+      the backend and driver that produced them anyway
+*/
+
+#include "kuro/gfx_cache.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#elif OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t CACHE_FILE_MAGIC = 0x4350524B; // "KRPC"
+static const uint32_t CACHE_FILE_VERSION = 1;
+static const uint64_t CACHE_ALIGNMENT = 16;
+
+typedef struct _Cache_File {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t padding;
+} _Cache_File;
+
+typedef struct _Cache_Entry {
+    uint64_t key;
+    uint64_t offset;
+    uint64_t size;
+} _Cache_Entry;
+
+typedef struct _kr_cache_t {
+    std::string path;
+    const uint8_t *mapped;
+    size_t mapped_size;
+    const _Cache_Entry *entries;
+    uint32_t entry_count;
+#if OS_WINDOWS
+    HANDLE mapping;
+#endif
+    std::unordered_map<uint64_t, std::vector<uint8_t>> inserted;
+} _kr_cache_t;
+
+// MurmurHash64A, the bytecode of a pipeline is a few kilobytes so a word at a time matters
+uint64_t
+kuro_gfx_cache_hash(const void *data, size_t size_in_bytes, uint64_t seed)
+{
+    const uint64_t m = 0xC6A4A7935BD1E995ull;
+    const int r = 47;
+
+    uint64_t h = seed ^ (size_in_bytes * m);
+    const uint8_t *bytes = (const uint8_t *)data;
+    const uint8_t *end = bytes + (size_in_bytes & ~(size_t)7);
+    for (; bytes != end; bytes += 8)
+    {
+        uint64_t k = 0;
+        memcpy(&k, bytes, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    size_t tail = size_in_bytes & 7;
+    if (tail != 0)
+    {
+        uint64_t k = 0;
+        for (size_t i = 0; i < tail; ++i)
+            k |= (uint64_t)bytes[i] << (i * 8);
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+uint64_t
+kuro_gfx_pipeline_hash(Kuro_Gfx_Pipeline_Desc desc, const void *vertex_code, size_t vertex_code_size, const void *pixel_code, size_t pixel_code_size)
+{
+    // copied field by field into a zeroed struct so padding and the unused tail never reach the hash
+    struct {
+        uint32_t attribute_count;
+        uint32_t render_target_count;
+        uint32_t attributes[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES][3];
+    } key = {};
+
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+    {
+        const Kuro_Gfx_Vertex_Attribure &attribute = desc.vertex_attribures[i];
+        if (attribute.format == KURO_GFX_FORMAT_NONE)
+            break;
+        key.attributes[i][0] = (uint32_t)attribute.format;
+        key.attributes[i][1] = (uint32_t)attribute.classification;
+        key.attributes[i][2] = attribute.slot;
+        ++key.attribute_count;
+    }
+    key.render_target_count = desc.render_target_count ? desc.render_target_count : 1;
+
+    uint64_t hash = kuro_gfx_cache_hash(&key, sizeof(key), 0);
+    hash = kuro_gfx_cache_hash(vertex_code, vertex_code_size, hash);
+    hash = kuro_gfx_cache_hash(pixel_code, pixel_code_size, hash);
+    return hash;
+}
+
+static inline void
+_kuro_gfx_cache_unmap(kr_cache_t cache)
+{
+    if (cache->mapped)
+    {
+#if OS_WINDOWS
+        UnmapViewOfFile(cache->mapped);
+        CloseHandle(cache->mapping);
+        cache->mapping = nullptr;
+#elif OS_LINUX
+        munmap((void *)cache->mapped, cache->mapped_size);
+#endif
+    }
+    cache->mapped = nullptr;
+    cache->mapped_size = 0;
+    cache->entries = nullptr;
+    cache->entry_count = 0;
+}
+
+static inline bool
+_kuro_gfx_cache_check(const uint8_t *data, size_t size)
+{
+    _Cache_File file = {};
+    if (size < sizeof(file))
+        return false;
+    memcpy(&file, data, sizeof(file));
+
+    if (file.magic != CACHE_FILE_MAGIC || file.version != CACHE_FILE_VERSION)
+        return false;
+    uint64_t blobs_offset = sizeof(file) + (uint64_t)file.entry_count * sizeof(_Cache_Entry);
+    if (blobs_offset > size)
+        return false;
+
+    const _Cache_Entry *entries = (const _Cache_Entry *)(data + sizeof(file));
+    for (uint32_t i = 0; i < file.entry_count; ++i)
+    {
+        const _Cache_Entry &entry = entries[i];
+        if (i > 0 && entries[i - 1].key >= entry.key)
+            return false;
+        if (entry.offset < blobs_offset || entry.offset > size || entry.size > size - entry.offset)
+            return false;
+    }
+    return true;
+}
+
+static inline void
+_kuro_gfx_cache_map(kr_cache_t cache)
+{
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+#if OS_WINDOWS
+    HANDLE file = CreateFileA(cache->path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER file_size = {};
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (uint64_t)file_size.QuadPart <= SIZE_MAX)
+    {
+        size = (size_t)file_size.QuadPart;
+        cache->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (cache->mapping)
+        {
+            data = (const uint8_t *)MapViewOfFile(cache->mapping, FILE_MAP_READ, 0, 0, 0);
+            if (data == nullptr)
+            {
+                CloseHandle(cache->mapping);
+                cache->mapping = nullptr;
+            }
+        }
+    }
+    // the mapping keeps the file open
+    CloseHandle(file);
+#elif OS_LINUX
+    int file = open(cache->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        return;
+    struct stat file_stat = {};
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        size = (size_t)file_stat.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped != MAP_FAILED)
+            data = (const uint8_t *)mapped;
+    }
+    close(file);
+#endif
+
+    if (data == nullptr)
+        return;
+
+    cache->mapped = data;
+    cache->mapped_size = size;
+    if (!_kuro_gfx_cache_check(data, size))
+    {
+        _kuro_gfx_cache_unmap(cache);
+        return;
+    }
+
+    _Cache_File header = {};
+    memcpy(&header, data, sizeof(header));
+    cache->entries = (const _Cache_Entry *)(data + sizeof(header));
+    cache->entry_count = header.entry_count;
+}
+
+static inline const _Cache_Entry *
+_kuro_gfx_cache_find_mapped(kr_cache_t cache, uint64_t key)
+{
+    const _Cache_Entry *end = cache->entries + cache->entry_count;
+    const _Cache_Entry *entry = std::lower_bound(cache->entries, end, key,
+        [](const _Cache_Entry &entry, uint64_t key) { return entry.key < key; });
+    if (entry == end || entry->key != key)
+        return nullptr;
+    return entry;
+}
+
+kr_cache_t
+kuro_gfx_cache_open(const char *path)
+{
+    kr_cache_t cache = new _kr_cache_t{};
+    if (path)
+    {
+        cache->path = path;
+        _kuro_gfx_cache_map(cache);
+    }
+    return cache;
+}
+
+void
+kuro_gfx_cache_close(kr_cache_t cache)
+{
+    if (cache == nullptr)
+        return;
+    _kuro_gfx_cache_unmap(cache);
+    delete cache;
+}
+
+const void *
+kuro_gfx_cache_find(kr_cache_t cache, uint64_t key, size_t *size_in_bytes)
+{
+    auto it = cache->inserted.find(key);
+    if (it != cache->inserted.end())
+    {
+        if (size_in_bytes)
+            *size_in_bytes = it->second.size();
+        return it->second.data();
+    }
+
+    const _Cache_Entry *entry = _kuro_gfx_cache_find_mapped(cache, key);
+    if (entry == nullptr)
+        return nullptr;
+    if (size_in_bytes)
+        *size_in_bytes = (size_t)entry->size;
+    return cache->mapped + entry->offset;
+}
+
+void
+kuro_gfx_cache_insert(kr_cache_t cache, uint64_t key, const void *data, size_t size_in_bytes)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    cache->inserted[key].assign(bytes, bytes + size_in_bytes);
+}
+
+uint32_t
+kuro_gfx_cache_count(kr_cache_t cache)
+{
+    uint32_t count = cache->entry_count;
+    for (const auto &it : cache->inserted)
+        if (_kuro_gfx_cache_find_mapped(cache, it.first) == nullptr)
+            ++count;
+    return count;
+}
+
+bool
+kuro_gfx_cache_save(kr_cache_t cache)
+{
+    if (cache->path.empty())
+        return false;
+
+    struct Blob {
+        uint64_t key;
+        const uint8_t *data;
+        uint64_t size;
+    };
+
+    std::vector<Blob> blobs;
+    blobs.reserve(kuro_gfx_cache_count(cache));
+    // inserted data shadows the mapped data of the same key
+    for (uint32_t i = 0; i < cache->entry_count; ++i)
+        if (cache->inserted.count(cache->entries[i].key) == 0)
+            blobs.push_back({cache->entries[i].key, cache->mapped + cache->entries[i].offset, cache->entries[i].size});
+    for (const auto &it : cache->inserted)
+        blobs.push_back({it.first, it.second.data(), it.second.size()});
+    std::sort(blobs.begin(), blobs.end(), [](const Blob &a, const Blob &b) { return a.key < b.key; });
+
+    _Cache_File header = {};
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.entry_count = (uint32_t)blobs.size();
+
+    uint64_t offset = sizeof(header) + blobs.size() * sizeof(_Cache_Entry);
+    std::vector<_Cache_Entry> entries(blobs.size());
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        offset = (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+        entries[i] = {blobs[i].key, offset, blobs[i].size};
+        offset += blobs[i].size;
+    }
+
+    std::vector<uint8_t> data((size_t)offset);
+    memcpy(data.data(), &header, sizeof(header));
+    if (!entries.empty())
+        memcpy(data.data() + sizeof(header), entries.data(), entries.size() * sizeof(_Cache_Entry));
+    for (size_t i = 0; i < blobs.size(); ++i)
+        if (blobs[i].size != 0)
+            memcpy(data.data() + entries[i].offset, blobs[i].data, (size_t)blobs[i].size);
+
+    // everything is copied out of the mapping, which has to go before the file can be replaced on windows
+    _kuro_gfx_cache_unmap(cache);
+    cache->inserted.clear();
+
+    std::string temporary_path = cache->path + ".tmp";
+    bool saved = false;
+    FILE *file = fopen(temporary_path.c_str(), "wb");
+    if (file)
+    {
+        saved = fwrite(data.data(), 1, data.size(), file) == data.size();
+        saved = fclose(file) == 0 && saved;
+    }
+#if OS_WINDOWS
+    saved = saved && MoveFileExA(temporary_path.c_str(), cache->path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    saved = saved && rename(temporary_path.c_str(), cache->path.c_str()) == 0;
+#endif
+
+    _kuro_gfx_cache_map(cache);
+    if (!saved)
+    {
+        remove(temporary_path.c_str());
+        // the old file is untouched, everything goes back into memory for a later save
+        for (size_t i = 0; i < blobs.size(); ++i)
+        {
+            const uint8_t *bytes = data.data() + entries[i].offset;
+            cache->inserted.emplace(blobs[i].key, std::vector<uint8_t>(bytes, bytes + blobs[i].size));
+        }
+    }
+    return saved;
+}
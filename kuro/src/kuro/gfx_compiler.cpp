@@ -0,0 +1,223 @@
+/*
+    backend independent shader compile threads of gfx_compiler.h
+
+    * one mutex guards the queue, the compiles in flight and the cache, the compile function itself
+      runs without it so the threads only serialize on bookkeeping
+    * a compile holds a reference for every submit that shares it and one while it is queued, the
+      last release frees it
+    * failed compiles are not cached, so every submit of a broken shader reports its errors again
+*/
+
+#include "kuro/gfx_compiler.h"
+#include "kuro/gfx_cache.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef struct _kr_compile_t {
+    kr_compiler_t compiler;
+    uint64_t key;
+    std::string source;
+    std::string entry_point;
+    std::string profile;
+    uint32_t flags;
+    std::vector<uint8_t> code;
+    bool done;
+    bool failed;
+    uint32_t references;
+} _kr_compile_t;
+
+typedef struct _kr_compiler_t {
+    Kuro_Gfx_Shader_Compile compile;
+    void *user_data;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable done;
+    std::deque<kr_compile_t> queue;
+    std::unordered_map<uint64_t, kr_compile_t> pending;
+    kr_cache_t cache;
+    bool quit;
+} _kr_compiler_t;
+
+// called with the compiler mutex held
+static inline void
+_kuro_gfx_compile_release(kr_compile_t compile)
+{
+    assert(compile->references > 0);
+    if (--compile->references == 0)
+        delete compile;
+}
+
+static void
+_kuro_gfx_compiler_main(kr_compiler_t compiler)
+{
+    std::unique_lock<std::mutex> lock(compiler->mutex);
+    for (;;)
+    {
+        compiler->work.wait(lock, [compiler] { return compiler->quit || !compiler->queue.empty(); });
+        if (compiler->queue.empty())
+            return;
+
+        kr_compile_t compile = compiler->queue.front();
+        compiler->queue.pop_front();
+        lock.unlock();
+
+        Kuro_Gfx_Shader_Source source = {};
+        source.source = compile->source.c_str();
+        source.source_size = compile->source.size();
+        source.entry_point = compile->entry_point.c_str();
+        source.profile = compile->profile.c_str();
+        source.flags = compile->flags;
+        size_t code_size = 0;
+        void *code = compiler->compile(compiler->user_data, source, &code_size);
+
+        lock.lock();
+        if (code)
+        {
+            compile->code.assign((const uint8_t *)code, (const uint8_t *)code + code_size);
+            kuro_gfx_cache_insert(compiler->cache, compile->key, code, code_size);
+        }
+        free(code);
+        compile->failed = code == nullptr;
+        compile->done = true;
+        compiler->pending.erase(compile->key);
+        _kuro_gfx_compile_release(compile);
+        compiler->done.notify_all();
+    }
+}
+
+uint64_t
+kuro_gfx_shader_hash(Kuro_Gfx_Shader_Source source)
+{
+    // the strings are hashed with their terminator so "ab" + "c" and "a" + "bc" differ
+    uint64_t hash = kuro_gfx_cache_hash(source.source, source.source_size, 0);
+    hash = kuro_gfx_cache_hash(source.entry_point, strlen(source.entry_point) + 1, hash);
+    hash = kuro_gfx_cache_hash(source.profile, strlen(source.profile) + 1, hash);
+    hash = kuro_gfx_cache_hash(&source.flags, sizeof(source.flags), hash);
+    return hash;
+}
+
+kr_compiler_t
+kuro_gfx_compiler_create(Kuro_Gfx_Shader_Compile compile, void *user_data, uint32_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        uint32_t core_count = std::thread::hardware_concurrency();
+        thread_count = core_count > 1 ? core_count - 1 : 1;
+    }
+
+    kr_compiler_t compiler = new _kr_compiler_t;
+    compiler->compile = compile;
+    compiler->user_data = user_data;
+    compiler->cache = kuro_gfx_cache_open(nullptr);
+    compiler->quit = false;
+    for (uint32_t i = 0; i < thread_count; ++i)
+        compiler->threads.emplace_back(_kuro_gfx_compiler_main, compiler);
+    return compiler;
+}
+
+void
+kuro_gfx_compiler_destroy(kr_compiler_t compiler)
+{
+    {
+        std::lock_guard<std::mutex> lock(compiler->mutex);
+        compiler->quit = true;
+    }
+    compiler->work.notify_all();
+    for (std::thread &thread : compiler->threads)
+        thread.join();
+    assert(compiler->pending.empty());
+    kuro_gfx_cache_close(compiler->cache);
+    delete compiler;
+}
+
+void
+kuro_gfx_compiler_cache_open(kr_compiler_t compiler, const char *path)
+{
+    std::lock_guard<std::mutex> lock(compiler->mutex);
+    kuro_gfx_cache_close(compiler->cache);
+    compiler->cache = kuro_gfx_cache_open(path);
+}
+
+bool
+kuro_gfx_compiler_cache_save(kr_compiler_t compiler)
+{
+    std::lock_guard<std::mutex> lock(compiler->mutex);
+    return kuro_gfx_cache_save(compiler->cache);
+}
+
+kr_compile_t
+kuro_gfx_compile_submit(kr_compiler_t compiler, Kuro_Gfx_Shader_Source source)
+{
+    uint64_t key = kuro_gfx_shader_hash(source);
+
+    std::unique_lock<std::mutex> lock(compiler->mutex);
+    auto it = compiler->pending.find(key);
+    if (it != compiler->pending.end())
+    {
+        ++it->second->references;
+        return it->second;
+    }
+
+    kr_compile_t compile = new _kr_compile_t{};
+    compile->compiler = compiler;
+    compile->key = key;
+    compile->references = 1;
+
+    size_t code_size = 0;
+    const void *code = kuro_gfx_cache_find(compiler->cache, key, &code_size);
+    if (code)
+    {
+        compile->code.assign((const uint8_t *)code, (const uint8_t *)code + code_size);
+        compile->done = true;
+        return compile;
+    }
+
+    if (source.source_size)
+        compile->source.assign(source.source, source.source_size);
+    compile->entry_point = source.entry_point;
+    compile->profile = source.profile;
+    compile->flags = source.flags;
+    // the queue holds a reference until the compile is done
+    ++compile->references;
+    compiler->pending[key] = compile;
+    compiler->queue.push_back(compile);
+    lock.unlock();
+    compiler->work.notify_one();
+    return compile;
+}
+
+bool
+kuro_gfx_compile_ready(kr_compile_t compile)
+{
+    std::lock_guard<std::mutex> lock(compile->compiler->mutex);
+    return compile->done;
+}
+
+const void *
+kuro_gfx_compile_wait(kr_compile_t compile, size_t *code_size)
+{
+    kr_compiler_t compiler = compile->compiler;
+    std::unique_lock<std::mutex> lock(compiler->mutex);
+    compiler->done.wait(lock, [compile] { return compile->done; });
+    if (code_size)
+        *code_size = compile->code.size();
+    return compile->failed ? nullptr : compile->code.data();
+}
+
+void
+kuro_gfx_compile_release(kr_compile_t compile)
+{
+    std::lock_guard<std::mutex> lock(compile->compiler->mutex);
+    _kuro_gfx_compile_release(compile);
+}
@@ -0,0 +1,410 @@
+/*
+    backend independent frame graph of gfx_graph.h
+
+    * every use remembers the pass that last wrote its resource before it, culling walks the passes
+      backwards and keeps the writers of whatever a surviving pass uses
+    * the combined read state of a use is found in a second backwards walk, the reads of a resource
+      pile up until a write of it is met, so each read knows every read that follows it
+    * transients are placed largest first at the lowest offset that does not overlap a transient
+      alive at the same time, the same greedy placement most frame graphs use
+    * compiling is linear in passes and uses apart from the placement, which is quadratic in the
+      number of transients and fine for the few dozen a frame has
+*/
+
+#include "kuro/gfx_graph.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <vector>
+
+static const uint32_t GRAPH_NONE = UINT32_MAX;
+
+typedef struct _Graph_Resource {
+    bool transient;
+    uint64_t size_in_bytes;
+    uint64_t alignment;
+    uint32_t initial_usage;
+    uint32_t final_usage;
+    uint64_t offset;
+    // surviving passes that use the resource first and last, GRAPH_NONE if none does
+    uint32_t first;
+    uint32_t last;
+} _Graph_Resource;
+
+typedef struct _Graph_Use {
+    uint32_t resource;
+    uint32_t usage;
+    // the pass whose write this use sees, GRAPH_NONE before the first write
+    uint32_t writer;
+    // usage of a write, the reads of the resource up to the next write for a read
+    uint32_t state;
+} _Graph_Use;
+
+typedef struct _Graph_Pass {
+    Kuro_Gfx_Graph_Pass execute;
+    void *user_data;
+    bool side_effects;
+    bool culled;
+    std::vector<_Graph_Use> uses;
+    uint32_t barrier_first;
+    uint32_t barrier_count;
+} _Graph_Pass;
+
+typedef struct _kr_graph_t {
+    std::vector<_Graph_Resource> resources;
+    // passes are kept across resets so their use vectors keep their capacity
+    std::vector<_Graph_Pass> passes;
+    uint32_t pass_count;
+    std::vector<Kuro_Gfx_Graph_Barrier> barriers;
+    uint32_t final_barrier_first;
+    uint64_t memory_size;
+    bool compiled;
+} _kr_graph_t;
+
+static inline uint64_t
+_kuro_gfx_graph_align(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline void
+_kuro_gfx_graph_cull(kr_graph_t graph)
+{
+    std::vector<uint32_t> writers(graph->resources.size(), GRAPH_NONE);
+    for (uint32_t p = 0; p < graph->pass_count; ++p)
+    {
+        _Graph_Pass &pass = graph->passes[p];
+        for (_Graph_Use &use : pass.uses)
+            use.writer = writers[use.resource];
+        for (_Graph_Use &use : pass.uses)
+            if (use.usage & KURO_GFX_GRAPH_USAGE_WRITE)
+                writers[use.resource] = p;
+    }
+
+    std::vector<bool> needed(graph->pass_count, false);
+    for (uint32_t p = graph->pass_count; p-- > 0;)
+    {
+        _Graph_Pass &pass = graph->passes[p];
+        bool survives = needed[p] || pass.side_effects;
+        for (const _Graph_Use &use : pass.uses)
+            if ((use.usage & KURO_GFX_GRAPH_USAGE_WRITE) && !graph->resources[use.resource].transient)
+                survives = true;
+
+        pass.culled = !survives;
+        if (pass.culled)
+            continue;
+        for (const _Graph_Use &use : pass.uses)
+            if (use.writer != GRAPH_NONE)
+                needed[use.writer] = true;
+    }
+}
+
+static inline void
+_kuro_gfx_graph_states(kr_graph_t graph)
+{
+    std::vector<uint32_t> reads(graph->resources.size(), 0);
+    for (uint32_t p = graph->pass_count; p-- > 0;)
+    {
+        _Graph_Pass &pass = graph->passes[p];
+        if (pass.culled)
+            continue;
+        for (_Graph_Use &use : pass.uses)
+        {
+            if (use.usage & KURO_GFX_GRAPH_USAGE_WRITE)
+            {
+                reads[use.resource] = 0;
+                use.state = use.usage;
+            }
+            else
+            {
+                reads[use.resource] |= use.usage;
+                use.state = reads[use.resource];
+            }
+        }
+    }
+}
+
+static inline void
+_kuro_gfx_graph_place(kr_graph_t graph)
+{
+    for (_Graph_Resource &resource : graph->resources)
+    {
+        resource.first = GRAPH_NONE;
+        resource.last = GRAPH_NONE;
+        resource.offset = 0;
+    }
+    for (uint32_t p = 0; p < graph->pass_count; ++p)
+    {
+        if (graph->passes[p].culled)
+            continue;
+        for (const _Graph_Use &use : graph->passes[p].uses)
+        {
+            _Graph_Resource &resource = graph->resources[use.resource];
+            if (resource.first == GRAPH_NONE)
+                resource.first = p;
+            resource.last = p;
+        }
+    }
+
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < (uint32_t)graph->resources.size(); ++i)
+        if (graph->resources[i].transient && graph->resources[i].first != GRAPH_NONE)
+            order.push_back(i);
+    std::sort(order.begin(), order.end(), [graph](uint32_t a, uint32_t b) {
+        const _Graph_Resource &ra = graph->resources[a];
+        const _Graph_Resource &rb = graph->resources[b];
+        if (ra.size_in_bytes != rb.size_in_bytes)
+            return ra.size_in_bytes > rb.size_in_bytes;
+        return ra.first < rb.first;
+    });
+
+    struct Range {
+        uint64_t begin;
+        uint64_t end;
+    };
+    std::vector<Range> taken;
+    graph->memory_size = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        _Graph_Resource &resource = graph->resources[order[i]];
+
+        taken.clear();
+        for (size_t j = 0; j < i; ++j)
+        {
+            const _Graph_Resource &placed = graph->resources[order[j]];
+            if (placed.first <= resource.last && resource.first <= placed.last)
+                taken.push_back({placed.offset, placed.offset + placed.size_in_bytes});
+        }
+        std::sort(taken.begin(), taken.end(), [](const Range &a, const Range &b) { return a.begin < b.begin; });
+
+        uint64_t offset = 0;
+        for (const Range &range : taken)
+        {
+            if (offset + resource.size_in_bytes <= range.begin)
+                break;
+            offset = std::max(offset, _kuro_gfx_graph_align(range.end, resource.alignment));
+        }
+        resource.offset = offset;
+        graph->memory_size = std::max(graph->memory_size, offset + resource.size_in_bytes);
+    }
+}
+
+static inline bool
+_kuro_gfx_graph_aliasing(kr_graph_t graph, uint32_t index)
+{
+    const _Graph_Resource &resource = graph->resources[index];
+    for (const _Graph_Resource &other : graph->resources)
+    {
+        if (&other == &resource || !other.transient || other.first == GRAPH_NONE || other.last >= resource.first)
+            continue;
+        if (other.offset < resource.offset + resource.size_in_bytes && resource.offset < other.offset + other.size_in_bytes)
+            return true;
+    }
+    return false;
+}
+
+static inline void
+_kuro_gfx_graph_barriers(kr_graph_t graph)
+{
+    std::vector<uint32_t> states(graph->resources.size());
+    for (size_t i = 0; i < graph->resources.size(); ++i)
+        states[i] = graph->resources[i].transient ? 0 : graph->resources[i].initial_usage;
+
+    graph->barriers.clear();
+    for (uint32_t p = 0; p < graph->pass_count; ++p)
+    {
+        _Graph_Pass &pass = graph->passes[p];
+        pass.barrier_first = (uint32_t)graph->barriers.size();
+        pass.barrier_count = 0;
+        if (pass.culled)
+            continue;
+
+        for (const _Graph_Use &use : pass.uses)
+        {
+            uint32_t &state = states[use.resource];
+            bool first_use = graph->resources[use.resource].transient && state == 0;
+            // a read is covered by a combined read state that already includes it
+            bool covered = (use.usage & KURO_GFX_GRAPH_USAGE_WRITE) == 0 && (state & KURO_GFX_GRAPH_USAGE_WRITE) == 0 && (state & use.usage) == use.usage;
+            if (!first_use && (state == use.state || covered))
+                continue;
+
+            Kuro_Gfx_Graph_Barrier barrier = {};
+            barrier.resource = use.resource;
+            barrier.before = state;
+            barrier.after = use.state;
+            barrier.aliasing = first_use && _kuro_gfx_graph_aliasing(graph, use.resource);
+            graph->barriers.push_back(barrier);
+            state = use.state;
+        }
+        pass.barrier_count = (uint32_t)graph->barriers.size() - pass.barrier_first;
+    }
+
+    graph->final_barrier_first = (uint32_t)graph->barriers.size();
+    for (uint32_t i = 0; i < (uint32_t)graph->resources.size(); ++i)
+    {
+        const _Graph_Resource &resource = graph->resources[i];
+        if (resource.transient || resource.final_usage == 0 || states[i] == resource.final_usage)
+            continue;
+        graph->barriers.push_back({i, states[i], resource.final_usage, false});
+    }
+}
+
+kr_graph_t
+kuro_gfx_graph_create(void)
+{
+    kr_graph_t graph = new _kr_graph_t{};
+    return graph;
+}
+
+void
+kuro_gfx_graph_destroy(kr_graph_t graph)
+{
+    delete graph;
+}
+
+void
+kuro_gfx_graph_reset(kr_graph_t graph)
+{
+    graph->resources.clear();
+    graph->pass_count = 0;
+    graph->barriers.clear();
+    graph->final_barrier_first = 0;
+    graph->memory_size = 0;
+    graph->compiled = false;
+}
+
+uint32_t
+kuro_gfx_graph_transient(kr_graph_t graph, uint64_t size_in_bytes, uint64_t alignment)
+{
+    assert(alignment > 0);
+    _Graph_Resource resource = {};
+    resource.transient = true;
+    resource.size_in_bytes = size_in_bytes;
+    resource.alignment = alignment;
+    graph->resources.push_back(resource);
+    graph->compiled = false;
+    return (uint32_t)graph->resources.size() - 1;
+}
+
+uint32_t
+kuro_gfx_graph_import(kr_graph_t graph, uint32_t initial_usage, uint32_t final_usage)
+{
+    _Graph_Resource resource = {};
+    resource.initial_usage = initial_usage;
+    resource.final_usage = final_usage;
+    graph->resources.push_back(resource);
+    graph->compiled = false;
+    return (uint32_t)graph->resources.size() - 1;
+}
+
+uint32_t
+kuro_gfx_graph_pass(kr_graph_t graph, Kuro_Gfx_Graph_Pass execute, void *user_data, bool side_effects)
+{
+    if (graph->pass_count == graph->passes.size())
+        graph->passes.emplace_back();
+
+    _Graph_Pass &pass = graph->passes[graph->pass_count];
+    pass.execute = execute;
+    pass.user_data = user_data;
+    pass.side_effects = side_effects;
+    pass.culled = false;
+    pass.uses.clear();
+    pass.barrier_first = 0;
+    pass.barrier_count = 0;
+    graph->compiled = false;
+    return graph->pass_count++;
+}
+
+void
+kuro_gfx_graph_use(kr_graph_t graph, uint32_t pass, uint32_t resource, uint32_t usage)
+{
+    assert(pass < graph->pass_count && resource < graph->resources.size() && usage != 0);
+    graph->compiled = false;
+
+    std::vector<_Graph_Use> &uses = graph->passes[pass].uses;
+    for (_Graph_Use &use : uses)
+    {
+        if (use.resource == resource)
+        {
+            use.usage |= usage;
+            return;
+        }
+    }
+    uses.push_back({resource, usage, GRAPH_NONE, 0});
+}
+
+void
+kuro_gfx_graph_compile(kr_graph_t graph)
+{
+    _kuro_gfx_graph_cull(graph);
+    _kuro_gfx_graph_states(graph);
+    _kuro_gfx_graph_place(graph);
+    _kuro_gfx_graph_barriers(graph);
+    graph->compiled = true;
+}
+
+bool
+kuro_gfx_graph_culled(kr_graph_t graph, uint32_t pass)
+{
+    assert(graph->compiled && pass < graph->pass_count);
+    return graph->passes[pass].culled;
+}
+
+const Kuro_Gfx_Graph_Barrier *
+kuro_gfx_graph_barriers(kr_graph_t graph, uint32_t pass, uint32_t *barrier_count)
+{
+    assert(graph->compiled && pass < graph->pass_count);
+    *barrier_count = graph->passes[pass].barrier_count;
+    return graph->barriers.data() + graph->passes[pass].barrier_first;
+}
+
+const Kuro_Gfx_Graph_Barrier *
+kuro_gfx_graph_final_barriers(kr_graph_t graph, uint32_t *barrier_count)
+{
+    assert(graph->compiled);
+    *barrier_count = (uint32_t)graph->barriers.size() - graph->final_barrier_first;
+    return graph->barriers.data() + graph->final_barrier_first;
+}
+
+uint32_t
+kuro_gfx_graph_barrier_count(kr_graph_t graph)
+{
+    assert(graph->compiled);
+    return (uint32_t)graph->barriers.size();
+}
+
+uint64_t
+kuro_gfx_graph_memory_size(kr_graph_t graph)
+{
+    assert(graph->compiled);
+    return graph->memory_size;
+}
+
+uint64_t
+kuro_gfx_graph_offset(kr_graph_t graph, uint32_t resource)
+{
+    assert(graph->compiled && resource < graph->resources.size() && graph->resources[resource].transient);
+    return graph->resources[resource].offset;
+}
+
+void
+kuro_gfx_graph_execute(kr_graph_t graph, Kuro_Gfx_Graph_Barriers barriers, void *context)
+{
+    assert(graph->compiled && "kuro_gfx_graph_compile has to run after the last change");
+
+    for (uint32_t p = 0; p < graph->pass_count; ++p)
+    {
+        const _Graph_Pass &pass = graph->passes[p];
+        if (pass.culled)
+            continue;
+        if (pass.barrier_count)
+            barriers(context, graph->barriers.data() + pass.barrier_first, pass.barrier_count);
+        if (pass.execute)
+            pass.execute(pass.user_data, context);
+    }
+
+    uint32_t final_count = (uint32_t)graph->barriers.size() - graph->final_barrier_first;
+    if (final_count)
+        barriers(context, graph->barriers.data() + graph->final_barrier_first, final_count);
+}
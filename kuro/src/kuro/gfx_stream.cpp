@@ -0,0 +1,675 @@
+/*
+    backend independent command streams of gfx.h
+
+    * a stream is a flat array of commands, each one starts with a _Stream_Command header whose size
+      covers the payload and keeps the next command 8 byte aligned, replay is a single forward walk
+    * handles are replaced by 1 based indices into a table filled in order of first use, 0 is null,
+      so a saved stream is position independent and only the table has to be patched after a load
+    * the saved blob is a _Stream_File header, the handle kinds and the command bytes as recorded,
+      it uses the byte order of the machine that saved it
+*/
+
+#include "kuro/gfx.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unordered_map>
+#include <vector>
+
+enum _STREAM_COMMAND : uint32_t
+{
+    _STREAM_COMMAND_SET_PIPELINE = 1,
+    _STREAM_COMMAND_VIEWPORT,
+    _STREAM_COMMAND_CLEAR,
+    _STREAM_COMMAND_BUFFER_WRITE,
+    _STREAM_COMMAND_BUFFER_BIND,
+    _STREAM_COMMAND_DRAW
+};
+
+static const uint32_t STREAM_FILE_MAGIC = 0x5343524B; // "KRCS"
+static const uint32_t STREAM_FILE_VERSION = 2;
+static const uint32_t STREAM_ALIGNMENT = 8;
+
+typedef struct _Stream_Command {
+    uint32_t type;
+    uint32_t size;
+} _Stream_Command;
+
+typedef struct _Stream_Set_Pipeline {
+    _Stream_Command header;
+    uint32_t pipeline;
+    uint32_t padding;
+} _Stream_Set_Pipeline;
+
+typedef struct _Stream_Viewport {
+    _Stream_Command header;
+    uint32_t width;
+    uint32_t height;
+} _Stream_Viewport;
+
+typedef struct _Stream_Clear {
+    _Stream_Command header;
+    Kuro_Gfx_Color color;
+    float depth;
+    uint32_t padding;
+} _Stream_Clear;
+
+// followed by size_in_bytes bytes of data
+typedef struct _Stream_Buffer_Write {
+    _Stream_Command header;
+    uint32_t buffer;
+    uint32_t size_in_bytes;
+} _Stream_Buffer_Write;
+
+typedef struct _Stream_Buffer_Bind {
+    _Stream_Command header;
+    uint32_t buffer;
+    uint32_t slot;
+} _Stream_Buffer_Bind;
+
+// followed by one _Stream_Vertex_Buffer per set bit of vertex_buffer_mask
+typedef struct _Stream_Draw {
+    _Stream_Command header;
+    uint32_t primitive;
+    uint32_t count;
+    uint32_t index_buffer;
+    uint32_t index_format;
+    uint32_t vertex_buffer_mask;
+    uint32_t instance_count;
+    uint32_t first;
+    int32_t base_vertex;
+    uint32_t first_instance;
+    uint32_t padding;
+} _Stream_Draw;
+
+typedef struct _Stream_Vertex_Buffer {
+    uint32_t buffer;
+    uint32_t stride;
+} _Stream_Vertex_Buffer;
+
+typedef struct _Stream_File {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t handle_count;
+    uint32_t command_bytes;
+} _Stream_File;
+
+typedef struct _kr_stream_t {
+    std::vector<uint8_t> data;
+    std::vector<void *> handles;
+    std::vector<KURO_GFX_STREAM_HANDLE> kinds;
+    std::unordered_map<void *, uint32_t> handle_indices;
+    std::vector<uint32_t> writes;
+} _kr_stream_t;
+
+static inline uint32_t
+_kuro_gfx_stream_align(uint32_t size)
+{
+    return (size + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+}
+
+static inline uint32_t
+_kuro_gfx_stream_handle(kr_stream_t stream, void *handle, KURO_GFX_STREAM_HANDLE kind)
+{
+    if (handle == nullptr)
+        return 0;
+
+    auto it = stream->handle_indices.find(handle);
+    if (it != stream->handle_indices.end())
+    {
+        assert(stream->kinds[it->second - 1] == kind);
+        return it->second;
+    }
+
+    stream->handles.push_back(handle);
+    stream->kinds.push_back(kind);
+    uint32_t index = (uint32_t)stream->handles.size();
+    stream->handle_indices[handle] = index;
+    return index;
+}
+
+static inline uint8_t *
+_kuro_gfx_stream_push(kr_stream_t stream, uint32_t type, uint32_t size)
+{
+    uint32_t aligned_size = _kuro_gfx_stream_align(size);
+    size_t offset = stream->data.size();
+    stream->data.resize(offset + aligned_size);
+
+    uint8_t *command = stream->data.data() + offset;
+    memset(command, 0, aligned_size);
+    ((_Stream_Command *)command)->type = type;
+    ((_Stream_Command *)command)->size = aligned_size;
+    return command;
+}
+
+static inline void *
+_kuro_gfx_stream_handle_get(kr_stream_t stream, uint32_t index)
+{
+    return index ? stream->handles[index - 1] : nullptr;
+}
+
+static inline bool
+_kuro_gfx_stream_handle_valid(kr_stream_t stream, uint32_t index, KURO_GFX_STREAM_HANDLE kind, bool nullable)
+{
+    if (index == 0)
+        return nullable;
+    return index <= stream->handles.size() && stream->kinds[index - 1] == kind;
+}
+
+static inline uint32_t
+_kuro_gfx_stream_popcount(uint32_t mask)
+{
+    uint32_t count = 0;
+    for (; mask; mask &= mask - 1)
+        ++count;
+    return count;
+}
+
+// checks that the commands are well formed and that their handle indices are in the table,
+// without this a loaded blob could make replay read out of bounds
+static bool
+_kuro_gfx_stream_check_encoding(kr_stream_t stream)
+{
+    const uint8_t *data = stream->data.data();
+    size_t size = stream->data.size();
+    size_t offset = 0;
+
+    while (offset < size)
+    {
+        if (size - offset < sizeof(_Stream_Command))
+            return false;
+
+        const _Stream_Command *command = (const _Stream_Command *)(data + offset);
+        if (command->size < sizeof(_Stream_Command) || command->size % STREAM_ALIGNMENT || command->size > size - offset)
+            return false;
+
+        uint32_t expected = 0;
+        switch (command->type)
+        {
+            case _STREAM_COMMAND_SET_PIPELINE:
+            {
+                const _Stream_Set_Pipeline *set_pipeline = (const _Stream_Set_Pipeline *)command;
+                expected = sizeof(_Stream_Set_Pipeline);
+                if (command->size == expected && !_kuro_gfx_stream_handle_valid(stream, set_pipeline->pipeline, KURO_GFX_STREAM_HANDLE_PIPELINE, true))
+                    return false;
+                break;
+            }
+            case _STREAM_COMMAND_VIEWPORT:
+                expected = sizeof(_Stream_Viewport);
+                break;
+            case _STREAM_COMMAND_CLEAR:
+                expected = sizeof(_Stream_Clear);
+                break;
+            case _STREAM_COMMAND_BUFFER_WRITE:
+            {
+                const _Stream_Buffer_Write *write = (const _Stream_Buffer_Write *)command;
+                if (command->size < sizeof(_Stream_Buffer_Write) || write->size_in_bytes > command->size - sizeof(_Stream_Buffer_Write))
+                    return false;
+                expected = _kuro_gfx_stream_align(sizeof(_Stream_Buffer_Write) + write->size_in_bytes);
+                if (!_kuro_gfx_stream_handle_valid(stream, write->buffer, KURO_GFX_STREAM_HANDLE_BUFFER, false))
+                    return false;
+                break;
+            }
+            case _STREAM_COMMAND_BUFFER_BIND:
+            {
+                const _Stream_Buffer_Bind *bind = (const _Stream_Buffer_Bind *)command;
+                expected = sizeof(_Stream_Buffer_Bind);
+                if (command->size != expected || bind->slot >= KURO_CONSTANT_MAX_CONSTANT_BUFFERS)
+                    return false;
+                if (!_kuro_gfx_stream_handle_valid(stream, bind->buffer, KURO_GFX_STREAM_HANDLE_BUFFER, false))
+                    return false;
+                break;
+            }
+            case _STREAM_COMMAND_DRAW:
+            {
+                const _Stream_Draw *draw = (const _Stream_Draw *)command;
+                if (command->size < sizeof(_Stream_Draw) || (draw->vertex_buffer_mask >> KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES))
+                    return false;
+                expected = sizeof(_Stream_Draw) + _kuro_gfx_stream_popcount(draw->vertex_buffer_mask) * sizeof(_Stream_Vertex_Buffer);
+                if (command->size != expected)
+                    return false;
+                if (!_kuro_gfx_stream_handle_valid(stream, draw->index_buffer, KURO_GFX_STREAM_HANDLE_BUFFER, true))
+                    return false;
+                if (draw->primitive != KURO_GFX_PRIMITIVE_TRIANGLE)
+                    return false;
+                if (draw->index_buffer && draw->index_format != KURO_GFX_FORMAT_R16_UINT && draw->index_format != KURO_GFX_FORMAT_R32_UINT)
+                    return false;
+
+                const _Stream_Vertex_Buffer *vertex_buffers = (const _Stream_Vertex_Buffer *)(draw + 1);
+                for (uint32_t i = 0; i < _kuro_gfx_stream_popcount(draw->vertex_buffer_mask); ++i)
+                {
+                    if (!_kuro_gfx_stream_handle_valid(stream, vertex_buffers[i].buffer, KURO_GFX_STREAM_HANDLE_BUFFER, false))
+                        return false;
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+
+        if (command->size != expected)
+            return false;
+        offset += command->size;
+    }
+
+    return true;
+}
+
+static void
+_kuro_gfx_stream_index_writes(kr_stream_t stream)
+{
+    stream->writes.clear();
+    for (size_t offset = 0; offset < stream->data.size();)
+    {
+        const _Stream_Command *command = (const _Stream_Command *)(stream->data.data() + offset);
+        if (command->type == _STREAM_COMMAND_BUFFER_WRITE)
+            stream->writes.push_back((uint32_t)offset);
+        offset += command->size;
+    }
+}
+
+kr_stream_t
+kuro_gfx_stream_create(void)
+{
+    return new _kr_stream_t();
+}
+
+void
+kuro_gfx_stream_destroy(kr_stream_t stream)
+{
+    delete stream;
+}
+
+void
+kuro_gfx_stream_reset(kr_stream_t stream)
+{
+    stream->data.clear();
+    stream->handles.clear();
+    stream->kinds.clear();
+    stream->handle_indices.clear();
+    stream->writes.clear();
+}
+
+void
+kuro_gfx_stream_set_pipeline(kr_stream_t stream, kr_pipeline_t pipeline)
+{
+    uint32_t index = _kuro_gfx_stream_handle(stream, pipeline, KURO_GFX_STREAM_HANDLE_PIPELINE);
+    _Stream_Set_Pipeline *command = (_Stream_Set_Pipeline *)_kuro_gfx_stream_push(stream, _STREAM_COMMAND_SET_PIPELINE, sizeof(_Stream_Set_Pipeline));
+    command->pipeline = index;
+}
+
+void
+kuro_gfx_stream_viewport(kr_stream_t stream, uint32_t width, uint32_t height)
+{
+    _Stream_Viewport *command = (_Stream_Viewport *)_kuro_gfx_stream_push(stream, _STREAM_COMMAND_VIEWPORT, sizeof(_Stream_Viewport));
+    command->width = width;
+    command->height = height;
+}
+
+void
+kuro_gfx_stream_clear(kr_stream_t stream, Kuro_Gfx_Color color, float depth)
+{
+    _Stream_Clear *command = (_Stream_Clear *)_kuro_gfx_stream_push(stream, _STREAM_COMMAND_CLEAR, sizeof(_Stream_Clear));
+    command->color = color;
+    command->depth = depth;
+}
+
+uint32_t
+kuro_gfx_stream_buffer_write(kr_stream_t stream, kr_buffer_t buffer, const void *data, uint32_t size_in_bytes)
+{
+    assert(buffer);
+    uint32_t index = _kuro_gfx_stream_handle(stream, buffer, KURO_GFX_STREAM_HANDLE_BUFFER);
+    uint32_t offset = (uint32_t)stream->data.size();
+    _Stream_Buffer_Write *command = (_Stream_Buffer_Write *)_kuro_gfx_stream_push(stream, _STREAM_COMMAND_BUFFER_WRITE, sizeof(_Stream_Buffer_Write) + size_in_bytes);
+    command->buffer = index;
+    command->size_in_bytes = size_in_bytes;
+    if (data)
+        memcpy(command + 1, data, size_in_bytes);
+
+    stream->writes.push_back(offset);
+    return (uint32_t)stream->writes.size() - 1;
+}
+
+void
+kuro_gfx_stream_buffer_bind(kr_stream_t stream, kr_buffer_t buffer, uint32_t slot)
+{
+    assert(buffer);
+    assert(slot < KURO_CONSTANT_MAX_CONSTANT_BUFFERS);
+    uint32_t index = _kuro_gfx_stream_handle(stream, buffer, KURO_GFX_STREAM_HANDLE_BUFFER);
+    _Stream_Buffer_Bind *command = (_Stream_Buffer_Bind *)_kuro_gfx_stream_push(stream, _STREAM_COMMAND_BUFFER_BIND, sizeof(_Stream_Buffer_Bind));
+    command->buffer = index;
+    command->slot = slot;
+}
+
+void
+kuro_gfx_stream_draw(kr_stream_t stream, Kuro_Gfx_Draw_Desc desc)
+{
+    uint32_t vertex_buffer_mask = 0;
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+    {
+        if (desc.vertex_buffers[i].buffer)
+            vertex_buffer_mask |= 1u << i;
+    }
+
+    // resolve the handles first, the push below may move the data
+    uint32_t index_buffer = _kuro_gfx_stream_handle(stream, desc.index_buffer.buffer, KURO_GFX_STREAM_HANDLE_BUFFER);
+    _Stream_Vertex_Buffer vertex_buffers[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES];
+    uint32_t vertex_buffer_count = 0;
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+    {
+        if (vertex_buffer_mask & (1u << i))
+        {
+            vertex_buffers[vertex_buffer_count].buffer = _kuro_gfx_stream_handle(stream, desc.vertex_buffers[i].buffer, KURO_GFX_STREAM_HANDLE_BUFFER);
+            vertex_buffers[vertex_buffer_count].stride = desc.vertex_buffers[i].stride;
+            ++vertex_buffer_count;
+        }
+    }
+
+    _Stream_Draw *command = (_Stream_Draw *)_kuro_gfx_stream_push(stream, _STREAM_COMMAND_DRAW, sizeof(_Stream_Draw) + vertex_buffer_count * sizeof(_Stream_Vertex_Buffer));
+    command->primitive = desc.primitive;
+    command->count = desc.count;
+    command->index_buffer = index_buffer;
+    command->index_format = desc.index_buffer.format;
+    command->vertex_buffer_mask = vertex_buffer_mask;
+    command->instance_count = desc.instance_count;
+    command->first = desc.first;
+    command->base_vertex = desc.base_vertex;
+    command->first_instance = desc.first_instance;
+    memcpy(command + 1, vertex_buffers, vertex_buffer_count * sizeof(_Stream_Vertex_Buffer));
+}
+
+void *
+kuro_gfx_stream_write_data(kr_stream_t stream, uint32_t write)
+{
+    assert(write < stream->writes.size());
+    return stream->data.data() + stream->writes[write] + sizeof(_Stream_Buffer_Write);
+}
+
+bool
+kuro_gfx_stream_validate(kr_stream_t stream)
+{
+    if (!_kuro_gfx_stream_check_encoding(stream))
+        return false;
+
+    for (void *handle : stream->handles)
+    {
+        if (handle == nullptr)
+            return false;
+    }
+
+    bool pipeline_set = false;
+    bool viewport_set = false;
+    for (size_t offset = 0; offset < stream->data.size();)
+    {
+        const _Stream_Command *command = (const _Stream_Command *)(stream->data.data() + offset);
+        switch (command->type)
+        {
+            case _STREAM_COMMAND_SET_PIPELINE:
+                pipeline_set = ((const _Stream_Set_Pipeline *)command)->pipeline != 0;
+                break;
+            case _STREAM_COMMAND_VIEWPORT:
+                viewport_set = true;
+                break;
+            case _STREAM_COMMAND_DRAW:
+                // primitive and index format are part of the encoding check
+                if (!pipeline_set || !viewport_set)
+                    return false;
+                break;
+            default:
+                break;
+        }
+        offset += command->size;
+    }
+
+    return true;
+}
+
+uint32_t
+kuro_gfx_stream_optimize(kr_stream_t stream)
+{
+    // a pipeline change may change the root signature, which drops the buffer bindings
+    uint32_t pipeline = 0;
+    bool viewport_set = false;
+    uint32_t viewport_width = 0, viewport_height = 0;
+    std::vector<uint32_t> bound;
+
+    uint32_t removed = 0;
+    size_t write = 0;
+    for (size_t offset = 0; offset < stream->data.size();)
+    {
+        const _Stream_Command *command = (const _Stream_Command *)(stream->data.data() + offset);
+        uint32_t size = command->size;
+
+        bool redundant = false;
+        switch (command->type)
+        {
+            case _STREAM_COMMAND_SET_PIPELINE:
+            {
+                const _Stream_Set_Pipeline *set_pipeline = (const _Stream_Set_Pipeline *)command;
+                redundant = set_pipeline->pipeline != 0 && set_pipeline->pipeline == pipeline;
+                if (!redundant)
+                {
+                    pipeline = set_pipeline->pipeline;
+                    bound.clear();
+                }
+                break;
+            }
+            case _STREAM_COMMAND_VIEWPORT:
+            {
+                const _Stream_Viewport *viewport = (const _Stream_Viewport *)command;
+                redundant = viewport_set && viewport->width == viewport_width && viewport->height == viewport_height;
+                viewport_set = true;
+                viewport_width = viewport->width;
+                viewport_height = viewport->height;
+                break;
+            }
+            case _STREAM_COMMAND_BUFFER_BIND:
+            {
+                const _Stream_Buffer_Bind *bind = (const _Stream_Buffer_Bind *)command;
+                if (bind->slot >= bound.size())
+                    bound.resize(bind->slot + 1, 0);
+                redundant = bound[bind->slot] == bind->buffer;
+                bound[bind->slot] = bind->buffer;
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (redundant)
+            ++removed;
+        else
+        {
+            if (write != offset)
+                memmove(stream->data.data() + write, command, size);
+            write += size;
+        }
+        offset += size;
+    }
+
+    stream->data.resize(write);
+    _kuro_gfx_stream_index_writes(stream);
+    return removed;
+}
+
+void
+kuro_gfx_stream_replay(kr_stream_t stream, kr_commands_t commands)
+{
+#ifdef DEBUG
+    assert(kuro_gfx_stream_validate(stream));
+#endif
+
+    const uint8_t *data = stream->data.data();
+    for (size_t offset = 0; offset < stream->data.size();)
+    {
+        const _Stream_Command *command = (const _Stream_Command *)(data + offset);
+        switch (command->type)
+        {
+            case _STREAM_COMMAND_SET_PIPELINE:
+            {
+                const _Stream_Set_Pipeline *set_pipeline = (const _Stream_Set_Pipeline *)command;
+                kuro_gfx_set_pipeline(commands, (kr_pipeline_t)_kuro_gfx_stream_handle_get(stream, set_pipeline->pipeline));
+                break;
+            }
+            case _STREAM_COMMAND_VIEWPORT:
+            {
+                const _Stream_Viewport *viewport = (const _Stream_Viewport *)command;
+                kuro_gfx_viewport(commands, viewport->width, viewport->height);
+                break;
+            }
+            case _STREAM_COMMAND_CLEAR:
+            {
+                const _Stream_Clear *clear = (const _Stream_Clear *)command;
+                kuro_gfx_clear(commands, clear->color, clear->depth);
+                break;
+            }
+            case _STREAM_COMMAND_BUFFER_WRITE:
+            {
+                const _Stream_Buffer_Write *write = (const _Stream_Buffer_Write *)command;
+                kuro_gfx_buffer_write(commands, (kr_buffer_t)_kuro_gfx_stream_handle_get(stream, write->buffer), (void *)(write + 1), write->size_in_bytes);
+                break;
+            }
+            case _STREAM_COMMAND_BUFFER_BIND:
+            {
+                const _Stream_Buffer_Bind *bind = (const _Stream_Buffer_Bind *)command;
+                kuro_gfx_buffer_bind(commands, (kr_buffer_t)_kuro_gfx_stream_handle_get(stream, bind->buffer), bind->slot);
+                break;
+            }
+            case _STREAM_COMMAND_DRAW:
+            {
+                const _Stream_Draw *draw = (const _Stream_Draw *)command;
+                const _Stream_Vertex_Buffer *vertex_buffers = (const _Stream_Vertex_Buffer *)(draw + 1);
+
+                Kuro_Gfx_Draw_Desc desc = {};
+                desc.primitive = (KURO_GFX_PRIMITIVE)draw->primitive;
+                desc.count = draw->count;
+                desc.instance_count = draw->instance_count;
+                desc.first = draw->first;
+                desc.base_vertex = draw->base_vertex;
+                desc.first_instance = draw->first_instance;
+                desc.index_buffer.buffer = (kr_buffer_t)_kuro_gfx_stream_handle_get(stream, draw->index_buffer);
+                desc.index_buffer.format = (KURO_GFX_FORMAT)draw->index_format;
+                for (uint32_t i = 0, j = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+                {
+                    if (draw->vertex_buffer_mask & (1u << i))
+                    {
+                        desc.vertex_buffers[i].buffer = (kr_buffer_t)_kuro_gfx_stream_handle_get(stream, vertex_buffers[j].buffer);
+                        desc.vertex_buffers[i].stride = vertex_buffers[j].stride;
+                        ++j;
+                    }
+                }
+                kuro_gfx_draw(commands, desc);
+                break;
+            }
+            default:
+                assert(false && "corrupted gfx stream");
+                return;
+        }
+        offset += command->size;
+    }
+}
+
+uint32_t
+kuro_gfx_stream_save(kr_stream_t stream, void *data, uint32_t capacity)
+{
+    uint32_t handle_count = (uint32_t)stream->handles.size();
+    uint32_t size = sizeof(_Stream_File) + handle_count * sizeof(uint32_t) + (uint32_t)stream->data.size();
+    if (data == nullptr || capacity < size)
+        return size;
+
+    _Stream_File file = {};
+    file.magic = STREAM_FILE_MAGIC;
+    file.version = STREAM_FILE_VERSION;
+    file.handle_count = handle_count;
+    file.command_bytes = (uint32_t)stream->data.size();
+
+    uint8_t *bytes = (uint8_t *)data;
+    memcpy(bytes, &file, sizeof(file));
+    bytes += sizeof(file);
+    for (KURO_GFX_STREAM_HANDLE kind : stream->kinds)
+    {
+        uint32_t value = kind;
+        memcpy(bytes, &value, sizeof(value));
+        bytes += sizeof(value);
+    }
+    if (!stream->data.empty())
+        memcpy(bytes, stream->data.data(), stream->data.size());
+    return size;
+}
+
+kr_stream_t
+kuro_gfx_stream_load(const void *data, uint32_t size_in_bytes)
+{
+    _Stream_File file = {};
+    if (data == nullptr || size_in_bytes < sizeof(file))
+        return nullptr;
+    memcpy(&file, data, sizeof(file));
+
+    if (file.magic != STREAM_FILE_MAGIC || file.version != STREAM_FILE_VERSION)
+        return nullptr;
+    if ((uint64_t)sizeof(file) + (uint64_t)file.handle_count * sizeof(uint32_t) + file.command_bytes != size_in_bytes)
+        return nullptr;
+
+    kr_stream_t stream = kuro_gfx_stream_create();
+    const uint8_t *bytes = (const uint8_t *)data + sizeof(file);
+    for (uint32_t i = 0; i < file.handle_count; ++i)
+    {
+        uint32_t kind = 0;
+        memcpy(&kind, bytes, sizeof(kind));
+        bytes += sizeof(kind);
+        if (kind != KURO_GFX_STREAM_HANDLE_PIPELINE && kind != KURO_GFX_STREAM_HANDLE_BUFFER)
+        {
+            kuro_gfx_stream_destroy(stream);
+            return nullptr;
+        }
+        stream->handles.push_back(nullptr);
+        stream->kinds.push_back((KURO_GFX_STREAM_HANDLE)kind);
+    }
+    stream->data.assign(bytes, bytes + file.command_bytes);
+
+    if (!_kuro_gfx_stream_check_encoding(stream))
+    {
+        kuro_gfx_stream_destroy(stream);
+        return nullptr;
+    }
+
+    _kuro_gfx_stream_index_writes(stream);
+    return stream;
+}
+
+uint32_t
+kuro_gfx_stream_handle_count(kr_stream_t stream)
+{
+    return (uint32_t)stream->handles.size();
+}
+
+KURO_GFX_STREAM_HANDLE
+kuro_gfx_stream_handle_kind(kr_stream_t stream, uint32_t index)
+{
+    assert(index < stream->kinds.size());
+    return stream->kinds[index];
+}
+
+void
+kuro_gfx_stream_pipeline_set(kr_stream_t stream, uint32_t index, kr_pipeline_t pipeline)
+{
+    assert(index < stream->handles.size() && stream->kinds[index] == KURO_GFX_STREAM_HANDLE_PIPELINE);
+    if (stream->handles[index])
+        stream->handle_indices.erase(stream->handles[index]);
+    stream->handles[index] = pipeline;
+    if (pipeline)
+        stream->handle_indices[pipeline] = index + 1;
+}
+
+void
+kuro_gfx_stream_buffer_set(kr_stream_t stream, uint32_t index, kr_buffer_t buffer)
+{
+    assert(index < stream->handles.size() && stream->kinds[index] == KURO_GFX_STREAM_HANDLE_BUFFER);
+    if (stream->handles[index])
+        stream->handle_indices.erase(stream->handles[index]);
+    stream->handles[index] = buffer;
+    if (buffer)
+        stream->handle_indices[buffer] = index + 1;
+}
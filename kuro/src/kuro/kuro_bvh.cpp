@@ -0,0 +1,535 @@
+/*
+    bounding volume hierarchy of kuro_bvh.h
+
+    * a build task owns a node and a range of bvh.primitives, it partitions the range in place and
+      hands the child ranges out as new tasks, so tasks never touch the same memory and the threads
+      only serialize on the task queue. node indices come from an atomic counter, a child always
+      gets a larger index than its parent which is what refit relies on
+    * ranges below BVH_TASK_SIZE primitives are finished by the thread that split them
+    * deep in the tree, or when the centroids of a range are all equal, splits fall back to the
+      object median so the depth (and the traversal stacks) stay bounded
+*/
+
+#include "kuro/kuro_bvh.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace kuro
+{
+    static constexpr u32 BVH_BINS = 16;
+    static constexpr u32 BVH_TASK_SIZE = 1024;
+    static constexpr u32 BVH_SAH_DEPTH = 48;
+    // 3 children pushed per level, the median splits below BVH_SAH_DEPTH at least halve a range
+    static constexpr u32 BVH_STACK_SIZE = 256;
+
+    struct _Bvh_Range
+    {
+        u32 begin, end;
+        aabb3 bounds;
+    };
+
+    struct _Bvh_Task
+    {
+        u32 node;
+        u32 depth;
+        _Bvh_Range range;
+    };
+
+    struct _Bvh_Build
+    {
+        bvh *tree;
+        std::vector<vec3> centroids;
+        std::atomic<u32> node_count;
+        bool threaded;
+
+        std::mutex mutex;
+        std::condition_variable work;
+        std::deque<_Bvh_Task> queue;
+        // queued and running tasks
+        u32 pending;
+    };
+
+    static f32
+    _bvh_area(const aabb3 &box)
+    {
+        if (aabb3_is_empty(box))
+            return 0.0f;
+        vec3 e = box.max - box.min;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    static aabb3
+    _bvh_bounds(const bvh &tree, u32 begin, u32 end)
+    {
+        aabb3 bounds = aabb3_empty();
+        for (u32 i = begin; i < end; ++i)
+            bounds = aabb3_merge(bounds, tree.boxes[tree.primitives[i]]);
+        return bounds;
+    }
+
+    static u32
+    _bvh_bin(f32 c, f32 lo, f32 scale)
+    {
+        u32 bin = (u32)((c - lo) * scale);
+        return bin < BVH_BINS - 1 ? bin : BVH_BINS - 1;
+    }
+
+    // splits range in two non empty halves and returns them in left and right
+    static void
+    _bvh_split(_Bvh_Build &build, const _Bvh_Range &range, u32 depth, _Bvh_Range &left, _Bvh_Range &right)
+    {
+        bvh &tree = *build.tree;
+        u32 *primitives = tree.primitives.data();
+        const vec3 *centroids = build.centroids.data();
+
+        aabb3 centroid_bounds = aabb3_empty();
+        for (u32 i = range.begin; i < range.end; ++i)
+            centroid_bounds = aabb3_merge(centroid_bounds, centroids[primitives[i]]);
+
+        const f32 *lo = &centroid_bounds.min.x;
+        const f32 *hi = &centroid_bounds.max.x;
+
+        f32 best_cost = F32_MAX;
+        int best_axis = -1;
+        u32 best_bin = 0;
+        if (depth < BVH_SAH_DEPTH)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (hi[axis] <= lo[axis])
+                    continue;
+
+                f32 scale = BVH_BINS / (hi[axis] - lo[axis]);
+                u32 counts[BVH_BINS] = {};
+                aabb3 bins[BVH_BINS];
+                for (aabb3 &bin : bins)
+                    bin = aabb3_empty();
+                for (u32 i = range.begin; i < range.end; ++i)
+                {
+                    u32 p = primitives[i];
+                    u32 bin = _bvh_bin((&centroids[p].x)[axis], lo[axis], scale);
+                    ++counts[bin];
+                    bins[bin] = aabb3_merge(bins[bin], tree.boxes[p]);
+                }
+
+                // cost of splitting after bin i, right sides swept first
+                f32 right_areas[BVH_BINS];
+                u32 right_counts[BVH_BINS];
+                aabb3 acc = aabb3_empty();
+                u32 count = 0;
+                for (u32 i = BVH_BINS - 1; i > 0; --i)
+                {
+                    acc = aabb3_merge(acc, bins[i]);
+                    count += counts[i];
+                    right_areas[i] = _bvh_area(acc);
+                    right_counts[i] = count;
+                }
+
+                acc = aabb3_empty();
+                count = 0;
+                for (u32 i = 0; i < BVH_BINS - 1; ++i)
+                {
+                    acc = aabb3_merge(acc, bins[i]);
+                    count += counts[i];
+                    if (count == 0 || right_counts[i + 1] == 0)
+                        continue;
+
+                    f32 cost = _bvh_area(acc) * count + right_areas[i + 1] * right_counts[i + 1];
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin = i;
+                    }
+                }
+            }
+        }
+
+        u32 middle;
+        if (best_axis >= 0)
+        {
+            f32 axis_lo = lo[best_axis];
+            f32 scale = BVH_BINS / (hi[best_axis] - lo[best_axis]);
+            middle = (u32)(std::partition(primitives + range.begin, primitives + range.end, [&](u32 p) {
+                return _bvh_bin((&centroids[p].x)[best_axis], axis_lo, scale) <= best_bin;
+            }) - primitives);
+        }
+        else
+        {
+            int axis = 0;
+            for (int i = 1; i < 3; ++i)
+                if (hi[i] - lo[i] > hi[axis] - lo[axis])
+                    axis = i;
+
+            middle = range.begin + (range.end - range.begin) / 2;
+            std::nth_element(primitives + range.begin, primitives + middle, primitives + range.end, [&](u32 a, u32 b) {
+                return (&centroids[a].x)[axis] < (&centroids[b].x)[axis];
+            });
+        }
+        assert(middle > range.begin && middle < range.end);
+
+        left = _Bvh_Range{range.begin, middle, _bvh_bounds(tree, range.begin, middle)};
+        right = _Bvh_Range{middle, range.end, _bvh_bounds(tree, middle, range.end)};
+    }
+
+    static void
+    _bvh_push(_Bvh_Build &build, const _Bvh_Task &task)
+    {
+        std::lock_guard<std::mutex> lock(build.mutex);
+        build.queue.push_back(task);
+        ++build.pending;
+        build.work.notify_one();
+    }
+
+    static void
+    _bvh_build_task(_Bvh_Build &build, const _Bvh_Task &first)
+    {
+        std::vector<_Bvh_Task> stack;
+        stack.push_back(first);
+        while (!stack.empty())
+        {
+            _Bvh_Task task = stack.back();
+            stack.pop_back();
+
+            // split the largest child that is too big for a leaf until there are 4
+            _Bvh_Range children[4];
+            u32 child_count = task.range.end > task.range.begin ? 1 : 0;
+            children[0] = task.range;
+            while (child_count < 4)
+            {
+                int largest = -1;
+                for (u32 i = 0; i < child_count; ++i)
+                {
+                    if (children[i].end - children[i].begin <= BVH_MAX_LEAF_SIZE)
+                        continue;
+                    if (largest < 0 || _bvh_area(children[i].bounds) > _bvh_area(children[largest].bounds))
+                        largest = (int)i;
+                }
+                if (largest < 0)
+                    break;
+
+                _Bvh_Range range = children[largest];
+                _bvh_split(build, range, task.depth, children[largest], children[child_count]);
+                ++child_count;
+            }
+
+            bvh_node &node = build.tree->nodes[task.node];
+            for (u32 i = 0; i < 4; ++i)
+            {
+                if (i >= child_count)
+                {
+                    aabb3_x4_set(node.bounds, i, aabb3_empty());
+                    node.child[i] = U32_MAX;
+                    node.count[i] = 0;
+                    continue;
+                }
+
+                const _Bvh_Range &range = children[i];
+                aabb3_x4_set(node.bounds, i, range.bounds);
+                u32 count = range.end - range.begin;
+                if (count <= BVH_MAX_LEAF_SIZE)
+                {
+                    node.child[i] = range.begin;
+                    node.count[i] = count;
+                    continue;
+                }
+
+                node.child[i] = build.node_count.fetch_add(1);
+                assert(node.child[i] < build.tree->nodes.size());
+                node.count[i] = 0;
+                _Bvh_Task child = {node.child[i], task.depth + 1, range};
+                if (build.threaded && count >= BVH_TASK_SIZE)
+                    _bvh_push(build, child);
+                else
+                    stack.push_back(child);
+            }
+        }
+    }
+
+    static void
+    _bvh_worker(_Bvh_Build &build)
+    {
+        for (;;)
+        {
+            _Bvh_Task task;
+            {
+                std::unique_lock<std::mutex> lock(build.mutex);
+                build.work.wait(lock, [&build] { return !build.queue.empty() || build.pending == 0; });
+                if (build.queue.empty())
+                    return;
+                task = build.queue.front();
+                build.queue.pop_front();
+            }
+
+            _bvh_build_task(build, task);
+
+            std::lock_guard<std::mutex> lock(build.mutex);
+            if (--build.pending == 0)
+                build.work.notify_all();
+        }
+    }
+
+    void
+    bvh_build(bvh &tree, const aabb3 *boxes, u32 count, u32 thread_count)
+    {
+        tree.boxes.assign(boxes, boxes + count);
+        tree.primitives.resize(count);
+        for (u32 i = 0; i < count; ++i)
+            tree.primitives[i] = i;
+        // a node has 4 children or only leaves, then with more than BVH_MAX_LEAF_SIZE primitives, so
+        // there are at most about 0.6 nodes per primitive
+        tree.nodes.resize(count - count / 3 + 1);
+
+        _Bvh_Build build;
+        build.tree = &tree;
+        build.centroids.resize(count);
+        for (u32 i = 0; i < count; ++i)
+            build.centroids[i] = aabb3_center(boxes[i]);
+        build.node_count = 1;
+
+        if (thread_count == 0)
+            thread_count = std::thread::hardware_concurrency();
+        build.threaded = thread_count > 1 && count >= BVH_TASK_SIZE;
+        build.pending = 0;
+
+        _Bvh_Task root = {0, 0, _Bvh_Range{0, count, _bvh_bounds(tree, 0, count)}};
+        if (build.threaded)
+        {
+            _bvh_push(build, root);
+            std::vector<std::thread> threads;
+            for (u32 i = 1; i < thread_count; ++i)
+                threads.emplace_back(_bvh_worker, std::ref(build));
+            _bvh_worker(build);
+            for (std::thread &thread : threads)
+                thread.join();
+        }
+        else
+        {
+            _bvh_build_task(build, root);
+        }
+
+        tree.nodes.resize(build.node_count);
+        tree.bounds = root.range.bounds;
+    }
+
+    void
+    bvh_build(bvh &tree, const vec3 *vertices, const u32 *indices, u32 triangle_count, u32 thread_count)
+    {
+        std::vector<aabb3> boxes(triangle_count);
+        for (u32 i = 0; i < triangle_count; ++i)
+        {
+            const vec3 &v0 = vertices[indices[3 * i + 0]];
+            boxes[i] = aabb3_merge(aabb3_merge(aabb3{v0, v0}, vertices[indices[3 * i + 1]]), vertices[indices[3 * i + 2]]);
+        }
+        bvh_build(tree, boxes.data(), triangle_count, thread_count);
+    }
+
+    static aabb3
+    _bvh_node_bounds(const bvh_node &node)
+    {
+        const aabb3_x4 &b = node.bounds;
+        aabb3 bounds = aabb3_empty();
+        for (u32 i = 0; i < 4; ++i)
+        {
+            if (node.child[i] != U32_MAX)
+                bounds = aabb3_merge(bounds, aabb3{{b.min_x[i], b.min_y[i], b.min_z[i]}, {b.max_x[i], b.max_y[i], b.max_z[i]}});
+        }
+        return bounds;
+    }
+
+    void
+    bvh_refit(bvh &tree, const aabb3 *boxes)
+    {
+        tree.boxes.assign(boxes, boxes + tree.boxes.size());
+
+        // children come after their parent, so going backwards they are refit first
+        for (u32 n = (u32)tree.nodes.size(); n-- > 0;)
+        {
+            bvh_node &node = tree.nodes[n];
+            for (u32 i = 0; i < 4; ++i)
+            {
+                if (node.child[i] == U32_MAX)
+                    continue;
+                if (node.count[i])
+                    aabb3_x4_set(node.bounds, i, _bvh_bounds(tree, node.child[i], node.child[i] + node.count[i]));
+                else
+                    aabb3_x4_set(node.bounds, i, _bvh_node_bounds(tree.nodes[node.child[i]]));
+            }
+        }
+        tree.bounds = tree.nodes.empty() ? aabb3_empty() : _bvh_node_bounds(tree.nodes[0]);
+    }
+
+    void
+    bvh_refit(bvh &tree, const vec3 *vertices, const u32 *indices)
+    {
+        std::vector<aabb3> boxes(tree.boxes.size());
+        for (u32 i = 0; i < (u32)boxes.size(); ++i)
+        {
+            const vec3 &v0 = vertices[indices[3 * i + 0]];
+            boxes[i] = aabb3_merge(aabb3_merge(aabb3{v0, v0}, vertices[indices[3 * i + 1]]), vertices[indices[3 * i + 2]]);
+        }
+        bvh_refit(tree, boxes.data());
+    }
+
+    bool
+    bvh_closest_hit(const bvh &tree, const vec3 *vertices, const u32 *indices, const ray3 &ray, f32 t_max, bvh_hit &hit)
+    {
+        struct Entry
+        {
+            u32 node;
+            f32 t;
+        };
+
+        if (tree.nodes.empty())
+            return false;
+
+        bool found = false;
+        Entry stack[BVH_STACK_SIZE];
+        u32 top = 0;
+        stack[top++] = Entry{0, 0.0f};
+        while (top)
+        {
+            Entry entry = stack[--top];
+            if (entry.t > t_max)
+                continue;
+
+            const bvh_node &node = tree.nodes[entry.node];
+            f32 t[4];
+            u32 mask = ray_aabb_intersect_x4(ray, node.bounds, t_max, t);
+
+            // inner children are pushed farthest first so the nearest is visited next
+            Entry inner[4];
+            u32 inner_count = 0;
+            for (u32 i = 0; i < 4; ++i)
+            {
+                if ((mask & (1u << i)) == 0)
+                    continue;
+
+                if (node.count[i] == 0)
+                {
+                    u32 j = inner_count++;
+                    for (; j > 0 && inner[j - 1].t < t[i]; --j)
+                        inner[j] = inner[j - 1];
+                    inner[j] = Entry{node.child[i], t[i]};
+                    continue;
+                }
+
+                for (u32 p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+                {
+                    u32 primitive = tree.primitives[p];
+                    const u32 *triangle = indices + 3 * primitive;
+                    f32 bt, bu, bv;
+                    if (ray_triangle_intersect(ray, vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]], bt, bu, bv) && bt <= t_max)
+                    {
+                        t_max = bt;
+                        hit = bvh_hit{primitive, bt, bu, bv};
+                        found = true;
+                    }
+                }
+            }
+
+            assert(top + inner_count <= BVH_STACK_SIZE);
+            for (u32 i = 0; i < inner_count; ++i)
+                stack[top++] = inner[i];
+        }
+        return found;
+    }
+
+    bool
+    bvh_any_hit(const bvh &tree, const vec3 *vertices, const u32 *indices, const ray3 &ray, f32 t_max)
+    {
+        if (tree.nodes.empty())
+            return false;
+
+        u32 stack[BVH_STACK_SIZE];
+        u32 top = 0;
+        stack[top++] = 0;
+        while (top)
+        {
+            const bvh_node &node = tree.nodes[stack[--top]];
+            f32 t[4];
+            u32 mask = ray_aabb_intersect_x4(ray, node.bounds, t_max, t);
+            for (u32 i = 0; i < 4; ++i)
+            {
+                if ((mask & (1u << i)) == 0)
+                    continue;
+
+                if (node.count[i] == 0)
+                {
+                    assert(top < BVH_STACK_SIZE);
+                    stack[top++] = node.child[i];
+                    continue;
+                }
+
+                for (u32 p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+                {
+                    const u32 *triangle = indices + 3 * tree.primitives[p];
+                    f32 bt;
+                    if (ray_triangle_intersect(ray, vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]], bt) && bt <= t_max)
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    u32
+    bvh_overlap(const bvh &tree, const aabb3 &box, u32 *primitives, u32 capacity)
+    {
+        if (tree.nodes.empty())
+            return 0;
+
+        f32x4 lo_x = f32x4_splat(box.min.x), lo_y = f32x4_splat(box.min.y), lo_z = f32x4_splat(box.min.z);
+        f32x4 hi_x = f32x4_splat(box.max.x), hi_y = f32x4_splat(box.max.y), hi_z = f32x4_splat(box.max.z);
+
+        u32 found = 0;
+        u32 stack[BVH_STACK_SIZE];
+        u32 top = 0;
+        stack[top++] = 0;
+        while (top)
+        {
+            const bvh_node &node = tree.nodes[stack[--top]];
+            const aabb3_x4 &b = node.bounds;
+            mask4 overlap =
+                (f32x4_load(b.min_x) <= hi_x) & (f32x4_load(b.max_x) >= lo_x) &
+                (f32x4_load(b.min_y) <= hi_y) & (f32x4_load(b.max_y) >= lo_y) &
+                (f32x4_load(b.min_z) <= hi_z) & (f32x4_load(b.max_z) >= lo_z);
+            u32 mask = bitmask(overlap);
+            for (u32 i = 0; i < 4; ++i)
+            {
+                if ((mask & (1u << i)) == 0 || node.child[i] == U32_MAX)
+                    continue;
+
+                if (node.count[i] == 0)
+                {
+                    assert(top < BVH_STACK_SIZE);
+                    stack[top++] = node.child[i];
+                    continue;
+                }
+
+                for (u32 p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+                {
+                    u32 primitive = tree.primitives[p];
+                    const aabb3 &other = tree.boxes[primitive];
+                    if (other.min.x <= box.max.x && other.max.x >= box.min.x &&
+                        other.min.y <= box.max.y && other.max.y >= box.min.y &&
+                        other.min.z <= box.max.z && other.max.z >= box.min.z)
+                    {
+                        if (found < capacity)
+                            primitives[found] = primitive;
+                        ++found;
+                    }
+                }
+            }
+        }
+        return found;
+    }
+}
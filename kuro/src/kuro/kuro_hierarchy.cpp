@@ -0,0 +1,215 @@
+/*
+    transform hierarchy of kuro_hierarchy.h
+
+    * a node is recomputed when it is dirty or its parent changed in the same pass, since the parent
+      comes first its changed flag is already final when the child is reached
+    * the threaded pass walks the sorted nodes once, a subtree of at most grain nodes becomes a task
+      and is skipped, a bigger one has its root updated right away and the walk goes down into it.
+      the parent of a task root is always one of those roots, so every task only reads matrices that
+      are done before the threads start, and tasks write disjoint ranges
+*/
+
+#include "kuro/kuro_hierarchy.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <thread>
+
+namespace kuro
+{
+    static constexpr u32 HIERARCHY_THREADED_MIN = 4096;
+
+    struct _Hierarchy_Range
+    {
+        u32 begin, end;
+    };
+
+    u32
+    transform_hierarchy_add(transform_hierarchy &hierarchy, u32 parent, const vec3 &translation, const quat &rotation, const vec3 &scale)
+    {
+        u32 node = (u32)hierarchy.parents.size();
+        assert(parent == TRANSFORM_NONE || parent < node);
+
+        hierarchy.parents.push_back(parent);
+        hierarchy.translations.push_back(translation);
+        hierarchy.rotations.push_back(rotation);
+        hierarchy.scales.push_back(scale);
+        hierarchy.worlds.push_back(mat4_identity());
+        hierarchy.dirty.push_back(1);
+        hierarchy.changed.push_back(0);
+        hierarchy.subtree_sizes.push_back(1);
+
+        if (hierarchy.sorted && parent != TRANSFORM_NONE)
+        {
+            if (parent + hierarchy.subtree_sizes[parent] == node)
+            {
+                for (u32 p = parent; p != TRANSFORM_NONE; p = hierarchy.parents[p])
+                    ++hierarchy.subtree_sizes[p];
+            }
+            else
+            {
+                hierarchy.sorted = false;
+            }
+        }
+        return node;
+    }
+
+    void
+    transform_hierarchy_clear(transform_hierarchy &hierarchy)
+    {
+        hierarchy.parents.clear();
+        hierarchy.translations.clear();
+        hierarchy.rotations.clear();
+        hierarchy.scales.clear();
+        hierarchy.worlds.clear();
+        hierarchy.dirty.clear();
+        hierarchy.changed.clear();
+        hierarchy.subtree_sizes.clear();
+        hierarchy.sorted = true;
+    }
+
+    template <typename T>
+    static void
+    _hierarchy_permute(std::vector<T> &values, const std::vector<u32> &order)
+    {
+        std::vector<T> permuted(values.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            permuted[i] = values[order[i]];
+        values.swap(permuted);
+    }
+
+    void
+    transform_hierarchy_sort(transform_hierarchy &hierarchy, u32 *remap)
+    {
+        u32 count = (u32)hierarchy.parents.size();
+
+        // children of every node in index order, counting sort on the parents
+        std::vector<u32> first_child(count + 1, 0);
+        for (u32 i = 0; i < count; ++i)
+            if (hierarchy.parents[i] != TRANSFORM_NONE)
+                ++first_child[hierarchy.parents[i] + 1];
+        for (u32 i = 0; i < count; ++i)
+            first_child[i + 1] += first_child[i];
+
+        std::vector<u32> children(first_child[count]);
+        std::vector<u32> fill(first_child.begin(), first_child.end() - 1);
+        for (u32 i = 0; i < count; ++i)
+            if (hierarchy.parents[i] != TRANSFORM_NONE)
+                children[fill[hierarchy.parents[i]]++] = i;
+
+        // depth first, children pushed backwards so they come out in order
+        std::vector<u32> order;
+        order.reserve(count);
+        std::vector<u32> stack;
+        for (u32 i = count; i-- > 0;)
+            if (hierarchy.parents[i] == TRANSFORM_NONE)
+                stack.push_back(i);
+        while (!stack.empty())
+        {
+            u32 node = stack.back();
+            stack.pop_back();
+            order.push_back(node);
+            for (u32 c = first_child[node + 1]; c-- > first_child[node];)
+                stack.push_back(children[c]);
+        }
+        assert(order.size() == count);
+
+        std::vector<u32> new_index(count);
+        for (u32 i = 0; i < count; ++i)
+            new_index[order[i]] = i;
+
+        std::vector<u32> parents(count);
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 parent = hierarchy.parents[order[i]];
+            parents[i] = parent == TRANSFORM_NONE ? TRANSFORM_NONE : new_index[parent];
+        }
+        hierarchy.parents.swap(parents);
+        _hierarchy_permute(hierarchy.translations, order);
+        _hierarchy_permute(hierarchy.rotations, order);
+        _hierarchy_permute(hierarchy.scales, order);
+        _hierarchy_permute(hierarchy.worlds, order);
+        _hierarchy_permute(hierarchy.dirty, order);
+        _hierarchy_permute(hierarchy.changed, order);
+
+        // children come after their parent, so going backwards a subtree is complete when it is added
+        hierarchy.subtree_sizes.assign(count, 1);
+        for (u32 i = count; i-- > 0;)
+            if (hierarchy.parents[i] != TRANSFORM_NONE)
+                hierarchy.subtree_sizes[hierarchy.parents[i]] += hierarchy.subtree_sizes[i];
+        hierarchy.sorted = true;
+
+        if (remap)
+        {
+            for (u32 i = 0; i < count; ++i)
+                remap[i] = new_index[i];
+        }
+    }
+
+    static void
+    _hierarchy_update(transform_hierarchy &hierarchy, u32 begin, u32 end)
+    {
+        const u32 *parents = hierarchy.parents.data();
+        u8 *dirty = hierarchy.dirty.data();
+        u8 *changed = hierarchy.changed.data();
+        mat4 *worlds = hierarchy.worlds.data();
+
+        for (u32 i = begin; i < end; ++i)
+        {
+            u32 parent = parents[i];
+            changed[i] = dirty[i] | (parent != TRANSFORM_NONE ? changed[parent] : 0);
+            if (changed[i] == 0)
+                continue;
+
+            dirty[i] = 0;
+            mat4 local = mat4_trs(hierarchy.translations[i], hierarchy.rotations[i], hierarchy.scales[i]);
+            worlds[i] = parent == TRANSFORM_NONE ? local : mat4_affine_mul(local, worlds[parent]);
+        }
+    }
+
+    void
+    transform_hierarchy_update(transform_hierarchy &hierarchy, u32 thread_count)
+    {
+        u32 count = (u32)hierarchy.parents.size();
+        if (thread_count == 0)
+            thread_count = std::thread::hardware_concurrency();
+
+        if (thread_count <= 1 || !hierarchy.sorted || count < HIERARCHY_THREADED_MIN)
+        {
+            _hierarchy_update(hierarchy, 0, count);
+            return;
+        }
+
+        // a few tasks per thread so uneven subtrees still balance
+        u32 grain = count / (thread_count * 4);
+        std::vector<_Hierarchy_Range> tasks;
+        for (u32 i = 0; i < count;)
+        {
+            u32 size = hierarchy.subtree_sizes[i];
+            if (size <= grain)
+            {
+                tasks.push_back(_Hierarchy_Range{i, i + size});
+                i += size;
+            }
+            else
+            {
+                _hierarchy_update(hierarchy, i, i + 1);
+                ++i;
+            }
+        }
+
+        std::atomic<u32> next(0);
+        auto work = [&hierarchy, &tasks, &next] {
+            for (u32 t = next.fetch_add(1); t < (u32)tasks.size(); t = next.fetch_add(1))
+                _hierarchy_update(hierarchy, tasks[t].begin, tasks[t].end);
+        };
+
+        std::vector<std::thread> threads;
+        for (u32 i = 1; i < thread_count; ++i)
+            threads.emplace_back(work);
+        work();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+}
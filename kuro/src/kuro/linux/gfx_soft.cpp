@@ -0,0 +1,2522 @@
+/*
+    CPU software implementation of gfx.h
+
+    * commands are recorded and executed by kuro_gfx_commands_end, kuro_gfx_sync only waits for uploads
+    * uploads are staged in a fence guarded ring and copied by a copy thread that stands in for the
+      D3D12 copy queue, kuro_gfx_commands_end waits for the submitted uploads like the graphics queue
+    * fences complete as soon as they are signaled since nothing else is in flight, other threads
+      wait on them with a futex
+    * every draw is vertex shaded, clipped, set up and binned into 64x64 tiles by all the workers, each
+      worker takes a contiguous range of triangles so its bins stay in submission order
+    * tiles are rasterized in parallel, a tile merges the bins of all the workers by submission order
+      and walks the triangles in 8x8 blocks, fully covered blocks skip the edge tests
+    * edges are evaluated in 28.4 fixed point with the top-left rule, depth, interpolation and pixel
+      shading run on 8 pixel spans with the kuro_math f32x8 kernels
+    * the rasterizer state matches the D3D12 backend: back faces are culled with counter clockwise
+      front faces and z is clipped to [0, 1], depth testing (less) is enabled whenever a depth target
+      is bound
+*/
+
+#include "kuro/gfx.h"
+#include "kuro/gfx_cache.h"
+#include "kuro/gfx_compiler.h"
+#include "kuro/gfx_input.h"
+#include "kuro/gfx_ring.h"
+#include "kuro/gfx_soft.h"
+#include "kuro/kuro_math.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+static const int SWAPCHAIN_BUFFER_COUNT = 2;
+static const int MAX_WORKERS = 64;
+static const int TILE_SIZE = 64;
+static const int BLOCK_SIZE = 8;
+static const int SUBPIXEL_BITS = 4;
+// malloc's alignment, placed images need nothing more than the allocated ones
+static const uint64_t HEAP_ALIGNMENT = 16;
+static const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+static const int MAX_VERTEX_FLOATS = 4 + KURO_GFX_SOFT_CONSTANT_MAX_VARYINGS;
+static const int MAX_CLIP_VERTICES = 9;
+static const float GUARD_BAND = 8.0f;
+static const float MIN_W = 1e-5f;
+// smaller draws are processed on the calling thread, waking the workers costs more than the work
+static const uint32_t INLINE_TRIANGLES = 1024;
+static const uint32_t INLINE_VERTICES = 4096;
+static const uint32_t VERTEX_CHUNK = 256;
+static const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+// uploads larger than a chunk are split, so the arena keeps a few batches in flight
+static const uint64_t STAGING_SIZE = 4 * 1024 * 1024;
+static const uint64_t STAGING_CHUNK = STAGING_SIZE / 4;
+
+typedef void (*_Soft_Job)(void *ctx, uint32_t worker);
+
+typedef struct _Soft_Arena_Block {
+    uint8_t *data;
+    size_t capacity;
+} _Soft_Arena_Block;
+
+// linear allocator, pointers stay valid until the arena is reset
+typedef struct _Soft_Arena {
+    std::vector<_Soft_Arena_Block> blocks;
+    size_t current;
+    size_t used;
+} _Soft_Arena;
+
+typedef struct _Soft_Shader_Entry {
+    std::string entry_point;
+    void *shader;
+    uint32_t varying_count;
+} _Soft_Shader_Entry;
+
+typedef struct _Soft_Triangle {
+    // edge k is opposite to vertex k, E = a x + b y + c in subpixels, inside when E + bias >= 0
+    int32_t a[3], b[3], bias[3];
+    int64_t c[3];
+    int64_t area;
+    // inclusive pixel bounds clamped to the viewport
+    int32_t min_x, min_y, max_x, max_y;
+    // value at vertex 0 and deltas to vertex 1 and 2
+    float z[3];
+    float iw[3];
+    uint32_t varyings;
+    uint32_t draw;
+    uint32_t order;
+} _Soft_Triangle;
+
+typedef struct _Soft_Worker {
+    std::vector<_Soft_Triangle> triangles;
+    std::vector<float> varyings;
+    std::vector<std::vector<uint32_t>> bins;
+} _Soft_Worker;
+
+typedef struct _Soft_Draw {
+    Kuro_Gfx_Soft_Pixel_Shader pixel_shader;
+    uint32_t varying_count;
+    const void *constants[KURO_GFX_SOFT_CONSTANT_MAX_CONSTANT_BUFFERS];
+    bool clear;
+    uint32_t clear_color;
+    float clear_depth;
+} _Soft_Draw;
+
+// a copy of size bytes from staging to offset bytes into buffer, or of size rows to row offset of
+// image
+typedef struct _Soft_Upload {
+    struct _kr_buffer_t *buffer;
+    struct _kr_image_t *image;
+    uint32_t offset;
+    uint32_t size;
+    uint64_t staging;
+} _Soft_Upload;
+
+typedef struct _Soft_Upload_Batch {
+    std::vector<_Soft_Upload> uploads;
+    uint64_t token;
+} _Soft_Upload_Batch;
+
+typedef struct _Soft_Fence_Callback {
+    uint64_t value;
+    Kuro_Gfx_Fence_Callback callback;
+    void *user_data;
+} _Soft_Fence_Callback;
+
+// sequence is the futex word, it changes on every signal so a waiter never misses one
+typedef struct _kr_fence_t {
+    std::atomic<uint64_t> value;
+    std::atomic<uint32_t> sequence;
+    std::mutex mutex;
+    // sorted by value, callbacks with the same value keep their order
+    std::vector<_Soft_Fence_Callback> callbacks;
+} _kr_fence_t;
+
+typedef struct _kr_gfx_t {
+    uint32_t worker_count;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable job_start;
+    std::condition_variable job_done;
+    _Soft_Job job;
+    void *job_ctx;
+    uint64_t job_generation;
+    uint32_t job_running;
+    bool quit;
+
+    std::vector<_Soft_Shader_Entry> vertex_shaders;
+    std::vector<_Soft_Shader_Entry> pixel_shaders;
+
+    std::vector<_Soft_Worker> workers;
+    std::vector<_Soft_Draw> draws;
+    std::vector<float> vertices;
+
+    // staged holds the uploads of the next batch, the copy thread retires the staging blocks of a
+    // batch once it copied them
+    std::thread copy_thread;
+    std::mutex copy_mutex;
+    std::condition_variable copy_start;
+    std::condition_variable copy_done;
+    std::deque<_Soft_Upload_Batch> copy_queue;
+    std::vector<_Soft_Upload> staged;
+    uint8_t *staging;
+    Kuro_Gfx_Ring staging_ring;
+    uint64_t upload_submitted;
+    uint64_t upload_completed;
+    bool copy_quit;
+
+    // kuro_gfx_commands_begin runs the callbacks of every fence
+    std::mutex fence_mutex;
+    std::vector<kr_fence_t> fences;
+
+    // live pipelines by key, the cache holds attribute layouts by the key of the shader entry points
+    std::unordered_map<uint64_t, kr_pipeline_t> pipelines;
+    kr_cache_t pipeline_cache;
+
+    // soft shaders go through the same compile path as on D3D12, their compiled code is the entry
+    // point, which is looked up when the shader is handed out
+    kr_compiler_t compiler;
+} _kr_gfx_t;
+
+typedef struct _kr_swapchain_t {
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t *buffers[SWAPCHAIN_BUFFER_COUNT];
+    uint32_t back_buffer;
+} _kr_swapchain_t;
+
+// render targets store color, depth targets store depth, placed images live in a heap they do not own
+typedef struct _kr_image_t {
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t *color;
+    float *depth;
+    bool placed;
+} _kr_image_t;
+
+typedef struct _kr_heap_t {
+    uint8_t *memory;
+    uint64_t size_in_bytes;
+} _kr_heap_t;
+
+typedef struct _kr_readback_t {
+    uint32_t width;
+    uint32_t height;
+    uint32_t *pixels;
+} _kr_readback_t;
+
+typedef struct _kr_buffer_t {
+    KURO_GFX_ACCESS cpu_access;
+    uint8_t *data;
+    // points into the commands arena while a buffer_write is in flight
+    const uint8_t *current;
+    uint32_t size_in_bytes;
+} _kr_buffer_t;
+
+// soft shaders have no bytecode, the hash of the entry point stands in for it in pipeline keys
+typedef struct _kr_vshader_t {
+    Kuro_Gfx_Soft_Vertex_Shader shader;
+    uint32_t varying_count;
+    uint64_t code_hash;
+} _kr_vshader_t;
+
+typedef struct _kr_pshader_t {
+    Kuro_Gfx_Soft_Pixel_Shader shader;
+    uint64_t code_hash;
+} _kr_pshader_t;
+
+typedef struct _Soft_Attribute {
+    KURO_GFX_FORMAT format;
+    KURO_GFX_CLASS classification;
+    uint32_t slot;
+    uint32_t offset;
+} _Soft_Attribute;
+
+typedef struct _kr_pipeline_t {
+    Kuro_Gfx_Soft_Vertex_Shader vertex_shader;
+    Kuro_Gfx_Soft_Pixel_Shader pixel_shader;
+    uint32_t varying_count;
+    _Soft_Attribute attributes[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES];
+    uint32_t attribute_count;
+    uint64_t key;
+    uint32_t references;
+} _kr_pipeline_t;
+
+typedef enum _SOFT_COMMAND {
+    _SOFT_COMMAND_SET_PIPELINE,
+    _SOFT_COMMAND_VIEWPORT,
+    _SOFT_COMMAND_CLEAR,
+    _SOFT_COMMAND_BUFFER_WRITE,
+    _SOFT_COMMAND_BUFFER_BIND,
+    _SOFT_COMMAND_DRAW,
+    _SOFT_COMMAND_DRAW_INDIRECT,
+    _SOFT_COMMAND_READBACK
+} _SOFT_COMMAND;
+
+typedef struct _Soft_Command {
+    _SOFT_COMMAND kind;
+    kr_pipeline_t pipeline;
+    uint32_t width, height;
+    Kuro_Gfx_Color color;
+    float depth;
+    kr_buffer_t buffer;
+    const void *data;
+    uint32_t size_in_bytes;
+    uint32_t slot;
+    Kuro_Gfx_Draw_Desc draw;
+    uint32_t offset;
+    uint32_t draw_count;
+    kr_image_t image;
+    kr_readback_t readback;
+} _Soft_Command;
+
+// after kuro_gfx_commands_split the list holds the commands recorded before the split up to
+// split_index and the ones recorded after it from there, the recorders execute in between
+typedef struct _kr_commands_t {
+    std::vector<_Soft_Command> list;
+    _Soft_Arena arena;
+    kr_swapchain_t swapchain;
+    kr_image_t color_targets[KURO_CONSTANT_MAX_RENDER_TARGETS];
+    uint32_t color_target_count;
+    kr_image_t depth_target;
+    std::vector<_kr_commands_t *> recorders;
+    uint32_t recorder_count;
+    size_t split_index;
+    bool split;
+    bool recorder;
+    // draws copy their whole desc, the cache only counts what a D3D12 list would have set
+    Kuro_Gfx_Input_Cache input;
+} _kr_commands_t;
+
+// state shared by the jobs while a command list executes
+typedef struct _Soft_Frame {
+    kr_gfx_t gfx;
+    uint32_t *colors[KURO_CONSTANT_MAX_RENDER_TARGETS];
+    uint32_t color_count;
+    float *depth;
+    uint32_t width, height, pitch;
+    uint32_t tiles_x, tiles_y;
+
+    int32_t viewport_x1, viewport_y1;
+    float viewport_width, viewport_height;
+
+    kr_pipeline_t pipeline;
+    const Kuro_Gfx_Draw_Desc *desc;
+    const uint8_t *vertex_data[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES];
+    const uint8_t *index_data;
+    const void *const *constants;
+    // every instance shades the elements vertex_base to vertex_base + instance_vertices - 1 of the
+    // vertex buffers, vertex_count and triangle_count cover all instances
+    uint32_t vertex_base;
+    uint32_t instance_vertices;
+    uint32_t instance_triangles;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    uint32_t draw;
+    uint32_t order;
+
+    std::atomic<uint32_t> next;
+} _Soft_Frame;
+
+static inline uint32_t
+_kuro_gfx_align(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline uint32_t
+_kuro_gfx_format_float_count(KURO_GFX_FORMAT format)
+{
+    switch (format)
+    {
+        case KURO_GFX_FORMAT_R16_UINT:
+        case KURO_GFX_FORMAT_R32_UINT:
+            return 1;
+        case KURO_GFX_FORMAT_R32G32_FLOAT:
+            return 2;
+        case KURO_GFX_FORMAT_R32G32B32_FLOAT:
+            return 3;
+        default:
+            assert(false); return 0;
+    }
+}
+
+static inline uint32_t
+_kuro_gfx_format_size(KURO_GFX_FORMAT format)
+{
+    switch (format)
+    {
+        case KURO_GFX_FORMAT_R16_UINT:
+            return 2;
+        case KURO_GFX_FORMAT_R32_UINT:
+            return 4;
+        case KURO_GFX_FORMAT_R32G32_FLOAT:
+            return 8;
+        case KURO_GFX_FORMAT_R32G32B32_FLOAT:
+            return 12;
+        default:
+            assert(false); return 0;
+    }
+}
+
+static inline uint32_t
+_kuro_gfx_pack_color(const float color[4])
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        float c = color[i] < 0.0f ? 0.0f : (color[i] > 1.0f ? 1.0f : color[i]);
+        packed |= (uint32_t)(c * 255.0f + 0.5f) << (8 * i);
+    }
+    return packed;
+}
+
+// packs 8 lanes of colors stored per channel and writes the lanes set in mask
+static inline void
+_kuro_gfx_store_colors(uint32_t *row, const float color[4 * BLOCK_SIZE], uint32_t mask)
+{
+    uint32_t packed[BLOCK_SIZE];
+#if defined(KURO_MATH_SSE2)
+    for (int half = 0; half < BLOCK_SIZE; half += 4)
+    {
+        __m128i result = _mm_setzero_si128();
+        for (int c = 0; c < 4; ++c)
+        {
+            __m128 v = _mm_loadu_ps(color + c * BLOCK_SIZE + half);
+            v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128i channel = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+            result = _mm_or_si128(result, _mm_sll_epi32(channel, _mm_cvtsi32_si128(8 * c)));
+        }
+        _mm_storeu_si128((__m128i *)(packed + half), result);
+    }
+#else
+    for (int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        float lane[4] = {color[i], color[BLOCK_SIZE + i], color[2 * BLOCK_SIZE + i], color[3 * BLOCK_SIZE + i]};
+        packed[i] = _kuro_gfx_pack_color(lane);
+    }
+#endif
+
+    if (mask == 0xFF)
+    {
+        memcpy(row, packed, sizeof(packed));
+        return;
+    }
+    for (uint32_t bits = mask; bits; bits &= bits - 1)
+    {
+        int i = __builtin_ctz(bits);
+        row[i] = packed[i];
+    }
+}
+
+static void *
+_kuro_gfx_arena_push(_Soft_Arena &arena, size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    while (arena.current < arena.blocks.size())
+    {
+        _Soft_Arena_Block &block = arena.blocks[arena.current];
+        if (arena.used + size <= block.capacity)
+        {
+            void *ptr = block.data + arena.used;
+            arena.used += size;
+            return ptr;
+        }
+        arena.current++;
+        arena.used = 0;
+    }
+
+    _Soft_Arena_Block block = {};
+    block.capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    block.data = (uint8_t *)malloc(block.capacity);
+    arena.blocks.push_back(block);
+    arena.current = arena.blocks.size() - 1;
+    arena.used = size;
+    return block.data;
+}
+
+static void
+_kuro_gfx_arena_reset(_Soft_Arena &arena)
+{
+    arena.current = 0;
+    arena.used = 0;
+}
+
+static void
+_kuro_gfx_arena_free(_Soft_Arena &arena)
+{
+    for (const _Soft_Arena_Block &block : arena.blocks)
+        free(block.data);
+    arena.blocks.clear();
+    _kuro_gfx_arena_reset(arena);
+}
+
+// == thread pool ======================================================================================
+
+static void
+_kuro_gfx_worker_main(kr_gfx_t gfx, uint32_t worker)
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(gfx->mutex);
+        gfx->job_start.wait(lock, [&] { return gfx->quit || gfx->job_generation != generation; });
+        if (gfx->quit)
+            return;
+        generation = gfx->job_generation;
+        lock.unlock();
+
+        gfx->job(gfx->job_ctx, worker);
+
+        lock.lock();
+        if (--gfx->job_running == 0)
+            gfx->job_done.notify_one();
+    }
+}
+
+// runs job on every worker, the calling thread is worker 0
+static void
+_kuro_gfx_run(kr_gfx_t gfx, _Soft_Job job, void *ctx)
+{
+    if (gfx->threads.empty())
+    {
+        job(ctx, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gfx->mutex);
+        gfx->job = job;
+        gfx->job_ctx = ctx;
+        gfx->job_running = (uint32_t)gfx->threads.size();
+        gfx->job_generation++;
+    }
+    gfx->job_start.notify_all();
+
+    job(ctx, 0);
+
+    std::unique_lock<std::mutex> lock(gfx->mutex);
+    gfx->job_done.wait(lock, [&] { return gfx->job_running == 0; });
+}
+
+// == vertex stage =====================================================================================
+
+static void
+_kuro_gfx_shade_vertices(_Soft_Frame *frame, uint32_t begin, uint32_t end)
+{
+    kr_pipeline_t pipeline = frame->pipeline;
+    uint32_t vertex_floats = 4 + pipeline->varying_count;
+
+    float attributes[KURO_GFX_SOFT_CONSTANT_MAX_ATTRIBUTE_FLOATS];
+    Kuro_Gfx_Soft_Vertex vertex = {};
+    vertex.attributes = attributes;
+    vertex.constants = frame->constants;
+
+    for (uint32_t v = begin; v < end; ++v)
+    {
+        uint32_t instance = v / frame->instance_vertices;
+        uint32_t vertex_element = frame->vertex_base + v % frame->instance_vertices;
+        uint32_t instance_element = frame->desc->first_instance + instance;
+
+        float *attribute = attributes;
+        for (uint32_t i = 0; i < pipeline->attribute_count; ++i)
+        {
+            const _Soft_Attribute &desc = pipeline->attributes[i];
+            uint32_t element = desc.classification == KURO_GFX_CLASS_PER_VERTEX ? vertex_element : instance_element;
+            const uint8_t *src = frame->vertex_data[desc.slot] + (size_t)element * frame->desc->vertex_buffers[desc.slot].stride + desc.offset;
+            switch (desc.format)
+            {
+                case KURO_GFX_FORMAT_R16_UINT:
+                {
+                    uint16_t value;
+                    memcpy(&value, src, sizeof(value));
+                    *attribute++ = (float)value;
+                    break;
+                }
+                case KURO_GFX_FORMAT_R32_UINT:
+                {
+                    uint32_t value;
+                    memcpy(&value, src, sizeof(value));
+                    *attribute++ = (float)value;
+                    break;
+                }
+                default:
+                {
+                    uint32_t count = _kuro_gfx_format_float_count(desc.format);
+                    memcpy(attribute, src, count * sizeof(float));
+                    attribute += count;
+                    break;
+                }
+            }
+        }
+
+        vertex.vertex_id = vertex_element;
+        vertex.instance_id = instance;
+        float *out = frame->gfx->vertices.data() + (size_t)v * vertex_floats;
+        pipeline->vertex_shader(&vertex, out, out + 4);
+    }
+}
+
+static void
+_kuro_gfx_job_vertices(void *ctx, uint32_t)
+{
+    _Soft_Frame *frame = (_Soft_Frame *)ctx;
+    for (;;)
+    {
+        uint32_t begin = frame->next.fetch_add(VERTEX_CHUNK);
+        if (begin >= frame->vertex_count)
+            break;
+        uint32_t end = begin + VERTEX_CHUNK < frame->vertex_count ? begin + VERTEX_CHUNK : frame->vertex_count;
+        _kuro_gfx_shade_vertices(frame, begin, end);
+    }
+}
+
+// == triangle setup ===================================================================================
+
+static inline float
+_kuro_gfx_clip_distance(const float *v, int plane)
+{
+    switch (plane)
+    {
+        case 0: return v[2];
+        case 1: return GUARD_BAND * v[3] - v[0];
+        case 2: return GUARD_BAND * v[3] + v[0];
+        case 3: return GUARD_BAND * v[3] - v[1];
+        case 4: return GUARD_BAND * v[3] + v[1];
+        default: return v[3] - MIN_W;
+    }
+}
+
+static inline uint32_t
+_kuro_gfx_outcode(const float *v)
+{
+    uint32_t code = 0;
+    for (int plane = 0; plane < 6; ++plane)
+        code |= (_kuro_gfx_clip_distance(v, plane) < 0.0f ? 1u : 0u) << plane;
+    return code;
+}
+
+static uint32_t
+_kuro_gfx_clip_polygon(const float *in, uint32_t count, float *out, uint32_t vertex_floats, int plane)
+{
+    uint32_t out_count = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float *a = in + i * vertex_floats;
+        const float *b = in + ((i + 1) % count) * vertex_floats;
+        float da = _kuro_gfx_clip_distance(a, plane);
+        float db = _kuro_gfx_clip_distance(b, plane);
+
+        if (da >= 0.0f)
+            memcpy(out + (out_count++) * vertex_floats, a, vertex_floats * sizeof(float));
+
+        if ((da >= 0.0f) != (db >= 0.0f))
+        {
+            float t = da / (da - db);
+            float *v = out + (out_count++) * vertex_floats;
+            for (uint32_t j = 0; j < vertex_floats; ++j)
+                v[j] = a[j] + t * (b[j] - a[j]);
+        }
+    }
+    return out_count;
+}
+
+// any edge rejects the whole size x size pixel square starting at pixel (x, y)
+static inline bool
+_kuro_gfx_square_outside(const _Soft_Triangle &t, int32_t x, int32_t y, int32_t size)
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        int64_t e = (int64_t)t.a[k] * (x * SUBPIXEL + SUBPIXEL / 2) + (int64_t)t.b[k] * (y * SUBPIXEL + SUBPIXEL / 2) + t.c[k] + t.bias[k];
+        int64_t step_x = (int64_t)t.a[k] * (size - 1) * SUBPIXEL;
+        int64_t step_y = (int64_t)t.b[k] * (size - 1) * SUBPIXEL;
+        int64_t e_max = e + (step_x > 0 ? step_x : 0) + (step_y > 0 ? step_y : 0);
+        if (e_max < 0)
+            return true;
+    }
+    return false;
+}
+
+static void
+_kuro_gfx_setup_triangle(_Soft_Frame *frame, _Soft_Worker &worker, const float *v0, const float *v1, const float *v2)
+{
+    const float *v[3] = {v0, v1, v2};
+    int32_t x[3], y[3];
+    float z[3], iw[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        iw[i] = 1.0f / v[i][3];
+        float sx = (v[i][0] * iw[i] * 0.5f + 0.5f) * frame->viewport_width;
+        float sy = (0.5f - v[i][1] * iw[i] * 0.5f) * frame->viewport_height;
+        x[i] = (int32_t)floorf(sx * SUBPIXEL + 0.5f);
+        y[i] = (int32_t)floorf(sy * SUBPIXEL + 0.5f);
+        z[i] = v[i][2] * iw[i];
+    }
+
+    // y points down on screen, counter clockwise front faces have a negative area
+    int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+    if (area >= 0)
+        return;
+
+    // swap to a positive area so the edge functions are positive inside
+    int32_t tx = x[1]; x[1] = x[2]; x[2] = tx;
+    int32_t ty = y[1]; y[1] = y[2]; y[2] = ty;
+    float tz = z[1]; z[1] = z[2]; z[2] = tz;
+    float tw = iw[1]; iw[1] = iw[2]; iw[2] = tw;
+    const float *tv = v[1]; v[1] = v[2]; v[2] = tv;
+    area = -area;
+
+    _Soft_Triangle t = {};
+    t.area = area;
+
+    int32_t min_x = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+    int32_t min_y = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+    int32_t max_x = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+    int32_t max_y = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+
+    // pixel centers sit at 8 subpixels, shifts round towards negative infinity
+    t.min_x = (min_x - SUBPIXEL / 2 + SUBPIXEL - 1) >> SUBPIXEL_BITS;
+    t.min_y = (min_y - SUBPIXEL / 2 + SUBPIXEL - 1) >> SUBPIXEL_BITS;
+    t.max_x = (max_x - SUBPIXEL / 2) >> SUBPIXEL_BITS;
+    t.max_y = (max_y - SUBPIXEL / 2) >> SUBPIXEL_BITS;
+    if (t.min_x < 0) t.min_x = 0;
+    if (t.min_y < 0) t.min_y = 0;
+    if (t.max_x > frame->viewport_x1 - 1) t.max_x = frame->viewport_x1 - 1;
+    if (t.max_y > frame->viewport_y1 - 1) t.max_y = frame->viewport_y1 - 1;
+    if (t.min_x > t.max_x || t.min_y > t.max_y)
+        return;
+
+    for (int k = 0; k < 3; ++k)
+    {
+        int i = (k + 1) % 3;
+        int j = (k + 2) % 3;
+        t.a[k] = y[i] - y[j];
+        t.b[k] = x[j] - x[i];
+        t.c[k] = -((int64_t)t.a[k] * x[i] + (int64_t)t.b[k] * y[i]);
+        bool top_left = t.a[k] > 0 || (t.a[k] == 0 && t.b[k] > 0);
+        t.bias[k] = top_left ? 0 : -1;
+    }
+
+    t.z[0] = z[0]; t.z[1] = z[1] - z[0]; t.z[2] = z[2] - z[0];
+    t.iw[0] = iw[0]; t.iw[1] = iw[1] - iw[0]; t.iw[2] = iw[2] - iw[0];
+    t.draw = frame->draw;
+    t.order = frame->order;
+
+    uint32_t varying_count = frame->pipeline->varying_count;
+    t.varyings = (uint32_t)worker.varyings.size();
+    worker.varyings.resize(worker.varyings.size() + 3 * varying_count);
+    float *varyings = worker.varyings.data() + t.varyings;
+    for (uint32_t j = 0; j < varying_count; ++j)
+    {
+        float a = v[0][4 + j] * iw[0];
+        varyings[j] = a;
+        varyings[varying_count + j] = v[1][4 + j] * iw[1] - a;
+        varyings[2 * varying_count + j] = v[2][4 + j] * iw[2] - a;
+    }
+
+    uint32_t index = (uint32_t)worker.triangles.size();
+    worker.triangles.push_back(t);
+
+    int32_t tile_x0 = t.min_x / TILE_SIZE, tile_x1 = t.max_x / TILE_SIZE;
+    int32_t tile_y0 = t.min_y / TILE_SIZE, tile_y1 = t.max_y / TILE_SIZE;
+    bool single = tile_x0 == tile_x1 && tile_y0 == tile_y1;
+    for (int32_t ty = tile_y0; ty <= tile_y1; ++ty)
+    {
+        for (int32_t tx = tile_x0; tx <= tile_x1; ++tx)
+        {
+            if (!single && _kuro_gfx_square_outside(t, tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE))
+                continue;
+            worker.bins[ty * frame->tiles_x + tx].push_back(index);
+        }
+    }
+}
+
+static inline uint32_t
+_kuro_gfx_index(const _Soft_Frame *frame, uint32_t i)
+{
+    if (frame->index_data == nullptr)
+        return i;
+
+    if (frame->desc->index_buffer.format == KURO_GFX_FORMAT_R16_UINT)
+    {
+        uint16_t index;
+        memcpy(&index, frame->index_data + i * sizeof(uint16_t), sizeof(index));
+        return index;
+    }
+
+    uint32_t index;
+    memcpy(&index, frame->index_data + i * sizeof(uint32_t), sizeof(index));
+    return index;
+}
+
+// the vertex buffer element at position i of the index (or vertex) stream of the draw
+static inline uint32_t
+_kuro_gfx_element(const _Soft_Frame *frame, uint32_t i)
+{
+    if (frame->index_data == nullptr)
+        return i;
+    return (uint32_t)((int64_t)_kuro_gfx_index(frame, i) + frame->desc->base_vertex);
+}
+
+// where the vertex corner of triangle i was shaded to
+static inline const float *
+_kuro_gfx_corner(const _Soft_Frame *frame, const float *vertices, uint32_t vertex_floats, uint32_t i, uint32_t corner)
+{
+    uint32_t instance = i / frame->instance_triangles;
+    uint32_t local = i % frame->instance_triangles;
+    uint32_t element = _kuro_gfx_element(frame, frame->desc->first + 3 * local + corner);
+    size_t slot = (size_t)instance * frame->instance_vertices + (element - frame->vertex_base);
+    return vertices + slot * vertex_floats;
+}
+
+static void
+_kuro_gfx_setup_triangles(_Soft_Frame *frame, _Soft_Worker &worker, uint32_t begin, uint32_t end)
+{
+    uint32_t vertex_floats = 4 + frame->pipeline->varying_count;
+    const float *vertices = frame->gfx->vertices.data();
+
+    float polygon[2][MAX_CLIP_VERTICES * MAX_VERTEX_FLOATS];
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const float *v0 = _kuro_gfx_corner(frame, vertices, vertex_floats, i, 0);
+        const float *v1 = _kuro_gfx_corner(frame, vertices, vertex_floats, i, 1);
+        const float *v2 = _kuro_gfx_corner(frame, vertices, vertex_floats, i, 2);
+
+        uint32_t c0 = _kuro_gfx_outcode(v0);
+        uint32_t c1 = _kuro_gfx_outcode(v1);
+        uint32_t c2 = _kuro_gfx_outcode(v2);
+        if (c0 & c1 & c2)
+            continue;
+
+        if ((c0 | c1 | c2) == 0)
+        {
+            _kuro_gfx_setup_triangle(frame, worker, v0, v1, v2);
+            continue;
+        }
+
+        memcpy(polygon[0], v0, vertex_floats * sizeof(float));
+        memcpy(polygon[0] + vertex_floats, v1, vertex_floats * sizeof(float));
+        memcpy(polygon[0] + 2 * vertex_floats, v2, vertex_floats * sizeof(float));
+
+        uint32_t count = 3;
+        int current = 0;
+        for (int plane = 0; plane < 6 && count >= 3; ++plane)
+        {
+            if (((c0 | c1 | c2) & (1u << plane)) == 0)
+                continue;
+            count = _kuro_gfx_clip_polygon(polygon[current], count, polygon[1 - current], vertex_floats, plane);
+            current = 1 - current;
+        }
+
+        for (uint32_t j = 1; j + 1 < count; ++j)
+        {
+            _kuro_gfx_setup_triangle(
+                frame, worker,
+                polygon[current],
+                polygon[current] + j * vertex_floats,
+                polygon[current] + (j + 1) * vertex_floats);
+        }
+    }
+}
+
+static void
+_kuro_gfx_setup_range(_Soft_Frame *frame, uint32_t worker_index, uint32_t begin, uint32_t end)
+{
+    _Soft_Worker &worker = frame->gfx->workers[worker_index];
+    _kuro_gfx_setup_triangles(frame, worker, begin, end);
+}
+
+static void
+_kuro_gfx_job_setup(void *ctx, uint32_t worker)
+{
+    _Soft_Frame *frame = (_Soft_Frame *)ctx;
+    uint64_t count = frame->triangle_count;
+    uint64_t workers = frame->gfx->worker_count;
+    uint32_t begin = (uint32_t)(count * worker / workers);
+    uint32_t end = (uint32_t)(count * (worker + 1) / workers);
+    _kuro_gfx_setup_range(frame, worker, begin, end);
+}
+
+// == rasterization ====================================================================================
+
+// coverage of 8 pixels of a row, bit i is set when every edge is >= 0 at pixel i
+static inline uint32_t
+_kuro_gfx_coverage_row(const int32_t *e, const int32_t *step, uint32_t count)
+{
+#if defined(KURO_MATH_SSE2)
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        __m128i base = _mm_set1_epi32(e[k]);
+        __m128i s = _mm_set1_epi32(step[k]);
+        __m128i lane_lo = _mm_add_epi32(base, _mm_and_si128(s, _mm_setr_epi32(0, -1, 0, -1)));
+        lane_lo = _mm_add_epi32(lane_lo, _mm_and_si128(_mm_add_epi32(s, s), _mm_setr_epi32(0, 0, -1, -1)));
+        __m128i lane_hi = _mm_add_epi32(lane_lo, _mm_slli_epi32(s, 2));
+        lo = _mm_or_si128(lo, lane_lo);
+        hi = _mm_or_si128(hi, lane_hi);
+    }
+    uint32_t outside = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lo)) | ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+    return ~outside & 0xFF;
+#else
+    uint32_t mask = 0xFF;
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        for (int i = 0; i < BLOCK_SIZE; ++i)
+        {
+            if (e[k] + step[k] * i < 0)
+                mask &= ~(1u << i);
+        }
+    }
+    return mask;
+#endif
+}
+
+static void
+_kuro_gfx_clear_tile(_Soft_Frame *frame, const _Soft_Draw &draw, uint32_t tile_x, uint32_t tile_y)
+{
+    uint32_t x0 = tile_x * TILE_SIZE;
+    uint32_t y0 = tile_y * TILE_SIZE;
+    uint32_t y1 = y0 + TILE_SIZE < frame->height ? y0 + TILE_SIZE : frame->height;
+
+    // the storage is padded to whole tiles so the clear writes full tile rows
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        for (uint32_t i = 0; i < frame->color_count; ++i)
+        {
+            uint32_t *row = frame->colors[i] + (size_t)y * frame->pitch + x0;
+            for (int x = 0; x < TILE_SIZE; ++x)
+                row[x] = draw.clear_color;
+        }
+        if (frame->depth)
+        {
+            float *row = frame->depth + (size_t)y * frame->pitch + x0;
+            for (int x = 0; x < TILE_SIZE; ++x)
+                row[x] = draw.clear_depth;
+        }
+    }
+}
+
+static void
+_kuro_gfx_raster_triangle(_Soft_Frame *frame, const _Soft_Triangle &t, const float *varyings, uint32_t tile_x, uint32_t tile_y)
+{
+    const _Soft_Draw &draw = frame->gfx->draws[t.draw];
+    uint32_t varying_count = draw.varying_count;
+
+    int32_t x0 = (int32_t)tile_x * TILE_SIZE, y0 = (int32_t)tile_y * TILE_SIZE;
+    int32_t x1 = x0 + TILE_SIZE - 1, y1 = y0 + TILE_SIZE - 1;
+    if (x0 < t.min_x) x0 = t.min_x;
+    if (y0 < t.min_y) y0 = t.min_y;
+    if (x1 > t.max_x) x1 = t.max_x;
+    if (y1 > t.max_y) y1 = t.max_y;
+
+    double inv_area = 1.0 / (double)t.area;
+    float l1_x = (float)(t.a[1] * SUBPIXEL * inv_area);
+    float l2_x = (float)(t.a[2] * SUBPIXEL * inv_area);
+
+    const kuro::f32 LANES[BLOCK_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7};
+    kuro::f32x8 lanes = kuro::f32x8_loadu(LANES);
+    kuro::f32x8 l1_lanes = lanes * l1_x;
+    kuro::f32x8 l2_lanes = lanes * l2_x;
+    kuro::f32x8 z0 = kuro::f32x8_splat(t.z[0]), dz1 = kuro::f32x8_splat(t.z[1]), dz2 = kuro::f32x8_splat(t.z[2]);
+    kuro::f32x8 iw0 = kuro::f32x8_splat(t.iw[0]), diw1 = kuro::f32x8_splat(t.iw[1]), diw2 = kuro::f32x8_splat(t.iw[2]);
+
+    int32_t a16[3] = {t.a[0] * SUBPIXEL, t.a[1] * SUBPIXEL, t.a[2] * SUBPIXEL};
+    int32_t b16[3] = {t.b[0] * SUBPIXEL, t.b[1] * SUBPIXEL, t.b[2] * SUBPIXEL};
+
+    float zs[BLOCK_SIZE];
+    float row_varyings[KURO_GFX_SOFT_CONSTANT_MAX_VARYINGS * BLOCK_SIZE];
+    float color[KURO_CONSTANT_MAX_RENDER_TARGETS * 4 * BLOCK_SIZE];
+    Kuro_Gfx_Soft_Pixels pixels = {};
+    pixels.depth = zs;
+    pixels.varyings = row_varyings;
+    pixels.constants = draw.constants;
+
+    for (int32_t by = y0 & ~(BLOCK_SIZE - 1); by <= y1; by += BLOCK_SIZE)
+    {
+        int32_t row_begin = by > y0 ? by : y0;
+        int32_t row_end = by + BLOCK_SIZE - 1 < y1 ? by + BLOCK_SIZE - 1 : y1;
+
+        for (int32_t bx = x0 & ~(BLOCK_SIZE - 1); bx <= x1; bx += BLOCK_SIZE)
+        {
+            // classify the block against every edge, partial edges are tested per pixel
+            int64_t e[3];
+            int32_t partial_e[3], partial_step[3], partial_b16[3];
+            uint32_t partial = 0;
+            bool outside = false;
+            for (int k = 0; k < 3; ++k)
+            {
+                e[k] = (int64_t)t.a[k] * (bx * SUBPIXEL + SUBPIXEL / 2) + (int64_t)t.b[k] * (by * SUBPIXEL + SUBPIXEL / 2) + t.c[k] + t.bias[k];
+                int64_t step_x = (int64_t)a16[k] * (BLOCK_SIZE - 1);
+                int64_t step_y = (int64_t)b16[k] * (BLOCK_SIZE - 1);
+                int64_t e_min = e[k] + (step_x < 0 ? step_x : 0) + (step_y < 0 ? step_y : 0);
+                int64_t e_max = e[k] + (step_x > 0 ? step_x : 0) + (step_y > 0 ? step_y : 0);
+                if (e_max < 0)
+                {
+                    outside = true;
+                    break;
+                }
+                if (e_min < 0)
+                {
+                    // an edge crossing the block stays well inside 32 bits over it
+                    partial_e[partial] = (int32_t)e[k];
+                    partial_step[partial] = a16[k];
+                    partial_b16[partial] = b16[k];
+                    partial++;
+                }
+            }
+            if (outside)
+                continue;
+
+            int32_t col_begin = bx > x0 ? bx : x0;
+            int32_t col_end = bx + BLOCK_SIZE - 1 < x1 ? bx + BLOCK_SIZE - 1 : x1;
+            uint32_t columns = ((1u << (col_end - col_begin + 1)) - 1) << (col_begin - bx);
+
+            for (int32_t y = row_begin; y <= row_end; ++y)
+            {
+                uint32_t mask = columns;
+                if (partial)
+                {
+                    int32_t row_e[3];
+                    for (uint32_t k = 0; k < partial; ++k)
+                        row_e[k] = partial_e[k] + partial_b16[k] * (y - by);
+                    mask &= _kuro_gfx_coverage_row(row_e, partial_step, partial);
+                }
+                if (mask == 0)
+                    continue;
+
+                // barycentrics of the first pixel of the row from the exact edge values
+                int64_t row_y = (int64_t)y * SUBPIXEL + SUBPIXEL / 2;
+                int64_t row_x = (int64_t)bx * SUBPIXEL + SUBPIXEL / 2;
+                float l1_row = (float)((double)(t.a[1] * row_x + t.b[1] * row_y + t.c[1]) * inv_area);
+                float l2_row = (float)((double)(t.a[2] * row_x + t.b[2] * row_y + t.c[2]) * inv_area);
+                kuro::f32x8 l1 = kuro::f32x8_splat(l1_row) + l1_lanes;
+                kuro::f32x8 l2 = kuro::f32x8_splat(l2_row) + l2_lanes;
+                kuro::f32x8 z = z0 + l1 * dz1 + l2 * dz2;
+
+                auto pass = (z >= 0.0f) & (z <= 1.0f);
+                float *depth_row = nullptr;
+                if (frame->depth)
+                {
+                    depth_row = frame->depth + (size_t)y * frame->pitch + bx;
+                    pass = pass & (z < kuro::f32x8_loadu(depth_row));
+                }
+                mask &= kuro::bitmask(pass);
+                if (mask == 0)
+                    continue;
+
+                kuro::f32x8_storeu(zs, z);
+                if (depth_row)
+                {
+                    for (uint32_t bits = mask; bits; bits &= bits - 1)
+                    {
+                        int i = __builtin_ctz(bits);
+                        depth_row[i] = zs[i];
+                    }
+                }
+
+                if (draw.pixel_shader == nullptr || frame->color_count == 0)
+                    continue;
+
+                kuro::f32x8 w = 1.0f / (iw0 + l1 * diw1 + l2 * diw2);
+                for (uint32_t j = 0; j < varying_count; ++j)
+                {
+                    kuro::f32x8 value = (kuro::f32x8_splat(varyings[j]) + l1 * varyings[varying_count + j] + l2 * varyings[2 * varying_count + j]) * w;
+                    kuro::f32x8_storeu(row_varyings + j * BLOCK_SIZE, value);
+                }
+
+                pixels.x = (uint32_t)bx;
+                pixels.y = (uint32_t)y;
+                pixels.mask = mask;
+
+                memset(color, 0, frame->color_count * 4 * BLOCK_SIZE * sizeof(float));
+                draw.pixel_shader(&pixels, color);
+                for (uint32_t i = 0; i < frame->color_count; ++i)
+                    _kuro_gfx_store_colors(frame->colors[i] + (size_t)y * frame->pitch + bx, color + i * 4 * BLOCK_SIZE, mask);
+            }
+        }
+    }
+}
+
+static void
+_kuro_gfx_raster_tile(_Soft_Frame *frame, uint32_t tile)
+{
+    kr_gfx_t gfx = frame->gfx;
+    uint32_t tile_x = tile % frame->tiles_x;
+    uint32_t tile_y = tile / frame->tiles_x;
+
+    // every worker bin is sorted by submission order, merge them
+    uint32_t heads[MAX_WORKERS] = {};
+    for (;;)
+    {
+        uint32_t best = UINT32_MAX;
+        uint32_t best_order = UINT32_MAX;
+        for (uint32_t w = 0; w < gfx->worker_count; ++w)
+        {
+            const std::vector<uint32_t> &bin = gfx->workers[w].bins[tile];
+            if (heads[w] < bin.size())
+            {
+                uint32_t order = gfx->workers[w].triangles[bin[heads[w]]].order;
+                if (order < best_order)
+                {
+                    best = w;
+                    best_order = order;
+                }
+            }
+        }
+        if (best == UINT32_MAX)
+            break;
+
+        const _Soft_Worker &worker = gfx->workers[best];
+        const _Soft_Triangle &t = worker.triangles[worker.bins[tile][heads[best]++]];
+        const _Soft_Draw &draw = gfx->draws[t.draw];
+        if (draw.clear)
+            _kuro_gfx_clear_tile(frame, draw, tile_x, tile_y);
+        else
+            _kuro_gfx_raster_triangle(frame, t, worker.varyings.data() + t.varyings, tile_x, tile_y);
+    }
+}
+
+static void
+_kuro_gfx_job_raster(void *ctx, uint32_t)
+{
+    _Soft_Frame *frame = (_Soft_Frame *)ctx;
+    uint32_t tile_count = frame->tiles_x * frame->tiles_y;
+    for (;;)
+    {
+        uint32_t tile = frame->next.fetch_add(1);
+        if (tile >= tile_count)
+            break;
+        _kuro_gfx_raster_tile(frame, tile);
+    }
+}
+
+// == execution ========================================================================================
+
+static void
+_kuro_gfx_execute_clear(_Soft_Frame *frame, const _Soft_Command &command)
+{
+    kr_gfx_t gfx = frame->gfx;
+
+    _Soft_Draw draw = {};
+    draw.clear = true;
+    draw.clear_color = _kuro_gfx_pack_color(&command.color.r);
+    draw.clear_depth = command.depth;
+
+    _Soft_Triangle t = {};
+    t.draw = (uint32_t)gfx->draws.size();
+    t.order = frame->order++;
+    gfx->draws.push_back(draw);
+
+    _Soft_Worker &worker = gfx->workers[0];
+    uint32_t index = (uint32_t)worker.triangles.size();
+    worker.triangles.push_back(t);
+    for (uint32_t tile = 0; tile < frame->tiles_x * frame->tiles_y; ++tile)
+        worker.bins[tile].push_back(index);
+}
+
+static void
+_kuro_gfx_execute_draw(_Soft_Frame *frame, const Kuro_Gfx_Draw_Desc &desc, kr_buffer_t *bound)
+{
+    kr_gfx_t gfx = frame->gfx;
+    kr_pipeline_t pipeline = frame->pipeline;
+    assert(pipeline && "kuro_gfx_draw without a pipeline");
+
+    _Soft_Draw draw = {};
+    draw.pixel_shader = pipeline->pixel_shader;
+    draw.varying_count = pipeline->varying_count;
+    for (int i = 0; i < KURO_GFX_SOFT_CONSTANT_MAX_CONSTANT_BUFFERS; ++i)
+        draw.constants[i] = bound[i] ? bound[i]->current : nullptr;
+
+    frame->draw = (uint32_t)gfx->draws.size();
+    gfx->draws.push_back(draw);
+
+    frame->desc = &desc;
+    frame->constants = gfx->draws[frame->draw].constants;
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+        frame->vertex_data[i] = desc.vertex_buffers[i].buffer ? desc.vertex_buffers[i].buffer->current : nullptr;
+
+    // the vertices of an instance are shaded once each, instances are shaded one after the other
+    frame->index_data = nullptr;
+    frame->vertex_base = desc.first;
+    frame->instance_vertices = desc.count;
+    if (desc.index_buffer.buffer)
+    {
+        assert(desc.index_buffer.format == KURO_GFX_FORMAT_R16_UINT || desc.index_buffer.format == KURO_GFX_FORMAT_R32_UINT);
+        assert(((uint64_t)desc.first + desc.count) * _kuro_gfx_format_size(desc.index_buffer.format) <= desc.index_buffer.buffer->size_in_bytes);
+        frame->index_data = desc.index_buffer.buffer->current;
+
+        uint32_t min_element = UINT32_MAX, max_element = 0;
+        for (uint32_t i = desc.first; i < desc.first + desc.count; ++i)
+        {
+            assert((int64_t)_kuro_gfx_index(frame, i) + desc.base_vertex >= 0);
+            uint32_t element = _kuro_gfx_element(frame, i);
+            min_element = element < min_element ? element : min_element;
+            max_element = element > max_element ? element : max_element;
+        }
+        frame->vertex_base = desc.count ? min_element : 0;
+        frame->instance_vertices = desc.count ? max_element - min_element + 1 : 0;
+    }
+
+    uint32_t instance_count = desc.instance_count ? desc.instance_count : 1;
+
+    // the elements every attribute reads have to be in its buffer, like the indices above
+    for (uint32_t i = 0; i < pipeline->attribute_count && frame->instance_vertices; ++i)
+    {
+        const _Soft_Attribute &attribute = pipeline->attributes[i];
+        assert(frame->vertex_data[attribute.slot] && "the pipeline reads a vertex buffer slot the draw does not bind");
+        uint64_t last = attribute.classification == KURO_GFX_CLASS_PER_VERTEX
+            ? (uint64_t)frame->vertex_base + frame->instance_vertices - 1
+            : (uint64_t)desc.first_instance + instance_count - 1;
+        assert(last * desc.vertex_buffers[attribute.slot].stride + attribute.offset + _kuro_gfx_format_size(attribute.format) <=
+               desc.vertex_buffers[attribute.slot].buffer->size_in_bytes);
+        (void)last;
+    }
+
+    frame->instance_triangles = desc.count / 3;
+    frame->vertex_count = frame->instance_vertices * instance_count;
+    frame->triangle_count = frame->instance_triangles * instance_count;
+
+    gfx->vertices.resize((size_t)frame->vertex_count * (4 + pipeline->varying_count));
+    if (frame->vertex_count < INLINE_VERTICES)
+    {
+        _kuro_gfx_shade_vertices(frame, 0, frame->vertex_count);
+    }
+    else
+    {
+        frame->next = 0;
+        _kuro_gfx_run(gfx, _kuro_gfx_job_vertices, frame);
+    }
+
+    // every triangle of the draw shares the same order, tiles keep the worker order within a draw
+    if (frame->triangle_count < INLINE_TRIANGLES)
+        _kuro_gfx_setup_range(frame, 0, 0, frame->triangle_count);
+    else
+        _kuro_gfx_run(gfx, _kuro_gfx_job_setup, frame);
+    frame->order++;
+}
+
+// the arguments are read when the command executes, so writes recorded before it are seen
+static void
+_kuro_gfx_execute_draw_indirect(_Soft_Frame *frame, const _Soft_Command &command, kr_buffer_t *bound)
+{
+    bool indexed = command.draw.index_buffer.buffer != nullptr;
+    uint32_t stride = indexed ? sizeof(Kuro_Gfx_Draw_Indexed_Arguments) : sizeof(Kuro_Gfx_Draw_Arguments);
+    assert((uint64_t)command.offset + (uint64_t)command.draw_count * stride <= command.buffer->size_in_bytes);
+
+    Kuro_Gfx_Draw_Desc desc = command.draw;
+    for (uint32_t i = 0; i < command.draw_count; ++i)
+    {
+        const uint8_t *record = command.buffer->current + command.offset + (size_t)i * stride;
+        if (indexed)
+        {
+            Kuro_Gfx_Draw_Indexed_Arguments arguments;
+            memcpy(&arguments, record, sizeof(arguments));
+            desc.count = arguments.count;
+            desc.instance_count = arguments.instance_count;
+            desc.first = arguments.first;
+            desc.base_vertex = arguments.base_vertex;
+            desc.first_instance = arguments.first_instance;
+        }
+        else
+        {
+            Kuro_Gfx_Draw_Arguments arguments;
+            memcpy(&arguments, record, sizeof(arguments));
+            desc.count = arguments.count;
+            desc.instance_count = arguments.instance_count;
+            desc.first = arguments.first;
+            desc.base_vertex = 0;
+            desc.first_instance = arguments.first_instance;
+        }
+
+        // unlike kuro_gfx_draw 0 instances draw nothing, like D3D12 ExecuteIndirect
+        if (desc.count && desc.instance_count)
+            _kuro_gfx_execute_draw(frame, desc, bound);
+    }
+}
+
+// rasterizes everything binned so far
+static void
+_kuro_gfx_flush(_Soft_Frame *frame)
+{
+    kr_gfx_t gfx = frame->gfx;
+
+    frame->next = 0;
+    _kuro_gfx_run(gfx, _kuro_gfx_job_raster, frame);
+
+    for (_Soft_Worker &worker : gfx->workers)
+    {
+        worker.triangles.clear();
+        worker.varyings.clear();
+        worker.bins.resize(frame->tiles_x * frame->tiles_y);
+        for (std::vector<uint32_t> &bin : worker.bins)
+            bin.clear();
+    }
+}
+
+static void
+_kuro_gfx_execute_readback(_Soft_Frame *frame, const _Soft_Command &command)
+{
+    _kuro_gfx_flush(frame);
+
+    kr_image_t image = command.image;
+    kr_readback_t readback = command.readback;
+    assert(image->color && "only render targets can be read back");
+    assert(readback->width == image->width && readback->height == image->height);
+
+    for (uint32_t y = 0; y < image->height; ++y)
+        memcpy(readback->pixels + (size_t)y * readback->width, image->color + (size_t)y * image->pitch, image->width * sizeof(uint32_t));
+}
+
+// every list starts without a pipeline, bound buffers or viewport like a D3D12 command list does
+static void
+_kuro_gfx_execute_list(_Soft_Frame *frame, kr_commands_t commands, size_t begin, size_t end)
+{
+    frame->pipeline = nullptr;
+    frame->viewport_x1 = (int32_t)frame->width;
+    frame->viewport_y1 = (int32_t)frame->height;
+    frame->viewport_width = (float)frame->width;
+    frame->viewport_height = (float)frame->height;
+
+    kr_buffer_t bound[KURO_GFX_SOFT_CONSTANT_MAX_CONSTANT_BUFFERS] = {};
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const _Soft_Command &command = commands->list[i];
+        switch (command.kind)
+        {
+            case _SOFT_COMMAND_SET_PIPELINE:
+                frame->pipeline = command.pipeline;
+                break;
+            case _SOFT_COMMAND_VIEWPORT:
+                frame->viewport_width = (float)command.width;
+                frame->viewport_height = (float)command.height;
+                frame->viewport_x1 = (int32_t)(command.width < frame->width ? command.width : frame->width);
+                frame->viewport_y1 = (int32_t)(command.height < frame->height ? command.height : frame->height);
+                break;
+            case _SOFT_COMMAND_CLEAR:
+                _kuro_gfx_execute_clear(frame, command);
+                break;
+            case _SOFT_COMMAND_BUFFER_WRITE:
+            {
+                kr_buffer_t buffer = command.buffer;
+                if (command.size_in_bytes < buffer->size_in_bytes)
+                {
+                    // partial write, keep the rest of the buffer
+                    uint8_t *data = (uint8_t *)_kuro_gfx_arena_push(commands->arena, buffer->size_in_bytes);
+                    memcpy(data, buffer->current, buffer->size_in_bytes);
+                    memcpy(data, command.data, command.size_in_bytes);
+                    buffer->current = data;
+                }
+                else
+                {
+                    buffer->current = (const uint8_t *)command.data;
+                }
+                break;
+            }
+            case _SOFT_COMMAND_BUFFER_BIND:
+                bound[command.slot] = command.buffer;
+                break;
+            case _SOFT_COMMAND_DRAW:
+                _kuro_gfx_execute_draw(frame, command.draw, bound);
+                break;
+            case _SOFT_COMMAND_DRAW_INDIRECT:
+                _kuro_gfx_execute_draw_indirect(frame, command, bound);
+                break;
+            case _SOFT_COMMAND_READBACK:
+                _kuro_gfx_execute_readback(frame, command);
+                break;
+        }
+    }
+}
+
+static void
+_kuro_gfx_apply_writes(kr_commands_t commands)
+{
+    for (const _Soft_Command &command : commands->list)
+    {
+        if (command.kind != _SOFT_COMMAND_BUFFER_WRITE)
+            continue;
+        kr_buffer_t buffer = command.buffer;
+        if (buffer->current != buffer->data)
+        {
+            memcpy(buffer->data, buffer->current, buffer->size_in_bytes);
+            buffer->current = buffer->data;
+        }
+    }
+}
+
+static void
+_kuro_gfx_execute(kr_gfx_t gfx, kr_commands_t commands)
+{
+    _Soft_Frame frame;
+    frame.gfx = gfx;
+    frame.color_count = 0;
+    frame.depth = nullptr;
+    frame.width = 0;
+    frame.height = 0;
+    frame.pitch = 0;
+
+    // every target has the size of the first one, the depth target may be larger
+    if (commands->swapchain)
+    {
+        frame.colors[frame.color_count++] = commands->swapchain->buffers[commands->swapchain->back_buffer];
+        frame.width = commands->swapchain->width;
+        frame.height = commands->swapchain->height;
+        frame.pitch = commands->swapchain->pitch;
+    }
+    for (uint32_t i = 0; i < commands->color_target_count; ++i)
+    {
+        kr_image_t target = commands->color_targets[i];
+        if (frame.color_count == 0)
+        {
+            frame.width = target->width;
+            frame.height = target->height;
+            frame.pitch = target->pitch;
+        }
+        assert(target->pitch == frame.pitch && target->height == frame.height);
+        frame.colors[frame.color_count++] = target->color;
+    }
+    if (commands->depth_target)
+    {
+        frame.depth = commands->depth_target->depth;
+        if (frame.color_count == 0)
+        {
+            frame.width = commands->depth_target->width;
+            frame.height = commands->depth_target->height;
+            frame.pitch = commands->depth_target->pitch;
+        }
+        assert(commands->depth_target->pitch == frame.pitch && commands->depth_target->height >= frame.height);
+    }
+
+    frame.tiles_x = _kuro_gfx_align(frame.width, TILE_SIZE) / TILE_SIZE;
+    frame.tiles_y = _kuro_gfx_align(frame.height, TILE_SIZE) / TILE_SIZE;
+    frame.order = 0;
+
+    gfx->draws.clear();
+    for (_Soft_Worker &worker : gfx->workers)
+    {
+        worker.triangles.clear();
+        worker.varyings.clear();
+        worker.bins.resize(frame.tiles_x * frame.tiles_y);
+        for (std::vector<uint32_t> &bin : worker.bins)
+            bin.clear();
+    }
+
+    if (commands->split)
+    {
+        _kuro_gfx_execute_list(&frame, commands, 0, commands->split_index);
+        for (uint32_t i = 0; i < commands->recorder_count; ++i)
+            _kuro_gfx_execute_list(&frame, commands->recorders[i], 0, commands->recorders[i]->list.size());
+        _kuro_gfx_execute_list(&frame, commands, commands->split_index, commands->list.size());
+    }
+    else
+    {
+        _kuro_gfx_execute_list(&frame, commands, 0, commands->list.size());
+    }
+
+    _kuro_gfx_flush(&frame);
+
+    // buffer writes outlive the command list
+    _kuro_gfx_apply_writes(commands);
+    for (uint32_t i = 0; commands->split && i < commands->recorder_count; ++i)
+        _kuro_gfx_apply_writes(commands->recorders[i]);
+}
+
+// == uploads ==========================================================================================
+
+static void
+_kuro_gfx_copy_main(kr_gfx_t gfx)
+{
+    std::unique_lock<std::mutex> lock(gfx->copy_mutex);
+    for (;;)
+    {
+        gfx->copy_start.wait(lock, [gfx] { return gfx->copy_quit || !gfx->copy_queue.empty(); });
+        if (gfx->copy_queue.empty())
+            return;
+
+        _Soft_Upload_Batch batch = std::move(gfx->copy_queue.front());
+        gfx->copy_queue.pop_front();
+        lock.unlock();
+
+        for (const _Soft_Upload &upload : batch.uploads)
+        {
+            const uint8_t *src = gfx->staging + upload.staging;
+            if (upload.buffer)
+            {
+                memcpy(upload.buffer->data + upload.offset, src, upload.size);
+                continue;
+            }
+            kr_image_t image = upload.image;
+            for (uint32_t y = 0; y < upload.size; ++y)
+                memcpy(image->color + (size_t)(upload.offset + y) * image->pitch, src + (size_t)y * image->width * sizeof(uint32_t), image->width * sizeof(uint32_t));
+        }
+
+        lock.lock();
+        gfx->upload_completed = batch.token;
+        kuro_gfx_ring_retire(&gfx->staging_ring, batch.token);
+        gfx->copy_done.notify_all();
+    }
+}
+
+// called with copy_mutex held
+static uint64_t
+_kuro_gfx_upload_submit(kr_gfx_t gfx)
+{
+    if (gfx->staged.empty())
+        return gfx->upload_submitted;
+
+    _Soft_Upload_Batch batch;
+    batch.token = ++gfx->upload_submitted;
+    batch.uploads.swap(gfx->staged);
+    kuro_gfx_ring_frame_end(&gfx->staging_ring, batch.token);
+    gfx->copy_queue.push_back(std::move(batch));
+    gfx->copy_start.notify_one();
+    return gfx->upload_submitted;
+}
+
+// returns the staging offset of size bytes, when the arena is full the staged uploads are submitted
+// and the oldest batch is waited for, called with copy_mutex held
+static uint64_t
+_kuro_gfx_staging_alloc(kr_gfx_t gfx, std::unique_lock<std::mutex> &lock, uint64_t size)
+{
+    uint64_t offset = 0;
+    while (!kuro_gfx_ring_alloc(&gfx->staging_ring, size, 16, &offset))
+    {
+        _kuro_gfx_upload_submit(gfx);
+        uint64_t token = kuro_gfx_ring_oldest_fence(&gfx->staging_ring);
+        assert(token && "upload chunk larger than the staging arena");
+        gfx->copy_done.wait(lock, [gfx, token] { return gfx->upload_completed >= token; });
+    }
+    return offset;
+}
+
+// == fences ===========================================================================================
+
+// runs the callbacks whose value completed one at a time, so a callback can add new ones
+static void
+_kuro_gfx_fence_dispatch(kr_fence_t fence)
+{
+    uint64_t value = fence->value.load(std::memory_order_acquire);
+    for (;;)
+    {
+        _Soft_Fence_Callback callback;
+        {
+            std::lock_guard<std::mutex> lock(fence->mutex);
+            if (fence->callbacks.empty() || fence->callbacks.front().value > value)
+                return;
+            callback = fence->callbacks.front();
+            fence->callbacks.erase(fence->callbacks.begin());
+        }
+        callback.callback(callback.user_data, callback.value);
+    }
+}
+
+static void
+_kuro_gfx_futex_wait(std::atomic<uint32_t> *word, uint32_t expected, const struct timespec *timeout)
+{
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+static void
+_kuro_gfx_futex_wake(std::atomic<uint32_t> *word)
+{
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static uint64_t
+_kuro_gfx_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// == gfx.h ============================================================================================
+
+// runs on the compile thread, the registered shaders may still change so they are only looked up
+// when the shader is handed out
+static void *
+_kuro_gfx_shader_compile(void *, Kuro_Gfx_Shader_Source source, size_t *code_size)
+{
+    *code_size = strlen(source.entry_point) + 1;
+    void *code = malloc(*code_size);
+    memcpy(code, source.entry_point, *code_size);
+    return code;
+}
+
+kr_gfx_t
+kuro_gfx_soft_create(uint32_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0)
+        thread_count = 1;
+    if (thread_count > MAX_WORKERS)
+        thread_count = MAX_WORKERS;
+
+    kr_gfx_t gfx = new _kr_gfx_t;
+    gfx->worker_count = thread_count;
+    gfx->job = nullptr;
+    gfx->job_ctx = nullptr;
+    gfx->job_generation = 0;
+    gfx->job_running = 0;
+    gfx->quit = false;
+    gfx->workers.resize(thread_count);
+
+    for (uint32_t i = 1; i < thread_count; ++i)
+        gfx->threads.emplace_back(_kuro_gfx_worker_main, gfx, i);
+
+    gfx->staging = (uint8_t *)malloc(STAGING_SIZE);
+    kuro_gfx_ring_init(&gfx->staging_ring, STAGING_SIZE);
+    gfx->upload_submitted = 0;
+    gfx->upload_completed = 0;
+    gfx->copy_quit = false;
+    gfx->copy_thread = std::thread(_kuro_gfx_copy_main, gfx);
+    gfx->pipeline_cache = nullptr;
+    gfx->compiler = kuro_gfx_compiler_create(_kuro_gfx_shader_compile, gfx, 1);
+
+    return gfx;
+}
+
+kr_gfx_t
+kuro_gfx_create()
+{
+    return kuro_gfx_soft_create(0);
+}
+
+void
+kuro_gfx_destroy(kr_gfx_t gfx)
+{
+    kuro_gfx_sync(gfx);
+    {
+        std::lock_guard<std::mutex> lock(gfx->mutex);
+        gfx->quit = true;
+    }
+    gfx->job_start.notify_all();
+    for (std::thread &thread : gfx->threads)
+        thread.join();
+    {
+        std::lock_guard<std::mutex> lock(gfx->copy_mutex);
+        gfx->copy_quit = true;
+    }
+    gfx->copy_start.notify_all();
+    gfx->copy_thread.join();
+    free(gfx->staging);
+    kuro_gfx_cache_close(gfx->pipeline_cache);
+    kuro_gfx_compiler_destroy(gfx->compiler);
+    delete gfx;
+}
+
+void
+kuro_gfx_soft_vertex_shader_register(kr_gfx_t gfx, const char *entry_point, Kuro_Gfx_Soft_Vertex_Shader shader, uint32_t varying_count)
+{
+    assert(varying_count <= KURO_GFX_SOFT_CONSTANT_MAX_VARYINGS);
+
+    for (_Soft_Shader_Entry &entry : gfx->vertex_shaders)
+    {
+        if (entry.entry_point == entry_point)
+        {
+            entry.shader = (void *)shader;
+            entry.varying_count = varying_count;
+            return;
+        }
+    }
+    gfx->vertex_shaders.push_back(_Soft_Shader_Entry{entry_point, (void *)shader, varying_count});
+}
+
+void
+kuro_gfx_soft_pixel_shader_register(kr_gfx_t gfx, const char *entry_point, Kuro_Gfx_Soft_Pixel_Shader shader)
+{
+    for (_Soft_Shader_Entry &entry : gfx->pixel_shaders)
+    {
+        if (entry.entry_point == entry_point)
+        {
+            entry.shader = (void *)shader;
+            return;
+        }
+    }
+    gfx->pixel_shaders.push_back(_Soft_Shader_Entry{entry_point, (void *)shader, 0});
+}
+
+kr_swapchain_t
+kuro_gfx_swapchain_create(kr_gfx_t gfx, uint32_t width, uint32_t height, void *)
+{
+    kr_swapchain_t swapchain = (kr_swapchain_t)malloc(sizeof(_kr_swapchain_t));
+    for (int i = 0; i < SWAPCHAIN_BUFFER_COUNT; ++i)
+        swapchain->buffers[i] = nullptr;
+    kuro_gfx_swapchain_resize(gfx, swapchain, width, height);
+    return swapchain;
+}
+
+void
+kuro_gfx_swapchain_destroy(kr_gfx_t gfx, kr_swapchain_t swapchain)
+{
+    kuro_gfx_sync(gfx);
+    for (int i = 0; i < SWAPCHAIN_BUFFER_COUNT; ++i)
+        free(swapchain->buffers[i]);
+    free(swapchain);
+}
+
+void
+kuro_gfx_swapchain_resize(kr_gfx_t gfx, kr_swapchain_t swapchain, uint32_t width, uint32_t height)
+{
+    kuro_gfx_sync(gfx);
+
+    swapchain->width = width;
+    swapchain->height = height;
+    swapchain->pitch = _kuro_gfx_align(width, TILE_SIZE);
+    swapchain->back_buffer = 0;
+
+    size_t size = (size_t)swapchain->pitch * _kuro_gfx_align(height, TILE_SIZE) * sizeof(uint32_t);
+    for (int i = 0; i < SWAPCHAIN_BUFFER_COUNT; ++i)
+    {
+        free(swapchain->buffers[i]);
+        swapchain->buffers[i] = (uint32_t *)calloc(1, size);
+    }
+}
+
+void
+kuro_gfx_soft_swapchain_read(kr_gfx_t gfx, kr_swapchain_t swapchain, uint32_t *pixels)
+{
+    kuro_gfx_sync(gfx);
+
+    uint32_t front = (swapchain->back_buffer + SWAPCHAIN_BUFFER_COUNT - 1) % SWAPCHAIN_BUFFER_COUNT;
+    for (uint32_t y = 0; y < swapchain->height; ++y)
+        memcpy(pixels + (size_t)y * swapchain->width, swapchain->buffers[front] + (size_t)y * swapchain->pitch, swapchain->width * sizeof(uint32_t));
+}
+
+kr_image_t
+kuro_gfx_image_create(kr_gfx_t, uint32_t width, uint32_t height)
+{
+    kr_image_t image = (kr_image_t)malloc(sizeof(_kr_image_t));
+    image->width = width;
+    image->height = height;
+    image->pitch = _kuro_gfx_align(width, TILE_SIZE);
+    image->placed = false;
+
+    image->color = nullptr;
+
+    size_t count = (size_t)image->pitch * _kuro_gfx_align(height, TILE_SIZE);
+    image->depth = (float *)malloc(count * sizeof(float));
+    for (size_t i = 0; i < count; ++i)
+        image->depth[i] = 1.0f;
+
+    return image;
+}
+
+kr_image_t
+kuro_gfx_render_target_create(kr_gfx_t, uint32_t width, uint32_t height)
+{
+    kr_image_t image = (kr_image_t)malloc(sizeof(_kr_image_t));
+    image->width = width;
+    image->height = height;
+    image->pitch = _kuro_gfx_align(width, TILE_SIZE);
+    image->depth = nullptr;
+    image->placed = false;
+
+    size_t count = (size_t)image->pitch * _kuro_gfx_align(height, TILE_SIZE);
+    image->color = (uint32_t *)calloc(count, sizeof(uint32_t));
+
+    return image;
+}
+
+void
+kuro_gfx_image_destroy(kr_gfx_t gfx, kr_image_t image)
+{
+    kuro_gfx_sync(gfx);
+    if (!image->placed)
+    {
+        free(image->color);
+        free(image->depth);
+    }
+    free(image);
+}
+
+kr_heap_t
+kuro_gfx_heap_create(kr_gfx_t, uint64_t size_in_bytes)
+{
+    kr_heap_t heap = (kr_heap_t)malloc(sizeof(_kr_heap_t));
+    heap->size_in_bytes = size_in_bytes;
+    heap->memory = (uint8_t *)malloc(size_in_bytes);
+    return heap;
+}
+
+void
+kuro_gfx_heap_destroy(kr_gfx_t gfx, kr_heap_t heap)
+{
+    kuro_gfx_sync(gfx);
+    free(heap->memory);
+    free(heap);
+}
+
+void
+kuro_gfx_image_memory(kr_gfx_t, uint32_t width, uint32_t height, bool, uint64_t *size_in_bytes, uint64_t *alignment)
+{
+    // color and depth texels are both 4 bytes
+    *size_in_bytes = (uint64_t)_kuro_gfx_align(width, TILE_SIZE) * _kuro_gfx_align(height, TILE_SIZE) * 4;
+    *alignment = HEAP_ALIGNMENT;
+}
+
+kr_image_t
+kuro_gfx_image_place(kr_gfx_t gfx, kr_heap_t heap, uint64_t offset, uint32_t width, uint32_t height, bool render_target)
+{
+    uint64_t size_in_bytes = 0, alignment = 0;
+    kuro_gfx_image_memory(gfx, width, height, render_target, &size_in_bytes, &alignment);
+    assert(offset % alignment == 0 && offset + size_in_bytes <= heap->size_in_bytes);
+
+    kr_image_t image = (kr_image_t)malloc(sizeof(_kr_image_t));
+    image->width = width;
+    image->height = height;
+    image->pitch = _kuro_gfx_align(width, TILE_SIZE);
+    image->color = render_target ? (uint32_t *)(heap->memory + offset) : nullptr;
+    image->depth = render_target ? nullptr : (float *)(heap->memory + offset);
+    image->placed = true;
+    return image;
+}
+
+void
+kuro_gfx_image_alias(kr_commands_t, kr_image_t, kr_image_t after)
+{
+    // the texels are plain memory, there is nothing to flush, only the content becomes undefined
+    assert(after->placed && "only placed images alias");
+    (void)after;
+}
+
+kr_readback_t
+kuro_gfx_readback_create(kr_gfx_t, uint32_t width, uint32_t height)
+{
+    kr_readback_t readback = (kr_readback_t)malloc(sizeof(_kr_readback_t));
+    readback->width = width;
+    readback->height = height;
+    readback->pixels = (uint32_t *)calloc((size_t)width * height, sizeof(uint32_t));
+    return readback;
+}
+
+void
+kuro_gfx_readback_destroy(kr_gfx_t gfx, kr_readback_t readback)
+{
+    kuro_gfx_sync(gfx);
+    free(readback->pixels);
+    free(readback);
+}
+
+bool
+kuro_gfx_readback_ready(kr_gfx_t, kr_readback_t)
+{
+    // the copy happens while kuro_gfx_commands_end executes the commands
+    return true;
+}
+
+const void *
+kuro_gfx_readback_map(kr_gfx_t, kr_readback_t readback, uint32_t *row_pitch)
+{
+    if (row_pitch)
+        *row_pitch = readback->width * sizeof(uint32_t);
+    return readback->pixels;
+}
+
+void
+kuro_gfx_readback_unmap(kr_gfx_t, kr_readback_t)
+{
+}
+
+void
+kuro_gfx_soft_image_read(kr_gfx_t gfx, kr_image_t image, float *depth)
+{
+    kuro_gfx_sync(gfx);
+
+    assert(image->depth && "only depth targets can be read with kuro_gfx_soft_image_read");
+    for (uint32_t y = 0; y < image->height; ++y)
+        memcpy(depth + (size_t)y * image->width, image->depth + (size_t)y * image->pitch, image->width * sizeof(float));
+}
+
+kr_buffer_t
+kuro_gfx_buffer_create(kr_gfx_t gfx, KURO_GFX_ACCESS cpu_access, void *data, uint32_t size_in_bytes)
+{
+    if (cpu_access == KURO_GFX_ACCESS_NONE)
+    {
+        assert(data);
+        return kuro_gfx_upload_buffer(gfx, data, size_in_bytes);
+    }
+
+    kr_buffer_t buffer = (kr_buffer_t)malloc(sizeof(_kr_buffer_t));
+    buffer->cpu_access = cpu_access;
+    buffer->size_in_bytes = size_in_bytes;
+    buffer->data = (uint8_t *)calloc(1, size_in_bytes);
+    buffer->current = buffer->data;
+
+    switch (buffer->cpu_access)
+    {
+        case KURO_GFX_ACCESS_WRITE:
+            if (data)
+                memcpy(buffer->data, data, size_in_bytes);
+            break;
+        default:
+            assert(false); break;
+    }
+
+    return buffer;
+}
+
+void
+kuro_gfx_buffer_destroy(kr_gfx_t gfx, kr_buffer_t buffer)
+{
+    kuro_gfx_sync(gfx);
+    free(buffer->data);
+    free(buffer);
+}
+
+kr_buffer_t
+kuro_gfx_upload_buffer(kr_gfx_t gfx, const void *data, uint32_t size_in_bytes)
+{
+    kr_buffer_t buffer = (kr_buffer_t)malloc(sizeof(_kr_buffer_t));
+    buffer->cpu_access = KURO_GFX_ACCESS_NONE;
+    buffer->size_in_bytes = size_in_bytes;
+    buffer->data = (uint8_t *)calloc(1, size_in_bytes);
+    buffer->current = buffer->data;
+
+    std::unique_lock<std::mutex> lock(gfx->copy_mutex);
+    for (uint32_t offset = 0; offset < size_in_bytes;)
+    {
+        uint32_t size = (uint32_t)std::min<uint64_t>(size_in_bytes - offset, STAGING_CHUNK);
+        uint64_t staging = _kuro_gfx_staging_alloc(gfx, lock, size);
+        memcpy(gfx->staging + staging, (const uint8_t *)data + offset, size);
+        gfx->staged.push_back({buffer, nullptr, offset, size, staging});
+        offset += size;
+    }
+
+    return buffer;
+}
+
+void
+kuro_gfx_upload_image(kr_gfx_t gfx, kr_image_t render_target, const void *pixels, uint32_t row_pitch)
+{
+    assert(render_target->color && "only render targets can be uploaded");
+
+    uint32_t row_size = render_target->width * sizeof(uint32_t);
+    uint32_t chunk_rows = std::max<uint32_t>(1, (uint32_t)(STAGING_CHUNK / row_size));
+
+    std::unique_lock<std::mutex> lock(gfx->copy_mutex);
+    for (uint32_t y = 0; y < render_target->height;)
+    {
+        uint32_t rows = std::min(render_target->height - y, chunk_rows);
+        uint64_t staging = _kuro_gfx_staging_alloc(gfx, lock, (uint64_t)rows * row_size);
+        for (uint32_t i = 0; i < rows; ++i)
+            memcpy(gfx->staging + staging + (size_t)i * row_size, (const uint8_t *)pixels + (size_t)(y + i) * row_pitch, row_size);
+        gfx->staged.push_back({nullptr, render_target, y, rows, staging});
+        y += rows;
+    }
+}
+
+uint64_t
+kuro_gfx_upload_submit(kr_gfx_t gfx)
+{
+    std::lock_guard<std::mutex> lock(gfx->copy_mutex);
+    return _kuro_gfx_upload_submit(gfx);
+}
+
+bool
+kuro_gfx_upload_complete(kr_gfx_t gfx, uint64_t token)
+{
+    std::lock_guard<std::mutex> lock(gfx->copy_mutex);
+    return gfx->upload_completed >= token;
+}
+
+void
+kuro_gfx_upload_wait(kr_gfx_t gfx, uint64_t token)
+{
+    std::unique_lock<std::mutex> lock(gfx->copy_mutex);
+    assert(token <= gfx->upload_submitted && "waiting on an upload that was never submitted");
+    gfx->copy_done.wait(lock, [gfx, token] { return gfx->upload_completed >= token; });
+}
+
+static inline kr_compile_t
+_kuro_gfx_shader_compile_submit(kr_gfx_t gfx, const char *shader, const char *entry_point, const char *profile)
+{
+    Kuro_Gfx_Shader_Source source = {};
+    source.source = shader;
+    source.source_size = shader ? strlen(shader) : 0;
+    source.entry_point = entry_point;
+    source.profile = profile;
+    return kuro_gfx_compile_submit(gfx->compiler, source);
+}
+
+kr_vshader_t
+kuro_gfx_vertex_shader_create(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return kuro_gfx_vertex_shader_get(gfx, kuro_gfx_vertex_shader_compile(gfx, shader, entry_point));
+}
+
+void
+kuro_gfx_vertex_shader_destroy(kr_gfx_t gfx, kr_vshader_t vertex_shader)
+{
+    kuro_gfx_sync(gfx);
+    free(vertex_shader);
+}
+
+kr_pshader_t
+kuro_gfx_pixel_shader_create(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return kuro_gfx_pixel_shader_get(gfx, kuro_gfx_pixel_shader_compile(gfx, shader, entry_point));
+}
+
+void
+kuro_gfx_pixel_shader_destroy(kr_gfx_t gfx, kr_pshader_t pixel_shader)
+{
+    kuro_gfx_sync(gfx);
+    free(pixel_shader);
+}
+
+kr_compile_t
+kuro_gfx_vertex_shader_compile(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return _kuro_gfx_shader_compile_submit(gfx, shader, entry_point, "vs");
+}
+
+kr_compile_t
+kuro_gfx_pixel_shader_compile(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return _kuro_gfx_shader_compile_submit(gfx, shader, entry_point, "ps");
+}
+
+bool
+kuro_gfx_shader_ready(kr_compile_t compile)
+{
+    return kuro_gfx_compile_ready(compile);
+}
+
+kr_vshader_t
+kuro_gfx_vertex_shader_get(kr_gfx_t gfx, kr_compile_t compile)
+{
+    const char *entry_point = (const char *)kuro_gfx_compile_wait(compile, nullptr);
+
+    kr_vshader_t vertex_shader = (kr_vshader_t)malloc(sizeof(_kr_vshader_t));
+    vertex_shader->shader = nullptr;
+    vertex_shader->varying_count = 0;
+    vertex_shader->code_hash = 0;
+
+    for (const _Soft_Shader_Entry &entry : gfx->vertex_shaders)
+    {
+        if (entry.entry_point == entry_point)
+        {
+            vertex_shader->shader = (Kuro_Gfx_Soft_Vertex_Shader)entry.shader;
+            vertex_shader->varying_count = entry.varying_count;
+            vertex_shader->code_hash = kuro_gfx_cache_hash(entry_point, strlen(entry_point), entry.varying_count);
+        }
+    }
+
+    if (vertex_shader->shader == nullptr)
+        fprintf(stderr, "vertex shader error: '%s' is not registered with kuro_gfx_soft_vertex_shader_register\n", entry_point);
+    assert(vertex_shader->shader);
+
+    kuro_gfx_compile_release(compile);
+    return vertex_shader;
+}
+
+kr_pshader_t
+kuro_gfx_pixel_shader_get(kr_gfx_t gfx, kr_compile_t compile)
+{
+    const char *entry_point = (const char *)kuro_gfx_compile_wait(compile, nullptr);
+
+    kr_pshader_t pixel_shader = (kr_pshader_t)malloc(sizeof(_kr_pshader_t));
+    pixel_shader->shader = nullptr;
+    pixel_shader->code_hash = 0;
+
+    for (const _Soft_Shader_Entry &entry : gfx->pixel_shaders)
+    {
+        if (entry.entry_point == entry_point)
+        {
+            pixel_shader->shader = (Kuro_Gfx_Soft_Pixel_Shader)entry.shader;
+            pixel_shader->code_hash = kuro_gfx_cache_hash(entry_point, strlen(entry_point), 0);
+        }
+    }
+
+    if (pixel_shader->shader == nullptr)
+        fprintf(stderr, "pixel shader error: '%s' is not registered with kuro_gfx_soft_pixel_shader_register\n", entry_point);
+    assert(pixel_shader->shader);
+
+    kuro_gfx_compile_release(compile);
+    return pixel_shader;
+}
+
+void
+kuro_gfx_shader_cache_open(kr_gfx_t gfx, const char *path)
+{
+    kuro_gfx_compiler_cache_open(gfx->compiler, path);
+}
+
+bool
+kuro_gfx_shader_cache_save(kr_gfx_t gfx)
+{
+    return kuro_gfx_compiler_cache_save(gfx->compiler);
+}
+
+kr_pipeline_t
+kuro_gfx_pipeline_create(kr_gfx_t gfx, Kuro_Gfx_Pipeline_Desc desc)
+{
+    assert(desc.vertex_shader);
+
+    // the cache key names the shaders by entry point so it holds across runs, the live key adds the
+    // registered functions since an entry point can be registered again with another one
+    uint64_t cache_key = kuro_gfx_pipeline_hash(desc,
+        &desc.vertex_shader->code_hash, sizeof(uint64_t),
+        desc.pixel_shader ? &desc.pixel_shader->code_hash : nullptr, desc.pixel_shader ? sizeof(uint64_t) : 0);
+    void *functions[2] = {(void *)desc.vertex_shader->shader, desc.pixel_shader ? (void *)desc.pixel_shader->shader : nullptr};
+    uint64_t key = kuro_gfx_cache_hash(functions, sizeof(functions), cache_key);
+
+    auto it = gfx->pipelines.find(key);
+    if (it != gfx->pipelines.end())
+    {
+        ++it->second->references;
+        return it->second;
+    }
+
+    kr_pipeline_t pipeline = (kr_pipeline_t)malloc(sizeof(_kr_pipeline_t));
+    pipeline->vertex_shader = desc.vertex_shader->shader;
+    pipeline->varying_count = desc.vertex_shader->varying_count;
+    pipeline->pixel_shader = desc.pixel_shader ? desc.pixel_shader->shader : nullptr;
+    pipeline->key = key;
+    pipeline->references = 1;
+    gfx->pipelines[key] = pipeline;
+
+    size_t cached_size = 0;
+    const void *cached = gfx->pipeline_cache ? kuro_gfx_cache_find(gfx->pipeline_cache, cache_key, &cached_size) : nullptr;
+    if (cached && cached_size == sizeof(pipeline->attributes) + sizeof(pipeline->attribute_count))
+    {
+        memcpy(pipeline->attributes, cached, sizeof(pipeline->attributes));
+        memcpy(&pipeline->attribute_count, (const uint8_t *)cached + sizeof(pipeline->attributes), sizeof(pipeline->attribute_count));
+        return pipeline;
+    }
+
+    // attributes are packed per slot in order, like D3D12_APPEND_ALIGNED_ELEMENT
+    uint32_t offsets[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
+    uint32_t float_count = 0;
+    memset(pipeline->attributes, 0, sizeof(pipeline->attributes));
+    pipeline->attribute_count = 0;
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+    {
+        const Kuro_Gfx_Vertex_Attribure &attribute = desc.vertex_attribures[i];
+        if (attribute.format == KURO_GFX_FORMAT_NONE)
+            break;
+        assert(attribute.slot < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES);
+
+        _Soft_Attribute &soft_attribute = pipeline->attributes[pipeline->attribute_count++];
+        soft_attribute.format = attribute.format;
+        soft_attribute.classification = attribute.classification;
+        soft_attribute.slot = attribute.slot;
+        soft_attribute.offset = offsets[attribute.slot];
+        offsets[attribute.slot] += _kuro_gfx_format_size(attribute.format);
+        float_count += _kuro_gfx_format_float_count(attribute.format);
+    }
+    assert(float_count <= KURO_GFX_SOFT_CONSTANT_MAX_ATTRIBUTE_FLOATS);
+
+    if (gfx->pipeline_cache)
+    {
+        uint8_t blob[sizeof(pipeline->attributes) + sizeof(pipeline->attribute_count)];
+        memcpy(blob, pipeline->attributes, sizeof(pipeline->attributes));
+        memcpy(blob + sizeof(pipeline->attributes), &pipeline->attribute_count, sizeof(pipeline->attribute_count));
+        kuro_gfx_cache_insert(gfx->pipeline_cache, cache_key, blob, sizeof(blob));
+    }
+
+    return pipeline;
+}
+
+void
+kuro_gfx_pipeline_destroy(kr_gfx_t gfx, kr_pipeline_t pipeline)
+{
+    assert(pipeline->references > 0);
+    if (--pipeline->references != 0)
+        return;
+
+    kuro_gfx_sync(gfx);
+    gfx->pipelines.erase(pipeline->key);
+    free(pipeline);
+}
+
+void
+kuro_gfx_pipeline_cache_open(kr_gfx_t gfx, const char *path)
+{
+    kuro_gfx_cache_close(gfx->pipeline_cache);
+    gfx->pipeline_cache = kuro_gfx_cache_open(path);
+}
+
+bool
+kuro_gfx_pipeline_cache_save(kr_gfx_t gfx)
+{
+    return gfx->pipeline_cache && kuro_gfx_cache_save(gfx->pipeline_cache);
+}
+
+kr_commands_t
+kuro_gfx_commands_create(kr_gfx_t)
+{
+    kr_commands_t commands = new _kr_commands_t;
+    commands->arena.current = 0;
+    commands->arena.used = 0;
+    commands->swapchain = nullptr;
+    commands->color_target_count = 0;
+    commands->depth_target = nullptr;
+    commands->recorder_count = 0;
+    commands->split_index = 0;
+    commands->split = false;
+    commands->recorder = false;
+    kuro_gfx_input_init(&commands->input);
+    return commands;
+}
+
+void
+kuro_gfx_commands_destroy(kr_gfx_t gfx, kr_commands_t commands)
+{
+    kuro_gfx_sync(gfx);
+    for (kr_commands_t recorder : commands->recorders)
+        kuro_gfx_commands_destroy(gfx, recorder);
+    _kuro_gfx_arena_free(commands->arena);
+    delete commands;
+}
+
+void
+kuro_gfx_commands_begin(kr_gfx_t gfx, kr_commands_t commands, kr_swapchain_t swapchain, kr_image_t depth_target)
+{
+    {
+        std::lock_guard<std::mutex> lock(gfx->fence_mutex);
+        for (kr_fence_t fence : gfx->fences)
+            _kuro_gfx_fence_dispatch(fence);
+    }
+
+    commands->swapchain = swapchain;
+    commands->color_target_count = 0;
+    commands->depth_target = depth_target;
+    commands->recorder_count = 0;
+    commands->split = false;
+    commands->list.clear();
+    _kuro_gfx_arena_reset(commands->arena);
+    kuro_gfx_input_reset(&commands->input);
+
+    if (swapchain)
+    {
+        _Soft_Command command = {};
+        command.kind = _SOFT_COMMAND_VIEWPORT;
+        command.width = swapchain->width;
+        command.height = swapchain->height;
+        commands->list.push_back(command);
+    }
+}
+
+void
+kuro_gfx_commands_begin_pass(kr_gfx_t gfx, kr_commands_t commands, Kuro_Gfx_Pass_Desc desc)
+{
+    kuro_gfx_commands_begin(gfx, commands, nullptr, desc.depth_target);
+
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_RENDER_TARGETS && desc.color_targets[i]; ++i)
+    {
+        assert(desc.color_targets[i]->color && "color targets are created with kuro_gfx_render_target_create");
+        commands->color_targets[commands->color_target_count++] = desc.color_targets[i];
+    }
+
+    kr_image_t first = commands->color_target_count ? commands->color_targets[0] : desc.depth_target;
+    if (first)
+    {
+        _Soft_Command command = {};
+        command.kind = _SOFT_COMMAND_VIEWPORT;
+        command.width = first->width;
+        command.height = first->height;
+        commands->list.push_back(command);
+    }
+}
+
+void
+kuro_gfx_commands_split(kr_gfx_t gfx, kr_commands_t commands, uint32_t recorder_count, kr_commands_t *recorders)
+{
+    assert(!commands->split && "the commands are already split");
+    assert(recorder_count <= KURO_CONSTANT_MAX_RECORDERS);
+
+    commands->split = true;
+    commands->split_index = commands->list.size();
+    commands->recorder_count = recorder_count;
+    kuro_gfx_input_reset(&commands->input);
+    while (commands->recorders.size() < recorder_count)
+        commands->recorders.push_back(kuro_gfx_commands_create(gfx));
+
+    for (uint32_t i = 0; i < recorder_count; ++i)
+    {
+        kr_commands_t recorder = commands->recorders[i];
+        recorder->recorder = true;
+        recorder->swapchain = commands->swapchain;
+        memcpy(recorder->color_targets, commands->color_targets, sizeof(commands->color_targets));
+        recorder->color_target_count = commands->color_target_count;
+        recorder->depth_target = commands->depth_target;
+        recorder->list.clear();
+        _kuro_gfx_arena_reset(recorder->arena);
+        kuro_gfx_input_reset(&recorder->input);
+        recorders[i] = recorder;
+    }
+}
+
+void
+kuro_gfx_commands_end(kr_gfx_t gfx, kr_commands_t commands)
+{
+    kuro_gfx_upload_wait(gfx, kuro_gfx_upload_submit(gfx));
+    _kuro_gfx_execute(gfx, commands);
+
+    if (commands->swapchain)
+        commands->swapchain->back_buffer = (commands->swapchain->back_buffer + 1) % SWAPCHAIN_BUFFER_COUNT;
+
+    commands->swapchain = nullptr;
+    commands->color_target_count = 0;
+    commands->depth_target = nullptr;
+    commands->recorder_count = 0;
+    commands->split = false;
+}
+
+bool
+kuro_gfx_commands_ready(kr_gfx_t, kr_commands_t)
+{
+    // the commands executed in kuro_gfx_commands_end
+    return true;
+}
+
+Kuro_Gfx_Input_Stats
+kuro_gfx_commands_input_stats(kr_commands_t commands)
+{
+    return commands->input.stats;
+}
+
+void
+kuro_gfx_set_pipeline(kr_commands_t commands, kr_pipeline_t pipeline)
+{
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_SET_PIPELINE;
+    command.pipeline = pipeline;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_viewport(kr_commands_t commands, uint32_t width, uint32_t height)
+{
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_VIEWPORT;
+    command.width = width;
+    command.height = height;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_clear(kr_commands_t commands, Kuro_Gfx_Color color, float depth)
+{
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_CLEAR;
+    command.color = color;
+    command.depth = depth;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_buffer_write(kr_commands_t commands, kr_buffer_t buffer, void *data, uint32_t size_in_bytes)
+{
+    assert(buffer->cpu_access == KURO_GFX_ACCESS_WRITE);
+    assert(size_in_bytes <= buffer->size_in_bytes);
+
+    // copied now so the caller can reuse data, applied in order when the commands execute
+    void *copy = _kuro_gfx_arena_push(commands->arena, size_in_bytes);
+    memcpy(copy, data, size_in_bytes);
+
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_BUFFER_WRITE;
+    command.buffer = buffer;
+    command.data = copy;
+    command.size_in_bytes = size_in_bytes;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_buffer_bind(kr_commands_t commands, kr_buffer_t buffer, uint32_t slot)
+{
+    assert(buffer->cpu_access == KURO_GFX_ACCESS_WRITE);
+    assert(slot < KURO_GFX_SOFT_CONSTANT_MAX_CONSTANT_BUFFERS);
+
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_BUFFER_BIND;
+    command.buffer = buffer;
+    command.slot = slot;
+    commands->list.push_back(command);
+}
+
+// buffers are identified by their handle, topology 0 is none
+static void
+_kuro_gfx_input_record(kr_commands_t commands, const Kuro_Gfx_Draw_Desc &desc)
+{
+    Kuro_Gfx_Input_View vertex_views[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
+    for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+    {
+        kr_buffer_t vertex_buffer = desc.vertex_buffers[i].buffer;
+        if (vertex_buffer == nullptr)
+            continue;
+        vertex_views[i].address = (uintptr_t)vertex_buffer;
+        vertex_views[i].size_in_bytes = vertex_buffer->size_in_bytes;
+        vertex_views[i].layout = desc.vertex_buffers[i].stride;
+    }
+
+    Kuro_Gfx_Input_View index_view = {};
+    if (desc.index_buffer.buffer)
+    {
+        index_view.address = (uintptr_t)desc.index_buffer.buffer;
+        index_view.size_in_bytes = desc.index_buffer.buffer->size_in_bytes;
+        index_view.layout = desc.index_buffer.format;
+    }
+
+    Kuro_Gfx_Input_Changes changes;
+    kuro_gfx_input_draw(&commands->input, desc.primitive + 1, vertex_views, &index_view, &changes);
+}
+
+void
+kuro_gfx_draw(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc)
+{
+    _kuro_gfx_input_record(commands, desc);
+
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_DRAW;
+    command.draw = desc;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_draw_indirect(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc, kr_buffer_t arguments, uint32_t offset, uint32_t draw_count)
+{
+    assert(offset % sizeof(uint32_t) == 0);
+    _kuro_gfx_input_record(commands, desc);
+
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_DRAW_INDIRECT;
+    command.draw = desc;
+    command.buffer = arguments;
+    command.offset = offset;
+    command.draw_count = draw_count;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_readback(kr_commands_t commands, kr_image_t render_target, kr_readback_t readback)
+{
+    assert(render_target->color && "only render targets can be read back");
+    assert(!commands->recorder && "recorders do not transition resources, read back before or after the split");
+
+    _Soft_Command command = {};
+    command.kind = _SOFT_COMMAND_READBACK;
+    command.image = render_target;
+    command.readback = readback;
+    commands->list.push_back(command);
+}
+
+void
+kuro_gfx_sync(kr_gfx_t gfx)
+{
+    // commands execute in kuro_gfx_commands_end, only uploads can be in flight
+    kuro_gfx_upload_wait(gfx, kuro_gfx_upload_submit(gfx));
+}
+
+kr_fence_t
+kuro_gfx_fence_create(kr_gfx_t gfx)
+{
+    kr_fence_t fence = new _kr_fence_t;
+    fence->value.store(0);
+    fence->sequence.store(0);
+
+    std::lock_guard<std::mutex> lock(gfx->fence_mutex);
+    gfx->fences.push_back(fence);
+    return fence;
+}
+
+void
+kuro_gfx_fence_destroy(kr_gfx_t gfx, kr_fence_t fence)
+{
+    {
+        std::lock_guard<std::mutex> lock(gfx->fence_mutex);
+        gfx->fences.erase(std::find(gfx->fences.begin(), gfx->fences.end(), fence));
+    }
+    delete fence;
+}
+
+void
+kuro_gfx_fence_signal(kr_gfx_t, kr_fence_t fence, uint64_t value)
+{
+    // everything submitted already executed, so the value completes right away
+    assert(value >= fence->value.load() && "fence values have to increase");
+    fence->value.store(value, std::memory_order_release);
+    fence->sequence.fetch_add(1, std::memory_order_release);
+    _kuro_gfx_futex_wake(&fence->sequence);
+}
+
+uint64_t
+kuro_gfx_fence_value(kr_gfx_t, kr_fence_t fence)
+{
+    return fence->value.load(std::memory_order_acquire);
+}
+
+bool
+kuro_gfx_fence_complete(kr_gfx_t, kr_fence_t fence, uint64_t value)
+{
+    if (fence->value.load(std::memory_order_acquire) < value)
+        return false;
+    _kuro_gfx_fence_dispatch(fence);
+    return true;
+}
+
+bool
+kuro_gfx_fence_wait(kr_gfx_t gfx, kr_fence_t fence, uint64_t value, uint64_t timeout_ns)
+{
+    // a deadline past what fits is as good as none
+    uint64_t start = _kuro_gfx_now_ns();
+    uint64_t deadline = timeout_ns >= UINT64_MAX - start ? UINT64_MAX : start + timeout_ns;
+    for (;;)
+    {
+        // read the sequence first, a signal after the value check changes it and wakes the futex
+        uint32_t sequence = fence->sequence.load(std::memory_order_acquire);
+        if (kuro_gfx_fence_complete(gfx, fence, value))
+            return true;
+
+        if (deadline == UINT64_MAX)
+        {
+            _kuro_gfx_futex_wait(&fence->sequence, sequence, nullptr);
+            continue;
+        }
+
+        uint64_t now = _kuro_gfx_now_ns();
+        if (now >= deadline)
+            return false;
+        struct timespec remaining;
+        remaining.tv_sec = (time_t)((deadline - now) / 1000000000ull);
+        remaining.tv_nsec = (long)((deadline - now) % 1000000000ull);
+        _kuro_gfx_futex_wait(&fence->sequence, sequence, &remaining);
+    }
+}
+
+void
+kuro_gfx_fence_callback(kr_gfx_t, kr_fence_t fence, uint64_t value, Kuro_Gfx_Fence_Callback callback, void *user_data)
+{
+    {
+        std::lock_guard<std::mutex> lock(fence->mutex);
+        auto position = std::upper_bound(
+            fence->callbacks.begin(), fence->callbacks.end(), value,
+            [](uint64_t v, const _Soft_Fence_Callback &c) { return v < c.value; });
+        fence->callbacks.insert(position, {value, callback, user_data});
+    }
+    _kuro_gfx_fence_dispatch(fence);
+}
@@ -1,5 +1,7 @@
-#include "kuro_os.h"
+#include "kuro/kuro_os.h"
 
+#include <errno.h>
+#include <stdint.h>
 #include <time.h>
 
 namespace kuro
@@ -11,4 +13,20 @@ namespace kuro
         clock_gettime(CLOCK_MONOTONIC, &now);
         return now.tv_sec + now.tv_nsec / 1000000000.0;
     }
-}
\ No newline at end of file
+
+    void
+    os_sleep(double seconds)
+    {
+        // also catches NaN, and keeps the conversion to time_t in range
+        if (!(seconds > 0.0))
+            return;
+        if (seconds > (double)INT32_MAX)
+            seconds = (double)INT32_MAX;
+
+        struct timespec duration;
+        duration.tv_sec = (time_t)seconds;
+        duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1000000000.0);
+        // only a signal resumes the sleep with what is left, any other error gives up
+        while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {}
+    }
+}
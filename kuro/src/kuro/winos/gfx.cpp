@@ -9,15 +9,61 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include "kuro/gfx.h"
+#include "kuro/gfx_cache.h"
+#include "kuro/gfx_compiler.h"
+#include "kuro/gfx_descriptor.h"
+#include "kuro/gfx_input.h"
+#include "kuro/gfx_ring.h"
+#include "kuro/gfx_state.h"
 
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
 #include <assert.h>
+#include <stdlib.h>
 
 static const int MAX_SWAPCHAIN_BUFFER_COUNT = 3;
+// read states combine in the state tracker, every write state stands alone
+static const uint32_t STATE_READ_MASK = D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_DEPTH_READ;
+// barriers handed to one ResourceBarrier call, larger batches take a few calls
+static const uint32_t MAX_BATCHED_BARRIERS = 32;
 static const int SYNC = 3;
 static const int MAX_CBV_HEAP_DESC_NUM = 1024;
+static const int MAX_RTV_HEAP_DESC_NUM = 256;
+static const int MAX_DSV_HEAP_DESC_NUM = 64;
+static const int MAX_PENDING_READBACKS = 16;
+static const int MAX_CONSTANT_BUFFERS = KURO_CONSTANT_MAX_CONSTANT_BUFFERS;
+static const uint64_t UPLOAD_RING_SIZE = 16 * 1024 * 1024;
+// uploads larger than a chunk are split, so the staging arena keeps a few batches in flight
+static const uint64_t STAGING_SIZE = 32 * 1024 * 1024;
+static const uint64_t STAGING_CHUNK = STAGING_SIZE / 4;
+static const int UPLOAD_BATCHES = 4;
+static const int MAX_POOLED_EVENTS = 16;
+
+// buffers are copied on the copy queue, render targets can not be used there so their copies run on
+// the graphics queue and the copy queue waits for them before it signals the token of the batch
+typedef struct _Upload_Batch {
+    ID3D12CommandAllocator *allocator;
+    ID3D12GraphicsCommandList *command_list;
+    ID3D12CommandAllocator *image_allocator;
+    ID3D12GraphicsCommandList *image_command_list;
+    uint32_t image_copy_count;
+    uint64_t token;
+} _Upload_Batch;
+
+// an event whose wait timed out stays registered with the fence, it is parked until the fence
+// reaches the value so that it can not wake a later wait
+typedef struct _Parked_Event {
+    HANDLE event;
+    ID3D12Fence *fence;
+    uint64_t value;
+} _Parked_Event;
+
+typedef struct _Fence_Callback {
+    uint64_t value;
+    Kuro_Gfx_Fence_Callback callback;
+    void *user_data;
+} _Fence_Callback;
 
 typedef struct _kr_gfx_t {
     IDXGIFactory4 *factory;
@@ -28,12 +74,70 @@ typedef struct _kr_gfx_t {
     uint32_t cbv_descriptor_size;
     ID3D12Fence *fence;
     uint64_t current_fence;
-    ID3D12GraphicsCommandList *command_list;
-    ID3D12CommandAllocator *command_allocator;
     ID3D12DescriptorHeap *cbv_heap;
-    int next_free_cbv_index;
+    // every swapchain, depth target and render target takes its views from these two heaps, a freed
+    // slot is reused once the fence current at the time of the free completed
+    ID3D12DescriptorHeap *rtv_heap;
+    ID3D12DescriptorHeap *dsv_heap;
+    Kuro_Gfx_Descriptor_Allocator rtv_descriptors;
+    Kuro_Gfx_Descriptor_Allocator dsv_descriptors;
+    // constant buffer writes are suballocated from one persistently mapped upload buffer, a block
+    // belongs to the fence of the list that wrote it. upload_lists are the lists with blocks that
+    // kuro_gfx_commands_end has not tagged yet, in the order of their first block
+    ID3D12Resource *upload_buffer;
+    uint8_t *upload_data;
+    D3D12_GPU_VIRTUAL_ADDRESS upload_address;
+    Kuro_Gfx_Ring upload_ring;
+    SRWLOCK upload_lock;
+    kr_commands_t upload_lists;
+    // resource uploads are staged in their own arena and recorded into the open batch, the staging
+    // blocks of a batch are retired once the copy fence reaches its token
+    ID3D12CommandQueue *copy_queue;
+    ID3D12Fence *copy_fence;
+    ID3D12Fence *image_copy_fence;
+    ID3D12Resource *staging_buffer;
+    uint8_t *staging_data;
+    Kuro_Gfx_Ring staging_ring;
+    _Upload_Batch upload_batches[UPLOAD_BATCHES];
+    uint32_t upload_batch;
+    bool upload_open;
+    uint64_t upload_submitted;
+    // image copies transition their target through the same states as the lists, flushed per copy
+    Kuro_Gfx_State_Tracker upload_states;
+    SRWLOCK staging_lock;
+    // every CPU wait takes its event from the pool instead of creating one
+    HANDLE events[MAX_POOLED_EVENTS];
+    uint32_t event_count;
+    _Parked_Event *parked_events;
+    uint32_t parked_event_count;
+    uint32_t parked_event_capacity;
+    SRWLOCK event_lock;
+    // kuro_gfx_commands_begin runs the callbacks of every fence
+    struct _kr_fence_t *fences;
+    SRWLOCK fence_lock;
+    // live pipelines are shared by key, there are few enough of them to search a list, the cache
+    // holds the driver blobs of compiled pipelines by the same key
+    struct _kr_pipeline_t *pipelines;
+    kr_cache_t pipeline_cache;
+    // D3DCompile runs on the compile threads, compiled code is cached by source and entry point
+    kr_compiler_t compiler;
+    // kuro_gfx_draw_indirect reads Kuro_Gfx_Draw_Arguments or Kuro_Gfx_Draw_Indexed_Arguments records,
+    // neither changes root arguments so they work with every root signature
+    ID3D12CommandSignature *draw_signature;
+    ID3D12CommandSignature *draw_indexed_signature;
 } _kr_gfx_t;
 
+// callbacks are sorted by value, callbacks with the same value keep their order
+typedef struct _kr_fence_t {
+    ID3D12Fence *fence;
+    _Fence_Callback *callbacks;
+    uint32_t callback_count;
+    uint32_t callback_capacity;
+    SRWLOCK lock;
+    struct _kr_fence_t *prev;
+    struct _kr_fence_t *next;
+} _kr_fence_t;
+
 typedef struct _kr_swapchain_t {
     DXGI_FORMAT backbuffer_format;
     uint32_t buffer_count;
@@ -41,25 +145,50 @@ typedef struct _kr_swapchain_t {
     uint32_t msaa_x4_quality;
     IDXGISwapChain3 *swapchain;
     ID3D12Resource *buffers[MAX_SWAPCHAIN_BUFFER_COUNT];
-    ID3D12DescriptorHeap *rtv_heap;
+    Kuro_Gfx_State_Resource buffer_states[MAX_SWAPCHAIN_BUFFER_COUNT];
+    uint32_t rtv_index;
     D3D12_CPU_DESCRIPTOR_HANDLE rtv_descriptor[MAX_SWAPCHAIN_BUFFER_COUNT];
 } _kr_swapchain_t;
 
+typedef struct _kr_heap_t {
+    ID3D12Heap *heap;
+    uint64_t size_in_bytes;
+} _kr_heap_t;
+
+// depth targets use the depth_stencil fields, render targets the render_target fields
 typedef struct _kr_image_t {
+    uint32_t width;
+    uint32_t height;
     DXGI_FORMAT depth_stencil_format;
     bool msaa_state;
     uint32_t msaa_x4_quality;
     ID3D12Resource *depth_stencil_buffer;
-    ID3D12DescriptorHeap *dsv_heap;
+    uint32_t dsv_index;
     D3D12_CPU_DESCRIPTOR_HANDLE dsv_descriptor;
-    bool transition;
+    // of whichever of depth_stencil_buffer and render_target the image has
+    Kuro_Gfx_State_Resource state;
+    DXGI_FORMAT render_target_format;
+    ID3D12Resource *render_target;
+    uint32_t rtv_index;
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv_descriptor;
 } _kr_image_t;
 
+typedef struct _kr_readback_t {
+    ID3D12Resource *buffer;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    uint64_t size_in_bytes;
+    uint64_t fence;
+} _kr_readback_t;
+
+// static buffers own a default heap resource that stays in the common state, the copy queue and the
+// graphics queue promote it implicitly, writable ones a CPU copy of their content and the
+// address of the upload block it was last written to
 typedef struct _kr_buffer_t {
     KURO_GFX_ACCESS cpu_access;
-    ID3D12Resource *buffer[SYNC];
+    ID3D12Resource *buffer;
     uint32_t size_in_bytes;
-    D3D12_GPU_DESCRIPTOR_HANDLE cbv[SYNC];
+    uint8_t *shadow;
+    D3D12_GPU_VIRTUAL_ADDRESS address;
 } _kr_buffer_t;
 
 typedef struct _kr_vshader_t {
@@ -73,15 +202,43 @@ typedef struct _kr_pshader_t {
 typedef struct _kr_pipeline_t {
     ID3D12PipelineState *pipeline_state;
     ID3D12RootSignature *root_signature;
+    uint64_t key;
+    uint32_t references;
+    struct _kr_pipeline_t *prev;
+    struct _kr_pipeline_t *next;
 } _kr_pipeline_t;
 
 typedef struct _kr_commands_t {
+    kr_gfx_t gfx;
     ID3D12CommandAllocator *command_allocator[SYNC];
     ID3D12GraphicsCommandList *command_list;
     uint64_t fence[SYNC];
     int current_resource_index;
     kr_swapchain_t swapchain;
+    kr_image_t color_targets[KURO_CONSTANT_MAX_RENDER_TARGETS];
+    uint32_t color_target_count;
     kr_image_t depth_target;
+    kr_buffer_t bound[MAX_CONSTANT_BUFFERS];
+    kr_readback_t readbacks[MAX_PENDING_READBACKS];
+    uint32_t readback_count;
+    // transitions wait here for the next draw, copy or the end of the list. resource states are
+    // shared and barriers land in recording order, so recorders never request any
+    Kuro_Gfx_State_Tracker states;
+    // what the input assembler of command_list has bound, reset with the list
+    Kuro_Gfx_Input_Cache input;
+    // after kuro_gfx_commands_split command_list records what comes after the split and split_list
+    // holds what came before it, they are swapped back in kuro_gfx_commands_end
+    ID3D12CommandAllocator *split_allocator[SYNC];
+    ID3D12GraphicsCommandList *split_list;
+    kr_commands_t recorders[KURO_CONSTANT_MAX_RECORDERS];
+    uint32_t recorder_capacity;
+    uint32_t recorder_count;
+    bool split;
+    // the ring position of the first upload block since the last end, UINT64_MAX when there is none,
+    // recorders upload on behalf of the list they were split from
+    uint64_t upload_start;
+    kr_commands_t upload_next;
+    kr_commands_t parent;
 } _kr_commands_t;
 
 static inline DXGI_FORMAT
@@ -102,6 +259,268 @@ _kuro_gfx_format_to_dx(KURO_GFX_FORMAT format)
     }
 }
 
+static inline D3D12_CPU_DESCRIPTOR_HANDLE
+_kuro_gfx_descriptor_handle(ID3D12DescriptorHeap *heap, uint32_t descriptor_size, uint32_t index)
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = heap->GetCPUDescriptorHandleForHeapStart();
+    handle.ptr += (SIZE_T)index * descriptor_size;
+    return handle;
+}
+
+static inline HANDLE
+_kuro_gfx_event_acquire(kr_gfx_t gfx)
+{
+    HANDLE event_handle = nullptr;
+
+    AcquireSRWLockExclusive(&gfx->event_lock);
+    for (uint32_t i = 0; i < gfx->parked_event_count;)
+    {
+        _Parked_Event *parked = &gfx->parked_events[i];
+        if (parked->fence->GetCompletedValue() < parked->value)
+        {
+            ++i;
+            continue;
+        }
+
+        // consume the completion so the event is unset again
+        WaitForSingleObject(parked->event, INFINITE);
+        parked->fence->Release();
+        if (gfx->event_count < MAX_POOLED_EVENTS)
+            gfx->events[gfx->event_count++] = parked->event;
+        else
+            CloseHandle(parked->event);
+        *parked = gfx->parked_events[--gfx->parked_event_count];
+    }
+    if (gfx->event_count)
+        event_handle = gfx->events[--gfx->event_count];
+    ReleaseSRWLockExclusive(&gfx->event_lock);
+
+    if (event_handle == nullptr)
+        event_handle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+    return event_handle;
+}
+
+static inline void
+_kuro_gfx_event_release(kr_gfx_t gfx, HANDLE event_handle)
+{
+    AcquireSRWLockExclusive(&gfx->event_lock);
+    if (gfx->event_count < MAX_POOLED_EVENTS)
+    {
+        gfx->events[gfx->event_count++] = event_handle;
+        event_handle = nullptr;
+    }
+    ReleaseSRWLockExclusive(&gfx->event_lock);
+
+    if (event_handle)
+        CloseHandle(event_handle);
+}
+
+// returns whether the fence reached value within timeout_ms, INFINITE waits for it
+static inline bool
+_kuro_gfx_fence_wait(kr_gfx_t gfx, ID3D12Fence *fence, uint64_t value, DWORD timeout_ms)
+{
+    if (fence->GetCompletedValue() >= value)
+        return true;
+    if (timeout_ms == 0)
+        return false;
+
+    HANDLE event_handle = _kuro_gfx_event_acquire(gfx);
+    HRESULT hr = fence->SetEventOnCompletion(value, event_handle);
+    assert(SUCCEEDED(hr));
+    if (WaitForSingleObject(event_handle, timeout_ms) == WAIT_OBJECT_0)
+    {
+        _kuro_gfx_event_release(gfx, event_handle);
+        return true;
+    }
+
+    AcquireSRWLockExclusive(&gfx->event_lock);
+    if (gfx->parked_event_count == gfx->parked_event_capacity)
+    {
+        gfx->parked_event_capacity = gfx->parked_event_capacity ? gfx->parked_event_capacity * 2 : MAX_POOLED_EVENTS;
+        gfx->parked_events = (_Parked_Event *)realloc(gfx->parked_events, gfx->parked_event_capacity * sizeof(_Parked_Event));
+    }
+    fence->AddRef();
+    gfx->parked_events[gfx->parked_event_count++] = {event_handle, fence, value};
+    ReleaseSRWLockExclusive(&gfx->event_lock);
+
+    return fence->GetCompletedValue() >= value;
+}
+
+// runs the callbacks whose value completed one at a time, so a callback can add new ones
+static inline void
+_kuro_gfx_fence_dispatch(kr_fence_t fence)
+{
+    uint64_t value = fence->fence->GetCompletedValue();
+    for (;;)
+    {
+        AcquireSRWLockExclusive(&fence->lock);
+        if (fence->callback_count == 0 || fence->callbacks[0].value > value)
+        {
+            ReleaseSRWLockExclusive(&fence->lock);
+            return;
+        }
+        _Fence_Callback callback = fence->callbacks[0];
+        memmove(fence->callbacks, fence->callbacks + 1, --fence->callback_count * sizeof(_Fence_Callback));
+        ReleaseSRWLockExclusive(&fence->lock);
+
+        callback.callback(callback.user_data, callback.value);
+    }
+}
+
+// copies data into a constant block of the upload ring for commands, waits for the oldest frame in
+// flight when the ring is full
+static inline D3D12_GPU_VIRTUAL_ADDRESS
+_kuro_gfx_upload(kr_commands_t commands, const void *data, uint32_t size_in_bytes)
+{
+    kr_gfx_t gfx = commands->gfx;
+    kr_commands_t owner = commands->parent ? commands->parent : commands;
+    uint64_t offset = 0;
+
+    AcquireSRWLockExclusive(&gfx->upload_lock);
+    while (!kuro_gfx_ring_alloc(&gfx->upload_ring, size_in_bytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, &offset))
+    {
+        // with nothing in flight the ring only holds blocks of lists that are still recording, waiting
+        // would never free anything and the block has nowhere to go
+        uint64_t fence = kuro_gfx_ring_oldest_fence(&gfx->upload_ring);
+        if (fence == 0)
+        {
+            OutputDebugStringA("kuro_gfx: the constants of the lists being recorded do not fit in the upload ring\n");
+            abort();
+        }
+        _kuro_gfx_fence_wait(gfx, gfx->fence, fence, INFINITE);
+        kuro_gfx_ring_retire(&gfx->upload_ring, gfx->fence->GetCompletedValue());
+    }
+    if (owner->upload_start == UINT64_MAX)
+    {
+        owner->upload_start = gfx->upload_ring.head - size_in_bytes;
+        kr_commands_t *link = &gfx->upload_lists;
+        while (*link)
+            link = &(*link)->upload_next;
+        *link = owner;
+        owner->upload_next = nullptr;
+    }
+    ReleaseSRWLockExclusive(&gfx->upload_lock);
+
+    memcpy(gfx->upload_data + offset, data, size_in_bytes);
+    return gfx->upload_address + offset;
+}
+
+// takes commands out of upload_lists, the caller holds upload_lock
+static inline void
+_kuro_gfx_upload_unlink(kr_gfx_t gfx, kr_commands_t commands)
+{
+    if (commands->upload_start == UINT64_MAX)
+        return;
+
+    kr_commands_t *link = &gfx->upload_lists;
+    while (*link != commands)
+        link = &(*link)->upload_next;
+    *link = commands->upload_next;
+    commands->upload_start = UINT64_MAX;
+    commands->upload_next = nullptr;
+}
+
+// records what the tracker batched up since the last flush, in as few ResourceBarrier calls as fit
+static inline void
+_kuro_gfx_barriers_flush(ID3D12GraphicsCommandList *command_list, Kuro_Gfx_State_Tracker *tracker)
+{
+    uint32_t count = 0;
+    const Kuro_Gfx_State_Barrier *pending = kuro_gfx_state_flush(tracker, &count);
+
+    D3D12_RESOURCE_BARRIER resource_barriers[MAX_BATCHED_BARRIERS];
+    for (uint32_t first = 0; first < count; first += MAX_BATCHED_BARRIERS)
+    {
+        uint32_t batch_count = count - first < MAX_BATCHED_BARRIERS ? count - first : MAX_BATCHED_BARRIERS;
+        for (uint32_t i = 0; i < batch_count; ++i)
+        {
+            const Kuro_Gfx_State_Barrier &barrier = pending[first + i];
+            resource_barriers[i] = {};
+            resource_barriers[i].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            resource_barriers[i].Transition.pResource = (ID3D12Resource *)barrier.resource->handle;
+            resource_barriers[i].Transition.Subresource = barrier.subresource;
+            resource_barriers[i].Transition.StateBefore = (D3D12_RESOURCE_STATES)barrier.before;
+            resource_barriers[i].Transition.StateAfter = (D3D12_RESOURCE_STATES)barrier.after;
+        }
+        command_list->ResourceBarrier(batch_count, resource_barriers);
+    }
+}
+
+// closes and submits the open batch, called with staging_lock held
+static inline uint64_t
+_kuro_gfx_upload_submit(kr_gfx_t gfx)
+{
+    if (!gfx->upload_open)
+        return gfx->upload_submitted;
+
+    HRESULT hr = {};
+    _Upload_Batch *batch = &gfx->upload_batches[gfx->upload_batch];
+    batch->token = ++gfx->upload_submitted;
+
+    hr = batch->image_command_list->Close();
+    assert(SUCCEEDED(hr));
+    hr = batch->command_list->Close();
+    assert(SUCCEEDED(hr));
+
+    if (batch->image_copy_count)
+    {
+        ID3D12CommandList *image_lists[] = { batch->image_command_list };
+        gfx->command_queue->ExecuteCommandLists(1, image_lists);
+        gfx->command_queue->Signal(gfx->image_copy_fence, batch->token);
+        gfx->copy_queue->Wait(gfx->image_copy_fence, batch->token);
+    }
+    ID3D12CommandList *cmd_lists[] = { batch->command_list };
+    gfx->copy_queue->ExecuteCommandLists(1, cmd_lists);
+    gfx->copy_queue->Signal(gfx->copy_fence, batch->token);
+
+    kuro_gfx_ring_frame_end(&gfx->staging_ring, batch->token);
+    gfx->upload_batch = (gfx->upload_batch + 1) % UPLOAD_BATCHES;
+    gfx->upload_open = false;
+    return batch->token;
+}
+
+// the lists of a batch are reused once the batch that recorded them last completed, called with
+// staging_lock held
+static inline _Upload_Batch *
+_kuro_gfx_upload_batch(kr_gfx_t gfx)
+{
+    _Upload_Batch *batch = &gfx->upload_batches[gfx->upload_batch];
+    if (gfx->upload_open)
+        return batch;
+
+    HRESULT hr = {};
+    _kuro_gfx_fence_wait(gfx, gfx->copy_fence, batch->token, INFINITE);
+    hr = batch->allocator->Reset();
+    assert(SUCCEEDED(hr));
+    hr = batch->command_list->Reset(batch->allocator, nullptr);
+    assert(SUCCEEDED(hr));
+    hr = batch->image_allocator->Reset();
+    assert(SUCCEEDED(hr));
+    hr = batch->image_command_list->Reset(batch->image_allocator, nullptr);
+    assert(SUCCEEDED(hr));
+    batch->image_copy_count = 0;
+
+    gfx->upload_open = true;
+    return batch;
+}
+
+// returns the staging offset of size bytes, when the arena is full the open batch is submitted and
+// the oldest batch is waited for, called with staging_lock held
+static inline uint64_t
+_kuro_gfx_staging_alloc(kr_gfx_t gfx, uint64_t size, uint64_t alignment)
+{
+    uint64_t offset = 0;
+    kuro_gfx_ring_retire(&gfx->staging_ring, gfx->copy_fence->GetCompletedValue());
+    while (!kuro_gfx_ring_alloc(&gfx->staging_ring, size, alignment, &offset))
+    {
+        _kuro_gfx_upload_submit(gfx);
+        uint64_t token = kuro_gfx_ring_oldest_fence(&gfx->staging_ring);
+        assert(token && "upload chunk larger than the staging arena");
+        _kuro_gfx_fence_wait(gfx, gfx->copy_fence, token, INFINITE);
+        kuro_gfx_ring_retire(&gfx->staging_ring, gfx->copy_fence->GetCompletedValue());
+    }
+    return offset;
+}
+
 static inline D3D12_INPUT_CLASSIFICATION
 _kuro_gfx_class_to_dx(KURO_GFX_CLASS classification)
 {
@@ -116,6 +535,30 @@ _kuro_gfx_class_to_dx(KURO_GFX_CLASS classification)
     }
 }
 
+// runs on the compile threads, D3DCompile is thread safe
+static void *
+_kuro_gfx_shader_compile(void *, Kuro_Gfx_Shader_Source source, size_t *code_size)
+{
+    ID3DBlob *code_blob = nullptr;
+    ID3DBlob *error_blob = nullptr;
+    HRESULT hr = D3DCompile(source.source, source.source_size, nullptr, nullptr, nullptr, source.entry_point, source.profile, source.flags, 0, &code_blob, &error_blob);
+    if (error_blob)
+    {
+        OutputDebugStringA(source.profile[0] == 'v' ? "vertex shader error: " : "pixel shader error: ");
+        OutputDebugStringA((char *)error_blob->GetBufferPointer());
+        OutputDebugStringA("\n");
+        error_blob->Release();
+    }
+    if (FAILED(hr))
+        return nullptr;
+
+    *code_size = code_blob->GetBufferSize();
+    void *code = malloc(*code_size);
+    memcpy(code, code_blob->GetBufferPointer(), *code_size);
+    code_blob->Release();
+    return code;
+}
+
 kr_gfx_t
 kuro_gfx_create()
 {
@@ -182,27 +625,133 @@ kuro_gfx_create()
     assert(SUCCEEDED(hr));
     gfx->current_fence = 0;
 
-    hr = gfx->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&gfx->command_allocator));
+    D3D12_COMMAND_QUEUE_DESC copy_queue_desc = {};
+    copy_queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    hr = gfx->device->CreateCommandQueue(&copy_queue_desc, IID_PPV_ARGS(&gfx->copy_queue));
     assert(SUCCEEDED(hr));
 
-    hr = gfx->device->CreateCommandList(
-        0,
-        D3D12_COMMAND_LIST_TYPE_DIRECT,
-        gfx->command_allocator,
-        nullptr,
-        IID_PPV_ARGS(&gfx->command_list));
+    hr = gfx->device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&gfx->copy_fence));
     assert(SUCCEEDED(hr));
-
-    hr = gfx->command_list->Close();
+    hr = gfx->device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&gfx->image_copy_fence));
     assert(SUCCEEDED(hr));
 
+    for (int i = 0; i < UPLOAD_BATCHES; ++i)
+    {
+        _Upload_Batch *batch = &gfx->upload_batches[i];
+        batch->image_copy_count = 0;
+        batch->token = 0;
+
+        hr = gfx->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&batch->allocator));
+        assert(SUCCEEDED(hr));
+        hr = gfx->device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, batch->allocator, nullptr, IID_PPV_ARGS(&batch->command_list));
+        assert(SUCCEEDED(hr));
+        hr = batch->command_list->Close();
+        assert(SUCCEEDED(hr));
+
+        hr = gfx->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&batch->image_allocator));
+        assert(SUCCEEDED(hr));
+        hr = gfx->device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, batch->image_allocator, nullptr, IID_PPV_ARGS(&batch->image_command_list));
+        assert(SUCCEEDED(hr));
+        hr = batch->image_command_list->Close();
+        assert(SUCCEEDED(hr));
+    }
+    gfx->upload_batch = 0;
+    gfx->upload_open = false;
+    gfx->upload_submitted = 0;
+
     D3D12_DESCRIPTOR_HEAP_DESC cbv_heap_desc = {};
     cbv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     cbv_heap_desc.NumDescriptors = MAX_CBV_HEAP_DESC_NUM;
     cbv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     hr = gfx->device->CreateDescriptorHeap(&cbv_heap_desc, IID_PPV_ARGS(&gfx->cbv_heap));
     assert(SUCCEEDED(hr));
-    gfx->next_free_cbv_index = 0;
+
+    D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc = {};
+    rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+    rtv_heap_desc.NumDescriptors = MAX_RTV_HEAP_DESC_NUM;
+    hr = gfx->device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&gfx->rtv_heap));
+    assert(SUCCEEDED(hr));
+    kuro_gfx_descriptor_init(&gfx->rtv_descriptors, MAX_RTV_HEAP_DESC_NUM);
+
+    D3D12_DESCRIPTOR_HEAP_DESC dsv_heap_desc = {};
+    dsv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+    dsv_heap_desc.NumDescriptors = MAX_DSV_HEAP_DESC_NUM;
+    hr = gfx->device->CreateDescriptorHeap(&dsv_heap_desc, IID_PPV_ARGS(&gfx->dsv_heap));
+    assert(SUCCEEDED(hr));
+    kuro_gfx_descriptor_init(&gfx->dsv_descriptors, MAX_DSV_HEAP_DESC_NUM);
+
+    D3D12_HEAP_PROPERTIES upload_heap_properties = {};
+    upload_heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+    D3D12_RESOURCE_DESC upload_desc = {};
+    upload_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    upload_desc.Width = UPLOAD_RING_SIZE;
+    upload_desc.Height = 1;
+    upload_desc.DepthOrArraySize = 1;
+    upload_desc.MipLevels = 1;
+    upload_desc.SampleDesc.Count = 1;
+    upload_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    hr = gfx->device->CreateCommittedResource(
+        &upload_heap_properties,
+        D3D12_HEAP_FLAG_NONE,
+        &upload_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&gfx->upload_buffer));
+    assert(SUCCEEDED(hr));
+
+    // upload heaps can stay mapped for their whole lifetime, the CPU never reads from it
+    D3D12_RANGE read_range = {};
+    hr = gfx->upload_buffer->Map(0, &read_range, (void **)&gfx->upload_data);
+    assert(SUCCEEDED(hr));
+    gfx->upload_address = gfx->upload_buffer->GetGPUVirtualAddress();
+    kuro_gfx_ring_init(&gfx->upload_ring, UPLOAD_RING_SIZE);
+    InitializeSRWLock(&gfx->upload_lock);
+    gfx->upload_lists = nullptr;
+
+    upload_desc.Width = STAGING_SIZE;
+    hr = gfx->device->CreateCommittedResource(
+        &upload_heap_properties,
+        D3D12_HEAP_FLAG_NONE,
+        &upload_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&gfx->staging_buffer));
+    assert(SUCCEEDED(hr));
+    hr = gfx->staging_buffer->Map(0, &read_range, (void **)&gfx->staging_data);
+    assert(SUCCEEDED(hr));
+    kuro_gfx_ring_init(&gfx->staging_ring, STAGING_SIZE);
+    kuro_gfx_state_init(&gfx->upload_states, STATE_READ_MASK);
+    InitializeSRWLock(&gfx->staging_lock);
+
+    gfx->event_count = 0;
+    gfx->parked_events = nullptr;
+    gfx->parked_event_count = 0;
+    gfx->parked_event_capacity = 0;
+    InitializeSRWLock(&gfx->event_lock);
+    gfx->fences = nullptr;
+    InitializeSRWLock(&gfx->fence_lock);
+    gfx->pipelines = nullptr;
+    gfx->pipeline_cache = nullptr;
+    gfx->compiler = kuro_gfx_compiler_create(_kuro_gfx_shader_compile, nullptr, 0);
+
+    static_assert(sizeof(Kuro_Gfx_Draw_Arguments) == sizeof(D3D12_DRAW_ARGUMENTS), "draw arguments layout");
+    static_assert(sizeof(Kuro_Gfx_Draw_Indexed_Arguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), "draw indexed arguments layout");
+
+    D3D12_INDIRECT_ARGUMENT_DESC argument_desc = {};
+    argument_desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+    D3D12_COMMAND_SIGNATURE_DESC signature_desc = {};
+    signature_desc.ByteStride = sizeof(Kuro_Gfx_Draw_Arguments);
+    signature_desc.NumArgumentDescs = 1;
+    signature_desc.pArgumentDescs = &argument_desc;
+    hr = gfx->device->CreateCommandSignature(&signature_desc, nullptr, IID_PPV_ARGS(&gfx->draw_signature));
+    assert(SUCCEEDED(hr));
+
+    argument_desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+    signature_desc.ByteStride = sizeof(Kuro_Gfx_Draw_Indexed_Arguments);
+    hr = gfx->device->CreateCommandSignature(&signature_desc, nullptr, IID_PPV_ARGS(&gfx->draw_indexed_signature));
+    assert(SUCCEEDED(hr));
 
     return gfx;
 }
@@ -211,9 +760,38 @@ void
 kuro_gfx_destroy(kr_gfx_t gfx)
 {
     kuro_gfx_sync(gfx);
+    gfx->upload_buffer->Unmap(0, nullptr);
+    gfx->upload_buffer->Release();
+    gfx->staging_buffer->Unmap(0, nullptr);
+    gfx->staging_buffer->Release();
+    for (int i = 0; i < UPLOAD_BATCHES; ++i)
+    {
+        gfx->upload_batches[i].command_list->Release();
+        gfx->upload_batches[i].allocator->Release();
+        gfx->upload_batches[i].image_command_list->Release();
+        gfx->upload_batches[i].image_allocator->Release();
+    }
+    kuro_gfx_state_destroy(&gfx->upload_states);
+    gfx->image_copy_fence->Release();
+    gfx->copy_fence->Release();
+    gfx->copy_queue->Release();
+    for (uint32_t i = 0; i < gfx->event_count; ++i)
+        CloseHandle(gfx->events[i]);
+    for (uint32_t i = 0; i < gfx->parked_event_count; ++i)
+    {
+        gfx->parked_events[i].fence->Release();
+        CloseHandle(gfx->parked_events[i].event);
+    }
+    free(gfx->parked_events);
+    kuro_gfx_cache_close(gfx->pipeline_cache);
+    kuro_gfx_compiler_destroy(gfx->compiler);
+    gfx->draw_indexed_signature->Release();
+    gfx->draw_signature->Release();
     gfx->cbv_heap->Release();
-    gfx->command_list->Release();
-    gfx->command_allocator->Release();
+    kuro_gfx_descriptor_destroy(&gfx->rtv_descriptors);
+    gfx->rtv_heap->Release();
+    kuro_gfx_descriptor_destroy(&gfx->dsv_descriptors);
+    gfx->dsv_heap->Release();
     gfx->fence->Release();
     gfx->command_queue->Release();
     gfx->device->Release();
@@ -271,22 +849,19 @@ kuro_gfx_swapchain_create(kr_gfx_t gfx, uint32_t width, uint32_t height, void *w
     assert(SUCCEEDED(hr));
     swapchain_tmp->Release();
 
-    D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc = {};
-    rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-    rtv_heap_desc.NumDescriptors = swapchain->buffer_count;
-    hr = gfx->device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&swapchain->rtv_heap));
-    assert(SUCCEEDED(hr));
+    // one contiguous range for all back buffers
+    bool allocated = kuro_gfx_descriptor_alloc(&gfx->rtv_descriptors, swapchain->buffer_count, &swapchain->rtv_index);
+    assert(allocated && "out of render target views");
+    (void)allocated;
 
     for (uint32_t i = 0; i < swapchain->buffer_count; ++i)
-    {
-        swapchain->rtv_descriptor[i] = swapchain->rtv_heap->GetCPUDescriptorHandleForHeapStart();
-        swapchain->rtv_descriptor[i].ptr += (i * gfx->rtv_desctiptor_size);
-    }
+        swapchain->rtv_descriptor[i] = _kuro_gfx_descriptor_handle(gfx->rtv_heap, gfx->rtv_desctiptor_size, swapchain->rtv_index + i);
 
     for (uint32_t i = 0; i < swapchain->buffer_count; ++i)
     {
         hr = swapchain->swapchain->GetBuffer(i, IID_PPV_ARGS(&swapchain->buffers[i]));
         assert(SUCCEEDED(hr));
+        kuro_gfx_state_resource_init(&swapchain->buffer_states[i], swapchain->buffers[i], 1, D3D12_RESOURCE_STATE_PRESENT);
         gfx->device->CreateRenderTargetView(
             swapchain->buffers[i],
             nullptr,
@@ -300,7 +875,7 @@ void
 kuro_gfx_swapchain_destroy(kr_gfx_t gfx, kr_swapchain_t swapchain)
 {
     kuro_gfx_sync(gfx);
-    swapchain->rtv_heap->Release();
+    kuro_gfx_descriptor_free(&gfx->rtv_descriptors, swapchain->rtv_index, gfx->current_fence);
     for (uint32_t i = 0; i < swapchain->buffer_count; ++i)
         swapchain->buffers[i]->Release();
     swapchain->swapchain->Release();
@@ -328,6 +903,7 @@ kuro_gfx_swapchain_resize(kr_gfx_t gfx, kr_swapchain_t swapchain, uint32_t width
     {
         hr = swapchain->swapchain->GetBuffer(i, IID_PPV_ARGS(&swapchain->buffers[i]));
         assert(SUCCEEDED(hr));
+        kuro_gfx_state_resource_init(&swapchain->buffer_states[i], swapchain->buffers[i], 1, D3D12_RESOURCE_STATE_PRESENT);
         gfx->device->CreateRenderTargetView(
             swapchain->buffers[i],
             nullptr,
@@ -339,10 +915,13 @@ kr_image_t
 kuro_gfx_image_create(kr_gfx_t gfx, uint32_t width, uint32_t height)
 {
     kr_image_t image = (kr_image_t)malloc(sizeof(_kr_image_t));
+    image->width = width;
+    image->height = height;
     image->depth_stencil_format = DXGI_FORMAT_D24_UNORM_S8_UINT;
     image->msaa_state = false;
     image->msaa_x4_quality = 0;
-    image->transition = true;
+    image->render_target_format = DXGI_FORMAT_UNKNOWN;
+    image->render_target = nullptr;
 
     HRESULT hr = {};
 
@@ -373,14 +952,13 @@ kuro_gfx_image_create(kr_gfx_t gfx, uint32_t width, uint32_t height)
         &optimized_clear_value,
         IID_PPV_ARGS(&image->depth_stencil_buffer));
     assert(SUCCEEDED(hr));
+    // the first pass that uses it moves it to the depth write state
+    kuro_gfx_state_resource_init(&image->state, image->depth_stencil_buffer, 1, D3D12_RESOURCE_STATE_COMMON);
 
-    D3D12_DESCRIPTOR_HEAP_DESC dsv_heap_desc = {};
-    dsv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-    dsv_heap_desc.NumDescriptors = 1;
-    hr = gfx->device->CreateDescriptorHeap(&dsv_heap_desc, IID_PPV_ARGS(&image->dsv_heap));
-    assert(SUCCEEDED(hr));
-
-    image->dsv_descriptor = image->dsv_heap->GetCPUDescriptorHandleForHeapStart();
+    bool allocated = kuro_gfx_descriptor_alloc(&gfx->dsv_descriptors, 1, &image->dsv_index);
+    assert(allocated && "out of depth stencil views");
+    (void)allocated;
+    image->dsv_descriptor = _kuro_gfx_descriptor_handle(gfx->dsv_heap, gfx->dsv_descriptor_size, image->dsv_index);
 
     gfx->device->CreateDepthStencilView(
         image->depth_stencil_buffer,
@@ -390,147 +968,308 @@ kuro_gfx_image_create(kr_gfx_t gfx, uint32_t width, uint32_t height)
     return image;
 }
 
+kr_image_t
+kuro_gfx_render_target_create(kr_gfx_t gfx, uint32_t width, uint32_t height)
+{
+    kr_image_t image = (kr_image_t)malloc(sizeof(_kr_image_t));
+    image->width = width;
+    image->height = height;
+    image->depth_stencil_format = DXGI_FORMAT_UNKNOWN;
+    image->msaa_state = false;
+    image->msaa_x4_quality = 0;
+    image->depth_stencil_buffer = nullptr;
+    image->render_target_format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    HRESULT hr = {};
+
+    D3D12_HEAP_PROPERTIES heap_properties = {};
+    heap_properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC render_target_desc = {};
+    render_target_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    render_target_desc.Width = width;
+    render_target_desc.Height = height;
+    render_target_desc.DepthOrArraySize = 1;
+    render_target_desc.MipLevels = 1;
+    render_target_desc.Format = image->render_target_format;
+    render_target_desc.SampleDesc.Count = 1;
+    render_target_desc.SampleDesc.Quality = 0;
+    render_target_desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+    // render targets stay in the render target state outside of readback copies
+    hr = gfx->device->CreateCommittedResource(
+        &heap_properties,
+        D3D12_HEAP_FLAG_NONE,
+        &render_target_desc,
+        D3D12_RESOURCE_STATE_RENDER_TARGET,
+        nullptr,
+        IID_PPV_ARGS(&image->render_target));
+    assert(SUCCEEDED(hr));
+    kuro_gfx_state_resource_init(&image->state, image->render_target, 1, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    bool allocated = kuro_gfx_descriptor_alloc(&gfx->rtv_descriptors, 1, &image->rtv_index);
+    assert(allocated && "out of render target views");
+    (void)allocated;
+    image->rtv_descriptor = _kuro_gfx_descriptor_handle(gfx->rtv_heap, gfx->rtv_desctiptor_size, image->rtv_index);
+
+    gfx->device->CreateRenderTargetView(
+        image->render_target,
+        nullptr,
+        image->rtv_descriptor);
+
+    return image;
+}
+
 void
 kuro_gfx_image_destroy(kr_gfx_t gfx, kr_image_t image)
 {
     kuro_gfx_sync(gfx);
-    image->dsv_heap->Release();
-    image->depth_stencil_buffer->Release();
+    // the views stay reserved until the GPU is past everything submitted before the destroy
+    if (image->depth_stencil_buffer)
+    {
+        kuro_gfx_descriptor_free(&gfx->dsv_descriptors, image->dsv_index, gfx->current_fence);
+        image->depth_stencil_buffer->Release();
+    }
+    if (image->render_target)
+    {
+        kuro_gfx_descriptor_free(&gfx->rtv_descriptors, image->rtv_index, gfx->current_fence);
+        image->render_target->Release();
+    }
+    kuro_gfx_state_resource_destroy(&image->state);
     free(image);
 }
 
-kr_buffer_t
-kuro_gfx_buffer_create(kr_gfx_t gfx, KURO_GFX_ACCESS cpu_access, void *data, uint32_t size_in_bytes)
+kr_heap_t
+kuro_gfx_heap_create(kr_gfx_t gfx, uint64_t size_in_bytes)
 {
-    kr_buffer_t buffer = (kr_buffer_t)malloc(sizeof(_kr_buffer_t));
+    kr_heap_t heap = (kr_heap_t)malloc(sizeof(_kr_heap_t));
+    heap->size_in_bytes = size_in_bytes;
 
-    buffer->cpu_access = cpu_access;
-    for (int i = 0; i < SYNC; ++i)
-        buffer->buffer[i] = nullptr;
-    buffer->size_in_bytes = size_in_bytes;
+    // only render targets and depth targets are placed, which every resource heap tier allows
+    D3D12_HEAP_DESC heap_desc = {};
+    heap_desc.SizeInBytes = size_in_bytes;
+    heap_desc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heap_desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heap_desc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
 
-    HRESULT hr = {};
+    HRESULT hr = gfx->device->CreateHeap(&heap_desc, IID_PPV_ARGS(&heap->heap));
+    assert(SUCCEEDED(hr));
+    (void)hr;
+    return heap;
+}
 
-    D3D12_HEAP_PROPERTIES heap_properties = {};
-    switch (buffer->cpu_access)
-    {
-        case KURO_GFX_ACCESS_NONE:
-            heap_properties.Type = D3D12_HEAP_TYPE_DEFAULT;
-            break;
-        case KURO_GFX_ACCESS_WRITE:
-            heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
-            break;
-        default:
-            assert(false); break;
-    }
+void
+kuro_gfx_heap_destroy(kr_gfx_t gfx, kr_heap_t heap)
+{
+    kuro_gfx_sync(gfx);
+    heap->heap->Release();
+    free(heap);
+}
 
-    D3D12_RESOURCE_STATES initial_state = {};
-    switch (buffer->cpu_access)
-    {
-        case KURO_GFX_ACCESS_NONE:
-            initial_state = D3D12_RESOURCE_STATE_COMMON;
-            break;
-        case KURO_GFX_ACCESS_WRITE:
-            initial_state = D3D12_RESOURCE_STATE_GENERIC_READ;
-            break;
-        default:
-            assert(false); break;
-    }
+static inline D3D12_RESOURCE_DESC
+_kuro_gfx_image_desc(uint32_t width, uint32_t height, bool render_target)
+{
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = width;
+    desc.Height = height;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = render_target ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_D24_UNORM_S8_UINT;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Flags = render_target ? D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET : D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+    return desc;
+}
 
-    D3D12_RESOURCE_DESC resource_desc = {};
-    resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    resource_desc.Width = size_in_bytes;
-    resource_desc.Height = 1;
-    resource_desc.DepthOrArraySize = 1;
-    resource_desc.MipLevels = 1;
-    resource_desc.SampleDesc.Count = 1;
-    resource_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+void
+kuro_gfx_image_memory(kr_gfx_t gfx, uint32_t width, uint32_t height, bool render_target, uint64_t *size_in_bytes, uint64_t *alignment)
+{
+    D3D12_RESOURCE_DESC desc = _kuro_gfx_image_desc(width, height, render_target);
+    D3D12_RESOURCE_ALLOCATION_INFO info = gfx->device->GetResourceAllocationInfo(0, 1, &desc);
+    *size_in_bytes = info.SizeInBytes;
+    *alignment = info.Alignment;
+}
 
-    for (int i = 0; i < SYNC; ++i)
-    {
-        hr = gfx->device->CreateCommittedResource(
-            &heap_properties,
-            D3D12_HEAP_FLAG_NONE,
-            &resource_desc,
-            initial_state,
-            nullptr,
-            IID_PPV_ARGS(&buffer->buffer[i]));
-        assert(SUCCEEDED(hr));
+kr_image_t
+kuro_gfx_image_place(kr_gfx_t gfx, kr_heap_t heap, uint64_t offset, uint32_t width, uint32_t height, bool render_target)
+{
+    kr_image_t image = (kr_image_t)malloc(sizeof(_kr_image_t));
+    image->width = width;
+    image->height = height;
+    image->depth_stencil_format = render_target ? DXGI_FORMAT_UNKNOWN : DXGI_FORMAT_D24_UNORM_S8_UINT;
+    image->msaa_state = false;
+    image->msaa_x4_quality = 0;
+    image->depth_stencil_buffer = nullptr;
+    image->render_target_format = render_target ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_UNKNOWN;
+    image->render_target = nullptr;
 
-        if (buffer->cpu_access == KURO_GFX_ACCESS_NONE)
-            break;
-    }
+    D3D12_RESOURCE_DESC desc = _kuro_gfx_image_desc(width, height, render_target);
+    D3D12_CLEAR_VALUE optimized_clear_value = {};
+    optimized_clear_value.Format = desc.Format;
+    optimized_clear_value.DepthStencil.Depth = 1.0f;
+
+    assert(offset + gfx->device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes <= heap->size_in_bytes);
+    // created in the state it rests in, so the passes that use it have nothing to transition
+    D3D12_RESOURCE_STATES state = render_target ? D3D12_RESOURCE_STATE_RENDER_TARGET : D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    ID3D12Resource *resource = nullptr;
+    HRESULT hr = gfx->device->CreatePlacedResource(
+        heap->heap,
+        offset,
+        &desc,
+        state,
+        render_target ? nullptr : &optimized_clear_value,
+        IID_PPV_ARGS(&resource));
+    assert(SUCCEEDED(hr));
+    (void)hr;
+    kuro_gfx_state_resource_init(&image->state, resource, 1, state);
 
-    if (buffer->cpu_access == KURO_GFX_ACCESS_NONE)
+    if (render_target)
     {
-        assert(data);
-        ID3D12Resource *upload_buffer = nullptr;
+        image->render_target = resource;
+        bool allocated = kuro_gfx_descriptor_alloc(&gfx->rtv_descriptors, 1, &image->rtv_index);
+        assert(allocated && "out of render target views");
+        (void)allocated;
+        image->rtv_descriptor = _kuro_gfx_descriptor_handle(gfx->rtv_heap, gfx->rtv_desctiptor_size, image->rtv_index);
+        gfx->device->CreateRenderTargetView(resource, nullptr, image->rtv_descriptor);
+    }
+    else
+    {
+        image->depth_stencil_buffer = resource;
+        bool allocated = kuro_gfx_descriptor_alloc(&gfx->dsv_descriptors, 1, &image->dsv_index);
+        assert(allocated && "out of depth stencil views");
+        (void)allocated;
+        image->dsv_descriptor = _kuro_gfx_descriptor_handle(gfx->dsv_heap, gfx->dsv_descriptor_size, image->dsv_index);
+        gfx->device->CreateDepthStencilView(resource, nullptr, image->dsv_descriptor);
+    }
 
-        heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+    return image;
+}
 
-        hr = gfx->device->CreateCommittedResource(
-            &heap_properties,
-            D3D12_HEAP_FLAG_NONE,
-            &resource_desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&upload_buffer));
-        assert(SUCCEEDED(hr));
+void
+kuro_gfx_image_alias(kr_commands_t commands, kr_image_t before, kr_image_t after)
+{
+    ID3D12Resource *before_resource = nullptr;
+    if (before)
+        before_resource = before->render_target ? before->render_target : before->depth_stencil_buffer;
+    ID3D12Resource *after_resource = after->render_target ? after->render_target : after->depth_stencil_buffer;
+
+    // the transitions requested before the alias happen before it
+    _kuro_gfx_barriers_flush(commands->command_list, &commands->states);
+
+    D3D12_RESOURCE_BARRIER resource_barrier = {};
+    resource_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+    resource_barrier.Aliasing.pResourceBefore = before_resource;
+    resource_barrier.Aliasing.pResourceAfter = after_resource;
+    commands->command_list->ResourceBarrier(1, &resource_barrier);
+
+    // a render target or depth target that takes over aliased memory has to be discarded or cleared
+    commands->command_list->DiscardResource(after_resource, nullptr);
+}
 
-        void *mapped_data = nullptr;
-        hr = upload_buffer->Map(0, nullptr, &mapped_data);
-        assert(SUCCEEDED(hr));
-        memcpy(mapped_data, data, size_in_bytes);
-        upload_buffer->Unmap(0, nullptr);
+kr_readback_t
+kuro_gfx_readback_create(kr_gfx_t gfx, uint32_t width, uint32_t height)
+{
+    kr_readback_t readback = (kr_readback_t)malloc(sizeof(_kr_readback_t));
+    readback->fence = 0;
 
-        kuro_gfx_sync(gfx);
-        hr = gfx->command_allocator->Reset();
-        assert(SUCCEEDED(hr));
-        hr = gfx->command_list->Reset(gfx->command_allocator, nullptr);
-        assert(SUCCEEDED(hr));
+    HRESULT hr = {};
 
-        D3D12_RESOURCE_BARRIER resource_barrier = {};
-        resource_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        resource_barrier.Transition.pResource = buffer->buffer[0];
-        resource_barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        resource_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
-        resource_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-        gfx->command_list->ResourceBarrier(1, &resource_barrier);
+    D3D12_RESOURCE_DESC texture_desc = {};
+    texture_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    texture_desc.Width = width;
+    texture_desc.Height = height;
+    texture_desc.DepthOrArraySize = 1;
+    texture_desc.MipLevels = 1;
+    texture_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texture_desc.SampleDesc.Count = 1;
+    gfx->device->GetCopyableFootprints(&texture_desc, 0, 1, 0, &readback->footprint, nullptr, nullptr, &readback->size_in_bytes);
 
-        gfx->command_list->CopyBufferRegion(buffer->buffer[0], 0, upload_buffer, 0, size_in_bytes);
+    D3D12_HEAP_PROPERTIES heap_properties = {};
+    heap_properties.Type = D3D12_HEAP_TYPE_READBACK;
 
-        resource_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        resource_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_GENERIC_READ;
-        gfx->command_list->ResourceBarrier(1, &resource_barrier);
+    D3D12_RESOURCE_DESC buffer_desc = {};
+    buffer_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    buffer_desc.Width = readback->size_in_bytes;
+    buffer_desc.Height = 1;
+    buffer_desc.DepthOrArraySize = 1;
+    buffer_desc.MipLevels = 1;
+    buffer_desc.SampleDesc.Count = 1;
+    buffer_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 
-        hr = gfx->command_list->Close();
-        assert(SUCCEEDED(hr));
-        ID3D12CommandList *cmd_lists[] = { gfx->command_list };
-        gfx->command_queue->ExecuteCommandLists(1, cmd_lists);
-        kuro_gfx_sync(gfx);
-        upload_buffer->Release();
-    }
-    else
-    {
-        assert(size_in_bytes % 256 == 0);
+    hr = gfx->device->CreateCommittedResource(
+        &heap_properties,
+        D3D12_HEAP_FLAG_NONE,
+        &buffer_desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&readback->buffer));
+    assert(SUCCEEDED(hr));
 
-        for (int i = 0; i < SYNC; ++i)
-        {
-            D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
-            cbv_desc.BufferLocation = buffer->buffer[i]->GetGPUVirtualAddress();
-            cbv_desc.SizeInBytes = size_in_bytes;
+    return readback;
+}
 
-            D3D12_CPU_DESCRIPTOR_HANDLE heap_handle = gfx->cbv_heap->GetCPUDescriptorHandleForHeapStart();
-            heap_handle.ptr += (gfx->next_free_cbv_index * gfx->cbv_descriptor_size);
-            gfx->device->CreateConstantBufferView(&cbv_desc, heap_handle);
+void
+kuro_gfx_readback_destroy(kr_gfx_t gfx, kr_readback_t readback)
+{
+    kuro_gfx_sync(gfx);
+    readback->buffer->Release();
+    free(readback);
+}
 
-            buffer->cbv[i] = gfx->cbv_heap->GetGPUDescriptorHandleForHeapStart();
-            buffer->cbv[i].ptr += (gfx->next_free_cbv_index * gfx->cbv_descriptor_size);
+bool
+kuro_gfx_readback_ready(kr_gfx_t gfx, kr_readback_t readback)
+{
+    return gfx->fence->GetCompletedValue() >= readback->fence;
+}
 
-            gfx->next_free_cbv_index++;
-        }
+const void *
+kuro_gfx_readback_map(kr_gfx_t gfx, kr_readback_t readback, uint32_t *row_pitch)
+{
+    // UINT64_MAX until kuro_gfx_commands_end submits the list, waiting on it would never return
+    assert(readback->fence != UINT64_MAX && "map a readback after kuro_gfx_commands_end of the list that recorded it");
+    _kuro_gfx_fence_wait(gfx, gfx->fence, readback->fence, INFINITE);
+
+    D3D12_RANGE read_range = {};
+    read_range.End = (SIZE_T)readback->size_in_bytes;
+
+    void *mapped_data = nullptr;
+    HRESULT hr = readback->buffer->Map(0, &read_range, &mapped_data);
+    assert(SUCCEEDED(hr));
+
+    if (row_pitch)
+        *row_pitch = readback->footprint.Footprint.RowPitch;
+    return (const uint8_t *)mapped_data + readback->footprint.Offset;
+}
+
+void
+kuro_gfx_readback_unmap(kr_gfx_t, kr_readback_t readback)
+{
+    D3D12_RANGE written_range = {};
+    readback->buffer->Unmap(0, &written_range);
+}
+
+kr_buffer_t
+kuro_gfx_buffer_create(kr_gfx_t gfx, KURO_GFX_ACCESS cpu_access, void *data, uint32_t size_in_bytes)
+{
+    if (cpu_access == KURO_GFX_ACCESS_NONE)
+    {
+        assert(data);
+        return kuro_gfx_upload_buffer(gfx, data, size_in_bytes);
     }
+    assert(cpu_access == KURO_GFX_ACCESS_WRITE);
+
+    kr_buffer_t buffer = (kr_buffer_t)malloc(sizeof(_kr_buffer_t));
+
+    buffer->cpu_access = cpu_access;
+    buffer->buffer = nullptr;
+    buffer->size_in_bytes = size_in_bytes;
+    buffer->address = 0;
 
+    // writable buffers get their memory from the upload ring on every write
+    buffer->shadow = (uint8_t *)calloc(1, size_in_bytes);
+    if (data)
+        memcpy(buffer->shadow, data, size_in_bytes);
     return buffer;
 }
 
@@ -538,72 +1277,189 @@ void
 kuro_gfx_buffer_destroy(kr_gfx_t gfx, kr_buffer_t buffer)
 {
     kuro_gfx_sync(gfx);
-    for (int i = 0; i < SYNC; ++i)
-    {
-        if (buffer->buffer[i])
-            buffer->buffer[i]->Release();
-    }
+    if (buffer->buffer)
+        buffer->buffer->Release();
+    free(buffer->shadow);
     free(buffer);
 }
 
-kr_vshader_t
-kuro_gfx_vertex_shader_create(kr_gfx_t, const char *shader, const char *entry_point)
+kr_buffer_t
+kuro_gfx_upload_buffer(kr_gfx_t gfx, const void *data, uint32_t size_in_bytes)
 {
-    kr_vshader_t vertex_shader = (kr_vshader_t)malloc(sizeof(_kr_vshader_t));
+    kr_buffer_t buffer = (kr_buffer_t)malloc(sizeof(_kr_buffer_t));
 
-    UINT compile_flags = 0;
-    #if defined(DEBUG) || defined(_DEBUG)
+    buffer->cpu_access = KURO_GFX_ACCESS_NONE;
+    buffer->buffer = nullptr;
+    buffer->size_in_bytes = size_in_bytes;
+    buffer->shadow = nullptr;
+    buffer->address = 0;
+
+    HRESULT hr = {};
+
+    D3D12_HEAP_PROPERTIES heap_properties = {};
+    heap_properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC resource_desc = {};
+    resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    resource_desc.Width = size_in_bytes;
+    resource_desc.Height = 1;
+    resource_desc.DepthOrArraySize = 1;
+    resource_desc.MipLevels = 1;
+    resource_desc.SampleDesc.Count = 1;
+    resource_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    hr = gfx->device->CreateCommittedResource(
+        &heap_properties,
+        D3D12_HEAP_FLAG_NONE,
+        &resource_desc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&buffer->buffer));
+    assert(SUCCEEDED(hr));
+
+    AcquireSRWLockExclusive(&gfx->staging_lock);
+    for (uint32_t offset = 0; offset < size_in_bytes;)
     {
-        compile_flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+        uint32_t size = size_in_bytes - offset < STAGING_CHUNK ? size_in_bytes - offset : (uint32_t)STAGING_CHUNK;
+        uint64_t staging = _kuro_gfx_staging_alloc(gfx, size, 16);
+        memcpy(gfx->staging_data + staging, (const uint8_t *)data + offset, size);
+
+        _Upload_Batch *batch = _kuro_gfx_upload_batch(gfx);
+        batch->command_list->CopyBufferRegion(buffer->buffer, offset, gfx->staging_buffer, staging, size);
+        offset += size;
     }
-    #endif
+    ReleaseSRWLockExclusive(&gfx->staging_lock);
 
-    ID3DBlob *error_blob = nullptr;
-    HRESULT hr = D3DCompile(shader, ::strlen(shader), nullptr, nullptr, nullptr, entry_point, "vs_5_0", compile_flags, 0, &vertex_shader->blob, &error_blob);
-    if (error_blob)
+    return buffer;
+}
+
+void
+kuro_gfx_upload_image(kr_gfx_t gfx, kr_image_t render_target, const void *pixels, uint32_t row_pitch)
+{
+    assert(render_target->render_target && "only render targets can be uploaded");
+
+    uint32_t row_size = render_target->width * sizeof(uint32_t);
+    uint32_t staging_pitch = (row_size + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) / D3D12_TEXTURE_DATA_PITCH_ALIGNMENT * D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+    uint32_t chunk_rows = staging_pitch < STAGING_CHUNK ? (uint32_t)(STAGING_CHUNK / staging_pitch) : 1;
+
+    AcquireSRWLockExclusive(&gfx->staging_lock);
+    // every copy leaves the image in the state it had, the lists recorded after it expect that one
+    uint32_t state = kuro_gfx_state_get(&render_target->state, 0);
+    for (uint32_t y = 0; y < render_target->height;)
     {
-        OutputDebugStringA("vertex shader error: ");
-        OutputDebugStringA((char *)error_blob->GetBufferPointer());
-        OutputDebugStringA("\n");
-        error_blob->Release();
+        uint32_t rows = render_target->height - y < chunk_rows ? render_target->height - y : chunk_rows;
+        uint64_t staging = _kuro_gfx_staging_alloc(gfx, (uint64_t)rows * staging_pitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        for (uint32_t i = 0; i < rows; ++i)
+            memcpy(gfx->staging_data + staging + (size_t)i * staging_pitch, (const uint8_t *)pixels + (size_t)(y + i) * row_pitch, row_size);
+
+        _Upload_Batch *batch = _kuro_gfx_upload_batch(gfx);
+        kuro_gfx_state_request(&gfx->upload_states, &render_target->state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_COPY_DEST);
+        _kuro_gfx_barriers_flush(batch->image_command_list, &gfx->upload_states);
+
+        D3D12_TEXTURE_COPY_LOCATION dst = {};
+        dst.pResource = render_target->render_target;
+        dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst.SubresourceIndex = 0;
+
+        D3D12_TEXTURE_COPY_LOCATION src = {};
+        src.pResource = gfx->staging_buffer;
+        src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.PlacedFootprint.Offset = staging;
+        src.PlacedFootprint.Footprint.Format = render_target->render_target_format;
+        src.PlacedFootprint.Footprint.Width = render_target->width;
+        src.PlacedFootprint.Footprint.Height = rows;
+        src.PlacedFootprint.Footprint.Depth = 1;
+        src.PlacedFootprint.Footprint.RowPitch = staging_pitch;
+
+        batch->image_command_list->CopyTextureRegion(&dst, 0, y, 0, &src, nullptr);
+        kuro_gfx_state_request(&gfx->upload_states, &render_target->state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, state);
+        _kuro_gfx_barriers_flush(batch->image_command_list, &gfx->upload_states);
+        batch->image_copy_count++;
+        y += rows;
     }
-    assert(SUCCEEDED(hr));
+    ReleaseSRWLockExclusive(&gfx->staging_lock);
+}
 
-    return vertex_shader;
+uint64_t
+kuro_gfx_upload_submit(kr_gfx_t gfx)
+{
+    AcquireSRWLockExclusive(&gfx->staging_lock);
+    uint64_t token = _kuro_gfx_upload_submit(gfx);
+    ReleaseSRWLockExclusive(&gfx->staging_lock);
+    return token;
 }
 
-void
-kuro_gfx_vertex_shader_destroy(kr_gfx_t gfx, kr_vshader_t vertex_shader)
+bool
+kuro_gfx_upload_complete(kr_gfx_t gfx, uint64_t token)
 {
-    kuro_gfx_sync(gfx);
-    vertex_shader->blob->Release();
-    free(vertex_shader);
+    return gfx->copy_fence->GetCompletedValue() >= token;
 }
 
-kr_pshader_t
-kuro_gfx_pixel_shader_create(kr_gfx_t, const char *shader, const char *entry_point)
+void
+kuro_gfx_upload_wait(kr_gfx_t gfx, uint64_t token)
 {
-    kr_pshader_t pixel_shader = (kr_pshader_t)malloc(sizeof(_kr_pshader_t));
+    assert(token <= gfx->upload_submitted && "waiting on an upload that was never submitted");
+    _kuro_gfx_fence_wait(gfx, gfx->copy_fence, token, INFINITE);
+}
 
+static inline UINT
+_kuro_gfx_shader_flags()
+{
     UINT compile_flags = 0;
     #if defined(DEBUG) || defined(_DEBUG)
     {
         compile_flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
     }
     #endif
+    return compile_flags;
+}
 
-    ID3DBlob *error_blob = nullptr;
-    HRESULT hr = D3DCompile(shader, ::strlen(shader), nullptr, nullptr, nullptr, entry_point, "ps_5_0", compile_flags, 0, &pixel_shader->blob, &error_blob);
-    if (error_blob)
-    {
-        OutputDebugStringA("pixel shader error: ");
-        OutputDebugStringA((char *)error_blob->GetBufferPointer());
-        OutputDebugStringA("\n");
-        error_blob->Release();
-    }
+static inline kr_compile_t
+_kuro_gfx_shader_compile_submit(kr_gfx_t gfx, const char *shader, const char *entry_point, const char *profile)
+{
+    Kuro_Gfx_Shader_Source source = {};
+    source.source = shader;
+    source.source_size = ::strlen(shader);
+    source.entry_point = entry_point;
+    source.profile = profile;
+    source.flags = _kuro_gfx_shader_flags();
+    return kuro_gfx_compile_submit(gfx->compiler, source);
+}
+
+// waits for the compile and releases it
+static inline ID3DBlob *
+_kuro_gfx_shader_blob(kr_compile_t compile)
+{
+    size_t code_size = 0;
+    const void *code = kuro_gfx_compile_wait(compile, &code_size);
+    assert(code && "shader compile failed");
+
+    ID3DBlob *blob = nullptr;
+    HRESULT hr = D3DCreateBlob(code_size, &blob);
     assert(SUCCEEDED(hr));
+    memcpy(blob->GetBufferPointer(), code, code_size);
+    kuro_gfx_compile_release(compile);
+    return blob;
+}
 
-    return pixel_shader;
+kr_vshader_t
+kuro_gfx_vertex_shader_create(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return kuro_gfx_vertex_shader_get(gfx, kuro_gfx_vertex_shader_compile(gfx, shader, entry_point));
+}
+
+void
+kuro_gfx_vertex_shader_destroy(kr_gfx_t gfx, kr_vshader_t vertex_shader)
+{
+    kuro_gfx_sync(gfx);
+    vertex_shader->blob->Release();
+    free(vertex_shader);
+}
+
+kr_pshader_t
+kuro_gfx_pixel_shader_create(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return kuro_gfx_pixel_shader_get(gfx, kuro_gfx_pixel_shader_compile(gfx, shader, entry_point));
 }
 
 void
@@ -614,33 +1470,93 @@ kuro_gfx_pixel_shader_destroy(kr_gfx_t gfx, kr_pshader_t pixel_shader)
     free(pixel_shader);
 }
 
+kr_compile_t
+kuro_gfx_vertex_shader_compile(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return _kuro_gfx_shader_compile_submit(gfx, shader, entry_point, "vs_5_0");
+}
+
+kr_compile_t
+kuro_gfx_pixel_shader_compile(kr_gfx_t gfx, const char *shader, const char *entry_point)
+{
+    return _kuro_gfx_shader_compile_submit(gfx, shader, entry_point, "ps_5_0");
+}
+
+bool
+kuro_gfx_shader_ready(kr_compile_t compile)
+{
+    return kuro_gfx_compile_ready(compile);
+}
+
+kr_vshader_t
+kuro_gfx_vertex_shader_get(kr_gfx_t, kr_compile_t compile)
+{
+    kr_vshader_t vertex_shader = (kr_vshader_t)malloc(sizeof(_kr_vshader_t));
+    vertex_shader->blob = _kuro_gfx_shader_blob(compile);
+    return vertex_shader;
+}
+
+kr_pshader_t
+kuro_gfx_pixel_shader_get(kr_gfx_t, kr_compile_t compile)
+{
+    kr_pshader_t pixel_shader = (kr_pshader_t)malloc(sizeof(_kr_pshader_t));
+    pixel_shader->blob = _kuro_gfx_shader_blob(compile);
+    return pixel_shader;
+}
+
+void
+kuro_gfx_shader_cache_open(kr_gfx_t gfx, const char *path)
+{
+    kuro_gfx_compiler_cache_open(gfx->compiler, path);
+}
+
+bool
+kuro_gfx_shader_cache_save(kr_gfx_t gfx)
+{
+    return kuro_gfx_compiler_cache_save(gfx->compiler);
+}
+
 kr_pipeline_t
 kuro_gfx_pipeline_create(kr_gfx_t gfx, Kuro_Gfx_Pipeline_Desc desc)
 {
     assert(desc.vertex_shader);
 
+    uint64_t key = kuro_gfx_pipeline_hash(desc,
+        desc.vertex_shader->blob->GetBufferPointer(), desc.vertex_shader->blob->GetBufferSize(),
+        desc.pixel_shader ? desc.pixel_shader->blob->GetBufferPointer() : nullptr, desc.pixel_shader ? desc.pixel_shader->blob->GetBufferSize() : 0);
+    for (kr_pipeline_t it = gfx->pipelines; it; it = it->next)
+    {
+        if (it->key == key)
+        {
+            ++it->references;
+            return it;
+        }
+    }
+
     kr_pipeline_t pipeline = (kr_pipeline_t)malloc(sizeof(_kr_pipeline_t));
+    pipeline->key = key;
+    pipeline->references = 1;
+    pipeline->prev = nullptr;
+    pipeline->next = gfx->pipelines;
+    if (gfx->pipelines)
+        gfx->pipelines->prev = pipeline;
+    gfx->pipelines = pipeline;
 
     HRESULT hr = {};
 
     // TODO[Waleed]: make this number dynamic
-    D3D12_DESCRIPTOR_RANGE descriptor_range[2] = {};
-    D3D12_ROOT_PARAMETER root_parameter[2] = {};
-    for (int i = 0; i < 2; ++i)
-    {
-        descriptor_range[i].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-        descriptor_range[i].NumDescriptors = 1;
-        descriptor_range[i].BaseShaderRegister = i;
-        descriptor_range[i].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-
-        root_parameter[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-        root_parameter[i].DescriptorTable.NumDescriptorRanges = 1;
-        root_parameter[i].DescriptorTable.pDescriptorRanges = &descriptor_range[i];
+    // constant buffers are root descriptors pointing into the upload ring, so binding one needs no descriptor
+    D3D12_ROOT_PARAMETER root_parameter[MAX_CONSTANT_BUFFERS] = {};
+    for (int i = 0; i < MAX_CONSTANT_BUFFERS; ++i)
+    {
+        root_parameter[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+        root_parameter[i].Descriptor.ShaderRegister = i;
+        root_parameter[i].Descriptor.RegisterSpace = 0;
         root_parameter[i].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
     }
 
     D3D12_ROOT_SIGNATURE_DESC root_signature_desc = {};
-    root_signature_desc.NumParameters = 2;
+    root_signature_desc.NumParameters = MAX_CONSTANT_BUFFERS;
     root_signature_desc.pParameters = root_parameter;
     root_signature_desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
 
@@ -676,7 +1592,7 @@ kuro_gfx_pipeline_create(kr_gfx_t gfx, Kuro_Gfx_Pipeline_Desc desc)
         input_element_desc[i].InputSlot = desc.vertex_attribures[i].slot;
         input_element_desc[i].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
         input_element_desc[i].InputSlotClass = _kuro_gfx_class_to_dx(desc.vertex_attribures[i].classification);
-        input_element_desc[i].InstanceDataStepRate = 0;
+        input_element_desc[i].InstanceDataStepRate = desc.vertex_attribures[i].classification == KURO_GFX_CLASS_PER_INSTANCE ? 1 : 0;
     }
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC pipeline_desc = {};
@@ -718,11 +1634,34 @@ kuro_gfx_pipeline_create(kr_gfx_t gfx, Kuro_Gfx_Pipeline_Desc desc)
     pipeline_desc.InputLayout.pInputElementDescs = input_element_desc;
     pipeline_desc.InputLayout.NumElements = shader_desc.InputParameters;
     pipeline_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    pipeline_desc.NumRenderTargets = 1;
-    pipeline_desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    pipeline_desc.NumRenderTargets = desc.render_target_count ? desc.render_target_count : 1;
+    for (uint32_t i = 0; i < pipeline_desc.NumRenderTargets; ++i)
+        pipeline_desc.RTVFormats[i] = DXGI_FORMAT_R8G8B8A8_UNORM;
     pipeline_desc.SampleDesc.Count = 1;
-    hr = gfx->device->CreateGraphicsPipelineState(&pipeline_desc, IID_PPV_ARGS(&pipeline->pipeline_state));
-    assert(SUCCEEDED(hr));
+
+    // a blob from another driver or adapter is rejected, the pipeline is compiled again and its new
+    // blob replaces the old one
+    size_t cached_size = 0;
+    const void *cached = gfx->pipeline_cache ? kuro_gfx_cache_find(gfx->pipeline_cache, key, &cached_size) : nullptr;
+    if (cached)
+    {
+        pipeline_desc.CachedPSO.pCachedBlob = cached;
+        pipeline_desc.CachedPSO.CachedBlobSizeInBytes = cached_size;
+        hr = gfx->device->CreateGraphicsPipelineState(&pipeline_desc, IID_PPV_ARGS(&pipeline->pipeline_state));
+        pipeline_desc.CachedPSO = {};
+    }
+    if (cached == nullptr || FAILED(hr))
+    {
+        hr = gfx->device->CreateGraphicsPipelineState(&pipeline_desc, IID_PPV_ARGS(&pipeline->pipeline_state));
+        assert(SUCCEEDED(hr));
+
+        ID3DBlob *cached_blob = nullptr;
+        if (gfx->pipeline_cache && SUCCEEDED(pipeline->pipeline_state->GetCachedBlob(&cached_blob)))
+        {
+            kuro_gfx_cache_insert(gfx->pipeline_cache, key, cached_blob->GetBufferPointer(), cached_blob->GetBufferSize());
+            cached_blob->Release();
+        }
+    }
 
     reflection->Release();
     free(input_element_desc);
@@ -733,36 +1672,81 @@ kuro_gfx_pipeline_create(kr_gfx_t gfx, Kuro_Gfx_Pipeline_Desc desc)
 void
 kuro_gfx_pipeline_destroy(kr_gfx_t gfx, kr_pipeline_t pipeline)
 {
+    assert(pipeline->references > 0);
+    if (--pipeline->references != 0)
+        return;
+
     kuro_gfx_sync(gfx);
+    if (pipeline->prev)
+        pipeline->prev->next = pipeline->next;
+    else
+        gfx->pipelines = pipeline->next;
+    if (pipeline->next)
+        pipeline->next->prev = pipeline->prev;
     pipeline->pipeline_state->Release();
     pipeline->root_signature->Release();
+    free(pipeline);
 }
 
-kr_commands_t
-kuro_gfx_commands_create(kr_gfx_t gfx)
+void
+kuro_gfx_pipeline_cache_open(kr_gfx_t gfx, const char *path)
 {
-    HRESULT hr = {};
+    kuro_gfx_cache_close(gfx->pipeline_cache);
+    gfx->pipeline_cache = kuro_gfx_cache_open(path);
+}
 
-    kr_commands_t commands = (kr_commands_t)malloc(sizeof(_kr_commands_t));
-    commands->current_resource_index = 0;
+bool
+kuro_gfx_pipeline_cache_save(kr_gfx_t gfx)
+{
+    return gfx->pipeline_cache && kuro_gfx_cache_save(gfx->pipeline_cache);
+}
+
+static inline void
+_kuro_gfx_command_list_create(kr_gfx_t gfx, ID3D12CommandAllocator **command_allocator, ID3D12GraphicsCommandList **command_list)
+{
+    HRESULT hr = {};
 
     for (int i = 0; i < SYNC; ++i)
     {
-        commands->fence[i] = 0;
-        hr = gfx->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commands->command_allocator[i]));
+        hr = gfx->device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&command_allocator[i]));
         assert(SUCCEEDED(hr));
     }
 
     hr = gfx->device->CreateCommandList(
         0,
         D3D12_COMMAND_LIST_TYPE_DIRECT,
-        commands->command_allocator[0],
+        command_allocator[0],
         nullptr,
-        IID_PPV_ARGS(&commands->command_list));
+        IID_PPV_ARGS(command_list));
     assert(SUCCEEDED(hr));
 
-    hr = commands->command_list->Close();
+    hr = (*command_list)->Close();
     assert(SUCCEEDED(hr));
+}
+
+kr_commands_t
+kuro_gfx_commands_create(kr_gfx_t gfx)
+{
+    kr_commands_t commands = (kr_commands_t)malloc(sizeof(_kr_commands_t));
+    commands->gfx = gfx;
+    commands->current_resource_index = 0;
+    commands->swapchain = nullptr;
+    commands->color_target_count = 0;
+    commands->depth_target = nullptr;
+    commands->readback_count = 0;
+    commands->split_list = nullptr;
+    commands->recorder_capacity = 0;
+    commands->recorder_count = 0;
+    commands->split = false;
+    commands->upload_start = UINT64_MAX;
+    commands->upload_next = nullptr;
+    commands->parent = nullptr;
+    kuro_gfx_state_init(&commands->states, STATE_READ_MASK);
+    kuro_gfx_input_init(&commands->input);
+
+    for (int i = 0; i < SYNC; ++i)
+        commands->fence[i] = 0;
+    _kuro_gfx_command_list_create(gfx, commands->command_allocator, &commands->command_list);
 
     return commands;
 }
@@ -771,67 +1755,178 @@ void
 kuro_gfx_commands_destroy(kr_gfx_t gfx, kr_commands_t commands)
 {
     kuro_gfx_sync(gfx);
+    AcquireSRWLockExclusive(&gfx->upload_lock);
+    _kuro_gfx_upload_unlink(gfx, commands);
+    ReleaseSRWLockExclusive(&gfx->upload_lock);
+    for (uint32_t i = 0; i < commands->recorder_capacity; ++i)
+        kuro_gfx_commands_destroy(gfx, commands->recorders[i]);
+    if (commands->split_list)
+    {
+        commands->split_list->Release();
+        for (int i = 0; i < SYNC; ++i)
+            commands->split_allocator[i]->Release();
+    }
     commands->command_list->Release();
     for (int i = 0; i < SYNC; ++i)
         commands->command_allocator[i]->Release();
+    kuro_gfx_state_destroy(&commands->states);
+    free(commands);
 }
 
-void
-kuro_gfx_commands_begin(kr_gfx_t gfx, kr_commands_t commands, kr_swapchain_t swapchain, kr_image_t depth_target)
+// binds the targets of the pass to the command list that is being recorded, a list that was reset or a
+// recorder that was re-armed has no constant buffers bound yet
+static inline void
+_kuro_gfx_commands_bind_targets(kr_gfx_t gfx, kr_commands_t commands)
+{
+    for (int i = 0; i < MAX_CONSTANT_BUFFERS; ++i)
+        commands->bound[i] = nullptr;
+
+    if (commands->swapchain)
+    {
+        commands->command_list->OMSetRenderTargets(
+            1,
+            &commands->swapchain->rtv_descriptor[commands->swapchain->swapchain->GetCurrentBackBufferIndex()],
+            true,
+            commands->depth_target ? &commands->depth_target->dsv_descriptor : nullptr);
+    }
+    else
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE rtv_descriptors[KURO_CONSTANT_MAX_RENDER_TARGETS] = {};
+        for (uint32_t i = 0; i < commands->color_target_count; ++i)
+            rtv_descriptors[i] = commands->color_targets[i]->rtv_descriptor;
+
+        commands->command_list->OMSetRenderTargets(
+            commands->color_target_count,
+            commands->color_target_count ? rtv_descriptors : nullptr,
+            false,
+            commands->depth_target ? &commands->depth_target->dsv_descriptor : nullptr);
+    }
+
+    ID3D12DescriptorHeap *descriptor_heaps[] = {gfx->cbv_heap};
+    commands->command_list->SetDescriptorHeaps(1, descriptor_heaps);
+}
+
+static inline void
+_kuro_gfx_commands_reset(kr_gfx_t gfx, kr_commands_t commands, kr_image_t depth_target)
 {
     HRESULT hr = {};
 
-    commands->swapchain = swapchain;
+    commands->swapchain = nullptr;
+    commands->color_target_count = 0;
     commands->depth_target = depth_target;
+    commands->readback_count = 0;
+    commands->recorder_count = 0;
+    commands->split = false;
+    for (int i = 0; i < MAX_CONSTANT_BUFFERS; ++i)
+        commands->bound[i] = nullptr;
 
     commands->current_resource_index = (commands->current_resource_index + 1) % SYNC;
-    uint64_t current_commands_fence = commands->fence[commands->current_resource_index];
-
-    if (gfx->fence->GetCompletedValue() < commands->fence[commands->current_resource_index])
-    {
-        HANDLE event_handle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        hr = gfx->fence->SetEventOnCompletion(current_commands_fence, event_handle);
-        WaitForSingleObject(event_handle, INFINITE);
-        CloseHandle(event_handle);
-    }
+    _kuro_gfx_fence_wait(gfx, gfx->fence, commands->fence[commands->current_resource_index], INFINITE);
 
     hr = commands->command_allocator[commands->current_resource_index]->Reset();
     assert(SUCCEEDED(hr));
 
     hr = commands->command_list->Reset(commands->command_allocator[commands->current_resource_index], nullptr);
     assert(SUCCEEDED(hr));
+    kuro_gfx_input_reset(&commands->input);
+
+    if (depth_target)
+        kuro_gfx_state_request(&commands->states, &depth_target->state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+}
+
+void
+kuro_gfx_commands_begin(kr_gfx_t gfx, kr_commands_t commands, kr_swapchain_t swapchain, kr_image_t depth_target)
+{
+    AcquireSRWLockShared(&gfx->fence_lock);
+    for (kr_fence_t fence = gfx->fences; fence; fence = fence->next)
+        _kuro_gfx_fence_dispatch(fence);
+    ReleaseSRWLockShared(&gfx->fence_lock);
+
+    _kuro_gfx_commands_reset(gfx, commands, depth_target);
+    commands->swapchain = swapchain;
 
-    if (depth_target && depth_target->transition)
+    if (swapchain)
     {
-        depth_target->transition = false;
+        kuro_gfx_state_request(
+            &commands->states,
+            &swapchain->buffer_states[swapchain->swapchain->GetCurrentBackBufferIndex()],
+            D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+            D3D12_RESOURCE_STATE_RENDER_TARGET);
 
-        D3D12_RESOURCE_BARRIER resource_barrier = {};
-        resource_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        resource_barrier.Transition.pResource = depth_target->depth_stencil_buffer;
-        resource_barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        resource_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
-        resource_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_DEPTH_WRITE;
-        commands->command_list->ResourceBarrier(1, &resource_barrier);
+        _kuro_gfx_commands_bind_targets(gfx, commands);
     }
+}
 
-    if (swapchain)
+void
+kuro_gfx_commands_begin_pass(kr_gfx_t gfx, kr_commands_t commands, Kuro_Gfx_Pass_Desc desc)
+{
+    _kuro_gfx_commands_reset(gfx, commands, desc.depth_target);
+
+    for (int i = 0; i < KURO_CONSTANT_MAX_RENDER_TARGETS && desc.color_targets[i]; ++i)
     {
-        D3D12_RESOURCE_BARRIER resource_barrier = {};
-        resource_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        resource_barrier.Transition.pResource = swapchain->buffers[swapchain->swapchain->GetCurrentBackBufferIndex()];
-        resource_barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        resource_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-        resource_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-        commands->command_list->ResourceBarrier(1, &resource_barrier);
+        assert(desc.color_targets[i]->render_target && "color targets must come from kuro_gfx_render_target_create");
+        commands->color_targets[commands->color_target_count++] = desc.color_targets[i];
+        // render targets rest in the render target state, so this is almost always elided
+        kuro_gfx_state_request(&commands->states, &desc.color_targets[i]->state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    }
 
-        commands->command_list->OMSetRenderTargets(
-            1,
-            &swapchain->rtv_descriptor[swapchain->swapchain->GetCurrentBackBufferIndex()],
-            true,
-            depth_target ? &depth_target->dsv_descriptor : nullptr);
+    _kuro_gfx_commands_bind_targets(gfx, commands);
+}
+
+void
+kuro_gfx_commands_split(kr_gfx_t gfx, kr_commands_t commands, uint32_t recorder_count, kr_commands_t *recorders)
+{
+    HRESULT hr = {};
+
+    assert(!commands->split && "the commands are already split");
+    assert(recorder_count <= KURO_CONSTANT_MAX_RECORDERS);
+
+    commands->split = true;
+    commands->recorder_count = recorder_count;
+    int index = commands->current_resource_index;
+
+    // what was recorded so far is closed and kept aside, the rest goes to a second list
+    _kuro_gfx_barriers_flush(commands->command_list, &commands->states);
+    hr = commands->command_list->Close();
+    assert(SUCCEEDED(hr));
+
+    if (commands->split_list == nullptr)
+        _kuro_gfx_command_list_create(gfx, commands->split_allocator, &commands->split_list);
 
-        ID3D12DescriptorHeap *descriptor_heaps[] = {gfx->cbv_heap};
-        commands->command_list->SetDescriptorHeaps(1, descriptor_heaps);
+    ID3D12GraphicsCommandList *command_list = commands->split_list;
+    commands->split_list = commands->command_list;
+    commands->command_list = command_list;
+
+    hr = commands->split_allocator[index]->Reset();
+    assert(SUCCEEDED(hr));
+    hr = commands->command_list->Reset(commands->split_allocator[index], nullptr);
+    assert(SUCCEEDED(hr));
+    kuro_gfx_input_reset(&commands->input);
+    _kuro_gfx_commands_bind_targets(gfx, commands);
+
+    // the recorders are submitted with commands, so its fence also covers their allocators
+    while (commands->recorder_capacity < recorder_count)
+        commands->recorders[commands->recorder_capacity++] = kuro_gfx_commands_create(gfx);
+
+    for (uint32_t i = 0; i < recorder_count; ++i)
+    {
+        kr_commands_t recorder = commands->recorders[i];
+        recorder->parent = commands;
+        recorder->current_resource_index = index;
+        recorder->swapchain = commands->swapchain;
+        memcpy(recorder->color_targets, commands->color_targets, sizeof(commands->color_targets));
+        recorder->color_target_count = commands->color_target_count;
+        recorder->depth_target = commands->depth_target;
+
+        hr = recorder->command_allocator[index]->Reset();
+        assert(SUCCEEDED(hr));
+        hr = recorder->command_list->Reset(recorder->command_allocator[index], nullptr);
+        assert(SUCCEEDED(hr));
+        kuro_gfx_input_reset(&recorder->input);
+        // also clears what the recorder had bound in the previous split
+        _kuro_gfx_commands_bind_targets(gfx, recorder);
+
+        recorders[i] = recorder;
     }
 }
 
@@ -842,20 +1937,46 @@ kuro_gfx_commands_end(kr_gfx_t gfx, kr_commands_t commands)
 
     if (commands->swapchain)
     {
-        D3D12_RESOURCE_BARRIER resource_barrier = {};
-        resource_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        resource_barrier.Transition.pResource = commands->swapchain->buffers[commands->swapchain->swapchain->GetCurrentBackBufferIndex()];
-        resource_barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        resource_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-        resource_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-        commands->command_list->ResourceBarrier(1, &resource_barrier);
+        kuro_gfx_state_request(
+            &commands->states,
+            &commands->swapchain->buffer_states[commands->swapchain->swapchain->GetCurrentBackBufferIndex()],
+            D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+            D3D12_RESOURCE_STATE_PRESENT);
     }
 
+    _kuro_gfx_barriers_flush(commands->command_list, &commands->states);
     hr = commands->command_list->Close();
     assert(SUCCEEDED(hr));
 
-    ID3D12CommandList *cmd_lists[] = { commands->command_list };
-    gfx->command_queue->ExecuteCommandLists(1, cmd_lists);
+    // the commands may use anything uploaded so far, the wait happens on the GPU
+    uint64_t upload_token = kuro_gfx_upload_submit(gfx);
+    if (upload_token)
+        gfx->command_queue->Wait(gfx->copy_fence, upload_token);
+
+    if (commands->split)
+    {
+        ID3D12CommandList *cmd_lists[KURO_CONSTANT_MAX_RECORDERS + 2] = {};
+        uint32_t cmd_list_count = 0;
+        cmd_lists[cmd_list_count++] = commands->split_list;
+        for (uint32_t i = 0; i < commands->recorder_count; ++i)
+        {
+            _kuro_gfx_barriers_flush(commands->recorders[i]->command_list, &commands->recorders[i]->states);
+            hr = commands->recorders[i]->command_list->Close();
+            assert(SUCCEEDED(hr));
+            cmd_lists[cmd_list_count++] = commands->recorders[i]->command_list;
+        }
+        cmd_lists[cmd_list_count++] = commands->command_list;
+        gfx->command_queue->ExecuteCommandLists(cmd_list_count, cmd_lists);
+
+        ID3D12GraphicsCommandList *command_list = commands->split_list;
+        commands->split_list = commands->command_list;
+        commands->command_list = command_list;
+    }
+    else
+    {
+        ID3D12CommandList *cmd_lists[] = { commands->command_list };
+        gfx->command_queue->ExecuteCommandLists(1, cmd_lists);
+    }
 
     if (commands->swapchain)
     {
@@ -866,8 +1987,42 @@ kuro_gfx_commands_end(kr_gfx_t gfx, kr_commands_t commands)
     commands->fence[commands->current_resource_index] = ++gfx->current_fence;
     gfx->command_queue->Signal(gfx->fence, commands->fence[commands->current_resource_index]);
 
+    // the blocks before the first one of a list still recording are in flight until this fence, it is
+    // the newest so it also covers lists that ended earlier. the blocks of this list that come after
+    // are tagged by the end of that other list
+    AcquireSRWLockExclusive(&gfx->upload_lock);
+    _kuro_gfx_upload_unlink(gfx, commands);
+    uint64_t upload_end = gfx->upload_lists ? gfx->upload_lists->upload_start : gfx->upload_ring.head;
+    kuro_gfx_ring_frame_end_at(&gfx->upload_ring, commands->fence[commands->current_resource_index], upload_end);
+    ReleaseSRWLockExclusive(&gfx->upload_lock);
+
+    uint64_t completed_fence = gfx->fence->GetCompletedValue();
+    kuro_gfx_descriptor_retire(&gfx->rtv_descriptors, completed_fence);
+    kuro_gfx_descriptor_retire(&gfx->dsv_descriptors, completed_fence);
+
+    // readbacks recorded in this list become ready with its fence, kuro_gfx_readback_map waits on it
+    for (uint32_t i = 0; i < commands->readback_count; ++i)
+        commands->readbacks[i]->fence = commands->fence[commands->current_resource_index];
+
     commands->swapchain = nullptr;
+    commands->color_target_count = 0;
     commands->depth_target = nullptr;
+    commands->readback_count = 0;
+    commands->recorder_count = 0;
+    commands->split = false;
+}
+
+bool
+kuro_gfx_commands_ready(kr_gfx_t gfx, kr_commands_t commands)
+{
+    // kuro_gfx_commands_begin waits for the fence of the next frame resources
+    return gfx->fence->GetCompletedValue() >= commands->fence[(commands->current_resource_index + 1) % SYNC];
+}
+
+Kuro_Gfx_Input_Stats
+kuro_gfx_commands_input_stats(kr_commands_t commands)
+{
+    return commands->input.stats;
 }
 
 void
@@ -875,6 +2030,13 @@ kuro_gfx_set_pipeline(kr_commands_t commands, kr_pipeline_t pipeline)
 {
     commands->command_list->SetPipelineState(pipeline->pipeline_state);
     commands->command_list->SetGraphicsRootSignature(pipeline->root_signature);
+
+    // a new root signature drops the root arguments
+    for (int i = 0; i < MAX_CONSTANT_BUFFERS; ++i)
+    {
+        if (commands->bound[i])
+            commands->command_list->SetGraphicsRootConstantBufferView(i, commands->bound[i]->address);
+    }
 }
 
 void
@@ -895,36 +2057,95 @@ kuro_gfx_viewport(kr_commands_t commands, uint32_t width, uint32_t height)
 void
 kuro_gfx_clear(kr_commands_t commands, Kuro_Gfx_Color color, float depth)
 {
-    commands->command_list->ClearRenderTargetView(commands->swapchain->rtv_descriptor[commands->swapchain->swapchain->GetCurrentBackBufferIndex()], &color.r, 0, nullptr);
-    commands->command_list->ClearDepthStencilView(commands->depth_target->dsv_descriptor, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+    _kuro_gfx_barriers_flush(commands->command_list, &commands->states);
+    if (commands->swapchain)
+        commands->command_list->ClearRenderTargetView(commands->swapchain->rtv_descriptor[commands->swapchain->swapchain->GetCurrentBackBufferIndex()], &color.r, 0, nullptr);
+    for (uint32_t i = 0; i < commands->color_target_count; ++i)
+        commands->command_list->ClearRenderTargetView(commands->color_targets[i]->rtv_descriptor, &color.r, 0, nullptr);
+    if (commands->depth_target)
+        commands->command_list->ClearDepthStencilView(commands->depth_target->dsv_descriptor, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+}
+
+void
+kuro_gfx_readback(kr_commands_t commands, kr_image_t render_target, kr_readback_t readback)
+{
+    assert(render_target->render_target && "only color render targets can be read back");
+    // the copy writes the whole footprint kuro_gfx_readback_create laid out
+    assert(readback->footprint.Footprint.Width == render_target->width && readback->footprint.Footprint.Height == render_target->height);
+    assert(readback->footprint.Footprint.Format == render_target->render_target_format);
+    assert(commands->parent == nullptr && "recorders do not transition resources, read back before or after the split");
+    assert(commands->readback_count < MAX_PENDING_READBACKS);
+
+    kuro_gfx_state_request(&commands->states, &render_target->state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    _kuro_gfx_barriers_flush(commands->command_list, &commands->states);
+
+    D3D12_TEXTURE_COPY_LOCATION dst = {};
+    dst.pResource = readback->buffer;
+    dst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+    dst.PlacedFootprint = readback->footprint;
+
+    D3D12_TEXTURE_COPY_LOCATION src = {};
+    src.pResource = render_target->render_target;
+    src.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    src.SubresourceIndex = 0;
+
+    commands->command_list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+    // back to its resting state once something needs it, a readback right after cancels this
+    kuro_gfx_state_request(&commands->states, &render_target->state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    // not ready until the list that copies into it has executed
+    readback->fence = UINT64_MAX;
+    commands->readbacks[commands->readback_count++] = readback;
 }
 
 void
 kuro_gfx_buffer_write(kr_commands_t commands, kr_buffer_t buffer, void *data, uint32_t size_in_bytes)
 {
     assert(buffer->cpu_access == KURO_GFX_ACCESS_WRITE);
+    assert(size_in_bytes <= buffer->size_in_bytes);
 
-    HRESULT hr = {};
+    // every write gets a fresh block, so draws recorded before it keep the old content, a partial
+    // write keeps the rest of the buffer through the shadow copy
+    memcpy(buffer->shadow, data, size_in_bytes);
+    buffer->address = _kuro_gfx_upload(commands, buffer->shadow, buffer->size_in_bytes);
 
-    void *mapped_data = nullptr;
-    hr = buffer->buffer[commands->current_resource_index]->Map(0, nullptr, &mapped_data);
-    assert(SUCCEEDED(hr));
-    memcpy(mapped_data, data, size_in_bytes);
-    buffer->buffer[commands->current_resource_index]->Unmap(0, nullptr);
+    for (int i = 0; i < MAX_CONSTANT_BUFFERS; ++i)
+    {
+        if (commands->bound[i] == buffer)
+            commands->command_list->SetGraphicsRootConstantBufferView(i, buffer->address);
+    }
 }
 
 void
 kuro_gfx_buffer_bind(kr_commands_t commands, kr_buffer_t buffer, uint32_t slot)
 {
     assert(buffer->cpu_access == KURO_GFX_ACCESS_WRITE);
-    commands->command_list->SetGraphicsRootDescriptorTable(slot, buffer->cbv[commands->current_resource_index]);
+    assert(slot < MAX_CONSTANT_BUFFERS);
+
+    // a buffer that was never written gets its initial content uploaded
+    if (buffer->address == 0)
+        buffer->address = _kuro_gfx_upload(commands, buffer->shadow, buffer->size_in_bytes);
+
+    commands->bound[slot] = buffer;
+    commands->command_list->SetGraphicsRootConstantBufferView(slot, buffer->address);
 }
 
-void
-kuro_gfx_draw(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc)
+// writable buffers have no resource of their own, the GPU reads their latest block in the upload ring
+static inline D3D12_GPU_VIRTUAL_ADDRESS
+_kuro_gfx_buffer_address(kr_commands_t commands, kr_buffer_t buffer)
 {
-    commands->command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (buffer->cpu_access != KURO_GFX_ACCESS_WRITE)
+        return buffer->buffer->GetGPUVirtualAddress();
+    if (buffer->address == 0)
+        buffer->address = _kuro_gfx_upload(commands, buffer->shadow, buffer->size_in_bytes);
+    return buffer->address;
+}
 
+static void
+_kuro_gfx_draw_buffers(kr_commands_t commands, const Kuro_Gfx_Draw_Desc &desc)
+{
+    Kuro_Gfx_Input_View vertex_views[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
     D3D12_VERTEX_BUFFER_VIEW vertex_buffer_views[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
     for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
     {
@@ -932,33 +2153,81 @@ kuro_gfx_draw(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc)
         if (vertex_buffer == nullptr)
             continue;
 
-        vertex_buffer_views[i].BufferLocation = vertex_buffer->buffer[0]->GetGPUVirtualAddress();
-        vertex_buffer_views[i].SizeInBytes = vertex_buffer->size_in_bytes;
-        vertex_buffer_views[i].StrideInBytes = desc.vertex_buffers[i].stride;
+        vertex_views[i].address = _kuro_gfx_buffer_address(commands, vertex_buffer);
+        vertex_views[i].size_in_bytes = vertex_buffer->size_in_bytes;
+        vertex_views[i].layout = desc.vertex_buffers[i].stride;
+        vertex_buffer_views[i].BufferLocation = vertex_views[i].address;
+        vertex_buffer_views[i].SizeInBytes = vertex_views[i].size_in_bytes;
+        vertex_buffer_views[i].StrideInBytes = vertex_views[i].layout;
     }
-    commands->command_list->IASetVertexBuffers(0, KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES, vertex_buffer_views);
 
+    Kuro_Gfx_Input_View index_view = {};
     if (desc.index_buffer.buffer)
     {
         assert(desc.index_buffer.format == KURO_GFX_FORMAT_R16_UINT || desc.index_buffer.format == KURO_GFX_FORMAT_R32_UINT);
+        index_view.address = _kuro_gfx_buffer_address(commands, desc.index_buffer.buffer);
+        index_view.size_in_bytes = desc.index_buffer.buffer->size_in_bytes;
+        index_view.layout = desc.index_buffer.format;
+    }
 
+    Kuro_Gfx_Input_Changes changes;
+    kuro_gfx_input_draw(&commands->input, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, vertex_views, &index_view, &changes);
+    if (changes.topology)
+        commands->command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    for (uint32_t i = 0; i < changes.range_count; ++i)
+        commands->command_list->IASetVertexBuffers(changes.ranges[i].start, changes.ranges[i].count, vertex_buffer_views + changes.ranges[i].start);
+    if (changes.index_buffer)
+    {
         D3D12_INDEX_BUFFER_VIEW index_buffer_view = {};
-        index_buffer_view.BufferLocation = desc.index_buffer.buffer->buffer[0]->GetGPUVirtualAddress();
-        index_buffer_view.SizeInBytes = desc.index_buffer.buffer->size_in_bytes;
+        index_buffer_view.BufferLocation = index_view.address;
+        index_buffer_view.SizeInBytes = index_view.size_in_bytes;
         index_buffer_view.Format = _kuro_gfx_format_to_dx(desc.index_buffer.format);
         commands->command_list->IASetIndexBuffer(&index_buffer_view);
-
-        commands->command_list->DrawIndexedInstanced(desc.count, 1, 0, 0, 0);
     }
+
+    _kuro_gfx_barriers_flush(commands->command_list, &commands->states);
+}
+
+void
+kuro_gfx_draw(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc)
+{
+    _kuro_gfx_draw_buffers(commands, desc);
+
+    uint32_t instance_count = desc.instance_count ? desc.instance_count : 1;
+    if (desc.index_buffer.buffer)
+        commands->command_list->DrawIndexedInstanced(desc.count, instance_count, desc.first, desc.base_vertex, desc.first_instance);
     else
+        commands->command_list->DrawInstanced(desc.count, instance_count, desc.first, desc.first_instance);
+}
+
+void
+kuro_gfx_draw_indirect(kr_commands_t commands, Kuro_Gfx_Draw_Desc desc, kr_buffer_t arguments, uint32_t offset, uint32_t draw_count)
+{
+    kr_gfx_t gfx = commands->gfx;
+    assert(offset % sizeof(uint32_t) == 0);
+
+    // writable buffers live in the upload ring, which stays in GENERIC_READ, uploaded buffers rest in
+    // COMMON and are promoted to INDIRECT_ARGUMENT by the first ExecuteIndirect that reads them
+    ID3D12Resource *resource = arguments->buffer;
+    uint64_t resource_offset = offset;
+    if (arguments->cpu_access == KURO_GFX_ACCESS_WRITE)
     {
-        commands->command_list->DrawInstanced(desc.count, 1, 0, 0);
+        if (arguments->address == 0)
+            arguments->address = _kuro_gfx_upload(commands, arguments->shadow, arguments->size_in_bytes);
+        resource = gfx->upload_buffer;
+        resource_offset += arguments->address - gfx->upload_address;
     }
+
+    _kuro_gfx_draw_buffers(commands, desc);
+    ID3D12CommandSignature *signature = desc.index_buffer.buffer ? gfx->draw_indexed_signature : gfx->draw_signature;
+    commands->command_list->ExecuteIndirect(signature, draw_count, resource, resource_offset, nullptr, 0);
 }
 
 void
 kuro_gfx_sync(kr_gfx_t gfx)
 {
+    kuro_gfx_upload_wait(gfx, kuro_gfx_upload_submit(gfx));
+
     // advance fence value to mark commands up to this fence point
     gfx->current_fence++;
 
@@ -968,16 +2237,113 @@ kuro_gfx_sync(kr_gfx_t gfx)
     gfx->command_queue->Signal(gfx->fence, gfx->current_fence);
 
     // wait until GPU has completed commands up to this fence point
-    if (gfx->fence->GetCompletedValue() < gfx->current_fence)
+    _kuro_gfx_fence_wait(gfx, gfx->fence, gfx->current_fence, INFINITE);
+
+    // everything submitted so far completed, so is every upload block
+    AcquireSRWLockExclusive(&gfx->upload_lock);
+    kuro_gfx_ring_retire(&gfx->upload_ring, gfx->current_fence);
+    ReleaseSRWLockExclusive(&gfx->upload_lock);
+    kuro_gfx_descriptor_retire(&gfx->rtv_descriptors, gfx->current_fence);
+    kuro_gfx_descriptor_retire(&gfx->dsv_descriptors, gfx->current_fence);
+}
+kr_fence_t
+kuro_gfx_fence_create(kr_gfx_t gfx)
+{
+    kr_fence_t fence = (kr_fence_t)malloc(sizeof(_kr_fence_t));
+    fence->callbacks = nullptr;
+    fence->callback_count = 0;
+    fence->callback_capacity = 0;
+    InitializeSRWLock(&fence->lock);
+
+    HRESULT hr = gfx->device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence->fence));
+    assert(SUCCEEDED(hr));
+
+    AcquireSRWLockExclusive(&gfx->fence_lock);
+    fence->prev = nullptr;
+    fence->next = gfx->fences;
+    if (gfx->fences)
+        gfx->fences->prev = fence;
+    gfx->fences = fence;
+    ReleaseSRWLockExclusive(&gfx->fence_lock);
+
+    return fence;
+}
+
+void
+kuro_gfx_fence_destroy(kr_gfx_t gfx, kr_fence_t fence)
+{
+    kuro_gfx_sync(gfx);
+
+    AcquireSRWLockExclusive(&gfx->fence_lock);
+    if (fence->prev)
+        fence->prev->next = fence->next;
+    else
+        gfx->fences = fence->next;
+    if (fence->next)
+        fence->next->prev = fence->prev;
+    ReleaseSRWLockExclusive(&gfx->fence_lock);
+
+    // parked events keep their own reference
+    fence->fence->Release();
+    free(fence->callbacks);
+    free(fence);
+}
+
+void
+kuro_gfx_fence_signal(kr_gfx_t gfx, kr_fence_t fence, uint64_t value)
+{
+    HRESULT hr = gfx->command_queue->Signal(fence->fence, value);
+    assert(SUCCEEDED(hr));
+}
+
+uint64_t
+kuro_gfx_fence_value(kr_gfx_t, kr_fence_t fence)
+{
+    return fence->fence->GetCompletedValue();
+}
+
+bool
+kuro_gfx_fence_complete(kr_gfx_t, kr_fence_t fence, uint64_t value)
+{
+    if (fence->fence->GetCompletedValue() < value)
+        return false;
+    _kuro_gfx_fence_dispatch(fence);
+    return true;
+}
+
+bool
+kuro_gfx_fence_wait(kr_gfx_t gfx, kr_fence_t fence, uint64_t value, uint64_t timeout_ns)
+{
+    // rounded up to whole milliseconds, just below INFINITE at most
+    DWORD timeout_ms = INFINITE;
+    if (timeout_ns != UINT64_MAX)
     {
-        HANDLE event_handle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+        uint64_t ms = timeout_ns / 1000000 + (timeout_ns % 1000000 != 0);
+        timeout_ms = ms < INFINITE ? (DWORD)ms : INFINITE - 1;
+    }
 
-        // fire event when GPU hits current fence
-        HRESULT hr = gfx->fence->SetEventOnCompletion(gfx->current_fence, event_handle);
-        assert(SUCCEEDED(hr));
+    if (!_kuro_gfx_fence_wait(gfx, fence->fence, value, timeout_ms))
+        return false;
+    _kuro_gfx_fence_dispatch(fence);
+    return true;
+}
 
-        // wait until GPU hits current fence event is fired
-        WaitForSingleObject(event_handle, INFINITE);
-        CloseHandle(event_handle);
+void
+kuro_gfx_fence_callback(kr_gfx_t, kr_fence_t fence, uint64_t value, Kuro_Gfx_Fence_Callback callback, void *user_data)
+{
+    AcquireSRWLockExclusive(&fence->lock);
+    if (fence->callback_count == fence->callback_capacity)
+    {
+        fence->callback_capacity = fence->callback_capacity ? fence->callback_capacity * 2 : 16;
+        fence->callbacks = (_Fence_Callback *)realloc(fence->callbacks, fence->callback_capacity * sizeof(_Fence_Callback));
     }
-}
\ No newline at end of file
+    uint32_t position = fence->callback_count;
+    while (position > 0 && fence->callbacks[position - 1].value > value)
+        --position;
+    memmove(fence->callbacks + position + 1, fence->callbacks + position, (fence->callback_count - position) * sizeof(_Fence_Callback));
+    fence->callbacks[position] = {value, callback, user_data};
+    fence->callback_count++;
+    ReleaseSRWLockExclusive(&fence->lock);
+
+    _kuro_gfx_fence_dispatch(fence);
+}
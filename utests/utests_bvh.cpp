@@ -0,0 +1,281 @@
+#include <kuro/kuro_bvh.h>
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+struct Bvh_Mesh
+{
+    std::vector<kuro::vec3> vertices;
+    std::vector<kuro::u32> indices;
+    kuro::u32 seed;
+
+    kuro::f32
+    random(kuro::f32 lo, kuro::f32 hi)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return lo + (hi - lo) * (kuro::f32)(seed >> 8) / (kuro::f32)(1u << 24);
+    }
+
+    kuro::u32
+    triangle_count() const
+    {
+        return (kuro::u32)indices.size() / 3;
+    }
+};
+
+// a soup of small triangles in a 100 units cube, with a few large ones across it
+static Bvh_Mesh
+bvh_mesh(kuro::u32 triangle_count)
+{
+    Bvh_Mesh mesh = {};
+    mesh.seed = 4242;
+    for (kuro::u32 i = 0; i < triangle_count; ++i)
+    {
+        kuro::f32 size = i % 97 == 0 ? 20.0f : 1.5f;
+        kuro::vec3 c = {mesh.random(-50.0f, 50.0f), mesh.random(-50.0f, 50.0f), mesh.random(-50.0f, 50.0f)};
+        for (int v = 0; v < 3; ++v)
+        {
+            mesh.indices.push_back((kuro::u32)mesh.vertices.size());
+            mesh.vertices.push_back(c + kuro::vec3{mesh.random(-size, size), mesh.random(-size, size), mesh.random(-size, size)});
+        }
+    }
+    return mesh;
+}
+
+static kuro::ray3
+bvh_ray(Bvh_Mesh &mesh)
+{
+    kuro::vec3 origin = {mesh.random(-80.0f, 80.0f), mesh.random(-80.0f, 80.0f), mesh.random(-80.0f, 80.0f)};
+    kuro::vec3 target = {mesh.random(-40.0f, 40.0f), mesh.random(-40.0f, 40.0f), mesh.random(-40.0f, 40.0f)};
+    return kuro::ray3{origin, target - origin};
+}
+
+static bool
+bvh_brute_closest(const Bvh_Mesh &mesh, const kuro::ray3 &ray, kuro::f32 t_max, kuro::bvh_hit &hit)
+{
+    bool found = false;
+    for (kuro::u32 i = 0; i < mesh.triangle_count(); ++i)
+    {
+        const kuro::u32 *triangle = &mesh.indices[3 * i];
+        kuro::f32 t, u, v;
+        if (kuro::ray_triangle_intersect(ray, mesh.vertices[triangle[0]], mesh.vertices[triangle[1]], mesh.vertices[triangle[2]], t, u, v) && t <= t_max)
+        {
+            t_max = t;
+            hit = kuro::bvh_hit{i, t, u, v};
+            found = true;
+        }
+    }
+    return found;
+}
+
+static bool
+bvh_box_overlap(const kuro::aabb3 &a, const kuro::aabb3 &b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static bool
+bvh_box_contains(const kuro::aabb3 &outer, const kuro::aabb3 &inner)
+{
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+static kuro::aabb3
+bvh_lane(const kuro::bvh_node &node, kuro::u32 i)
+{
+    const kuro::aabb3_x4 &b = node.bounds;
+    return kuro::aabb3{{b.min_x[i], b.min_y[i], b.min_z[i]}, {b.max_x[i], b.max_y[i], b.max_z[i]}};
+}
+
+// every primitive sits in exactly one leaf and every box holds what is below it
+static void
+bvh_check(const kuro::bvh &tree)
+{
+    std::vector<int> seen(tree.boxes.size(), 0);
+    std::vector<kuro::u32> stack = {0};
+    while (!stack.empty())
+    {
+        const kuro::bvh_node &node = tree.nodes[stack.back()];
+        stack.pop_back();
+        for (kuro::u32 i = 0; i < 4; ++i)
+        {
+            if (node.child[i] == kuro::U32_MAX)
+            {
+                CHECK(kuro::aabb3_is_empty(bvh_lane(node, i)));
+                continue;
+            }
+
+            if (node.count[i] == 0)
+            {
+                const kuro::bvh_node &child = tree.nodes[node.child[i]];
+                for (kuro::u32 j = 0; j < 4; ++j)
+                    if (child.child[j] != kuro::U32_MAX)
+                        REQUIRE(bvh_box_contains(bvh_lane(node, i), bvh_lane(child, j)));
+                stack.push_back(node.child[i]);
+                continue;
+            }
+
+            CHECK(node.count[i] <= kuro::BVH_MAX_LEAF_SIZE);
+            for (kuro::u32 p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+            {
+                ++seen[tree.primitives[p]];
+                REQUIRE(bvh_box_contains(bvh_lane(node, i), tree.boxes[tree.primitives[p]]));
+            }
+        }
+    }
+
+    for (int count : seen)
+        REQUIRE(count == 1);
+}
+
+// =================================================================================================
+// == BVH ==========================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_bvh]: bvh")
+{
+    SUBCASE("build")
+    {
+        Bvh_Mesh mesh = bvh_mesh(20000);
+
+        kuro::bvh single;
+        kuro::bvh_build(single, mesh.vertices.data(), mesh.indices.data(), mesh.triangle_count(), 1);
+        bvh_check(single);
+
+        kuro::bvh threaded;
+        kuro::bvh_build(threaded, mesh.vertices.data(), mesh.indices.data(), mesh.triangle_count(), 4);
+        bvh_check(threaded);
+
+        // the splits don't depend on the threads, only the order the nodes are stored in
+        CHECK(single.nodes.size() == threaded.nodes.size());
+        CHECK(single.bounds.min == threaded.bounds.min);
+        CHECK(single.bounds.max == threaded.bounds.max);
+        // 4 wide nodes over leaves of up to 4 triangles
+        CHECK(single.nodes.size() < mesh.triangle_count() / 4);
+
+        // small and empty trees
+        for (kuro::u32 count : {0u, 1u, 3u, 4u, 5u, 17u})
+        {
+            kuro::bvh tree;
+            kuro::bvh_build(tree, mesh.vertices.data(), mesh.indices.data(), count, 0);
+            bvh_check(tree);
+            CHECK(tree.nodes.size() >= 1);
+            Bvh_Mesh prefix = mesh;
+            prefix.indices.resize(3 * count);
+            for (int i = 0; i < 20; ++i)
+            {
+                kuro::ray3 ray = bvh_ray(mesh);
+                kuro::bvh_hit expected = {}, hit = {};
+                bool found = bvh_brute_closest(prefix, ray, kuro::F32_MAX, expected);
+                REQUIRE(kuro::bvh_closest_hit(tree, mesh.vertices.data(), mesh.indices.data(), ray, kuro::F32_MAX, hit) == found);
+            }
+            CHECK(kuro::bvh_overlap(tree, kuro::aabb3{{-1e30f, -1e30f, -1e30f}, {1e30f, 1e30f, 1e30f}}, nullptr, 0) == count);
+        }
+
+        // boxes with the same centroid can only be split by count
+        std::vector<kuro::aabb3> same(100, kuro::aabb3{{-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}});
+        kuro::bvh stacked;
+        kuro::bvh_build(stacked, same.data(), (kuro::u32)same.size(), 1);
+        bvh_check(stacked);
+    }
+
+    SUBCASE("closest hit")
+    {
+        Bvh_Mesh mesh = bvh_mesh(5000);
+        kuro::bvh tree;
+        kuro::bvh_build(tree, mesh.vertices.data(), mesh.indices.data(), mesh.triangle_count(), 2);
+
+        int hits = 0;
+        for (int i = 0; i < 500; ++i)
+        {
+            kuro::ray3 ray = bvh_ray(mesh);
+            kuro::f32 t_max = i % 5 == 0 ? 0.5f : kuro::F32_MAX;
+
+            kuro::bvh_hit expected = {}, hit = {};
+            bool found = bvh_brute_closest(mesh, ray, t_max, expected);
+            REQUIRE(kuro::bvh_closest_hit(tree, mesh.vertices.data(), mesh.indices.data(), ray, t_max, hit) == found);
+            REQUIRE(kuro::bvh_any_hit(tree, mesh.vertices.data(), mesh.indices.data(), ray, t_max) == found);
+            if (!found)
+                continue;
+
+            ++hits;
+            REQUIRE(hit.t == expected.t);
+            if (hit.primitive == expected.primitive)
+            {
+                CHECK(hit.u == expected.u);
+                CHECK(hit.v == expected.v);
+            }
+        }
+        // neither all hits nor all misses
+        CHECK(hits > 50);
+        CHECK(hits < 450);
+    }
+
+    SUBCASE("overlap")
+    {
+        Bvh_Mesh mesh = bvh_mesh(5000);
+        kuro::bvh tree;
+        kuro::bvh_build(tree, mesh.vertices.data(), mesh.indices.data(), mesh.triangle_count(), 0);
+
+        std::vector<kuro::u32> found(mesh.triangle_count());
+        for (int i = 0; i < 100; ++i)
+        {
+            kuro::vec3 c = {mesh.random(-60.0f, 60.0f), mesh.random(-60.0f, 60.0f), mesh.random(-60.0f, 60.0f)};
+            kuro::vec3 e = {mesh.random(0.0f, 10.0f), mesh.random(0.0f, 10.0f), mesh.random(0.0f, 10.0f)};
+            kuro::aabb3 query = {c - e, c + e};
+
+            std::vector<kuro::u32> expected;
+            for (kuro::u32 p = 0; p < mesh.triangle_count(); ++p)
+                if (bvh_box_overlap(tree.boxes[p], query))
+                    expected.push_back(p);
+
+            kuro::u32 count = kuro::bvh_overlap(tree, query, found.data(), (kuro::u32)found.size());
+            REQUIRE(count == expected.size());
+            std::sort(found.begin(), found.begin() + count);
+            REQUIRE(std::equal(expected.begin(), expected.end(), found.begin()));
+
+            // the total is reported past the capacity
+            CHECK(kuro::bvh_overlap(tree, query, found.data(), 1) == count);
+        }
+    }
+
+    SUBCASE("refit")
+    {
+        Bvh_Mesh mesh = bvh_mesh(3000);
+        kuro::bvh tree;
+        kuro::bvh_build(tree, mesh.vertices.data(), mesh.indices.data(), mesh.triangle_count(), 1);
+
+        // every triangle drifts on its own, the tree keeps its topology
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            for (kuro::u32 i = 0; i < mesh.triangle_count(); ++i)
+            {
+                kuro::vec3 offset = {mesh.random(-3.0f, 3.0f), mesh.random(-3.0f, 3.0f), mesh.random(-3.0f, 3.0f)};
+                for (int v = 0; v < 3; ++v)
+                    mesh.vertices[mesh.indices[3 * i + v]] += offset;
+            }
+
+            size_t node_count = tree.nodes.size();
+            kuro::bvh_refit(tree, mesh.vertices.data(), mesh.indices.data());
+            CHECK(tree.nodes.size() == node_count);
+            bvh_check(tree);
+
+            for (int i = 0; i < 100; ++i)
+            {
+                kuro::ray3 ray = bvh_ray(mesh);
+                kuro::bvh_hit expected = {}, hit = {};
+                bool found = bvh_brute_closest(mesh, ray, kuro::F32_MAX, expected);
+                REQUIRE(kuro::bvh_closest_hit(tree, mesh.vertices.data(), mesh.indices.data(), ray, kuro::F32_MAX, hit) == found);
+                if (found)
+                    REQUIRE(hit.t == expected.t);
+            }
+        }
+    }
+}
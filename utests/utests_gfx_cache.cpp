@@ -0,0 +1,177 @@
+#include <kuro/gfx_cache.h>
+
+#include <doctest/doctest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const char *CACHE_PATH = "utests_gfx_cache.bin";
+
+// =================================================================================================
+// == GFX CACHE ====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: pipeline cache")
+{
+    SUBCASE("hash")
+    {
+        const char text[] = "the quick brown fox jumps over the lazy dog";
+        uint64_t hash = kuro_gfx_cache_hash(text, sizeof(text), 0);
+        CHECK(hash == kuro_gfx_cache_hash(text, sizeof(text), 0));
+        CHECK(hash != kuro_gfx_cache_hash(text, sizeof(text), 1));
+        CHECK(hash != kuro_gfx_cache_hash(text, sizeof(text) - 1, 0));
+
+        // every byte counts, the tail as well as the words
+        std::vector<uint64_t> hashes;
+        for (size_t i = 0; i < sizeof(text); ++i)
+        {
+            char changed[sizeof(text)];
+            memcpy(changed, text, sizeof(text));
+            changed[i] ^= 1;
+            hashes.push_back(kuro_gfx_cache_hash(changed, sizeof(changed), 0));
+        }
+        for (size_t i = 0; i < hashes.size(); ++i)
+        {
+            CHECK(hashes[i] != hash);
+            for (size_t j = i + 1; j < hashes.size(); ++j)
+                CHECK(hashes[i] != hashes[j]);
+        }
+    }
+
+    SUBCASE("pipeline hash")
+    {
+        const uint8_t vertex_code[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+        const uint8_t pixel_code[] = {9, 8, 7};
+
+        Kuro_Gfx_Pipeline_Desc desc = {};
+        desc.vertex_attribures[0] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+        desc.vertex_attribures[1] = {KURO_GFX_FORMAT_R32G32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 1};
+        uint64_t hash = kuro_gfx_pipeline_hash(desc, vertex_code, sizeof(vertex_code), pixel_code, sizeof(pixel_code));
+
+        // handles, the attributes after the list ends and the default render target count do not matter
+        Kuro_Gfx_Pipeline_Desc same = desc;
+        same.vertex_shader = (kr_vshader_t)&same;
+        same.pixel_shader = (kr_pshader_t)&same;
+        same.vertex_attribures[3] = {KURO_GFX_FORMAT_R32G32_FLOAT, KURO_GFX_CLASS_PER_INSTANCE, 2};
+        same.render_target_count = 1;
+        CHECK(kuro_gfx_pipeline_hash(same, vertex_code, sizeof(vertex_code), pixel_code, sizeof(pixel_code)) == hash);
+
+        Kuro_Gfx_Pipeline_Desc other = desc;
+        other.vertex_attribures[1].slot = 0;
+        CHECK(kuro_gfx_pipeline_hash(other, vertex_code, sizeof(vertex_code), pixel_code, sizeof(pixel_code)) != hash);
+        other = desc;
+        other.render_target_count = 2;
+        CHECK(kuro_gfx_pipeline_hash(other, vertex_code, sizeof(vertex_code), pixel_code, sizeof(pixel_code)) != hash);
+        CHECK(kuro_gfx_pipeline_hash(desc, vertex_code, sizeof(vertex_code) - 1, pixel_code, sizeof(pixel_code)) != hash);
+        CHECK(kuro_gfx_pipeline_hash(desc, vertex_code, sizeof(vertex_code), nullptr, 0) != hash);
+
+        // code moving from one shader to the other changes the key
+        const uint8_t all_code[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 9, 8, 7};
+        CHECK(kuro_gfx_pipeline_hash(desc, all_code, 10, all_code + 10, 2) != hash);
+    }
+
+    SUBCASE("save and load")
+    {
+        remove(CACHE_PATH);
+        kr_cache_t cache = kuro_gfx_cache_open(CACHE_PATH);
+        CHECK(kuro_gfx_cache_count(cache) == 0);
+        CHECK(kuro_gfx_cache_find(cache, 1, nullptr) == nullptr);
+
+        std::vector<uint8_t> blobs[64];
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            blobs[i].resize(i * 7);
+            for (size_t j = 0; j < blobs[i].size(); ++j)
+                blobs[i][j] = (uint8_t)(i + j);
+            kuro_gfx_cache_insert(cache, kuro_gfx_cache_hash(&i, sizeof(i), 0), blobs[i].data(), blobs[i].size());
+        }
+        CHECK(kuro_gfx_cache_count(cache) == 64);
+        REQUIRE(kuro_gfx_cache_save(cache));
+        CHECK(kuro_gfx_cache_count(cache) == 64);
+        kuro_gfx_cache_close(cache);
+
+        // a warm start serves every blob from the mapped file
+        cache = kuro_gfx_cache_open(CACHE_PATH);
+        REQUIRE(kuro_gfx_cache_count(cache) == 64);
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            size_t size = 1;
+            const void *data = kuro_gfx_cache_find(cache, kuro_gfx_cache_hash(&i, sizeof(i), 0), &size);
+            REQUIRE(data);
+            CHECK(size == blobs[i].size());
+            CHECK((size == 0 || memcmp(data, blobs[i].data(), size) == 0));
+            CHECK((uintptr_t)data % 16 == 0);
+        }
+        CHECK(kuro_gfx_cache_find(cache, 12345, nullptr) == nullptr);
+
+        // new entries are merged into the file, replaced ones shadow the mapped data
+        uint32_t key = 64;
+        const char added[] = "added";
+        const char replaced[] = "replaced";
+        kuro_gfx_cache_insert(cache, kuro_gfx_cache_hash(&key, sizeof(key), 0), added, sizeof(added));
+        key = 3;
+        kuro_gfx_cache_insert(cache, kuro_gfx_cache_hash(&key, sizeof(key), 0), replaced, sizeof(replaced));
+        CHECK(kuro_gfx_cache_count(cache) == 65);
+        CHECK(strcmp((const char *)kuro_gfx_cache_find(cache, kuro_gfx_cache_hash(&key, sizeof(key), 0), nullptr), replaced) == 0);
+        REQUIRE(kuro_gfx_cache_save(cache));
+        kuro_gfx_cache_close(cache);
+
+        cache = kuro_gfx_cache_open(CACHE_PATH);
+        CHECK(kuro_gfx_cache_count(cache) == 65);
+        CHECK(strcmp((const char *)kuro_gfx_cache_find(cache, kuro_gfx_cache_hash(&key, sizeof(key), 0), nullptr), replaced) == 0);
+        key = 64;
+        CHECK(strcmp((const char *)kuro_gfx_cache_find(cache, kuro_gfx_cache_hash(&key, sizeof(key), 0), nullptr), added) == 0);
+        kuro_gfx_cache_close(cache);
+        remove(CACHE_PATH);
+    }
+
+    SUBCASE("invalid file")
+    {
+        remove(CACHE_PATH);
+        kr_cache_t cache = kuro_gfx_cache_open(CACHE_PATH);
+        const char blob[] = "pipeline";
+        kuro_gfx_cache_insert(cache, 1, blob, sizeof(blob));
+        kuro_gfx_cache_insert(cache, 2, blob, sizeof(blob));
+        REQUIRE(kuro_gfx_cache_save(cache));
+        kuro_gfx_cache_close(cache);
+
+        FILE *file = fopen(CACHE_PATH, "rb");
+        REQUIRE(file);
+        std::vector<uint8_t> data(4096);
+        data.resize(fread(data.data(), 1, data.size(), file));
+        fclose(file);
+
+        // a truncated file, a blob past the end, a bad magic and unsorted keys all open empty
+        auto check_invalid = [](const std::vector<uint8_t> &bytes) {
+            FILE *file = fopen(CACHE_PATH, "wb");
+            REQUIRE(file);
+            fwrite(bytes.data(), 1, bytes.size(), file);
+            fclose(file);
+            kr_cache_t cache = kuro_gfx_cache_open(CACHE_PATH);
+            CHECK(kuro_gfx_cache_count(cache) == 0);
+            CHECK(kuro_gfx_cache_find(cache, 1, nullptr) == nullptr);
+            kuro_gfx_cache_close(cache);
+        };
+
+        check_invalid(std::vector<uint8_t>(data.begin(), data.end() - 1));
+        check_invalid(std::vector<uint8_t>(data.begin(), data.begin() + 20));
+        std::vector<uint8_t> corrupted = data;
+        corrupted[0] ^= 0xFF;
+        check_invalid(corrupted);
+        // the records follow the 16 byte header, the key of the second one starts at 40
+        corrupted = data;
+        corrupted[40] = 0;
+        check_invalid(corrupted);
+
+        // saving replaces the invalid file
+        cache = kuro_gfx_cache_open(CACHE_PATH);
+        kuro_gfx_cache_insert(cache, 7, blob, sizeof(blob));
+        REQUIRE(kuro_gfx_cache_save(cache));
+        kuro_gfx_cache_close(cache);
+        cache = kuro_gfx_cache_open(CACHE_PATH);
+        CHECK(kuro_gfx_cache_count(cache) == 1);
+        CHECK(kuro_gfx_cache_find(cache, 7, nullptr) != nullptr);
+        kuro_gfx_cache_close(cache);
+        remove(CACHE_PATH);
+    }
+}
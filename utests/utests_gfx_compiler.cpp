@@ -0,0 +1,213 @@
+#include <kuro/gfx_compiler.h>
+
+#include <doctest/doctest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+struct Test_Compiler
+{
+    std::atomic<uint32_t> compile_count;
+    std::atomic<uint32_t> running;
+    std::atomic<uint32_t> max_running;
+    // compiles spin while the gate is closed
+    std::atomic<bool> gate_open;
+};
+
+// the code is the entry point followed by the source, "error" fails to compile
+static void *
+test_compile(void *user_data, Kuro_Gfx_Shader_Source source, size_t *code_size)
+{
+    Test_Compiler *test = (Test_Compiler *)user_data;
+    ++test->compile_count;
+    uint32_t running = ++test->running;
+    uint32_t max_running = test->max_running;
+    while (running > max_running && !test->max_running.compare_exchange_weak(max_running, running))
+        ;
+
+    while (!test->gate_open)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    --test->running;
+
+    if (strcmp(source.entry_point, "error") == 0)
+        return nullptr;
+
+    std::string code = std::string(source.entry_point) + ":" + std::string(source.source, source.source_size);
+    *code_size = code.size() + 1;
+    void *data = malloc(*code_size);
+    memcpy(data, code.c_str(), *code_size);
+    return data;
+}
+
+static Kuro_Gfx_Shader_Source
+test_source(const char *source, const char *entry_point)
+{
+    Kuro_Gfx_Shader_Source result = {};
+    result.source = source;
+    result.source_size = strlen(source);
+    result.entry_point = entry_point;
+    result.profile = "vs_5_0";
+    return result;
+}
+
+// =================================================================================================
+// == GFX COMPILER =================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: shader compiler")
+{
+    SUBCASE("hash")
+    {
+        Kuro_Gfx_Shader_Source source = test_source("float4 main() : SV_Position { return 0; }", "main");
+        uint64_t hash = kuro_gfx_shader_hash(source);
+
+        Kuro_Gfx_Shader_Source other = source;
+        other.entry_point = "main2";
+        CHECK(kuro_gfx_shader_hash(other) != hash);
+        other = source;
+        other.profile = "ps_5_0";
+        CHECK(kuro_gfx_shader_hash(other) != hash);
+        other = source;
+        other.flags = 1;
+        CHECK(kuro_gfx_shader_hash(other) != hash);
+        other = source;
+        other.source_size -= 1;
+        CHECK(kuro_gfx_shader_hash(other) != hash);
+
+        // only the content counts
+        std::string copy = source.source;
+        other = source;
+        other.source = copy.c_str();
+        CHECK(kuro_gfx_shader_hash(other) == hash);
+    }
+
+    SUBCASE("parallel")
+    {
+        Test_Compiler test = {};
+        test.gate_open = true;
+        kr_compiler_t compiler = kuro_gfx_compiler_create(test_compile, &test, 4);
+
+        // all the compiles are queued before any of them finishes
+        test.gate_open = false;
+        std::vector<std::string> sources;
+        for (uint32_t i = 0; i < 16; ++i)
+            sources.push_back("source " + std::to_string(i));
+        std::vector<kr_compile_t> compiles;
+        for (const std::string &source : sources)
+            compiles.push_back(kuro_gfx_compile_submit(compiler, test_source(source.c_str(), "main")));
+        for (kr_compile_t compile : compiles)
+            CHECK_FALSE(kuro_gfx_compile_ready(compile));
+        test.gate_open = true;
+
+        for (size_t i = 0; i < compiles.size(); ++i)
+        {
+            size_t code_size = 0;
+            const char *code = (const char *)kuro_gfx_compile_wait(compiles[i], &code_size);
+            REQUIRE(code);
+            CHECK(std::string(code) == "main:" + sources[i]);
+            CHECK(code_size == strlen(code) + 1);
+            CHECK(kuro_gfx_compile_ready(compiles[i]));
+            kuro_gfx_compile_release(compiles[i]);
+        }
+        CHECK(test.compile_count.load() == 16);
+        CHECK(test.max_running.load() > 1);
+        CHECK(test.max_running.load() <= 4);
+
+        kuro_gfx_compiler_destroy(compiler);
+    }
+
+    SUBCASE("shared and cached")
+    {
+        Test_Compiler test = {};
+        test.gate_open = true;
+        kr_compiler_t compiler = kuro_gfx_compiler_create(test_compile, &test, 2);
+
+        // a submit of a key that is still compiling shares the compile
+        test.gate_open = false;
+        kr_compile_t a = kuro_gfx_compile_submit(compiler, test_source("source", "vs_main"));
+        kr_compile_t b = kuro_gfx_compile_submit(compiler, test_source("source", "vs_main"));
+        kr_compile_t c = kuro_gfx_compile_submit(compiler, test_source("source", "ps_main"));
+        CHECK(a == b);
+        CHECK(a != c);
+        test.gate_open = true;
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(a, nullptr), "vs_main:source") == 0);
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(c, nullptr), "ps_main:source") == 0);
+        kuro_gfx_compile_release(a);
+        // still alive for the second submit
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(b, nullptr), "vs_main:source") == 0);
+        kuro_gfx_compile_release(b);
+        kuro_gfx_compile_release(c);
+        CHECK(test.compile_count.load() == 2);
+
+        // a finished compile is served from the cache
+        kr_compile_t d = kuro_gfx_compile_submit(compiler, test_source("source", "vs_main"));
+        CHECK(kuro_gfx_compile_ready(d));
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(d, nullptr), "vs_main:source") == 0);
+        kuro_gfx_compile_release(d);
+        CHECK(test.compile_count.load() == 2);
+
+        // failures are not cached
+        kr_compile_t e = kuro_gfx_compile_submit(compiler, test_source("source", "error"));
+        CHECK(kuro_gfx_compile_wait(e, nullptr) == nullptr);
+        kuro_gfx_compile_release(e);
+        e = kuro_gfx_compile_submit(compiler, test_source("source", "error"));
+        CHECK(kuro_gfx_compile_wait(e, nullptr) == nullptr);
+        kuro_gfx_compile_release(e);
+        CHECK(test.compile_count.load() == 4);
+
+        // without a file there is nothing to save
+        CHECK_FALSE(kuro_gfx_compiler_cache_save(compiler));
+        kuro_gfx_compiler_destroy(compiler);
+    }
+
+    SUBCASE("cache file")
+    {
+        Test_Compiler test = {};
+        test.gate_open = true;
+        const char *cache_path = "utests_gfx_compiler.bin";
+        remove(cache_path);
+
+        kr_compiler_t compiler = kuro_gfx_compiler_create(test_compile, &test, 2);
+        kuro_gfx_compiler_cache_open(compiler, cache_path);
+        kr_compile_t vertex = kuro_gfx_compile_submit(compiler, test_source("shader", "vs_main"));
+        kr_compile_t pixel = kuro_gfx_compile_submit(compiler, test_source("shader", "ps_main"));
+        kuro_gfx_compile_wait(vertex, nullptr);
+        kuro_gfx_compile_wait(pixel, nullptr);
+        kuro_gfx_compile_release(vertex);
+        kuro_gfx_compile_release(pixel);
+        CHECK(kuro_gfx_compiler_cache_save(compiler));
+        kuro_gfx_compiler_destroy(compiler);
+        CHECK(test.compile_count.load() == 2);
+
+        // a warm start compiles nothing
+        compiler = kuro_gfx_compiler_create(test_compile, &test, 2);
+        kuro_gfx_compiler_cache_open(compiler, cache_path);
+        vertex = kuro_gfx_compile_submit(compiler, test_source("shader", "vs_main"));
+        pixel = kuro_gfx_compile_submit(compiler, test_source("shader", "ps_main"));
+        CHECK(kuro_gfx_compile_ready(vertex));
+        CHECK(kuro_gfx_compile_ready(pixel));
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(vertex, nullptr), "vs_main:shader") == 0);
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(pixel, nullptr), "ps_main:shader") == 0);
+        kuro_gfx_compile_release(vertex);
+        kuro_gfx_compile_release(pixel);
+        CHECK(test.compile_count.load() == 2);
+
+        // a changed source misses
+        kr_compile_t changed = kuro_gfx_compile_submit(compiler, test_source("shader 2", "vs_main"));
+        CHECK(strcmp((const char *)kuro_gfx_compile_wait(changed, nullptr), "vs_main:shader 2") == 0);
+        kuro_gfx_compile_release(changed);
+        CHECK(test.compile_count.load() == 3);
+
+        kuro_gfx_compiler_destroy(compiler);
+        remove(cache_path);
+    }
+}
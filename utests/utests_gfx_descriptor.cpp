@@ -0,0 +1,201 @@
+#include <kuro/gfx_descriptor.h>
+
+#include <doctest/doctest.h>
+
+#include <stdlib.h>
+#include <vector>
+
+// =================================================================================================
+// == GFX DESCRIPTOR ===============================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: descriptor allocator")
+{
+    SUBCASE("alloc")
+    {
+        Kuro_Gfx_Descriptor_Allocator allocator = {};
+        kuro_gfx_descriptor_init(&allocator, 16);
+
+        uint32_t a = 0, b = 0, c = 0, d = 0;
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 1, &a));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 3, &b));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 8, &c));
+        // ranges start at a multiple of their size
+        CHECK(a == 0);
+        CHECK(b == 4);
+        CHECK(c == 8);
+        CHECK(allocator.used == 13);
+
+        // 3 slots left, a range of 4 does not fit
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 4, &d));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 2, &d));
+        CHECK(d == 2);
+
+        // freed ranges are reused by their size class
+        kuro_gfx_descriptor_free(&allocator, b, 0);
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 4, &d));
+        CHECK(d == b);
+        kuro_gfx_descriptor_destroy(&allocator);
+    }
+
+    SUBCASE("split")
+    {
+        Kuro_Gfx_Descriptor_Allocator allocator = {};
+        kuro_gfx_descriptor_init(&allocator, 8);
+
+        uint32_t range = 0;
+        REQUIRE(kuro_gfx_descriptor_alloc(&allocator, 8, &range));
+        kuro_gfx_descriptor_free(&allocator, range, 0);
+
+        // the 8 slot range is split into 1 + 1 + 2 + 4
+        uint32_t slots[4] = {};
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 1, &slots[0]));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 1, &slots[1]));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 2, &slots[2]));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 4, &slots[3]));
+        CHECK(slots[0] == 0);
+        CHECK(slots[1] == 1);
+        CHECK(slots[2] == 2);
+        CHECK(slots[3] == 4);
+        CHECK(allocator.used == 8);
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 1, &range));
+        kuro_gfx_descriptor_destroy(&allocator);
+    }
+
+    SUBCASE("deferred free")
+    {
+        Kuro_Gfx_Descriptor_Allocator allocator = {};
+        kuro_gfx_descriptor_init(&allocator, 4);
+
+        uint32_t slots[4] = {};
+        for (uint32_t &slot : slots)
+            REQUIRE(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+
+        kuro_gfx_descriptor_free(&allocator, slots[2], 5);
+        kuro_gfx_descriptor_free(&allocator, slots[0], 7);
+
+        uint32_t slot = 0;
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+        kuro_gfx_descriptor_retire(&allocator, 4);
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+        kuro_gfx_descriptor_retire(&allocator, 6);
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+        CHECK(slot == slots[2]);
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+        kuro_gfx_descriptor_retire(&allocator, 7);
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+        CHECK(slot == slots[0]);
+        kuro_gfx_descriptor_destroy(&allocator);
+    }
+
+    SUBCASE("long running")
+    {
+        // buffers and tables created and destroyed every frame for far longer than the heap is
+        // large, with three frames in flight, ranges in use never overlap and never run out
+        struct Range
+        {
+            uint32_t index, count;
+        };
+        std::vector<Range> live;
+        std::vector<uint8_t> owner(1024, 0);
+
+        Kuro_Gfx_Descriptor_Allocator allocator = {};
+        kuro_gfx_descriptor_init(&allocator, 1024);
+        srand(3);
+
+        bool exhausted = false;
+        bool overlap = false;
+        for (uint64_t fence = 1; fence < 20000; ++fence)
+        {
+            if (fence > 3)
+                kuro_gfx_descriptor_retire(&allocator, fence - 3);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                uint32_t count = rand() % 4 == 0 ? 1 + rand() % 8 : 1;
+                Range range = {0, count};
+                if (!kuro_gfx_descriptor_alloc(&allocator, count, &range.index))
+                {
+                    exhausted = true;
+                    continue;
+                }
+                for (uint32_t j = 0; j < count; ++j)
+                {
+                    overlap |= owner[range.index + j] != 0;
+                    owner[range.index + j] = 1;
+                }
+                live.push_back(range);
+            }
+
+            while (live.size() > 200)
+            {
+                size_t i = rand() % live.size();
+                for (uint32_t j = 0; j < live[i].count; ++j)
+                    owner[live[i].index + j] = 0;
+                kuro_gfx_descriptor_free(&allocator, live[i].index, fence);
+                live[i] = live.back();
+                live.pop_back();
+            }
+        }
+        CHECK_FALSE(exhausted);
+        CHECK_FALSE(overlap);
+
+        // once everything is back the heap is one range again
+        for (Range &range : live)
+            kuro_gfx_descriptor_free(&allocator, range.index, 0);
+        kuro_gfx_descriptor_retire(&allocator, UINT64_MAX);
+        CHECK(allocator.used == 0);
+        uint32_t all = 0;
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 1024, &all));
+        CHECK(all == 0);
+        kuro_gfx_descriptor_destroy(&allocator);
+    }
+
+    SUBCASE("merge")
+    {
+        // render targets created and destroyed one at a time must not keep a swapchain from
+        // getting its contiguous range
+        Kuro_Gfx_Descriptor_Allocator allocator = {};
+        kuro_gfx_descriptor_init(&allocator, 256);
+
+        uint32_t slots[256] = {};
+        for (uint32_t round = 0; round < 3; ++round)
+        {
+            for (uint32_t &slot : slots)
+                REQUIRE(kuro_gfx_descriptor_alloc(&allocator, 1, &slot));
+            uint32_t range = 0;
+            CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 1, &range));
+
+            // odd slots first, nothing merges until their even buddies come back
+            for (uint32_t i = 1; i < 256; i += 2)
+                kuro_gfx_descriptor_free(&allocator, slots[i], round == 1 ? i : 0);
+            kuro_gfx_descriptor_retire(&allocator, UINT64_MAX);
+            CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 2, &range));
+            for (uint32_t i = 0; i < 256; i += 2)
+                kuro_gfx_descriptor_free(&allocator, slots[i], round == 2 ? 1000 + i : 0);
+            kuro_gfx_descriptor_retire(&allocator, UINT64_MAX);
+            CHECK(allocator.used == 0);
+
+            CHECK(kuro_gfx_descriptor_alloc(&allocator, 2, &range));
+            kuro_gfx_descriptor_free(&allocator, range, 0);
+            CHECK(kuro_gfx_descriptor_alloc(&allocator, 256, &range));
+            CHECK(range == 0);
+            kuro_gfx_descriptor_free(&allocator, range, 0);
+        }
+
+        // capacities that are not a power of two start as several ranges
+        kuro_gfx_descriptor_destroy(&allocator);
+        kuro_gfx_descriptor_init(&allocator, 12);
+        uint32_t range = 0;
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 16, &range));
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 8, &range));
+        CHECK(range == 0);
+        for (uint32_t i = 0; i < 4; ++i)
+            REQUIRE(kuro_gfx_descriptor_alloc(&allocator, 1, &slots[i]));
+        CHECK_FALSE(kuro_gfx_descriptor_alloc(&allocator, 1, &slots[4]));
+        for (uint32_t i = 0; i < 4; ++i)
+            kuro_gfx_descriptor_free(&allocator, slots[i], 0);
+        CHECK(kuro_gfx_descriptor_alloc(&allocator, 4, &range));
+        CHECK(range == 8);
+        kuro_gfx_descriptor_destroy(&allocator);
+    }
+}
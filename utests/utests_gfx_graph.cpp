@@ -0,0 +1,297 @@
+#include <kuro/gfx_graph.h>
+
+#include <doctest/doctest.h>
+
+#include <stdlib.h>
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+struct Graph_Log
+{
+    // passes as their index, barrier batches as -1 - size
+    std::vector<int> events;
+    std::vector<Kuro_Gfx_Graph_Barrier> barriers;
+};
+
+struct Graph_Pass_Data
+{
+    int index;
+};
+
+static void
+graph_pass(void *user_data, void *context)
+{
+    ((Graph_Log *)context)->events.push_back(((Graph_Pass_Data *)user_data)->index);
+}
+
+static void
+graph_barriers(void *context, const Kuro_Gfx_Graph_Barrier *barriers, uint32_t barrier_count)
+{
+    Graph_Log *log = (Graph_Log *)context;
+    log->events.push_back(-1 - (int)barrier_count);
+    log->barriers.insert(log->barriers.end(), barriers, barriers + barrier_count);
+}
+
+static bool
+graph_barrier_is(const Kuro_Gfx_Graph_Barrier &barrier, uint32_t resource, uint32_t before, uint32_t after)
+{
+    return barrier.resource == resource && barrier.before == before && barrier.after == after;
+}
+
+// =================================================================================================
+// == GFX GRAPH ====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: frame graph")
+{
+    const uint32_t RT = KURO_GFX_GRAPH_USAGE_RENDER_TARGET;
+    const uint32_t DEPTH = KURO_GFX_GRAPH_USAGE_DEPTH_WRITE;
+    const uint32_t SHADER = KURO_GFX_GRAPH_USAGE_SHADER_READ;
+    const uint32_t COPY = KURO_GFX_GRAPH_USAGE_COPY_SOURCE;
+    const uint32_t PRESENT = KURO_GFX_GRAPH_USAGE_PRESENT;
+
+    SUBCASE("culling")
+    {
+        kr_graph_t graph = kuro_gfx_graph_create();
+        uint32_t backbuffer = kuro_gfx_graph_import(graph, PRESENT, PRESENT);
+        uint32_t unused = kuro_gfx_graph_transient(graph, 256, 16);
+        uint32_t shadow = kuro_gfx_graph_transient(graph, 256, 16);
+        uint32_t chain = kuro_gfx_graph_transient(graph, 256, 16);
+
+        // 1 feeds 3 which draws the backbuffer, 4 has side effects, 0 and 2 only feed 5 which writes
+        // nothing that is read later
+        uint32_t a = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, a, unused, RT);
+        uint32_t b = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, b, shadow, DEPTH);
+        uint32_t c = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, c, chain, RT);
+        uint32_t d = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, d, shadow, SHADER);
+        kuro_gfx_graph_use(graph, d, backbuffer, RT);
+        uint32_t e = kuro_gfx_graph_pass(graph, nullptr, nullptr, true);
+        uint32_t f = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, f, chain, SHADER);
+        kuro_gfx_graph_use(graph, f, unused, RT);
+        kuro_gfx_graph_compile(graph);
+
+        CHECK(kuro_gfx_graph_culled(graph, a));
+        CHECK_FALSE(kuro_gfx_graph_culled(graph, b));
+        CHECK(kuro_gfx_graph_culled(graph, c));
+        CHECK_FALSE(kuro_gfx_graph_culled(graph, d));
+        CHECK_FALSE(kuro_gfx_graph_culled(graph, e));
+        CHECK(kuro_gfx_graph_culled(graph, f));
+
+        // culled passes get no barriers and their resources no memory
+        uint32_t count = 0;
+        kuro_gfx_graph_barriers(graph, a, &count);
+        CHECK(count == 0);
+        CHECK(kuro_gfx_graph_memory_size(graph) == 256);
+
+        // a pass drawing over a surviving write keeps the writer alive
+        kuro_gfx_graph_reset(graph);
+        backbuffer = kuro_gfx_graph_import(graph, RT, 0);
+        uint32_t color = kuro_gfx_graph_transient(graph, 64, 64);
+        a = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, a, color, RT);
+        b = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, b, color, RT);
+        c = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, c, color, COPY);
+        kuro_gfx_graph_use(graph, c, backbuffer, RT);
+        kuro_gfx_graph_compile(graph);
+        CHECK_FALSE(kuro_gfx_graph_culled(graph, a));
+        CHECK_FALSE(kuro_gfx_graph_culled(graph, b));
+        CHECK_FALSE(kuro_gfx_graph_culled(graph, c));
+
+        kuro_gfx_graph_destroy(graph);
+    }
+
+    SUBCASE("barriers")
+    {
+        kr_graph_t graph = kuro_gfx_graph_create();
+        uint32_t backbuffer = kuro_gfx_graph_import(graph, PRESENT, PRESENT);
+        uint32_t color = kuro_gfx_graph_transient(graph, 1024, 256);
+        uint32_t depth = kuro_gfx_graph_transient(graph, 1024, 256);
+
+        // 0 draws color and depth, 1 and 2 read color in two ways, 3 draws the backbuffer with it
+        uint32_t passes[4] = {};
+        for (uint32_t i = 0; i < 4; ++i)
+            passes[i] = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+        kuro_gfx_graph_use(graph, passes[0], color, RT);
+        kuro_gfx_graph_use(graph, passes[0], depth, DEPTH);
+        kuro_gfx_graph_use(graph, passes[1], color, SHADER);
+        kuro_gfx_graph_use(graph, passes[1], depth, KURO_GFX_GRAPH_USAGE_DEPTH_READ);
+        kuro_gfx_graph_use(graph, passes[2], color, COPY);
+        kuro_gfx_graph_use(graph, passes[2], depth, KURO_GFX_GRAPH_USAGE_DEPTH_READ);
+        kuro_gfx_graph_use(graph, passes[3], color, SHADER);
+        kuro_gfx_graph_use(graph, passes[3], backbuffer, RT);
+        kuro_gfx_graph_use(graph, passes[1], backbuffer, RT);
+        kuro_gfx_graph_use(graph, passes[2], backbuffer, RT);
+        kuro_gfx_graph_compile(graph);
+
+        uint32_t count = 0;
+        const Kuro_Gfx_Graph_Barrier *barriers = kuro_gfx_graph_barriers(graph, passes[0], &count);
+        REQUIRE(count == 2);
+        CHECK(graph_barrier_is(barriers[0], color, 0, RT));
+        CHECK(graph_barrier_is(barriers[1], depth, 0, DEPTH));
+        CHECK_FALSE(barriers[0].aliasing);
+
+        // the three reads of color share one combined state
+        barriers = kuro_gfx_graph_barriers(graph, passes[1], &count);
+        REQUIRE(count == 3);
+        CHECK(graph_barrier_is(barriers[0], color, RT, SHADER | COPY));
+        CHECK(graph_barrier_is(barriers[1], depth, DEPTH, KURO_GFX_GRAPH_USAGE_DEPTH_READ));
+        CHECK(graph_barrier_is(barriers[2], backbuffer, PRESENT, RT));
+        kuro_gfx_graph_barriers(graph, passes[2], &count);
+        CHECK(count == 0);
+        kuro_gfx_graph_barriers(graph, passes[3], &count);
+        CHECK(count == 0);
+
+        barriers = kuro_gfx_graph_final_barriers(graph, &count);
+        REQUIRE(count == 1);
+        CHECK(graph_barrier_is(barriers[0], backbuffer, RT, PRESENT));
+        CHECK(kuro_gfx_graph_barrier_count(graph) == 6);
+
+        // color and depth are alive together
+        CHECK(kuro_gfx_graph_memory_size(graph) == 2048);
+        CHECK(kuro_gfx_graph_offset(graph, color) != kuro_gfx_graph_offset(graph, depth));
+
+        kuro_gfx_graph_destroy(graph);
+    }
+
+    SUBCASE("aliasing")
+    {
+        kr_graph_t graph = kuro_gfx_graph_create();
+        uint32_t output = kuro_gfx_graph_import(graph, COPY, COPY);
+        uint32_t first = kuro_gfx_graph_transient(graph, 100, 64);
+        uint32_t second = kuro_gfx_graph_transient(graph, 100, 64);
+        uint32_t middle = kuro_gfx_graph_transient(graph, 50, 64);
+
+        // first lives in 0-1, middle in 1-2, second in 2-3
+        uint32_t passes[4] = {};
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            passes[i] = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+            kuro_gfx_graph_use(graph, passes[i], output, RT);
+        }
+        kuro_gfx_graph_use(graph, passes[0], first, RT);
+        kuro_gfx_graph_use(graph, passes[1], first, SHADER);
+        kuro_gfx_graph_use(graph, passes[1], middle, RT);
+        kuro_gfx_graph_use(graph, passes[2], middle, SHADER);
+        kuro_gfx_graph_use(graph, passes[2], second, RT);
+        kuro_gfx_graph_use(graph, passes[3], second, SHADER);
+        kuro_gfx_graph_compile(graph);
+
+        CHECK(kuro_gfx_graph_offset(graph, first) == 0);
+        CHECK(kuro_gfx_graph_offset(graph, second) == 0);
+        CHECK(kuro_gfx_graph_offset(graph, middle) == 128);
+        CHECK(kuro_gfx_graph_memory_size(graph) == 178);
+
+        uint32_t count = 0;
+        const Kuro_Gfx_Graph_Barrier *barriers = kuro_gfx_graph_barriers(graph, passes[2], &count);
+        bool found = false;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (barriers[i].resource == second)
+            {
+                found = true;
+                CHECK(graph_barrier_is(barriers[i], second, 0, RT));
+                CHECK(barriers[i].aliasing);
+            }
+            if (barriers[i].resource == middle)
+                CHECK_FALSE(barriers[i].aliasing);
+        }
+        CHECK(found);
+
+        kuro_gfx_graph_destroy(graph);
+    }
+
+    SUBCASE("random placement")
+    {
+        srand(7);
+        kr_graph_t graph = kuro_gfx_graph_create();
+        for (int round = 0; round < 50; ++round)
+        {
+            kuro_gfx_graph_reset(graph);
+            uint32_t output = kuro_gfx_graph_import(graph, 0, 0);
+            const uint32_t transient_count = 24;
+            uint32_t pass_count = 4 + rand() % 12;
+            std::vector<uint64_t> sizes(transient_count);
+            std::vector<uint64_t> alignments(transient_count);
+            for (uint32_t i = 0; i < transient_count; ++i)
+            {
+                sizes[i] = 1 + rand() % 5000;
+                alignments[i] = (uint64_t)1 << (rand() % 9);
+                kuro_gfx_graph_transient(graph, sizes[i], alignments[i]);
+            }
+
+            std::vector<uint32_t> first(transient_count, UINT32_MAX), last(transient_count, 0);
+            for (uint32_t p = 0; p < pass_count; ++p)
+            {
+                uint32_t pass = kuro_gfx_graph_pass(graph, nullptr, nullptr, false);
+                kuro_gfx_graph_use(graph, pass, output, RT);
+                for (uint32_t i = 0; i < transient_count; ++i)
+                {
+                    if (rand() % 4 != 0)
+                        continue;
+                    kuro_gfx_graph_use(graph, pass, 1 + i, rand() % 2 ? RT : SHADER);
+                    if (first[i] == UINT32_MAX)
+                        first[i] = p;
+                    last[i] = p;
+                }
+            }
+            kuro_gfx_graph_compile(graph);
+
+            uint64_t total = 0;
+            for (uint32_t i = 0; i < transient_count; ++i)
+            {
+                if (first[i] == UINT32_MAX)
+                    continue;
+                uint64_t offset = kuro_gfx_graph_offset(graph, 1 + i);
+                CHECK(offset % alignments[i] == 0);
+                CHECK(offset + sizes[i] <= kuro_gfx_graph_memory_size(graph));
+                total += sizes[i];
+                for (uint32_t j = 0; j < i; ++j)
+                {
+                    if (first[j] == UINT32_MAX || first[i] > last[j] || first[j] > last[i])
+                        continue;
+                    uint64_t other = kuro_gfx_graph_offset(graph, 1 + j);
+                    CHECK((offset + sizes[i] <= other || other + sizes[j] <= offset));
+                }
+            }
+            CHECK(kuro_gfx_graph_memory_size(graph) <= total + 24 * 256);
+        }
+        kuro_gfx_graph_destroy(graph);
+    }
+
+    SUBCASE("execute")
+    {
+        kr_graph_t graph = kuro_gfx_graph_create();
+        uint32_t backbuffer = kuro_gfx_graph_import(graph, PRESENT, PRESENT);
+        uint32_t color = kuro_gfx_graph_transient(graph, 64, 64);
+
+        Graph_Pass_Data data[3] = {{0}, {1}, {2}};
+        uint32_t scene = kuro_gfx_graph_pass(graph, graph_pass, &data[0], false);
+        kuro_gfx_graph_use(graph, scene, color, RT);
+        uint32_t unused = kuro_gfx_graph_pass(graph, graph_pass, &data[1], false);
+        kuro_gfx_graph_use(graph, unused, color, COPY);
+        uint32_t post = kuro_gfx_graph_pass(graph, graph_pass, &data[2], false);
+        kuro_gfx_graph_use(graph, post, color, SHADER);
+        kuro_gfx_graph_use(graph, post, backbuffer, RT);
+        kuro_gfx_graph_compile(graph);
+
+        // a pass that only reads is culled as well
+        Graph_Log log;
+        kuro_gfx_graph_execute(graph, graph_barriers, &log);
+        CHECK(log.events == std::vector<int>{-2, 0, -3, 2, -2});
+        REQUIRE(log.barriers.size() == 4);
+        CHECK(graph_barrier_is(log.barriers[0], color, 0, RT));
+        CHECK(graph_barrier_is(log.barriers[1], color, RT, SHADER));
+        CHECK(graph_barrier_is(log.barriers[2], backbuffer, PRESENT, RT));
+        CHECK(graph_barrier_is(log.barriers[3], backbuffer, RT, PRESENT));
+
+        kuro_gfx_graph_destroy(graph);
+    }
+}
@@ -0,0 +1,148 @@
+#include <kuro/gfx_input.h>
+
+#include <doctest/doctest.h>
+
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+static const uint32_t INPUT_TRIANGLES = 4;
+
+// records the set calls a backend would make for the changes, like the D3D12 backend does
+struct Input_Recorder
+{
+    Kuro_Gfx_Input_Cache cache;
+    uint32_t calls;
+    std::vector<Kuro_Gfx_Input_Range> ranges;
+};
+
+static void
+input_draw(Input_Recorder &recorder, const Kuro_Gfx_Input_View *vertex_buffers, const Kuro_Gfx_Input_View *index_buffer = nullptr)
+{
+    Kuro_Gfx_Input_Changes changes;
+    kuro_gfx_input_draw(&recorder.cache, INPUT_TRIANGLES, vertex_buffers, index_buffer, &changes);
+    recorder.calls += (changes.topology ? 1 : 0) + changes.range_count + (changes.index_buffer ? 1 : 0);
+    recorder.ranges.assign(changes.ranges, changes.ranges + changes.range_count);
+}
+
+static Kuro_Gfx_Input_View
+input_view(uint64_t address, uint32_t layout = 24)
+{
+    return Kuro_Gfx_Input_View{address, 1024, layout};
+}
+
+// =================================================================================================
+// == GFX INPUT ====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: input cache")
+{
+    SUBCASE("redundant draws")
+    {
+        Input_Recorder recorder = {};
+        kuro_gfx_input_init(&recorder.cache);
+
+        Kuro_Gfx_Input_View vertex_buffers[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
+        vertex_buffers[0] = input_view(0x1000);
+        vertex_buffers[1] = input_view(0x2000, 12);
+        Kuro_Gfx_Input_View index_buffer = input_view(0x3000, KURO_GFX_FORMAT_R32_UINT);
+
+        // the first draw sets everything, the same geometry again sets nothing
+        input_draw(recorder, vertex_buffers, &index_buffer);
+        CHECK(recorder.calls == 3);
+        REQUIRE(recorder.ranges.size() == 1);
+        CHECK(recorder.ranges[0].start == 0);
+        CHECK(recorder.ranges[0].count == 2);
+        for (int i = 0; i < 9; ++i)
+            input_draw(recorder, vertex_buffers, &index_buffer);
+        CHECK(recorder.calls == 3);
+
+        // a draw without indices keeps the index buffer bound for the next indexed draw
+        input_draw(recorder, vertex_buffers);
+        input_draw(recorder, vertex_buffers, &index_buffer);
+        CHECK(recorder.calls == 3);
+
+        // the stride and the size of a view are part of it
+        vertex_buffers[1].layout = 16;
+        input_draw(recorder, vertex_buffers, &index_buffer);
+        index_buffer.size_in_bytes = 512;
+        input_draw(recorder, vertex_buffers, &index_buffer);
+        CHECK(recorder.calls == 5);
+
+        Kuro_Gfx_Input_Stats stats = recorder.cache.stats;
+        CHECK(stats.draws == 14);
+        CHECK(stats.topology_sets == 1);
+        CHECK(stats.vertex_buffer_sets == 2);
+        CHECK(stats.vertex_buffer_views == 3);
+        CHECK(stats.index_buffer_sets == 2);
+    }
+
+    SUBCASE("ranges")
+    {
+        Input_Recorder recorder = {};
+        kuro_gfx_input_init(&recorder.cache);
+
+        Kuro_Gfx_Input_View vertex_buffers[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
+        for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; ++i)
+            vertex_buffers[i] = input_view(0x1000 * (i + 1));
+        input_draw(recorder, vertex_buffers);
+        REQUIRE(recorder.ranges.size() == 1);
+        CHECK(recorder.ranges[0].count == KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES);
+
+        // only the runs of changed slots are set
+        vertex_buffers[2].address += 0x100000;
+        vertex_buffers[3].address += 0x100000;
+        vertex_buffers[7].address += 0x100000;
+        vertex_buffers[15].address += 0x100000;
+        input_draw(recorder, vertex_buffers);
+        REQUIRE(recorder.ranges.size() == 3);
+        CHECK(recorder.ranges[0].start == 2);
+        CHECK(recorder.ranges[0].count == 2);
+        CHECK(recorder.ranges[1].start == 7);
+        CHECK(recorder.ranges[1].count == 1);
+        CHECK(recorder.ranges[2].start == 15);
+        CHECK(recorder.ranges[2].count == 1);
+
+        // null slots are not read by the draw and keep what is bound
+        Kuro_Gfx_Input_View sparse[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
+        sparse[0] = vertex_buffers[0];
+        sparse[5] = input_view(0x900000);
+        input_draw(recorder, sparse);
+        REQUIRE(recorder.ranges.size() == 1);
+        CHECK(recorder.ranges[0].start == 5);
+        input_draw(recorder, vertex_buffers);
+        REQUIRE(recorder.ranges.size() == 1);
+        CHECK(recorder.ranges[0].start == 5);
+
+        // every other slot changed is the most runs a draw can have
+        for (uint32_t i = 0; i < KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES; i += 2)
+            vertex_buffers[i].address += 0x100000;
+        input_draw(recorder, vertex_buffers);
+        CHECK(recorder.ranges.size() == KURO_GFX_INPUT_CONSTANT_MAX_RANGES);
+    }
+
+    SUBCASE("reset")
+    {
+        Input_Recorder recorder = {};
+        kuro_gfx_input_init(&recorder.cache);
+
+        Kuro_Gfx_Input_View vertex_buffers[KURO_CONSTANT_MAX_VERTEX_ATTRIPUTES] = {};
+        vertex_buffers[0] = input_view(0x1000);
+        Kuro_Gfx_Input_View index_buffer = input_view(0x3000, KURO_GFX_FORMAT_R16_UINT);
+
+        // a reset list has nothing bound, every frame sets its state once
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            kuro_gfx_input_reset(&recorder.cache);
+            for (int draw = 0; draw < 5; ++draw)
+                input_draw(recorder, vertex_buffers, &index_buffer);
+        }
+        CHECK(recorder.calls == 9);
+
+        Kuro_Gfx_Input_Stats stats = recorder.cache.stats;
+        CHECK(stats.draws == 15);
+        CHECK(stats.topology_sets == 3);
+        CHECK(stats.vertex_buffer_sets == 3);
+        CHECK(stats.index_buffer_sets == 3);
+    }
+}
@@ -0,0 +1,175 @@
+#include <kuro/gfx_ring.h>
+
+#include <doctest/doctest.h>
+
+#include <stdlib.h>
+#include <vector>
+
+// =================================================================================================
+// == GFX RING =====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: ring")
+{
+    SUBCASE("alloc")
+    {
+        Kuro_Gfx_Ring ring = {};
+        kuro_gfx_ring_init(&ring, 1024);
+
+        uint64_t offset = ~0ull;
+        CHECK(kuro_gfx_ring_alloc(&ring, 100, 256, &offset));
+        CHECK(offset == 0);
+        CHECK(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        CHECK(offset == 256);
+        CHECK(kuro_gfx_ring_alloc(&ring, 4, 4, &offset));
+        CHECK(offset == 512);
+
+        // the range is full until a frame retires
+        CHECK(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        CHECK(offset == 768);
+        CHECK_FALSE(kuro_gfx_ring_alloc(&ring, 1, 1, &offset));
+        CHECK_FALSE(kuro_gfx_ring_alloc(&ring, 2048, 256, &offset));
+    }
+
+    SUBCASE("frames")
+    {
+        Kuro_Gfx_Ring ring = {};
+        kuro_gfx_ring_init(&ring, 1024);
+        uint64_t offset = 0;
+
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 0);
+        kuro_gfx_ring_frame_end(&ring, 1);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 0);
+
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 512, 256, &offset));
+        kuro_gfx_ring_frame_end(&ring, 2);
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        kuro_gfx_ring_frame_end(&ring, 3);
+        kuro_gfx_ring_frame_end(&ring, 4);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 2);
+
+        // 768 in flight, a block that does not fit at the end wraps to the start
+        CHECK_FALSE(kuro_gfx_ring_alloc(&ring, 512, 256, &offset));
+        kuro_gfx_ring_retire(&ring, 1);
+        CHECK_FALSE(kuro_gfx_ring_alloc(&ring, 512, 256, &offset));
+        kuro_gfx_ring_retire(&ring, 2);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 3);
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 512, 256, &offset));
+        CHECK(offset == 0);
+
+        kuro_gfx_ring_frame_end(&ring, 5);
+        kuro_gfx_ring_retire(&ring, 5);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 0);
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 1024, 256, &offset));
+        CHECK(offset == 0);
+    }
+
+    SUBCASE("frame overflow")
+    {
+        // more frames in flight than slots extend the newest one
+        Kuro_Gfx_Ring ring = {};
+        kuro_gfx_ring_init(&ring, 4096);
+        uint64_t offset = 0;
+        for (uint64_t fence = 1; fence <= KURO_GFX_RING_CONSTANT_MAX_FRAMES + 4; ++fence)
+        {
+            REQUIRE(kuro_gfx_ring_alloc(&ring, 16, 16, &offset));
+            kuro_gfx_ring_frame_end(&ring, fence);
+        }
+
+        kuro_gfx_ring_retire(&ring, KURO_GFX_RING_CONSTANT_MAX_FRAMES - 1);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == KURO_GFX_RING_CONSTANT_MAX_FRAMES + 4);
+        kuro_gfx_ring_retire(&ring, KURO_GFX_RING_CONSTANT_MAX_FRAMES);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == KURO_GFX_RING_CONSTANT_MAX_FRAMES + 4);
+        kuro_gfx_ring_retire(&ring, KURO_GFX_RING_CONSTANT_MAX_FRAMES + 4);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 0);
+        CHECK(ring.head == ring.tail);
+    }
+
+    SUBCASE("frame end at")
+    {
+        // two lists record at once, the first one to end only owns what came before the other
+        Kuro_Gfx_Ring ring = {};
+        kuro_gfx_ring_init(&ring, 1024);
+        uint64_t offset = 0;
+
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        uint64_t second = ring.head;
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+
+        kuro_gfx_ring_frame_end_at(&ring, 1, second);
+        kuro_gfx_ring_retire(&ring, 1);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 0);
+        CHECK(ring.head - ring.tail == 512);
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        CHECK(offset == 768);
+        REQUIRE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+        CHECK(offset == 0);
+        CHECK_FALSE(kuro_gfx_ring_alloc(&ring, 256, 256, &offset));
+
+        // the same end again is not a new frame
+        kuro_gfx_ring_frame_end_at(&ring, 2, second);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 0);
+
+        kuro_gfx_ring_frame_end_at(&ring, 3, ring.head);
+        CHECK(kuro_gfx_ring_oldest_fence(&ring) == 3);
+        kuro_gfx_ring_retire(&ring, 3);
+        CHECK(ring.head == ring.tail);
+    }
+
+    SUBCASE("frames in flight")
+    {
+        // three frames in flight like the D3D12 backend, blocks of a frame must not be handed out
+        // again before its fence completes
+        struct Block
+        {
+            uint64_t offset, size, fence;
+        };
+        std::vector<Block> live;
+
+        Kuro_Gfx_Ring ring = {};
+        kuro_gfx_ring_init(&ring, 64 * 1024);
+        srand(5);
+
+        uint64_t completed = 0;
+        for (uint64_t fence = 1; fence < 500; ++fence)
+        {
+            // the GPU lags three frames behind
+            if (fence > 3)
+            {
+                completed = fence - 3;
+                kuro_gfx_ring_retire(&ring, completed);
+                for (size_t i = 0; i < live.size();)
+                {
+                    if (live[i].fence <= completed)
+                    {
+                        live[i] = live.back();
+                        live.pop_back();
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                }
+            }
+
+            int count = rand() % 40;
+            for (int i = 0; i < count; ++i)
+            {
+                uint64_t size = 1 + rand() % 600;
+                uint64_t offset = 0;
+                if (!kuro_gfx_ring_alloc(&ring, size, 256, &offset))
+                    continue;
+
+                CHECK(offset % 256 == 0);
+                CHECK(offset + size <= 64 * 1024);
+                for (const Block &block : live)
+                {
+                    bool overlap = offset < block.offset + block.size && block.offset < offset + size;
+                    CHECK_FALSE(overlap);
+                }
+                live.push_back({offset, size, fence});
+            }
+            kuro_gfx_ring_frame_end(&ring, fence);
+        }
+    }
+}
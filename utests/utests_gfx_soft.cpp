@@ -0,0 +1,1232 @@
+#include <kuro/gfx.h>
+#include <kuro/gfx_cache.h>
+#include <kuro/gfx_graph.h>
+#include <kuro/gfx_soft.h>
+
+#include <doctest/doctest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+struct Soft_Vertex
+{
+    float x, y, z;
+    float r, g, b;
+};
+
+static const uint32_t SOFT_WIDTH = 200;
+static const uint32_t SOFT_HEIGHT = 150;
+
+// every pixel shader invocation lands in a single tile, so no two threads touch the same pixel
+static std::vector<uint32_t> soft_hits;
+
+static void
+soft_vs_main(const Kuro_Gfx_Soft_Vertex *vertex, float position[4], float *varyings)
+{
+    position[0] = vertex->attributes[0];
+    position[1] = vertex->attributes[1];
+    position[2] = vertex->attributes[2];
+    position[3] = 1.0f;
+    varyings[0] = vertex->attributes[3];
+    varyings[1] = vertex->attributes[4];
+    varyings[2] = vertex->attributes[5];
+}
+
+// instances move the vertex by (x, y) of their attribute and replace its blue with z
+static void
+soft_vs_instanced(const Kuro_Gfx_Soft_Vertex *vertex, float position[4], float *varyings)
+{
+    position[0] = vertex->attributes[0] + vertex->attributes[6];
+    position[1] = vertex->attributes[1] + vertex->attributes[7];
+    position[2] = vertex->attributes[2];
+    position[3] = 1.0f;
+    varyings[0] = vertex->attributes[3];
+    varyings[1] = vertex->attributes[4];
+    varyings[2] = vertex->attributes[8];
+}
+
+static void
+soft_ps_main(const Kuro_Gfx_Soft_Pixels *pixels, float *color)
+{
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        if ((pixels->mask & (1u << i)) == 0)
+            continue;
+        soft_hits[pixels->y * SOFT_WIDTH + pixels->x + i]++;
+        color[i] = pixels->varyings[i];
+        color[8 + i] = pixels->varyings[8 + i];
+        color[16 + i] = pixels->varyings[16 + i];
+        color[24 + i] = 1.0f;
+    }
+}
+
+static void
+soft_ps_constant(const Kuro_Gfx_Soft_Pixels *pixels, float *color)
+{
+    const float *constant = (const float *)pixels->constants[0];
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        color[i] = constant[0];
+        color[8 + i] = constant[1];
+        color[16 + i] = constant[2];
+        color[24 + i] = 1.0f;
+    }
+}
+
+static void
+soft_ps_targets(const Kuro_Gfx_Soft_Pixels *pixels, float *color)
+{
+    // target 0 gets the color, target 1 its complement
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            color[c * 8 + i] = pixels->varyings[c * 8 + i];
+            color[(4 + c) * 8 + i] = 1.0f - pixels->varyings[c * 8 + i];
+        }
+        color[3 * 8 + i] = 1.0f;
+        color[7 * 8 + i] = 1.0f;
+    }
+}
+
+struct Soft_Scene
+{
+    kr_gfx_t gfx;
+    kr_swapchain_t swapchain;
+    kr_image_t depth;
+    kr_vshader_t vertex_shader;
+    kr_pshader_t pixel_shader;
+    kr_pipeline_t pipeline;
+    kr_commands_t commands;
+};
+
+static Soft_Scene
+soft_scene_create(uint32_t thread_count, const char *pixel_entry_point = "ps_main")
+{
+    Soft_Scene scene = {};
+    scene.gfx = kuro_gfx_soft_create(thread_count);
+    kuro_gfx_soft_vertex_shader_register(scene.gfx, "vs_main", soft_vs_main, 3);
+    kuro_gfx_soft_vertex_shader_register(scene.gfx, "vs_instanced", soft_vs_instanced, 3);
+    kuro_gfx_soft_pixel_shader_register(scene.gfx, "ps_main", soft_ps_main);
+    kuro_gfx_soft_pixel_shader_register(scene.gfx, "ps_constant", soft_ps_constant);
+    kuro_gfx_soft_pixel_shader_register(scene.gfx, "ps_targets", soft_ps_targets);
+
+    scene.swapchain = kuro_gfx_swapchain_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT, nullptr);
+    scene.depth = kuro_gfx_image_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT);
+    scene.vertex_shader = kuro_gfx_vertex_shader_create(scene.gfx, "", "vs_main");
+    scene.pixel_shader = kuro_gfx_pixel_shader_create(scene.gfx, "", pixel_entry_point);
+
+    Kuro_Gfx_Pipeline_Desc desc = {};
+    desc.vertex_shader = scene.vertex_shader;
+    desc.pixel_shader = scene.pixel_shader;
+    desc.vertex_attribures[0] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+    desc.vertex_attribures[1] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+    scene.pipeline = kuro_gfx_pipeline_create(scene.gfx, desc);
+
+    scene.commands = kuro_gfx_commands_create(scene.gfx);
+
+    soft_hits.assign(SOFT_WIDTH * SOFT_HEIGHT, 0);
+    return scene;
+}
+
+static void
+soft_scene_destroy(Soft_Scene &scene)
+{
+    kuro_gfx_commands_destroy(scene.gfx, scene.commands);
+    kuro_gfx_pipeline_destroy(scene.gfx, scene.pipeline);
+    kuro_gfx_pixel_shader_destroy(scene.gfx, scene.pixel_shader);
+    kuro_gfx_vertex_shader_destroy(scene.gfx, scene.vertex_shader);
+    kuro_gfx_image_destroy(scene.gfx, scene.depth);
+    kuro_gfx_swapchain_destroy(scene.gfx, scene.swapchain);
+    kuro_gfx_destroy(scene.gfx);
+}
+
+static void
+soft_scene_draw(Soft_Scene &scene, const std::vector<Soft_Vertex> &vertices)
+{
+    kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, (void *)vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+
+    Kuro_Gfx_Draw_Desc desc = {};
+    desc.vertex_buffers[0] = {vertex_buffer, sizeof(Soft_Vertex)};
+    desc.count = (uint32_t)vertices.size();
+    kuro_gfx_draw(scene.commands, desc);
+
+    // recorded commands execute in kuro_gfx_commands_end, keep the buffer alive until then
+    kuro_gfx_commands_end(scene.gfx, scene.commands);
+    kuro_gfx_buffer_destroy(scene.gfx, vertex_buffer);
+}
+
+static std::vector<uint32_t>
+soft_scene_read(Soft_Scene &scene)
+{
+    std::vector<uint32_t> pixels(SOFT_WIDTH * SOFT_HEIGHT);
+    kuro_gfx_soft_swapchain_read(scene.gfx, scene.swapchain, pixels.data());
+    return pixels;
+}
+
+static void
+soft_quad(std::vector<Soft_Vertex> &vertices, float x0, float y0, float x1, float y1, float z, float r, float g, float b)
+{
+    // counter clockwise in NDC
+    vertices.push_back({x0, y0, z, r, g, b});
+    vertices.push_back({x1, y0, z, r, g, b});
+    vertices.push_back({x1, y1, z, r, g, b});
+    vertices.push_back({x0, y0, z, r, g, b});
+    vertices.push_back({x1, y1, z, r, g, b});
+    vertices.push_back({x0, y1, z, r, g, b});
+}
+
+// vs_instanced with the Soft_Vertex attributes in slot 0 and one float3 per instance in slot 1
+static kr_pipeline_t
+soft_instanced_pipeline(Soft_Scene &scene, kr_vshader_t *vertex_shader)
+{
+    *vertex_shader = kuro_gfx_vertex_shader_create(scene.gfx, "", "vs_instanced");
+
+    Kuro_Gfx_Pipeline_Desc desc = {};
+    desc.vertex_shader = *vertex_shader;
+    desc.pixel_shader = scene.pixel_shader;
+    desc.vertex_attribures[0] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+    desc.vertex_attribures[1] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+    desc.vertex_attribures[2] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_INSTANCE, 1};
+    return kuro_gfx_pipeline_create(scene.gfx, desc);
+}
+
+static uint32_t
+soft_pixel(const std::vector<uint32_t> &pixels, float x, float y)
+{
+    uint32_t px = (uint32_t)((x + 1.0f) * 0.5f * SOFT_WIDTH);
+    uint32_t py = (uint32_t)((1.0f - y) * 0.5f * SOFT_HEIGHT);
+    return pixels[py * SOFT_WIDTH + px];
+}
+
+// a frame graph pass draws a quad over a clear into its target and reads it back, aliasing barriers
+// are collected by soft_graph_barriers and recorded once the pass has begun
+struct Soft_Graph_Pass
+{
+    Soft_Scene *scene;
+    uint32_t resource;
+    kr_image_t target;
+    kr_readback_t readback;
+    Kuro_Gfx_Color clear;
+    float quad[3];
+};
+
+struct Soft_Graph_Frame
+{
+    kr_image_t previous_target;
+    std::vector<Kuro_Gfx_Graph_Barrier> barriers;
+    uint32_t alias_count;
+};
+
+static void
+soft_graph_barriers(void *context, const Kuro_Gfx_Graph_Barrier *barriers, uint32_t barrier_count)
+{
+    Soft_Graph_Frame *frame = (Soft_Graph_Frame *)context;
+    frame->barriers.assign(barriers, barriers + barrier_count);
+}
+
+static void
+soft_graph_pass(void *user_data, void *context)
+{
+    Soft_Graph_Pass *graph_pass = (Soft_Graph_Pass *)user_data;
+    Soft_Graph_Frame *frame = (Soft_Graph_Frame *)context;
+    Soft_Scene &scene = *graph_pass->scene;
+
+    Kuro_Gfx_Pass_Desc pass = {};
+    pass.color_targets[0] = graph_pass->target;
+    kuro_gfx_commands_begin_pass(scene.gfx, scene.commands, pass);
+    for (const Kuro_Gfx_Graph_Barrier &barrier : frame->barriers)
+    {
+        // the passes run one target after the other, so the memory comes from the previous one
+        if (barrier.aliasing)
+        {
+            kuro_gfx_image_alias(scene.commands, frame->previous_target, graph_pass->target);
+            ++frame->alias_count;
+        }
+    }
+    frame->barriers.clear();
+    frame->previous_target = graph_pass->target;
+
+    std::vector<Soft_Vertex> vertices;
+    soft_quad(vertices, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, graph_pass->quad[0], graph_pass->quad[1], graph_pass->quad[2]);
+    kuro_gfx_clear(scene.commands, graph_pass->clear, 1.0f);
+    kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+    kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+    Kuro_Gfx_Draw_Desc desc = {};
+    desc.vertex_buffers[0] = {vertex_buffer, sizeof(Soft_Vertex)};
+    desc.count = (uint32_t)vertices.size();
+    kuro_gfx_draw(scene.commands, desc);
+    kuro_gfx_readback(scene.commands, graph_pass->target, graph_pass->readback);
+    kuro_gfx_commands_end(scene.gfx, scene.commands);
+    kuro_gfx_buffer_destroy(scene.gfx, vertex_buffer);
+}
+
+// =================================================================================================
+// == GFX SOFT =====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx_soft]: rasterizer")
+{
+    SUBCASE("clear")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, scene.depth);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{1.0f, 0.0f, 0.0f, 1.0f}, 0.5f);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        for (uint32_t pixel : pixels)
+            REQUIRE(pixel == 0xFF0000FF);
+
+        std::vector<float> depth(SOFT_WIDTH * SOFT_HEIGHT);
+        kuro_gfx_soft_image_read(scene.gfx, scene.depth, depth.data());
+        for (float d : depth)
+            REQUIRE(d == 0.5f);
+
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("coverage")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+
+        // full screen quad, the shared diagonal must not be shaded twice
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -1.0f, -1.0f, 1.0f, 1.0f, 0.5f, 0.0f, 1.0f, 0.0f);
+        soft_scene_draw(scene, vertices);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        for (uint32_t i = 0; i < SOFT_WIDTH * SOFT_HEIGHT; ++i)
+        {
+            REQUIRE(soft_hits[i] == 1);
+            REQUIRE(pixels[i] == 0xFF00FF00);
+        }
+
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("top left rule")
+    {
+        Soft_Scene scene = soft_scene_create(3);
+
+        // a fan of slanted triangles around an off center point, every shared edge is hit by
+        // pixel centers somewhere along it
+        std::vector<Soft_Vertex> vertices;
+        const float ring[][2] = {{-0.9f, -0.7f}, {0.3f, -0.95f}, {0.85f, -0.1f}, {0.6f, 0.8f}, {-0.4f, 0.9f}, {-0.95f, 0.2f}};
+        const int ring_count = sizeof(ring) / sizeof(ring[0]);
+        for (int i = 0; i < ring_count; ++i)
+        {
+            const float *a = ring[i];
+            const float *b = ring[(i + 1) % ring_count];
+            vertices.push_back({0.1f, 0.05f, 0.5f, 1.0f, 1.0f, 1.0f});
+            vertices.push_back({a[0], a[1], 0.5f, 1.0f, 1.0f, 1.0f});
+            vertices.push_back({b[0], b[1], 0.5f, 1.0f, 1.0f, 1.0f});
+        }
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        soft_scene_draw(scene, vertices);
+
+        uint32_t covered = 0;
+        for (uint32_t hits : soft_hits)
+        {
+            REQUIRE(hits <= 1);
+            covered += hits;
+        }
+        CHECK(covered > SOFT_WIDTH * SOFT_HEIGHT / 2);
+
+        // edges through pixel centers, the top and left ones own them
+        soft_hits.assign(SOFT_WIDTH * SOFT_HEIGHT, 0);
+        vertices.clear();
+        soft_quad(vertices, 10.5f / 100.0f - 1.0f, 1.0f - 80.5f / 75.0f, 60.5f / 100.0f - 1.0f, 1.0f - 20.5f / 75.0f, 0.5f, 1.0f, 1.0f, 1.0f);
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        soft_scene_draw(scene, vertices);
+
+        for (uint32_t y = 0; y < SOFT_HEIGHT; ++y)
+        {
+            for (uint32_t x = 0; x < SOFT_WIDTH; ++x)
+            {
+                uint32_t expected = x >= 10 && x < 60 && y >= 20 && y < 80;
+                REQUIRE(soft_hits[y * SOFT_WIDTH + x] == expected);
+            }
+        }
+
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("depth test")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        for (int near_first = 0; near_first < 2; ++near_first)
+        {
+            std::vector<Soft_Vertex> vertices;
+            if (near_first)
+                soft_quad(vertices, -0.5f, -0.5f, 0.5f, 0.5f, 0.25f, 1.0f, 0.0f, 0.0f);
+            soft_quad(vertices, -1.0f, -1.0f, 1.0f, 1.0f, 0.75f, 0.0f, 0.0f, 1.0f);
+            if (!near_first)
+                soft_quad(vertices, -0.5f, -0.5f, 0.5f, 0.5f, 0.25f, 1.0f, 0.0f, 0.0f);
+
+            kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, scene.depth);
+            kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+            kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+            soft_scene_draw(scene, vertices);
+
+            std::vector<uint32_t> pixels = soft_scene_read(scene);
+            CHECK(pixels[(SOFT_HEIGHT / 2) * SOFT_WIDTH + SOFT_WIDTH / 2] == 0xFF0000FF);
+            CHECK(pixels[5 * SOFT_WIDTH + 5] == 0xFFFF0000);
+
+            std::vector<float> depth(SOFT_WIDTH * SOFT_HEIGHT);
+            kuro_gfx_soft_image_read(scene.gfx, scene.depth, depth.data());
+            CHECK(depth[(SOFT_HEIGHT / 2) * SOFT_WIDTH + SOFT_WIDTH / 2] == doctest::Approx(0.25f));
+            CHECK(depth[5 * SOFT_WIDTH + 5] == doctest::Approx(0.75f));
+        }
+
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("clipping")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        // crosses the near plane, extends way past the guard band and z = x + y + 1 only stays in
+        // [0, 1] on a diagonal strip
+        std::vector<Soft_Vertex> vertices;
+        vertices.push_back({-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f});
+        vertices.push_back({60.0f, -1.0f, 60.0f, 1.0f, 1.0f, 1.0f});
+        vertices.push_back({-1.0f, 60.0f, 60.0f, 1.0f, 1.0f, 1.0f});
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, scene.depth);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        soft_scene_draw(scene, vertices);
+
+        std::vector<float> depth(SOFT_WIDTH * SOFT_HEIGHT);
+        kuro_gfx_soft_image_read(scene.gfx, scene.depth, depth.data());
+        uint32_t shaded = 0;
+        for (uint32_t i = 0; i < SOFT_WIDTH * SOFT_HEIGHT; ++i)
+        {
+            REQUIRE(soft_hits[i] <= 1);
+            REQUIRE(depth[i] >= 0.0f);
+            REQUIRE(depth[i] <= 1.0f);
+            shaded += soft_hits[i];
+        }
+        CHECK(shaded > 0);
+        CHECK(shaded < SOFT_WIDTH * SOFT_HEIGHT);
+
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("back face culling")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        std::vector<Soft_Vertex> vertices;
+        vertices.push_back({-1.0f, -1.0f, 0.5f, 1.0f, 1.0f, 1.0f});
+        vertices.push_back({1.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f});
+        vertices.push_back({1.0f, -1.0f, 0.5f, 1.0f, 1.0f, 1.0f});
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        soft_scene_draw(scene, vertices);
+
+        for (uint32_t hits : soft_hits)
+            REQUIRE(hits == 0);
+
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("buffer write")
+    {
+        Soft_Scene scene = soft_scene_create(2, "ps_constant");
+
+        float constants[64] = {};
+        kr_buffer_t constant_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_WRITE, nullptr, sizeof(constants));
+
+        std::vector<Soft_Vertex> left, right;
+        soft_quad(left, -1.0f, -1.0f, 0.0f, 1.0f, 0.5f, 0.0f, 0.0f, 0.0f);
+        soft_quad(right, 0.0f, -1.0f, 1.0f, 1.0f, 0.5f, 0.0f, 0.0f, 0.0f);
+        kr_buffer_t left_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, left.data(), (uint32_t)(left.size() * sizeof(Soft_Vertex)));
+        kr_buffer_t right_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, right.data(), (uint32_t)(right.size() * sizeof(Soft_Vertex)));
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        kuro_gfx_buffer_bind(scene.commands, constant_buffer, 0);
+
+        // every draw sees the constants written before it was recorded
+        Kuro_Gfx_Draw_Desc desc = {};
+        desc.count = 6;
+        constants[0] = 1.0f;
+        kuro_gfx_buffer_write(scene.commands, constant_buffer, constants, sizeof(constants));
+        desc.vertex_buffers[0] = {left_buffer, sizeof(Soft_Vertex)};
+        kuro_gfx_draw(scene.commands, desc);
+
+        constants[0] = 0.0f;
+        constants[2] = 1.0f;
+        kuro_gfx_buffer_write(scene.commands, constant_buffer, constants, sizeof(constants));
+        desc.vertex_buffers[0] = {right_buffer, sizeof(Soft_Vertex)};
+        kuro_gfx_draw(scene.commands, desc);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        CHECK(pixels[10 * SOFT_WIDTH + 10] == 0xFF0000FF);
+        CHECK(pixels[10 * SOFT_WIDTH + SOFT_WIDTH - 10] == 0xFFFF0000);
+
+        kuro_gfx_buffer_destroy(scene.gfx, right_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, left_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, constant_buffer);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("small constant buffer")
+    {
+        Soft_Scene scene = soft_scene_create(2, "ps_constant");
+
+        // sizes are not rounded to 256 bytes like the D3D12 constant buffer views
+        float constants[3] = {0.0f, 1.0f, 0.0f};
+        kr_buffer_t constant_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_WRITE, constants, sizeof(constants));
+
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -1.0f, -1.0f, 1.0f, 1.0f, 0.5f, 0.0f, 0.0f, 0.0f);
+        kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        kuro_gfx_buffer_bind(scene.commands, constant_buffer, 0);
+        Kuro_Gfx_Draw_Desc desc = {};
+        desc.count = 6;
+        desc.vertex_buffers[0] = {vertex_buffer, sizeof(Soft_Vertex)};
+        kuro_gfx_draw(scene.commands, desc);
+
+        constants[1] = 0.0f;
+        constants[2] = 1.0f;
+        kuro_gfx_buffer_write(scene.commands, constant_buffer, constants, sizeof(constants));
+        kuro_gfx_draw(scene.commands, desc);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        CHECK(pixels[SOFT_HEIGHT / 2 * SOFT_WIDTH + SOFT_WIDTH / 2] == 0xFFFF0000);
+
+        kuro_gfx_buffer_destroy(scene.gfx, vertex_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, constant_buffer);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("input stats")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -1.0f, -1.0f, 0.0f, 1.0f, 0.5f, 1.0f, 0.0f, 0.0f);
+        soft_quad(vertices, 0.0f, -1.0f, 1.0f, 1.0f, 0.5f, 0.0f, 0.0f, 1.0f);
+        kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+        uint16_t indices[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+        kr_buffer_t index_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, indices, sizeof(indices));
+
+        // draws of the same geometry only bind it once per list, the image is unaffected
+        for (int frame = 0; frame < 2; ++frame)
+        {
+            kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+            kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+            Kuro_Gfx_Draw_Desc desc = {};
+            desc.vertex_buffers[0] = {vertex_buffer, sizeof(Soft_Vertex)};
+            desc.index_buffer = {index_buffer, KURO_GFX_FORMAT_R16_UINT};
+            desc.count = 6;
+            kuro_gfx_draw(scene.commands, desc);
+            desc.first = 6;
+            kuro_gfx_draw(scene.commands, desc);
+            desc.index_buffer = {};
+            desc.first = 0;
+            kuro_gfx_draw(scene.commands, desc);
+            kuro_gfx_commands_end(scene.gfx, scene.commands);
+        }
+
+        Kuro_Gfx_Input_Stats stats = kuro_gfx_commands_input_stats(scene.commands);
+        CHECK(stats.draws == 6);
+        CHECK(stats.topology_sets == 2);
+        CHECK(stats.vertex_buffer_sets == 2);
+        CHECK(stats.vertex_buffer_views == 2);
+        CHECK(stats.index_buffer_sets == 2);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        CHECK(pixels[10 * SOFT_WIDTH + 10] == 0xFF0000FF);
+        CHECK(pixels[10 * SOFT_WIDTH + SOFT_WIDTH - 10] == 0xFFFF0000);
+
+        kuro_gfx_buffer_destroy(scene.gfx, index_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, vertex_buffer);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("threads")
+    {
+        // a few thousand overlapping triangles, the image must not depend on the worker count
+        std::vector<Soft_Vertex> vertices;
+        srand(7);
+        for (int i = 0; i < 3000; ++i)
+        {
+            float cx = rand() / (float)RAND_MAX * 2.2f - 1.1f;
+            float cy = rand() / (float)RAND_MAX * 2.2f - 1.1f;
+            float z = rand() / (float)RAND_MAX;
+            float c = rand() / (float)RAND_MAX;
+            for (int j = 0; j < 3; ++j)
+            {
+                float x = cx + rand() / (float)RAND_MAX * 0.4f - 0.2f;
+                float y = cy + rand() / (float)RAND_MAX * 0.4f - 0.2f;
+                vertices.push_back({x, y, z, c, 1.0f - c, (float)j / 2.0f});
+            }
+        }
+
+        std::vector<uint32_t> images[2];
+        const uint32_t thread_counts[2] = {1, 4};
+        for (int i = 0; i < 2; ++i)
+        {
+            Soft_Scene scene = soft_scene_create(thread_counts[i]);
+            kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, scene.depth);
+            kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+            kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+            soft_scene_draw(scene, vertices);
+            images[i] = soft_scene_read(scene);
+            soft_scene_destroy(scene);
+        }
+        CHECK(images[0] == images[1]);
+    }
+
+    SUBCASE("render targets")
+    {
+        Soft_Scene scene = soft_scene_create(2, "ps_targets");
+
+        kr_image_t targets[2] = {
+            kuro_gfx_render_target_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT),
+            kuro_gfx_render_target_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT)
+        };
+        kr_readback_t readbacks[2] = {
+            kuro_gfx_readback_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT),
+            kuro_gfx_readback_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT)
+        };
+
+        Kuro_Gfx_Pass_Desc pass = {};
+        pass.color_targets[0] = targets[0];
+        pass.color_targets[1] = targets[1];
+        pass.depth_target = scene.depth;
+
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f);
+
+        kuro_gfx_commands_begin_pass(scene.gfx, scene.commands, pass);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 1.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        kuro_gfx_readback(scene.commands, targets[0], readbacks[0]);
+        kuro_gfx_readback(scene.commands, targets[1], readbacks[1]);
+        soft_scene_draw(scene, vertices);
+
+        // the readbacks were recorded before the draw
+        const uint32_t *before = (const uint32_t *)kuro_gfx_readback_map(scene.gfx, readbacks[0], nullptr);
+        CHECK(before[(SOFT_HEIGHT / 2) * SOFT_WIDTH + SOFT_WIDTH / 2] == 0xFFFF0000);
+        kuro_gfx_readback_unmap(scene.gfx, readbacks[0]);
+
+        kuro_gfx_commands_begin_pass(scene.gfx, scene.commands, pass);
+        kuro_gfx_readback(scene.commands, targets[0], readbacks[0]);
+        kuro_gfx_readback(scene.commands, targets[1], readbacks[1]);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        for (int i = 0; i < 2; ++i)
+        {
+            CHECK(kuro_gfx_readback_ready(scene.gfx, readbacks[i]));
+
+            uint32_t row_pitch = 0;
+            const uint8_t *pixels = (const uint8_t *)kuro_gfx_readback_map(scene.gfx, readbacks[i], &row_pitch);
+            CHECK(row_pitch >= SOFT_WIDTH * sizeof(uint32_t));
+
+            uint32_t center, corner;
+            memcpy(&center, pixels + (SOFT_HEIGHT / 2) * row_pitch + (SOFT_WIDTH / 2) * sizeof(uint32_t), sizeof(center));
+            memcpy(&corner, pixels + 5 * row_pitch + 5 * sizeof(uint32_t), sizeof(corner));
+            CHECK(center == (i == 0 ? 0xFF0000FF : 0xFFFFFF00));
+            CHECK(corner == 0xFFFF0000);
+
+            kuro_gfx_readback_unmap(scene.gfx, readbacks[i]);
+        }
+
+        for (int i = 0; i < 2; ++i)
+        {
+            kuro_gfx_readback_destroy(scene.gfx, readbacks[i]);
+            kuro_gfx_image_destroy(scene.gfx, targets[i]);
+        }
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("instancing")
+    {
+        Soft_Scene scene = soft_scene_create(4);
+        kr_vshader_t vertex_shader = nullptr;
+        kr_pipeline_t pipeline = soft_instanced_pipeline(scene, &vertex_shader);
+
+        // a red quad around the origin, instance 0 is skipped by first_instance
+        std::vector<Soft_Vertex> quad;
+        soft_quad(quad, -0.1f, -0.1f, 0.1f, 0.1f, 0.5f, 1.0f, 0.0f, 0.0f);
+        float instances[4][3] = {{0.0f, 0.0f, 1.0f}, {-0.5f, -0.5f, 0.0f}, {0.5f, -0.5f, 1.0f}, {-0.5f, 0.5f, 1.0f}};
+        kr_buffer_t quad_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, quad.data(), (uint32_t)(quad.size() * sizeof(Soft_Vertex)));
+        kr_buffer_t instance_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, instances, sizeof(instances));
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, pipeline);
+        Kuro_Gfx_Draw_Desc desc = {};
+        desc.vertex_buffers[0] = {quad_buffer, sizeof(Soft_Vertex)};
+        desc.vertex_buffers[1] = {instance_buffer, 3 * sizeof(float)};
+        desc.count = 6;
+        desc.instance_count = 3;
+        desc.first_instance = 1;
+        kuro_gfx_draw(scene.commands, desc);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        CHECK(soft_pixel(pixels, 0.0f, 0.0f) == 0xFF000000);
+        CHECK(soft_pixel(pixels, -0.5f, -0.5f) == 0xFF0000FF);
+        CHECK(soft_pixel(pixels, 0.5f, -0.5f) == 0xFFFF00FF);
+        CHECK(soft_pixel(pixels, -0.5f, 0.5f) == 0xFFFF00FF);
+        CHECK(soft_pixel(pixels, 0.5f, 0.5f) == 0xFF000000);
+
+        // first index and base vertex, the leading vertices and indices would cover the whole screen
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -1.0f, -1.0f, 1.0f, 1.0f, 0.5f, 0.0f, 1.0f, 0.0f);
+        vertices.push_back({-0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f});
+        vertices.push_back({0.0f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f});
+        vertices.push_back({0.0f, 0.0f, 0.5f, 1.0f, 0.0f, 0.0f});
+        vertices.push_back({-0.5f, 0.0f, 0.5f, 1.0f, 0.0f, 0.0f});
+        uint16_t indices[9] = {0, 1, 2, 0, 1, 2, 0, 2, 3};
+        kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+        kr_buffer_t index_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, indices, sizeof(indices));
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, pipeline);
+        desc.vertex_buffers[0] = {vertex_buffer, sizeof(Soft_Vertex)};
+        desc.index_buffer = {index_buffer, KURO_GFX_FORMAT_R16_UINT};
+        desc.count = 6;
+        desc.first = 3;
+        desc.base_vertex = 6;
+        desc.instance_count = 2;
+        desc.first_instance = 1;
+        kuro_gfx_draw(scene.commands, desc);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        pixels = soft_scene_read(scene);
+        CHECK(soft_pixel(pixels, -0.75f, -0.75f) == 0xFF0000FF);
+        CHECK(soft_pixel(pixels, 0.25f, -0.75f) == 0xFFFF00FF);
+        CHECK(soft_pixel(pixels, 0.5f, 0.5f) == 0xFF000000);
+        CHECK(soft_pixel(pixels, -0.9f, 0.9f) == 0xFF000000);
+
+        kuro_gfx_buffer_destroy(scene.gfx, index_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, vertex_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, instance_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, quad_buffer);
+        kuro_gfx_pipeline_destroy(scene.gfx, pipeline);
+        kuro_gfx_vertex_shader_destroy(scene.gfx, vertex_shader);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("many instances")
+    {
+        // enough instances to shade on the workers, the image matches the same quads drawn one by one
+        const uint32_t GRID = 30;
+        std::vector<Soft_Vertex> quad;
+        soft_quad(quad, 0.0f, 0.0f, 0.04f, 0.04f, 0.5f, 1.0f, 1.0f, 0.0f);
+        std::vector<float> instances;
+        std::vector<Soft_Vertex> expanded;
+        for (uint32_t y = 0; y < GRID; ++y)
+        {
+            for (uint32_t x = 0; x < GRID; ++x)
+            {
+                float dx = -1.0f + 2.0f * x / GRID, dy = -1.0f + 2.0f * y / GRID, blue = (float)((x + y) % 2);
+                instances.insert(instances.end(), {dx, dy, blue});
+                soft_quad(expanded, dx, dy, dx + 0.04f, dy + 0.04f, 0.5f, 1.0f, 1.0f, blue);
+            }
+        }
+
+        std::vector<uint32_t> images[2];
+        for (int instanced = 0; instanced < 2; ++instanced)
+        {
+            Soft_Scene scene = soft_scene_create(4);
+            kr_vshader_t vertex_shader = nullptr;
+            kr_pipeline_t pipeline = soft_instanced_pipeline(scene, &vertex_shader);
+            kr_buffer_t quad_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, quad.data(), (uint32_t)(quad.size() * sizeof(Soft_Vertex)));
+            kr_buffer_t instance_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, instances.data(), (uint32_t)(instances.size() * sizeof(float)));
+
+            kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+            kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+            if (instanced)
+            {
+                kuro_gfx_set_pipeline(scene.commands, pipeline);
+                Kuro_Gfx_Draw_Desc desc = {};
+                desc.vertex_buffers[0] = {quad_buffer, sizeof(Soft_Vertex)};
+                desc.vertex_buffers[1] = {instance_buffer, 3 * sizeof(float)};
+                desc.count = (uint32_t)quad.size();
+                desc.instance_count = GRID * GRID;
+                kuro_gfx_draw(scene.commands, desc);
+                kuro_gfx_commands_end(scene.gfx, scene.commands);
+            }
+            else
+            {
+                kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+                soft_scene_draw(scene, expanded);
+            }
+            images[instanced] = soft_scene_read(scene);
+
+            kuro_gfx_buffer_destroy(scene.gfx, instance_buffer);
+            kuro_gfx_buffer_destroy(scene.gfx, quad_buffer);
+            kuro_gfx_pipeline_destroy(scene.gfx, pipeline);
+            kuro_gfx_vertex_shader_destroy(scene.gfx, vertex_shader);
+            soft_scene_destroy(scene);
+        }
+        CHECK(images[0] == images[1]);
+        CHECK(soft_pixel(images[1], 0.02f, 0.02f) == 0xFF00FFFF);
+        CHECK(soft_pixel(images[1], 2.0f / GRID + 0.02f, 0.02f) == 0xFFFFFFFF);
+        CHECK(soft_pixel(images[1], 2.0f / GRID + 0.02f, 2.0f / GRID + 0.02f) == 0xFF00FFFF);
+    }
+
+    SUBCASE("indirect draws")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+        kr_vshader_t vertex_shader = nullptr;
+        kr_pipeline_t pipeline = soft_instanced_pipeline(scene, &vertex_shader);
+
+        // a left and a right quad, the right one drawn by two instances
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -0.9f, -0.1f, -0.7f, 0.1f, 0.5f, 1.0f, 0.0f, 0.0f);
+        soft_quad(vertices, 0.1f, -0.1f, 0.3f, 0.1f, 0.5f, 0.0f, 1.0f, 0.0f);
+        float instances[3][3] = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.5f, 1.0f}, {0.0f, -0.5f, 0.0f}};
+        uint32_t indices[6] = {0, 1, 2, 3, 4, 5};
+        kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+        kr_buffer_t instance_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, instances, sizeof(instances));
+        kr_buffer_t index_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, indices, sizeof(indices));
+
+        // the first record draws nothing and is skipped by the offset anyway
+        Kuro_Gfx_Draw_Arguments arguments[3] = {{6, 1, 0, 0}, {6, 1, 0, 0}, {6, 2, 6, 1}};
+        Kuro_Gfx_Draw_Indexed_Arguments indexed_arguments[2] = {{0, 1, 0, 0, 0}, {6, 1, 0, 6, 0}};
+        kr_buffer_t argument_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_WRITE, nullptr, 256);
+        kr_buffer_t indexed_argument_buffer = kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, indexed_arguments, sizeof(indexed_arguments));
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, pipeline);
+        kuro_gfx_buffer_write(scene.commands, argument_buffer, arguments, sizeof(arguments));
+        Kuro_Gfx_Draw_Desc desc = {};
+        desc.vertex_buffers[0] = {vertex_buffer, sizeof(Soft_Vertex)};
+        desc.vertex_buffers[1] = {instance_buffer, 3 * sizeof(float)};
+        kuro_gfx_draw_indirect(scene.commands, desc, argument_buffer, sizeof(Kuro_Gfx_Draw_Arguments), 2);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        std::vector<uint32_t> pixels = soft_scene_read(scene);
+        CHECK(soft_pixel(pixels, -0.8f, 0.0f) == 0xFF0000FF);
+        CHECK(soft_pixel(pixels, 0.2f, 0.5f) == 0xFFFFFF00);
+        CHECK(soft_pixel(pixels, 0.2f, -0.5f) == 0xFF00FF00);
+        CHECK(soft_pixel(pixels, 0.2f, 0.0f) == 0xFF000000);
+
+        // the indexed records draw the right quad with base vertex instead of the first index, the
+        // empty record draws nothing
+        desc.index_buffer = {index_buffer, KURO_GFX_FORMAT_R32_UINT};
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, pipeline);
+        kuro_gfx_draw_indirect(scene.commands, desc, indexed_argument_buffer, 0, 2);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        pixels = soft_scene_read(scene);
+        CHECK(soft_pixel(pixels, -0.8f, 0.0f) == 0xFF000000);
+        CHECK(soft_pixel(pixels, 0.2f, 0.0f) == 0xFF00FF00);
+
+        kuro_gfx_buffer_destroy(scene.gfx, indexed_argument_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, argument_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, index_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, instance_buffer);
+        kuro_gfx_buffer_destroy(scene.gfx, vertex_buffer);
+        kuro_gfx_pipeline_destroy(scene.gfx, pipeline);
+        kuro_gfx_vertex_shader_destroy(scene.gfx, vertex_shader);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("frame graph")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        // two passes with their own target, each read back, so the targets are never alive together
+        kr_graph_t graph = kuro_gfx_graph_create();
+        uint64_t size_in_bytes = 0, alignment = 0;
+        kuro_gfx_image_memory(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT, true, &size_in_bytes, &alignment);
+
+        Soft_Graph_Pass passes[2] = {};
+        passes[0].clear = Kuro_Gfx_Color{0.0f, 0.0f, 1.0f, 1.0f};
+        passes[1].clear = Kuro_Gfx_Color{0.0f, 1.0f, 0.0f, 1.0f};
+        passes[0].quad[0] = 1.0f;
+        passes[1].quad[0] = 1.0f;
+        passes[1].quad[1] = 1.0f;
+        for (int i = 0; i < 2; ++i)
+        {
+            passes[i].scene = &scene;
+            passes[i].resource = kuro_gfx_graph_transient(graph, size_in_bytes, alignment);
+            passes[i].readback = kuro_gfx_readback_create(scene.gfx, SOFT_WIDTH, SOFT_HEIGHT);
+            uint32_t pass = kuro_gfx_graph_pass(graph, soft_graph_pass, &passes[i], true);
+            kuro_gfx_graph_use(graph, pass, passes[i].resource, KURO_GFX_GRAPH_USAGE_RENDER_TARGET);
+            kuro_gfx_graph_use(graph, pass, passes[i].resource, KURO_GFX_GRAPH_USAGE_COPY_SOURCE);
+        }
+        kuro_gfx_graph_compile(graph);
+        CHECK(kuro_gfx_graph_memory_size(graph) == size_in_bytes);
+
+        kr_heap_t heap = kuro_gfx_heap_create(scene.gfx, kuro_gfx_graph_memory_size(graph));
+        for (int i = 0; i < 2; ++i)
+            passes[i].target = kuro_gfx_image_place(scene.gfx, heap, kuro_gfx_graph_offset(graph, passes[i].resource), SOFT_WIDTH, SOFT_HEIGHT, true);
+
+        Soft_Graph_Frame frame = {};
+        kuro_gfx_graph_execute(graph, soft_graph_barriers, &frame);
+        CHECK(frame.alias_count == 1);
+
+        // the second target took the memory over after the first one was read back
+        const uint32_t centers[2] = {0xFF0000FF, 0xFF00FFFF};
+        const uint32_t corners[2] = {0xFFFF0000, 0xFF00FF00};
+        for (int i = 0; i < 2; ++i)
+        {
+            uint32_t row_pitch = 0;
+            const uint8_t *pixels = (const uint8_t *)kuro_gfx_readback_map(scene.gfx, passes[i].readback, &row_pitch);
+            uint32_t center, corner;
+            memcpy(&center, pixels + (SOFT_HEIGHT / 2) * row_pitch + (SOFT_WIDTH / 2) * sizeof(uint32_t), sizeof(center));
+            memcpy(&corner, pixels + 5 * row_pitch + 5 * sizeof(uint32_t), sizeof(corner));
+            CHECK(center == centers[i]);
+            CHECK(corner == corners[i]);
+            kuro_gfx_readback_unmap(scene.gfx, passes[i].readback);
+        }
+
+        for (int i = 0; i < 2; ++i)
+        {
+            kuro_gfx_readback_destroy(scene.gfx, passes[i].readback);
+            kuro_gfx_image_destroy(scene.gfx, passes[i].target);
+        }
+        kuro_gfx_heap_destroy(scene.gfx, heap);
+        kuro_gfx_graph_destroy(graph);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("split recording")
+    {
+        // overlapping quads, one vertex buffer each since draws have no vertex offset
+        const uint32_t quad_count = 64;
+        const uint32_t recorder_count = 4;
+        std::vector<kr_buffer_t> quads;
+
+        Soft_Scene scene = soft_scene_create(2);
+        srand(11);
+        for (uint32_t i = 0; i < quad_count; ++i)
+        {
+            float x = rand() / (float)RAND_MAX * 1.5f - 1.0f;
+            float y = rand() / (float)RAND_MAX * 1.5f - 1.0f;
+            std::vector<Soft_Vertex> vertices;
+            soft_quad(vertices, x, y, x + 0.5f, y + 0.5f, 0.5f, (float)i / quad_count, 1.0f - (float)i / quad_count, 0.5f);
+            quads.push_back(kuro_gfx_buffer_create(scene.gfx, KURO_GFX_ACCESS_NONE, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex))));
+        }
+
+        auto draw_quads = [&](kr_commands_t commands, uint32_t begin, uint32_t end) {
+            kuro_gfx_set_pipeline(commands, scene.pipeline);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                Kuro_Gfx_Draw_Desc desc = {};
+                desc.vertex_buffers[0] = {quads[i], sizeof(Soft_Vertex)};
+                desc.count = 6;
+                kuro_gfx_draw(commands, desc);
+            }
+        };
+
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        draw_quads(scene.commands, 0, quad_count);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+        std::vector<uint32_t> expected = soft_scene_read(scene);
+
+        // the recorders are filled in reverse order on their own threads, the first quad goes before
+        // the split and the last one after it
+        for (int frame = 0; frame < 2; ++frame)
+        {
+            kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+            kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+            draw_quads(scene.commands, 0, 1);
+
+            kr_commands_t recorders[recorder_count] = {};
+            kuro_gfx_commands_split(scene.gfx, scene.commands, recorder_count, recorders);
+            std::vector<std::thread> threads;
+            for (uint32_t r = recorder_count; r-- > 0;)
+            {
+                uint32_t slice = (quad_count - 2) / recorder_count;
+                uint32_t begin = 1 + r * slice;
+                uint32_t end = r + 1 == recorder_count ? quad_count - 1 : begin + slice;
+                threads.emplace_back(draw_quads, recorders[r], begin, end);
+            }
+            for (std::thread &thread : threads)
+                thread.join();
+
+            draw_quads(scene.commands, quad_count - 1, quad_count);
+            kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+            CHECK(soft_scene_read(scene) == expected);
+        }
+
+        for (kr_buffer_t quad : quads)
+            kuro_gfx_buffer_destroy(scene.gfx, quad);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("pipelines")
+    {
+        const char *cache_path = "utests_gfx_soft_pipelines.bin";
+        remove(cache_path);
+
+        auto draw_quad = [](Soft_Scene &scene, kr_pipeline_t pipeline) {
+            kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+            kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+            kuro_gfx_set_pipeline(scene.commands, pipeline);
+            std::vector<Soft_Vertex> vertices;
+            soft_quad(vertices, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f);
+            soft_scene_draw(scene, vertices);
+            return soft_scene_read(scene);
+        };
+
+        Soft_Scene scene = soft_scene_create(2);
+        kuro_gfx_pipeline_cache_open(scene.gfx, cache_path);
+
+        // shaders created again from the same entry points give the same pipeline
+        kr_vshader_t vertex_shader = kuro_gfx_vertex_shader_create(scene.gfx, "", "vs_main");
+        kr_pshader_t pixel_shader = kuro_gfx_pixel_shader_create(scene.gfx, "", "ps_main");
+        kr_pshader_t targets_shader = kuro_gfx_pixel_shader_create(scene.gfx, "", "ps_targets");
+        Kuro_Gfx_Pipeline_Desc desc = {};
+        desc.vertex_shader = vertex_shader;
+        desc.pixel_shader = pixel_shader;
+        desc.vertex_attribures[0] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+        desc.vertex_attribures[1] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+        kr_pipeline_t shared = kuro_gfx_pipeline_create(scene.gfx, desc);
+        CHECK(shared == scene.pipeline);
+
+        desc.pixel_shader = targets_shader;
+        kr_pipeline_t targets = kuro_gfx_pipeline_create(scene.gfx, desc);
+        CHECK(targets != scene.pipeline);
+        CHECK(kuro_gfx_pipeline_create(scene.gfx, desc) == targets);
+        kuro_gfx_pipeline_destroy(scene.gfx, targets);
+
+        // the pipeline stays alive until its last destroy
+        kuro_gfx_pipeline_destroy(scene.gfx, shared);
+        std::vector<uint32_t> expected = draw_quad(scene, scene.pipeline);
+        std::vector<uint32_t> expected_targets = draw_quad(scene, targets);
+
+        // only the pipeline compiled since the cache was opened is stored
+        CHECK(kuro_gfx_pipeline_cache_save(scene.gfx));
+        kr_cache_t cache = kuro_gfx_cache_open(cache_path);
+        CHECK(kuro_gfx_cache_count(cache) == 1);
+        kuro_gfx_cache_close(cache);
+
+        kuro_gfx_pipeline_destroy(scene.gfx, targets);
+        kuro_gfx_pixel_shader_destroy(scene.gfx, targets_shader);
+        kuro_gfx_pixel_shader_destroy(scene.gfx, pixel_shader);
+        kuro_gfx_vertex_shader_destroy(scene.gfx, vertex_shader);
+        soft_scene_destroy(scene);
+
+        // a warm start builds the same pipelines
+        scene = soft_scene_create(2);
+        kuro_gfx_pipeline_cache_open(scene.gfx, cache_path);
+        targets_shader = kuro_gfx_pixel_shader_create(scene.gfx, "", "ps_targets");
+        desc.vertex_shader = scene.vertex_shader;
+        desc.pixel_shader = targets_shader;
+        targets = kuro_gfx_pipeline_create(scene.gfx, desc);
+        CHECK(draw_quad(scene, scene.pipeline) == expected);
+        CHECK(draw_quad(scene, targets) == expected_targets);
+        kuro_gfx_pipeline_destroy(scene.gfx, targets);
+        kuro_gfx_pixel_shader_destroy(scene.gfx, targets_shader);
+        soft_scene_destroy(scene);
+        remove(cache_path);
+    }
+
+    SUBCASE("shader compile")
+    {
+        Soft_Scene scene = soft_scene_create(2);
+
+        kr_compile_t vertex_compile = kuro_gfx_vertex_shader_compile(scene.gfx, "", "vs_main");
+        kr_compile_t pixel_compile = kuro_gfx_pixel_shader_compile(scene.gfx, "", "ps_main");
+        kr_vshader_t vertex_shader = kuro_gfx_vertex_shader_get(scene.gfx, vertex_compile);
+        kr_pshader_t pixel_shader = kuro_gfx_pixel_shader_get(scene.gfx, pixel_compile);
+
+        // the scene compiled the same shaders, the second compile comes from the cache
+        kr_compile_t cached = kuro_gfx_pixel_shader_compile(scene.gfx, "", "ps_main");
+        CHECK(kuro_gfx_shader_ready(cached));
+        kuro_gfx_pixel_shader_destroy(scene.gfx, kuro_gfx_pixel_shader_get(scene.gfx, cached));
+
+        Kuro_Gfx_Pipeline_Desc desc = {};
+        desc.vertex_shader = vertex_shader;
+        desc.pixel_shader = pixel_shader;
+        desc.vertex_attribures[0] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+        desc.vertex_attribures[1] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+        kr_pipeline_t pipeline = kuro_gfx_pipeline_create(scene.gfx, desc);
+        CHECK(pipeline == scene.pipeline);
+
+        kuro_gfx_pipeline_destroy(scene.gfx, pipeline);
+        kuro_gfx_pixel_shader_destroy(scene.gfx, pixel_shader);
+        kuro_gfx_vertex_shader_destroy(scene.gfx, vertex_shader);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("uploads")
+    {
+        // larger than the staging arena, so the uploads are split and wait for earlier batches
+        const uint32_t width = 1024;
+        const uint32_t height = 1536;
+
+        Soft_Scene scene = soft_scene_create(2);
+        kr_image_t target = kuro_gfx_render_target_create(scene.gfx, width, height);
+        kr_readback_t readback = kuro_gfx_readback_create(scene.gfx, width, height);
+
+        CHECK(kuro_gfx_upload_complete(scene.gfx, 0));
+        CHECK(kuro_gfx_upload_submit(scene.gfx) == 0);
+
+        std::vector<uint32_t> first((size_t)width * height);
+        std::vector<uint32_t> second((size_t)width * height);
+        for (size_t i = 0; i < first.size(); ++i)
+        {
+            first[i] = (uint32_t)i * 2654435761u;
+            second[i] = ~first[i];
+        }
+
+        // later batches land after earlier ones, waiting on the last token waits on all of them
+        kuro_gfx_upload_image(scene.gfx, target, first.data(), width * sizeof(uint32_t));
+        uint64_t first_token = kuro_gfx_upload_submit(scene.gfx);
+        kuro_gfx_upload_image(scene.gfx, target, second.data(), width * sizeof(uint32_t));
+        std::vector<Soft_Vertex> vertices;
+        soft_quad(vertices, -1.0f, -1.0f, 1.0f, 1.0f, 0.5f, 0.0f, 1.0f, 0.0f);
+        kr_buffer_t quad = kuro_gfx_upload_buffer(scene.gfx, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+        uint64_t second_token = kuro_gfx_upload_submit(scene.gfx);
+        CHECK(first_token > 0);
+        CHECK(second_token > first_token);
+        CHECK(kuro_gfx_upload_submit(scene.gfx) == second_token);
+
+        kuro_gfx_upload_wait(scene.gfx, second_token);
+        CHECK(kuro_gfx_upload_complete(scene.gfx, first_token));
+        CHECK(kuro_gfx_upload_complete(scene.gfx, second_token));
+
+        Kuro_Gfx_Pass_Desc pass = {};
+        pass.color_targets[0] = target;
+        kuro_gfx_commands_begin_pass(scene.gfx, scene.commands, pass);
+        kuro_gfx_readback(scene.commands, target, readback);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+
+        uint32_t row_pitch = 0;
+        const uint8_t *pixels = (const uint8_t *)kuro_gfx_readback_map(scene.gfx, readback, &row_pitch);
+        bool match = true;
+        for (uint32_t y = 0; y < height; ++y)
+            match &= memcmp(pixels + (size_t)y * row_pitch, second.data() + (size_t)y * width, width * sizeof(uint32_t)) == 0;
+        CHECK(match);
+        kuro_gfx_readback_unmap(scene.gfx, readback);
+
+        // staged but never submitted, kuro_gfx_commands_end submits it before the draw
+        kr_buffer_t late = kuro_gfx_upload_buffer(scene.gfx, vertices.data(), (uint32_t)(vertices.size() * sizeof(Soft_Vertex)));
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        kuro_gfx_clear(scene.commands, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_set_pipeline(scene.commands, scene.pipeline);
+        Kuro_Gfx_Draw_Desc desc = {};
+        desc.vertex_buffers[0] = {late, sizeof(Soft_Vertex)};
+        desc.count = (uint32_t)vertices.size();
+        kuro_gfx_draw(scene.commands, desc);
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+        CHECK(kuro_gfx_upload_complete(scene.gfx, second_token + 1));
+        CHECK(soft_scene_read(scene)[(SOFT_HEIGHT / 2) * SOFT_WIDTH + SOFT_WIDTH / 2] == 0xFF00FF00);
+
+        kuro_gfx_buffer_destroy(scene.gfx, late);
+        kuro_gfx_buffer_destroy(scene.gfx, quad);
+        kuro_gfx_readback_destroy(scene.gfx, readback);
+        kuro_gfx_image_destroy(scene.gfx, target);
+        soft_scene_destroy(scene);
+    }
+
+    SUBCASE("fences")
+    {
+        Soft_Scene scene = soft_scene_create(1);
+        kr_fence_t fence = kuro_gfx_fence_create(scene.gfx);
+
+        std::vector<uint64_t> calls;
+        auto record = [](void *user_data, uint64_t value) {
+            ((std::vector<uint64_t> *)user_data)->push_back(value);
+        };
+
+        // callbacks run in value order once an observer sees the value complete
+        kuro_gfx_fence_callback(scene.gfx, fence, 3, record, &calls);
+        kuro_gfx_fence_callback(scene.gfx, fence, 1, record, &calls);
+        kuro_gfx_fence_callback(scene.gfx, fence, 2, record, &calls);
+        CHECK(calls.empty());
+        CHECK(kuro_gfx_fence_complete(scene.gfx, fence, 0));
+        CHECK_FALSE(kuro_gfx_fence_complete(scene.gfx, fence, 1));
+        CHECK_FALSE(kuro_gfx_fence_wait(scene.gfx, fence, 1, 1000000));
+
+        kuro_gfx_fence_signal(scene.gfx, fence, 2);
+        CHECK(kuro_gfx_fence_value(scene.gfx, fence) == 2);
+        CHECK(calls.empty());
+        CHECK(kuro_gfx_fence_complete(scene.gfx, fence, 2));
+        CHECK(calls == std::vector<uint64_t>{1, 2});
+
+        kuro_gfx_fence_callback(scene.gfx, fence, 2, record, &calls);
+        CHECK(calls == std::vector<uint64_t>{1, 2, 2});
+
+        kuro_gfx_fence_signal(scene.gfx, fence, 5);
+        kuro_gfx_commands_begin(scene.gfx, scene.commands, scene.swapchain, nullptr);
+        CHECK(kuro_gfx_commands_ready(scene.gfx, scene.commands));
+        kuro_gfx_commands_end(scene.gfx, scene.commands);
+        CHECK(calls == std::vector<uint64_t>{1, 2, 2, 3});
+
+        // frame pacing between two threads, the producer never gets more than two frames ahead
+        const uint64_t frames = 200;
+        const uint64_t latency = 2;
+        kr_fence_t produced = kuro_gfx_fence_create(scene.gfx);
+        kr_fence_t consumed = kuro_gfx_fence_create(scene.gfx);
+        std::atomic<uint64_t> consumer_frame(0);
+        bool ahead = false;
+        bool timed_out = false;
+
+        std::thread consumer([&] {
+            for (uint64_t frame = 1; frame <= frames; ++frame)
+            {
+                timed_out |= !kuro_gfx_fence_wait(scene.gfx, produced, frame, 5000000000ull);
+                consumer_frame.store(frame);
+                kuro_gfx_fence_signal(scene.gfx, consumed, frame);
+            }
+        });
+        for (uint64_t frame = 1; frame <= frames; ++frame)
+        {
+            if (frame > latency)
+                CHECK(kuro_gfx_fence_wait(scene.gfx, consumed, frame - latency, UINT64_MAX));
+            ahead |= frame > consumer_frame.load() + latency;
+            kuro_gfx_fence_signal(scene.gfx, produced, frame);
+        }
+        consumer.join();
+        CHECK_FALSE(ahead);
+        CHECK_FALSE(timed_out);
+        CHECK(kuro_gfx_fence_value(scene.gfx, consumed) == frames);
+
+        // a timeout too large for a deadline waits like an infinite one instead of wrapping around
+        std::thread late([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            kuro_gfx_fence_signal(scene.gfx, produced, frames + 1);
+        });
+        CHECK(kuro_gfx_fence_wait(scene.gfx, produced, frames + 1, UINT64_MAX - 1));
+        late.join();
+
+        kuro_gfx_fence_destroy(scene.gfx, consumed);
+        kuro_gfx_fence_destroy(scene.gfx, produced);
+        kuro_gfx_fence_destroy(scene.gfx, fence);
+        soft_scene_destroy(scene);
+    }
+}
@@ -0,0 +1,221 @@
+#include <kuro/gfx_state.h>
+
+#include <doctest/doctest.h>
+
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+// the D3D12_RESOURCE_STATES values the D3D12 backend hands to the tracker
+enum State_Test
+{
+    STATE_COMMON = 0,
+    STATE_VERTEX_BUFFER = 0x1,
+    STATE_INDEX_BUFFER = 0x2,
+    STATE_RENDER_TARGET = 0x4,
+    STATE_DEPTH_WRITE = 0x10,
+    STATE_DEPTH_READ = 0x20,
+    STATE_SHADER_READ = 0x40 | 0x80,
+    STATE_COPY_DEST = 0x400,
+    STATE_COPY_SOURCE = 0x800,
+    STATE_PRESENT = 0,
+    STATE_READ_MASK = 0x1 | 0x2 | 0x20 | 0x40 | 0x80 | 0x200 | 0x800
+};
+
+static uint32_t
+state_flush(Kuro_Gfx_State_Tracker *tracker, std::vector<Kuro_Gfx_State_Barrier> *barriers = nullptr)
+{
+    uint32_t count = 0;
+    const Kuro_Gfx_State_Barrier *pending = kuro_gfx_state_flush(tracker, &count);
+    if (barriers)
+        barriers->assign(pending, pending + count);
+    return count;
+}
+
+static bool
+state_barrier_is(const Kuro_Gfx_State_Barrier &barrier, Kuro_Gfx_State_Resource *resource, uint32_t subresource, uint32_t before, uint32_t after)
+{
+    return barrier.resource == resource && barrier.subresource == subresource && barrier.before == before && barrier.after == after;
+}
+
+// =================================================================================================
+// == GFX STATE ====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: state tracker")
+{
+    const uint32_t ALL = (uint32_t)KURO_GFX_STATE_CONSTANT_ALL_SUBRESOURCES;
+
+    SUBCASE("elide")
+    {
+        Kuro_Gfx_State_Tracker tracker = {};
+        kuro_gfx_state_init(&tracker, STATE_READ_MASK);
+        Kuro_Gfx_State_Resource target = {};
+        kuro_gfx_state_resource_init(&target, nullptr, 1, STATE_RENDER_TARGET);
+
+        kuro_gfx_state_request(&tracker, &target, ALL, STATE_RENDER_TARGET);
+        CHECK(state_flush(&tracker) == 0);
+
+        // a readback between two draws
+        std::vector<Kuro_Gfx_State_Barrier> barriers;
+        kuro_gfx_state_request(&tracker, &target, ALL, STATE_COPY_SOURCE);
+        CHECK(state_flush(&tracker, &barriers) == 1);
+        CHECK(state_barrier_is(barriers[0], &target, ALL, STATE_RENDER_TARGET, STATE_COPY_SOURCE));
+        kuro_gfx_state_request(&tracker, &target, ALL, STATE_RENDER_TARGET);
+        CHECK(state_flush(&tracker) == 1);
+
+        // nothing used the copy source state in between, so there is no barrier at all
+        kuro_gfx_state_request(&tracker, &target, ALL, STATE_COPY_SOURCE);
+        kuro_gfx_state_request(&tracker, &target, ALL, STATE_RENDER_TARGET);
+        CHECK(state_flush(&tracker) == 0);
+        CHECK(kuro_gfx_state_get(&target, ALL) == STATE_RENDER_TARGET);
+
+        CHECK(tracker.requested == 5);
+        CHECK(tracker.elided == 2);
+        CHECK(tracker.emitted == 2);
+        CHECK(tracker.flushes == 2);
+
+        kuro_gfx_state_resource_destroy(&target);
+        kuro_gfx_state_destroy(&tracker);
+    }
+
+    SUBCASE("merge")
+    {
+        Kuro_Gfx_State_Tracker tracker = {};
+        kuro_gfx_state_init(&tracker, STATE_READ_MASK);
+        Kuro_Gfx_State_Resource depth = {}, color = {};
+        kuro_gfx_state_resource_init(&depth, nullptr, 1, STATE_COMMON);
+        kuro_gfx_state_resource_init(&color, nullptr, 1, STATE_RENDER_TARGET);
+
+        // the pending barrier of depth is retargeted instead of adding a second one
+        std::vector<Kuro_Gfx_State_Barrier> barriers;
+        kuro_gfx_state_request(&tracker, &depth, ALL, STATE_DEPTH_WRITE);
+        kuro_gfx_state_request(&tracker, &color, ALL, STATE_SHADER_READ);
+        kuro_gfx_state_request(&tracker, &depth, ALL, STATE_DEPTH_READ);
+        CHECK(state_flush(&tracker, &barriers) == 2);
+        CHECK(state_barrier_is(barriers[0], &depth, ALL, STATE_COMMON, STATE_DEPTH_READ));
+        CHECK(state_barrier_is(barriers[1], &color, ALL, STATE_RENDER_TARGET, STATE_SHADER_READ));
+
+        // reads combine and a covered read is free
+        kuro_gfx_state_request(&tracker, &color, ALL, STATE_COPY_SOURCE);
+        CHECK(state_flush(&tracker, &barriers) == 1);
+        CHECK(state_barrier_is(barriers[0], &color, ALL, STATE_SHADER_READ, STATE_SHADER_READ | STATE_COPY_SOURCE));
+        kuro_gfx_state_request(&tracker, &color, ALL, STATE_SHADER_READ);
+        kuro_gfx_state_request(&tracker, &color, ALL, STATE_COPY_SOURCE);
+        CHECK(state_flush(&tracker) == 0);
+
+        // common is not a read, so it does not combine
+        kuro_gfx_state_request(&tracker, &color, ALL, STATE_COMMON);
+        kuro_gfx_state_request(&tracker, &depth, ALL, STATE_DEPTH_WRITE);
+        CHECK(state_flush(&tracker, &barriers) == 2);
+        CHECK(state_barrier_is(barriers[0], &color, ALL, STATE_SHADER_READ | STATE_COPY_SOURCE, STATE_COMMON));
+        kuro_gfx_state_request(&tracker, &color, ALL, STATE_COPY_SOURCE);
+        CHECK(state_flush(&tracker, &barriers) == 1);
+        CHECK(barriers[0].after == STATE_COPY_SOURCE);
+
+        kuro_gfx_state_resource_destroy(&depth);
+        kuro_gfx_state_resource_destroy(&color);
+        kuro_gfx_state_destroy(&tracker);
+    }
+
+    SUBCASE("subresources")
+    {
+        Kuro_Gfx_State_Tracker tracker = {};
+        kuro_gfx_state_init(&tracker, STATE_READ_MASK);
+        Kuro_Gfx_State_Resource texture = {};
+        kuro_gfx_state_resource_init(&texture, nullptr, 4, STATE_SHADER_READ);
+
+        // a subresource that is already readable does not split the resource
+        kuro_gfx_state_request(&tracker, &texture, 2, STATE_SHADER_READ);
+        CHECK(texture.subresource_states == nullptr);
+
+        std::vector<Kuro_Gfx_State_Barrier> barriers;
+        kuro_gfx_state_request(&tracker, &texture, 2, STATE_COPY_DEST);
+        CHECK(state_flush(&tracker, &barriers) == 1);
+        CHECK(state_barrier_is(barriers[0], &texture, 2, STATE_SHADER_READ, STATE_COPY_DEST));
+        CHECK(kuro_gfx_state_get(&texture, 1) == STATE_SHADER_READ);
+        CHECK(kuro_gfx_state_get(&texture, 2) == STATE_COPY_DEST);
+
+        // only the split subresource has to move back, after that the resource is uniform again
+        kuro_gfx_state_request(&tracker, &texture, ALL, STATE_SHADER_READ);
+        CHECK(state_flush(&tracker, &barriers) == 1);
+        CHECK(state_barrier_is(barriers[0], &texture, 2, STATE_COPY_DEST, STATE_SHADER_READ));
+        CHECK(texture.subresource_states == nullptr);
+
+        kuro_gfx_state_request(&tracker, &texture, 0, STATE_COPY_DEST);
+        kuro_gfx_state_request(&tracker, &texture, 3, STATE_COPY_DEST);
+        CHECK(state_flush(&tracker) == 2);
+        kuro_gfx_state_request(&tracker, &texture, ALL, STATE_RENDER_TARGET);
+        CHECK(state_flush(&tracker, &barriers) == 4);
+        CHECK(state_barrier_is(barriers[0], &texture, 0, STATE_COPY_DEST, STATE_RENDER_TARGET));
+        CHECK(state_barrier_is(barriers[1], &texture, 1, STATE_SHADER_READ, STATE_RENDER_TARGET));
+        kuro_gfx_state_request(&tracker, &texture, ALL, STATE_SHADER_READ);
+        CHECK(state_flush(&tracker, &barriers) == 1);
+        CHECK(barriers[0].subresource == ALL);
+
+        kuro_gfx_state_resource_destroy(&texture);
+        kuro_gfx_state_destroy(&tracker);
+    }
+
+    SUBCASE("frames")
+    {
+        // what the D3D12 backend requests for a frame that draws into a render target, reads it back
+        // twice and then draws the swapchain
+        Kuro_Gfx_State_Tracker tracker = {};
+        kuro_gfx_state_init(&tracker, STATE_READ_MASK);
+        Kuro_Gfx_State_Resource back_buffer = {}, depth = {}, target = {};
+        kuro_gfx_state_resource_init(&back_buffer, nullptr, 1, STATE_PRESENT);
+        kuro_gfx_state_resource_init(&depth, nullptr, 1, STATE_COMMON);
+        kuro_gfx_state_resource_init(&target, nullptr, 1, STATE_RENDER_TARGET);
+
+        uint32_t counts[3] = {};
+        uint32_t calls[3] = {};
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            // commands_begin_pass and the draws
+            kuro_gfx_state_request(&tracker, &depth, ALL, STATE_DEPTH_WRITE);
+            kuro_gfx_state_request(&tracker, &target, ALL, STATE_RENDER_TARGET);
+            for (int draw = 0; draw < 4; ++draw)
+            {
+                uint32_t count = state_flush(&tracker);
+                counts[frame] += count;
+                calls[frame] += count ? 1 : 0;
+            }
+
+            // two readbacks back to back, the target goes back to its resting state in between
+            for (int readback = 0; readback < 2; ++readback)
+            {
+                kuro_gfx_state_request(&tracker, &target, ALL, STATE_COPY_SOURCE);
+                uint32_t count = state_flush(&tracker);
+                counts[frame] += count;
+                calls[frame] += count ? 1 : 0;
+                kuro_gfx_state_request(&tracker, &target, ALL, STATE_RENDER_TARGET);
+            }
+
+            // commands_begin with the swapchain, a draw and commands_end
+            kuro_gfx_state_request(&tracker, &back_buffer, ALL, STATE_RENDER_TARGET);
+            kuro_gfx_state_request(&tracker, &depth, ALL, STATE_DEPTH_WRITE);
+            for (int end = 0; end < 2; ++end)
+            {
+                uint32_t count = state_flush(&tracker);
+                counts[frame] += count;
+                calls[frame] += count ? 1 : 0;
+                kuro_gfx_state_request(&tracker, &back_buffer, ALL, STATE_PRESENT);
+            }
+        }
+
+        // the depth target moves once ever, the second readback and the restore between them are
+        // elided, the restore after them shares the batch with the back buffer
+        CHECK(counts[0] == 5);
+        CHECK(calls[0] == 4);
+        CHECK(counts[1] == 4);
+        CHECK(calls[1] == 3);
+        CHECK(counts[2] == 4);
+        CHECK(kuro_gfx_state_get(&back_buffer, ALL) == STATE_PRESENT);
+
+        kuro_gfx_state_resource_destroy(&back_buffer);
+        kuro_gfx_state_resource_destroy(&depth);
+        kuro_gfx_state_resource_destroy(&target);
+        kuro_gfx_state_destroy(&tracker);
+    }
+}
@@ -0,0 +1,317 @@
+#include <kuro/gfx.h>
+#if OS_LINUX
+#include <kuro/gfx_soft.h>
+#endif
+
+#include <doctest/doctest.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+// recording, optimizing and saving never dereference the handles
+static kr_pipeline_t stream_pipelines[2] = {(kr_pipeline_t)(uintptr_t)0x100, (kr_pipeline_t)(uintptr_t)0x200};
+static kr_buffer_t stream_buffers[3] = {(kr_buffer_t)(uintptr_t)0x1000, (kr_buffer_t)(uintptr_t)0x2000, (kr_buffer_t)(uintptr_t)0x3000};
+
+static Kuro_Gfx_Draw_Desc
+stream_draw_desc(kr_buffer_t vertex_buffer, kr_buffer_t index_buffer)
+{
+    Kuro_Gfx_Draw_Desc desc = {};
+    desc.vertex_buffers[0] = {vertex_buffer, 24};
+    desc.index_buffer = {index_buffer, KURO_GFX_FORMAT_R32_UINT};
+    desc.count = 36;
+    return desc;
+}
+
+static std::vector<uint8_t>
+stream_save(kr_stream_t stream)
+{
+    std::vector<uint8_t> blob(kuro_gfx_stream_save(stream, nullptr, 0));
+    CHECK(kuro_gfx_stream_save(stream, blob.data(), (uint32_t)blob.size()) == blob.size());
+    return blob;
+}
+
+#if OS_LINUX
+struct Stream_Vertex
+{
+    float x, y, z;
+};
+
+static void
+stream_vs_main(const Kuro_Gfx_Soft_Vertex *vertex, float position[4], float *)
+{
+    position[0] = vertex->attributes[0];
+    position[1] = vertex->attributes[1];
+    position[2] = vertex->attributes[2];
+    position[3] = 1.0f;
+}
+
+static void
+stream_ps_constant(const Kuro_Gfx_Soft_Pixels *pixels, float *color)
+{
+    const float *constant = (const float *)pixels->constants[0];
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        color[i] = constant[0];
+        color[8 + i] = constant[1];
+        color[16 + i] = constant[2];
+        color[24 + i] = 1.0f;
+    }
+}
+#endif
+
+// =================================================================================================
+// == GFX STREAM ===================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_gfx]: stream")
+{
+    SUBCASE("record")
+    {
+        kr_stream_t stream = kuro_gfx_stream_create();
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);
+        kuro_gfx_stream_viewport(stream, 640, 480);
+        kuro_gfx_stream_clear(stream, Kuro_Gfx_Color{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f);
+        kuro_gfx_stream_buffer_bind(stream, stream_buffers[2], 0);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], stream_buffers[1]));
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], nullptr));
+
+        // handles are numbered in order of first use
+        REQUIRE(kuro_gfx_stream_handle_count(stream) == 4);
+        CHECK(kuro_gfx_stream_handle_kind(stream, 0) == KURO_GFX_STREAM_HANDLE_PIPELINE);
+        CHECK(kuro_gfx_stream_handle_kind(stream, 1) == KURO_GFX_STREAM_HANDLE_BUFFER);
+        CHECK(kuro_gfx_stream_handle_kind(stream, 2) == KURO_GFX_STREAM_HANDLE_BUFFER);
+        CHECK(kuro_gfx_stream_handle_kind(stream, 3) == KURO_GFX_STREAM_HANDLE_BUFFER);
+        CHECK(kuro_gfx_stream_validate(stream));
+
+        kuro_gfx_stream_reset(stream);
+        CHECK(kuro_gfx_stream_handle_count(stream) == 0);
+        CHECK(kuro_gfx_stream_validate(stream));
+        kuro_gfx_stream_destroy(stream);
+    }
+
+    SUBCASE("validate")
+    {
+        kr_stream_t stream = kuro_gfx_stream_create();
+        kuro_gfx_stream_viewport(stream, 640, 480);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], nullptr));
+        CHECK_FALSE(kuro_gfx_stream_validate(stream));
+
+        kuro_gfx_stream_reset(stream);
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], nullptr));
+        CHECK_FALSE(kuro_gfx_stream_validate(stream));
+
+        kuro_gfx_stream_reset(stream);
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);
+        kuro_gfx_stream_viewport(stream, 640, 480);
+        Kuro_Gfx_Draw_Desc desc = stream_draw_desc(stream_buffers[0], stream_buffers[1]);
+        desc.index_buffer.format = KURO_GFX_FORMAT_R32G32_FLOAT;
+        kuro_gfx_stream_draw(stream, desc);
+        CHECK_FALSE(kuro_gfx_stream_validate(stream));
+        kuro_gfx_stream_destroy(stream);
+    }
+
+    SUBCASE("optimize")
+    {
+        kr_stream_t stream = kuro_gfx_stream_create();
+        float constants[4] = {};
+
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);
+        kuro_gfx_stream_viewport(stream, 640, 480);
+        kuro_gfx_stream_buffer_bind(stream, stream_buffers[2], 0);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], nullptr));
+
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);  // redundant
+        kuro_gfx_stream_viewport(stream, 640, 480);                 // redundant
+        kuro_gfx_stream_buffer_write(stream, stream_buffers[2], constants, sizeof(constants));
+        kuro_gfx_stream_buffer_bind(stream, stream_buffers[2], 0);  // redundant
+        kuro_gfx_stream_buffer_bind(stream, stream_buffers[1], 1);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], nullptr));
+
+        // a new pipeline drops the bindings, so the same bind is kept after it
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[1]);
+        kuro_gfx_stream_buffer_bind(stream, stream_buffers[2], 0);
+        kuro_gfx_stream_viewport(stream, 320, 240);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], nullptr));
+
+        uint32_t size = kuro_gfx_stream_save(stream, nullptr, 0);
+        CHECK(kuro_gfx_stream_optimize(stream) == 3);
+        CHECK(kuro_gfx_stream_save(stream, nullptr, 0) < size);
+        CHECK(kuro_gfx_stream_validate(stream));
+        CHECK(kuro_gfx_stream_optimize(stream) == 0);
+        kuro_gfx_stream_destroy(stream);
+    }
+
+    SUBCASE("write data")
+    {
+        kr_stream_t stream = kuro_gfx_stream_create();
+        float constants[3] = {1.0f, 2.0f, 3.0f};
+        uint32_t first = kuro_gfx_stream_buffer_write(stream, stream_buffers[2], constants, sizeof(constants));
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[0]);
+        uint32_t second = kuro_gfx_stream_buffer_write(stream, stream_buffers[2], nullptr, sizeof(constants));
+        CHECK(first == 0);
+        CHECK(second == 1);
+
+        CHECK(memcmp(kuro_gfx_stream_write_data(stream, first), constants, sizeof(constants)) == 0);
+        memcpy(kuro_gfx_stream_write_data(stream, second), constants, sizeof(constants));
+
+        // writes keep their index when commands in front of them are removed
+        CHECK(kuro_gfx_stream_optimize(stream) == 1);
+        CHECK(memcmp(kuro_gfx_stream_write_data(stream, second), constants, sizeof(constants)) == 0);
+        kuro_gfx_stream_destroy(stream);
+    }
+
+    SUBCASE("save load")
+    {
+        kr_stream_t stream = kuro_gfx_stream_create();
+        float constants[5] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f};
+        kuro_gfx_stream_set_pipeline(stream, stream_pipelines[1]);
+        kuro_gfx_stream_viewport(stream, 640, 480);
+        kuro_gfx_stream_buffer_write(stream, stream_buffers[2], constants, sizeof(constants));
+        kuro_gfx_stream_buffer_bind(stream, stream_buffers[2], 3);
+        kuro_gfx_stream_draw(stream, stream_draw_desc(stream_buffers[0], stream_buffers[1]));
+        std::vector<uint8_t> blob = stream_save(stream);
+
+        kr_stream_t loaded = kuro_gfx_stream_load(blob.data(), (uint32_t)blob.size());
+        REQUIRE(loaded);
+        REQUIRE(kuro_gfx_stream_handle_count(loaded) == 4);
+        CHECK(memcmp(kuro_gfx_stream_write_data(loaded, 0), constants, sizeof(constants)) == 0);
+
+        // handles have to be patched before the stream is usable
+        CHECK_FALSE(kuro_gfx_stream_validate(loaded));
+        kuro_gfx_stream_pipeline_set(loaded, 0, stream_pipelines[1]);
+        kuro_gfx_stream_buffer_set(loaded, 1, stream_buffers[2]);
+        kuro_gfx_stream_buffer_set(loaded, 2, stream_buffers[0]);
+        kuro_gfx_stream_buffer_set(loaded, 3, stream_buffers[1]);
+        CHECK(kuro_gfx_stream_validate(loaded));
+        CHECK(stream_save(loaded) == blob);
+
+        // recording into a loaded stream reuses the patched handles
+        kuro_gfx_stream_buffer_bind(loaded, stream_buffers[0], 4);
+        CHECK(kuro_gfx_stream_handle_count(loaded) == 4);
+        kuro_gfx_stream_destroy(loaded);
+
+        // truncated, resized and corrupted blobs are rejected
+        CHECK(kuro_gfx_stream_load(blob.data(), (uint32_t)blob.size() - 8) == nullptr);
+        CHECK(kuro_gfx_stream_load(blob.data(), 8) == nullptr);
+        std::vector<uint8_t> corrupted = blob;
+        corrupted[16 + 4 * sizeof(uint32_t)] = 0x7F; // type of the first command, after the header and the handle kinds
+        CHECK(kuro_gfx_stream_load(corrupted.data(), (uint32_t)corrupted.size()) == nullptr);
+        corrupted = blob;
+        corrupted[0] ^= 0xFF;
+        CHECK(kuro_gfx_stream_load(corrupted.data(), (uint32_t)corrupted.size()) == nullptr);
+
+        // well formed commands with fields replay would index or switch on out of range, the bind is
+        // at 104 after the pipeline, the viewport and the 40 bytes write, the draw follows at 120
+        const uint32_t bind_slot = 104 + 3 * sizeof(uint32_t);
+        const uint32_t draw_primitive = 120 + 2 * sizeof(uint32_t);
+        const uint32_t draw_index_format = 120 + 5 * sizeof(uint32_t);
+        uint32_t slot = 0;
+        memcpy(&slot, blob.data() + bind_slot, sizeof(slot));
+        REQUIRE(slot == 3);
+        for (uint32_t bad_slot : {(uint32_t)KURO_CONSTANT_MAX_CONSTANT_BUFFERS, 0xFFFFFFFEu, 0xFFFFFFFFu})
+        {
+            corrupted = blob;
+            memcpy(corrupted.data() + bind_slot, &bad_slot, sizeof(bad_slot));
+            CHECK(kuro_gfx_stream_load(corrupted.data(), (uint32_t)corrupted.size()) == nullptr);
+        }
+        corrupted = blob;
+        uint32_t primitive = 7;
+        memcpy(corrupted.data() + draw_primitive, &primitive, sizeof(primitive));
+        CHECK(kuro_gfx_stream_load(corrupted.data(), (uint32_t)corrupted.size()) == nullptr);
+        corrupted = blob;
+        uint32_t index_format = KURO_GFX_FORMAT_R32G32_FLOAT;
+        memcpy(corrupted.data() + draw_index_format, &index_format, sizeof(index_format));
+        CHECK(kuro_gfx_stream_load(corrupted.data(), (uint32_t)corrupted.size()) == nullptr);
+
+        kuro_gfx_stream_destroy(stream);
+    }
+
+#if OS_LINUX
+    SUBCASE("replay")
+    {
+        const uint32_t width = 64, height = 32;
+        kr_gfx_t gfx = kuro_gfx_soft_create(2);
+        kuro_gfx_soft_vertex_shader_register(gfx, "vs_main", stream_vs_main, 0);
+        kuro_gfx_soft_pixel_shader_register(gfx, "ps_constant", stream_ps_constant);
+        kr_swapchain_t swapchain = kuro_gfx_swapchain_create(gfx, width, height, nullptr);
+        kr_commands_t commands = kuro_gfx_commands_create(gfx);
+        kr_vshader_t vertex_shader = kuro_gfx_vertex_shader_create(gfx, "", "vs_main");
+        kr_pshader_t pixel_shader = kuro_gfx_pixel_shader_create(gfx, "", "ps_constant");
+
+        Kuro_Gfx_Pipeline_Desc pipeline_desc = {};
+        pipeline_desc.vertex_shader = vertex_shader;
+        pipeline_desc.pixel_shader = pixel_shader;
+        pipeline_desc.vertex_attribures[0] = {KURO_GFX_FORMAT_R32G32B32_FLOAT, KURO_GFX_CLASS_PER_VERTEX, 0};
+        kr_pipeline_t pipeline = kuro_gfx_pipeline_create(gfx, pipeline_desc);
+
+        // left half of the screen, the draw covers its upper left triangle twice
+        Stream_Vertex vertices[] = {{-1, -1, 0.5f}, {0, -1, 0.5f}, {0, 1, 0.5f}, {-1, -1, 0.5f}, {0, 1, 0.5f}, {-1, 1, 0.5f}};
+        kr_buffer_t vertex_buffer = kuro_gfx_buffer_create(gfx, KURO_GFX_ACCESS_NONE, vertices, sizeof(vertices));
+        kr_buffer_t constant_buffer = kuro_gfx_buffer_create(gfx, KURO_GFX_ACCESS_WRITE, nullptr, 256);
+
+        Kuro_Gfx_Draw_Desc draw_desc = {};
+        draw_desc.vertex_buffers[0] = {vertex_buffer, sizeof(Stream_Vertex)};
+        draw_desc.count = 3;
+        draw_desc.instance_count = 2;
+        draw_desc.first = 3;
+        float red[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+
+        kr_stream_t stream = kuro_gfx_stream_create();
+        kuro_gfx_stream_set_pipeline(stream, pipeline);
+        kuro_gfx_stream_viewport(stream, width, height);
+        kuro_gfx_stream_clear(stream, Kuro_Gfx_Color{0.0f, 0.0f, 1.0f, 1.0f}, 1.0f);
+        uint32_t write = kuro_gfx_stream_buffer_write(stream, constant_buffer, red, sizeof(red));
+        kuro_gfx_stream_buffer_bind(stream, constant_buffer, 0);
+        kuro_gfx_stream_set_pipeline(stream, pipeline);
+        kuro_gfx_stream_buffer_bind(stream, constant_buffer, 0);
+        kuro_gfx_stream_draw(stream, draw_desc);
+        CHECK(kuro_gfx_stream_optimize(stream) == 2);
+        REQUIRE(kuro_gfx_stream_validate(stream));
+
+        // the same frame recorded directly
+        std::vector<uint32_t> direct(width * height), replayed(width * height);
+        kuro_gfx_commands_begin(gfx, commands, swapchain, nullptr);
+        kuro_gfx_set_pipeline(commands, pipeline);
+        kuro_gfx_viewport(commands, width, height);
+        kuro_gfx_clear(commands, Kuro_Gfx_Color{0.0f, 0.0f, 1.0f, 1.0f}, 1.0f);
+        kuro_gfx_buffer_write(commands, constant_buffer, red, sizeof(red));
+        kuro_gfx_buffer_bind(commands, constant_buffer, 0);
+        kuro_gfx_draw(commands, draw_desc);
+        kuro_gfx_commands_end(gfx, commands);
+        kuro_gfx_soft_swapchain_read(gfx, swapchain, direct.data());
+
+        kuro_gfx_commands_begin(gfx, commands, swapchain, nullptr);
+        kuro_gfx_stream_replay(stream, commands);
+        kuro_gfx_commands_end(gfx, commands);
+        kuro_gfx_soft_swapchain_read(gfx, swapchain, replayed.data());
+        CHECK(direct == replayed);
+        CHECK(replayed[0] == 0xFF0000FF);
+        CHECK(replayed[width - 1] == 0xFFFF0000);
+
+        // the recorded constants are updated in place between replays
+        float *constants = (float *)kuro_gfx_stream_write_data(stream, write);
+        constants[0] = 0.0f;
+        constants[1] = 1.0f;
+        kuro_gfx_commands_begin(gfx, commands, swapchain, nullptr);
+        kuro_gfx_stream_replay(stream, commands);
+        kuro_gfx_commands_end(gfx, commands);
+        kuro_gfx_soft_swapchain_read(gfx, swapchain, replayed.data());
+        CHECK(replayed[0] == 0xFF00FF00);
+
+        kuro_gfx_stream_destroy(stream);
+        kuro_gfx_buffer_destroy(gfx, constant_buffer);
+        kuro_gfx_buffer_destroy(gfx, vertex_buffer);
+        kuro_gfx_pipeline_destroy(gfx, pipeline);
+        kuro_gfx_pixel_shader_destroy(gfx, pixel_shader);
+        kuro_gfx_vertex_shader_destroy(gfx, vertex_shader);
+        kuro_gfx_commands_destroy(gfx, commands);
+        kuro_gfx_swapchain_destroy(gfx, swapchain);
+        kuro_gfx_destroy(gfx);
+    }
+#endif
+}
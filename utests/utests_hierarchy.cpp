@@ -0,0 +1,227 @@
+#include <kuro/kuro_hierarchy.h>
+
+#include <doctest/doctest.h>
+
+#include <string.h>
+#include <vector>
+
+// =================================================================================================
+// == HELPERS ======================================================================================
+// =================================================================================================
+struct Hierarchy_Random
+{
+    kuro::u32 seed;
+
+    kuro::f32
+    next(kuro::f32 lo, kuro::f32 hi)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return lo + (hi - lo) * (kuro::f32)(seed >> 8) / (kuro::f32)(1u << 24);
+    }
+
+    kuro::u32
+    index(kuro::u32 count)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % count;
+    }
+
+    void
+    local(kuro::vec3 &translation, kuro::quat &rotation, kuro::vec3 &scale)
+    {
+        translation = {next(-5.0f, 5.0f), next(-5.0f, 5.0f), next(-5.0f, 5.0f)};
+        rotation = kuro::quat_from_euler(next(-3.0f, 3.0f), next(-3.0f, 3.0f), next(-3.0f, 3.0f));
+        scale = {next(0.8f, 1.25f), next(0.8f, 1.25f), next(0.8f, 1.25f)};
+    }
+};
+
+// the recursive products the hierarchy replaces
+static kuro::mat4
+hierarchy_reference(const kuro::transform_hierarchy &hierarchy, kuro::u32 node)
+{
+    kuro::mat4 local = kuro::mat4_scaling(hierarchy.scales[node]) * kuro::mat4_from_quat(hierarchy.rotations[node]) * kuro::mat4_translation(hierarchy.translations[node]);
+    kuro::u32 parent = hierarchy.parents[node];
+    return parent == kuro::TRANSFORM_NONE ? local : local * hierarchy_reference(hierarchy, parent);
+}
+
+static void
+hierarchy_check(const kuro::transform_hierarchy &hierarchy)
+{
+    for (kuro::u32 i = 0; i < (kuro::u32)hierarchy.parents.size(); ++i)
+    {
+        kuro::mat4 expected = hierarchy_reference(hierarchy, i);
+        const kuro::mat4 &world = hierarchy.worlds[i];
+        const kuro::f32 *a = &world.m00;
+        const kuro::f32 *b = &expected.m00;
+        for (int j = 0; j < 16; ++j)
+            REQUIRE(a[j] == doctest::Approx(b[j]).epsilon(1e-4).scale(1.0));
+    }
+}
+
+static bool
+hierarchy_below(const kuro::transform_hierarchy &hierarchy, kuro::u32 node, kuro::u32 ancestor)
+{
+    for (kuro::u32 p = node; p != kuro::TRANSFORM_NONE; p = hierarchy.parents[p])
+        if (p == ancestor)
+            return true;
+    return false;
+}
+
+// parents picked at random among the earlier nodes, a few roots
+static kuro::transform_hierarchy
+hierarchy_random(Hierarchy_Random &random, kuro::u32 count)
+{
+    kuro::transform_hierarchy hierarchy;
+    for (kuro::u32 i = 0; i < count; ++i)
+    {
+        kuro::vec3 t, s;
+        kuro::quat r;
+        random.local(t, r, s);
+        kuro::u32 parent = i == 0 || i % 50 == 0 ? kuro::TRANSFORM_NONE : random.index(i);
+        kuro::transform_hierarchy_add(hierarchy, parent, t, r, s);
+    }
+    return hierarchy;
+}
+
+// =================================================================================================
+// == HIERARCHY ====================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_hierarchy]: transform hierarchy")
+{
+    SUBCASE("propagation")
+    {
+        Hierarchy_Random random = {11};
+        kuro::transform_hierarchy hierarchy = hierarchy_random(random, 300);
+        kuro::transform_hierarchy_update(hierarchy);
+        hierarchy_check(hierarchy);
+        for (kuro::u8 changed : hierarchy.changed)
+            CHECK(changed == 1);
+
+        // nothing dirty, nothing changes
+        kuro::transform_hierarchy_update(hierarchy);
+        for (kuro::u8 changed : hierarchy.changed)
+            CHECK(changed == 0);
+    }
+
+    SUBCASE("dirty subtrees")
+    {
+        Hierarchy_Random random = {12};
+        kuro::transform_hierarchy hierarchy = hierarchy_random(random, 300);
+        kuro::transform_hierarchy_update(hierarchy);
+
+        kuro::u32 moved = 7;
+        kuro::transform_hierarchy_set_translation(hierarchy, moved, {1.0f, 2.0f, 3.0f});
+        kuro::transform_hierarchy_set_rotation(hierarchy, moved, kuro::quat_from_euler(0.5f, 0.0f, 0.0f));
+        kuro::transform_hierarchy_set_scale(hierarchy, 250, {2.0f, 2.0f, 2.0f});
+        kuro::transform_hierarchy_update(hierarchy);
+        hierarchy_check(hierarchy);
+
+        kuro::u32 changed = 0;
+        for (kuro::u32 i = 0; i < 300; ++i)
+        {
+            bool expected = hierarchy_below(hierarchy, i, moved) || hierarchy_below(hierarchy, i, 250);
+            REQUIRE((hierarchy.changed[i] == 1) == expected);
+            changed += hierarchy.changed[i];
+        }
+        CHECK(changed > 2);
+        CHECK(changed < 300);
+    }
+
+    SUBCASE("sort")
+    {
+        Hierarchy_Random random = {13};
+        kuro::transform_hierarchy hierarchy = hierarchy_random(random, 500);
+        CHECK_FALSE(hierarchy.sorted);
+        kuro::transform_hierarchy_update(hierarchy);
+        std::vector<kuro::mat4> worlds = hierarchy.worlds;
+        std::vector<kuro::u32> parents = hierarchy.parents;
+
+        std::vector<kuro::u32> remap(500);
+        kuro::transform_hierarchy_sort(hierarchy, remap.data());
+        CHECK(hierarchy.sorted);
+
+        for (kuro::u32 i = 0; i < 500; ++i)
+        {
+            // the same nodes under the same parents, with their world matrices
+            kuro::u32 node = remap[i];
+            REQUIRE(hierarchy.parents[node] == (parents[i] == kuro::TRANSFORM_NONE ? kuro::TRANSFORM_NONE : remap[parents[i]]));
+            CHECK(hierarchy.worlds[node].m30 == worlds[i].m30);
+            if (parents[i] != kuro::TRANSFORM_NONE)
+                REQUIRE(hierarchy.parents[node] < node);
+        }
+
+        // every subtree is the contiguous range after its root
+        for (kuro::u32 i = 0; i < 500; ++i)
+            for (kuro::u32 j = 0; j < 500; ++j)
+                REQUIRE(hierarchy_below(hierarchy, j, i) == (j >= i && j < i + hierarchy.subtree_sizes[i]));
+
+        // siblings keep their order
+        for (kuro::u32 i = 1; i < 500; ++i)
+            for (kuro::u32 j = 0; j < i; ++j)
+                if (parents[i] == parents[j])
+                    REQUIRE(remap[j] < remap[i]);
+
+        for (kuro::u32 i = 0; i < 500; ++i)
+            kuro::transform_hierarchy_set_scale(hierarchy, i, hierarchy.scales[i]);
+        kuro::transform_hierarchy_update(hierarchy);
+        hierarchy_check(hierarchy);
+    }
+
+    SUBCASE("depth first adds")
+    {
+        kuro::transform_hierarchy hierarchy;
+        kuro::vec3 t = {1.0f, 0.0f, 0.0f}, s = {1.0f, 1.0f, 1.0f};
+        kuro::quat r = kuro::quat_identity();
+
+        kuro::u32 root = kuro::transform_hierarchy_add(hierarchy, kuro::TRANSFORM_NONE, t, r, s);
+        kuro::u32 a = kuro::transform_hierarchy_add(hierarchy, root, t, r, s);
+        kuro::transform_hierarchy_add(hierarchy, a, t, r, s);
+        kuro::u32 b = kuro::transform_hierarchy_add(hierarchy, root, t, r, s);
+        kuro::transform_hierarchy_add(hierarchy, kuro::TRANSFORM_NONE, t, r, s);
+        CHECK(hierarchy.sorted);
+        CHECK(hierarchy.subtree_sizes[root] == 4);
+        CHECK(hierarchy.subtree_sizes[a] == 2);
+        CHECK(hierarchy.subtree_sizes[b] == 1);
+
+        kuro::transform_hierarchy_update(hierarchy);
+        CHECK(hierarchy.worlds[3].m30 == 2.0f);
+        CHECK(hierarchy.worlds[2].m30 == 3.0f);
+
+        // a's subtree doesn't end at the last node anymore
+        kuro::transform_hierarchy_add(hierarchy, a, t, r, s);
+        CHECK_FALSE(hierarchy.sorted);
+
+        kuro::transform_hierarchy_clear(hierarchy);
+        CHECK(hierarchy.sorted);
+        CHECK(hierarchy.worlds.empty());
+    }
+
+    SUBCASE("threads")
+    {
+        Hierarchy_Random random = {14};
+        kuro::transform_hierarchy serial = hierarchy_random(random, 20000);
+        kuro::transform_hierarchy_sort(serial, nullptr);
+        kuro::transform_hierarchy threaded = serial;
+
+        kuro::transform_hierarchy_update(serial, 1);
+        kuro::transform_hierarchy_update(threaded, 4);
+        for (kuro::u32 i = 0; i < 20000; ++i)
+            REQUIRE(memcmp(&serial.worlds[i], &threaded.worlds[i], sizeof(kuro::mat4)) == 0);
+
+        for (kuro::u32 frame = 0; frame < 3; ++frame)
+        {
+            for (kuro::u32 n = 0; n < 50; ++n)
+            {
+                kuro::u32 node = random.index(20000);
+                kuro::vec3 t = {random.next(-1.0f, 1.0f), 0.0f, 0.0f};
+                kuro::transform_hierarchy_set_translation(serial, node, t);
+                kuro::transform_hierarchy_set_translation(threaded, node, t);
+            }
+            kuro::transform_hierarchy_update(serial, 1);
+            kuro::transform_hierarchy_update(threaded, 0);
+            REQUIRE(serial.changed == threaded.changed);
+            for (kuro::u32 i = 0; i < 20000; ++i)
+                REQUIRE(memcmp(&serial.worlds[i], &threaded.worlds[i], sizeof(kuro::mat4)) == 0);
+        }
+    }
+}
@@ -130,6 +130,54 @@ TEST_CASE("[kuro_math]: math")
             CHECK(doctest::Approx(kuro::tan(kuro::f32(theta))) == ::tanf(kuro::f32(theta)));
         }
     }
+
+    SUBCASE("sincos")
+    {
+        for (kuro::f64 theta = -2.0 * kuro::TAU; theta < 2 * kuro::TAU; theta += 0.1)
+        {
+            INFO("theta: ", theta);
+            kuro::f32 s, c;
+            kuro::sincos(kuro::f32(theta), s, c);
+            CHECK(s == kuro::sin(kuro::f32(theta)));
+            CHECK(c == kuro::cos(kuro::f32(theta)));
+            CHECK(doctest::Approx(s) == ::sin(kuro::f32(theta)));
+            CHECK(doctest::Approx(c) == ::cos(kuro::f32(theta)));
+        }
+
+        // beyond the reduction range it falls back to libm
+        CHECK(doctest::Approx(kuro::sin(1.0e6f)) == ::sin(1.0e6));
+        CHECK(doctest::Approx(kuro::cos(-1.0e6f)) == ::cos(-1.0e6));
+    }
+
+    SUBCASE("asin")
+    {
+        for (kuro::f64 f = -1.0; f <= 1.0; f += 0.01)
+        {
+            INFO("f: ", f);
+            CHECK(doctest::Approx(kuro::asin(f)) == ::asin(f));
+            CHECK(doctest::Approx(kuro::asin(kuro::f32(f))) == ::asin(kuro::f32(f)));
+        }
+
+        CHECK(kuro::asin(1.0f) == doctest::Approx(kuro::PI_DIV_2));
+        CHECK(kuro::asin(1.0001f) == kuro::asin(1.0f));
+    }
+
+    SUBCASE("atan2")
+    {
+        for (kuro::f64 theta = -kuro::PI + 0.05; theta < kuro::PI; theta += 0.1)
+        {
+            INFO("theta: ", theta);
+            kuro::f64 y = 3.0 * ::sin(theta);
+            kuro::f64 x = 3.0 * ::cos(theta);
+            CHECK(doctest::Approx(kuro::atan2(y, x)) == theta);
+            CHECK(doctest::Approx(kuro::atan2(kuro::f32(y), kuro::f32(x))) == theta);
+        }
+
+        CHECK(kuro::atan2(1.0f, 0.0f) == doctest::Approx(kuro::PI_DIV_2));
+        CHECK(kuro::atan2(-1.0f, 0.0f) == doctest::Approx(-kuro::PI_DIV_2));
+        CHECK(kuro::atan2(0.0f, -1.0f) == doctest::Approx(kuro::PI));
+        CHECK(kuro::atan2(0.0f, 0.0f) == 0.0f);
+    }
 }
 
 // =================================================================================================
@@ -1315,6 +1363,37 @@ TEST_CASE("[kuro_math]: mat3")
         CHECK(b == a);
     }
 
+    SUBCASE("batch inverse")
+    {
+        constexpr kuro::u32 count = 11;
+        kuro::mat3 Ms[count], out[count];
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::f32 f = (kuro::f32)i;
+            Ms[i] = kuro::mat3{
+                3.0f + f, 2.0f, -1.0f * f,
+                2.0f, 1.0f - 0.5f * f, 5.0f,
+                0.25f * f, 5.0f, 2.0f
+            };
+        }
+        Ms[4] = kuro::mat3{
+            1.0f, 2.0f, 3.0f,
+            2.0f, 4.0f, 6.0f,
+            0.0f, 1.0f, 1.0f
+        };
+
+        kuro::mat3_inverse(Ms, out, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::mat3 expected = kuro::mat3_inverse(Ms[i]);
+            const kuro::f32 *a = &out[i].m00;
+            const kuro::f32 *b = &expected.m00;
+            for (int j = 0; j < 9; ++j)
+                CHECK(a[j] == doctest::Approx(b[j]));
+        }
+        CHECK(out[4] == kuro::mat3{});
+    }
+
     SUBCASE("translation 2d")
     {
         kuro::vec2 p = {10.0f, 20.0f};
@@ -2083,6 +2162,86 @@ TEST_CASE("[kuro_math]: mat4")
         CHECK(b.w == doctest::Approx(a.w));
     }
 
+    SUBCASE("affine multiply")
+    {
+        kuro::mat4 A = kuro::mat4_scaling(2.0f, 0.5f, 3.0f) * kuro::mat4_euler(0.3f, -1.2f, 0.7f) * kuro::mat4_translation(1.5f, -2.0f, 3.25f);
+        kuro::mat4 B = kuro::mat4_shearing_xy(0.25f) * kuro::mat4_rotation_axis(kuro::normalize(kuro::vec3{1.0f, 2.0f, -1.0f}), 2.1f) * kuro::mat4_translation(-4.0f, 0.5f, 7.0f);
+
+        kuro::mat4 C = kuro::mat4_affine_mul(A, B);
+        kuro::mat4 D = A * B;
+        const kuro::f32 *c = &C.m00;
+        const kuro::f32 *d = &D.m00;
+        for (int i = 0; i < 16; ++i)
+            CHECK(c[i] == doctest::Approx(d[i]));
+
+        C = kuro::mat4_affine_mul(kuro::mat4_identity(), A);
+        CHECK(C == A);
+        C = kuro::mat4_affine_mul(A, kuro::mat4_identity());
+        CHECK(C == A);
+    }
+
+    SUBCASE("affine inverse")
+    {
+        kuro::mat4 A = kuro::mat4_scaling(2.0f, 0.5f, 3.0f) * kuro::mat4_euler(0.3f, -1.2f, 0.7f) * kuro::mat4_shearing_zx(0.4f) * kuro::mat4_translation(1.5f, -2.0f, 3.25f);
+        kuro::mat4 R = kuro::mat4_euler(-2.0f, 0.4f, 2.5f) * kuro::mat4_translation(-4.0f, 0.5f, 7.0f);
+
+        kuro::mat4 B = kuro::mat4_affine_inverse(A);
+        kuro::mat4 C = kuro::mat4_inverse(A);
+        const kuro::f32 *b = &B.m00;
+        const kuro::f32 *c = &C.m00;
+        for (int i = 0; i < 16; ++i)
+            CHECK(b[i] == doctest::Approx(c[i]));
+
+        B = kuro::mat4_rigid_inverse(R);
+        C = kuro::mat4_inverse(R);
+        for (int i = 0; i < 16; ++i)
+            CHECK(b[i] == doctest::Approx(c[i]));
+
+        kuro::mat4 I = kuro::mat4_affine_mul(R, kuro::mat4_rigid_inverse(R));
+        kuro::mat4 identity = kuro::mat4_identity();
+        const kuro::f32 *m = &I.m00;
+        const kuro::f32 *e = &identity.m00;
+        for (int i = 0; i < 16; ++i)
+            CHECK(m[i] == doctest::Approx(e[i]));
+
+        CHECK(kuro::mat4_affine_inverse(kuro::mat4_scaling(1.0f, 0.0f, 1.0f)) == kuro::mat4{});
+    }
+
+    SUBCASE("batch inverse")
+    {
+        // two full batches and a tail, with singular matrices in both
+        constexpr kuro::u32 count = 19;
+        kuro::mat4 Ms[count], out[count];
+        kuro::f32 dets[count];
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::f32 f = (kuro::f32)i;
+            Ms[i] = kuro::mat4_scaling(1.0f + 0.1f * f, 2.0f - 0.05f * f, 0.5f + 0.2f * f) *
+                    kuro::mat4_euler(0.3f * f, -0.2f * f, 1.0f - 0.1f * f) *
+                    kuro::mat4_translation(f, -2.0f * f, 0.5f);
+            Ms[i].m03 = 0.1f * f;
+            Ms[i].m23 = -0.05f * f;
+        }
+        Ms[2] = kuro::mat4_scaling(1.0f, 0.0f, 1.0f);
+        Ms[17] = kuro::mat4{};
+
+        kuro::mat4_det(Ms, dets, count);
+        kuro::mat4_inverse(Ms, out, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            CHECK(dets[i] == doctest::Approx(kuro::mat4_det(Ms[i])));
+
+            kuro::mat4 expected = kuro::mat4_inverse(Ms[i]);
+            const kuro::f32 *a = &out[i].m00;
+            const kuro::f32 *b = &expected.m00;
+            for (int j = 0; j < 16; ++j)
+                CHECK(a[j] == doctest::Approx(b[j]));
+        }
+        CHECK(dets[2] == 0.0f);
+        CHECK(out[2] == kuro::mat4{});
+        CHECK(out[17] == kuro::mat4{});
+    }
+
     SUBCASE("translation")
     {
         kuro::vec3 t = {10.0f, 20.0f, 30.0f};
@@ -2452,6 +2611,854 @@ TEST_CASE("[kuro_math]: mat4")
     }
 }
 
+// =================================================================================================
+// == QUAT =========================================================================================
+// =================================================================================================
+
+TEST_CASE("[kuro_math]: quat")
+{
+    auto check_mat4 = [](const kuro::mat4 &A, const kuro::mat4 &B) {
+        const kuro::f32 *a = &A.m00;
+        const kuro::f32 *b = &B.m00;
+        for (int i = 0; i < 16; ++i)
+            CHECK(a[i] == doctest::Approx(b[i]).epsilon(1e-5));
+    };
+
+    SUBCASE("arithmetic")
+    {
+        kuro::quat a = {1.0f, 2.0f, 3.0f, 4.0f};
+        kuro::quat b = {-2.0f, 0.5f, 1.0f, 3.0f};
+
+        CHECK(a + b == kuro::quat{-1.0f, 2.5f, 4.0f, 7.0f});
+        CHECK(a - b == kuro::quat{3.0f, 1.5f, 2.0f, 1.0f});
+        CHECK(-a == kuro::quat{-1.0f, -2.0f, -3.0f, -4.0f});
+        CHECK(a * 2.0f == kuro::quat{2.0f, 4.0f, 6.0f, 8.0f});
+        CHECK(kuro::dot(a, b) == 14.0f);
+        CHECK(kuro::length(kuro::quat{0.0f, 3.0f, 0.0f, 4.0f}) == 5.0f);
+        CHECK(kuro::length(kuro::normalize(a)) == doctest::Approx(1.0f));
+        CHECK(kuro::quat_conjugate(a) == kuro::quat{-1.0f, -2.0f, -3.0f, 4.0f});
+        CHECK(a * kuro::quat_identity() == a);
+        CHECK(kuro::quat_identity() * a == a);
+
+        kuro::quat I = a * kuro::quat_inverse(a);
+        CHECK(I.x == doctest::Approx(0.0f));
+        CHECK(I.y == doctest::Approx(0.0f));
+        CHECK(I.z == doctest::Approx(0.0f));
+        CHECK(I.w == doctest::Approx(1.0f));
+    }
+
+    SUBCASE("rotation")
+    {
+        kuro::vec3 axis = kuro::normalize(kuro::vec3{1.0f, -2.0f, 0.5f});
+        kuro::quat q = kuro::quat_from_axis_angle(axis, 0.8f);
+        check_mat4(kuro::mat4_from_quat(q), kuro::mat4_rotation_axis(axis, 0.8f));
+        check_mat4(kuro::mat4_from_quat(kuro::quat_identity()), kuro::mat4_identity());
+
+        kuro::quat e = kuro::quat_from_euler(0.3f, -1.2f, 0.7f);
+        check_mat4(kuro::mat4_from_quat(e), kuro::mat4_euler(0.3f, -1.2f, 0.7f));
+        check_mat4(kuro::mat4_from_quat(kuro::quat_from_euler(kuro::vec3{-2.0f, 0.4f, 2.5f})), kuro::mat4_euler(-2.0f, 0.4f, 2.5f));
+
+        kuro::mat3 R = kuro::mat3_from_quat(e);
+        kuro::mat3 E = kuro::mat3_euler(0.3f, -1.2f, 0.7f);
+        CHECK(R.m01 == doctest::Approx(E.m01));
+        CHECK(R.m12 == doctest::Approx(E.m12));
+        CHECK(R.m20 == doctest::Approx(E.m20));
+
+        // composition follows the matrix order
+        check_mat4(kuro::mat4_from_quat(q * e), kuro::mat4_from_quat(q) * kuro::mat4_from_quat(e));
+        check_mat4(kuro::mat4_from_quat(e * q), kuro::mat4_from_quat(e) * kuro::mat4_from_quat(q));
+
+        kuro::vec3 v = {0.5f, 2.0f, -3.0f};
+        kuro::vec3 r = v * q;
+        kuro::vec4 p = kuro::vec4{v.x, v.y, v.z, 1.0f} * kuro::mat4_from_quat(q);
+        CHECK(r.x == doctest::Approx(p.x));
+        CHECK(r.y == doctest::Approx(p.y));
+        CHECK(r.z == doctest::Approx(p.z));
+
+        kuro::vec3 t = {4.0f, -1.0f, 2.5f}, s = {2.0f, 0.5f, 3.0f};
+        check_mat4(kuro::mat4_trs(t, q, s), kuro::mat4_scaling(s) * kuro::mat4_from_quat(q) * kuro::mat4_translation(t));
+    }
+
+    SUBCASE("interpolation")
+    {
+        kuro::vec3 axis = kuro::normalize(kuro::vec3{0.2f, 1.0f, -0.3f});
+        kuro::quat a = kuro::quat_from_axis_angle(axis, 0.2f);
+        kuro::quat b = kuro::quat_from_axis_angle(axis, 1.4f);
+
+        CHECK(kuro::quat_slerp(a, b, 0.0f).w == doctest::Approx(a.w));
+        CHECK(kuro::quat_slerp(a, b, 1.0f).w == doctest::Approx(b.w));
+
+        // slerp moves along the arc at constant speed
+        kuro::quat s = kuro::quat_slerp(a, b, 0.25f);
+        kuro::quat expected = kuro::quat_from_axis_angle(axis, 0.5f);
+        CHECK(s.x == doctest::Approx(expected.x));
+        CHECK(s.y == doctest::Approx(expected.y));
+        CHECK(s.z == doctest::Approx(expected.z));
+        CHECK(s.w == doctest::Approx(expected.w));
+
+        // -b is the same rotation, both take the short path
+        kuro::quat n = kuro::quat_nlerp(a, -b, 0.5f);
+        kuro::quat m = kuro::quat_from_axis_angle(axis, 0.8f);
+        CHECK(n.x == doctest::Approx(m.x));
+        CHECK(n.w == doctest::Approx(m.w));
+        CHECK(kuro::quat_slerp(a, -b, 0.5f).w == doctest::Approx(m.w));
+
+        // nearly equal rotations
+        kuro::quat c = kuro::quat_slerp(a, a, 0.3f);
+        CHECK(c.w == doctest::Approx(a.w));
+        CHECK(c.y == doctest::Approx(a.y));
+    }
+
+    SUBCASE("batch")
+    {
+        constexpr kuro::u32 count = 11;
+        kuro::quat a[count], b[count], out[count];
+        kuro::f32 t[count];
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::f32 f = (kuro::f32)i;
+            a[i] = kuro::quat_from_euler(0.3f * f, -0.2f * f, 1.0f - 0.1f * f);
+            b[i] = kuro::quat_from_euler(-0.5f + 0.4f * f, 0.7f * f, 0.25f * f);
+            t[i] = f / (count - 1);
+        }
+        b[3] = -b[3];
+        b[5] = a[5];
+
+        kuro::quat_slerp(a, b, t, out, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+            CHECK(out[i] == kuro::quat_slerp(a[i], b[i], t[i]));
+
+        kuro::quat_slerp(a, b, 0.6f, out, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+            CHECK(out[i] == kuro::quat_slerp(a[i], b[i], 0.6f));
+
+        kuro::quat_nlerp(a, b, t, out, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+            CHECK(out[i] == kuro::quat_nlerp(a[i], b[i], t[i]));
+
+        kuro::quat_nlerp(a, b, 0.6f, out, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+            CHECK(out[i] == kuro::quat_nlerp(a[i], b[i], 0.6f));
+    }
+}
+
+// =================================================================================================
+// == SIMD =========================================================================================
+// =================================================================================================
+
+TEST_CASE("[kuro_math]: simd")
+{
+    kuro::mat4 A = {
+         2.0f,  1.0f,  0.5f, -3.0f,
+        -1.0f,  4.0f,  2.0f,  0.25f,
+         0.3f, -2.0f,  5.0f,  1.0f,
+         7.0f,  0.1f, -0.7f,  1.0f
+    };
+
+    kuro::mat4 B = kuro::mat4_euler(0.3f, -1.2f, 0.7f) * kuro::mat4_translation(1.5f, -2.0f, 3.25f);
+
+    SUBCASE("f32x4")
+    {
+        kuro::f32x4 a = kuro::f32x4_set(1.0f, 2.0f, 3.0f, 4.0f);
+        kuro::f32x4 b = kuro::f32x4_splat(2.0f);
+
+        kuro::f32x4 c = (a + b) * b - a / b;
+        CHECK(kuro::f32x4_lane(c, 0) == 5.5f);
+        CHECK(kuro::f32x4_lane(c, 1) == 7.0f);
+        CHECK(kuro::f32x4_lane(c, 2) == 8.5f);
+        CHECK(kuro::f32x4_lane(c, 3) == 10.0f);
+
+        CHECK(kuro::f32x4_sum(a) == 10.0f);
+        CHECK(kuro::f32x4_lane(kuro::f32x4_min(a, b), 3) == 2.0f);
+        CHECK(kuro::f32x4_lane(kuro::f32x4_max(a, b), 0) == 2.0f);
+        CHECK(kuro::f32x4_lane(kuro::f32x4_sqrt(a * a), 2) == 3.0f);
+        CHECK(kuro::f32x4_equal(-(-a), a));
+    }
+
+    SUBCASE("vec4a")
+    {
+        kuro::vec4 a = {1.0f, -2.5f, 3.0f, 0.75f};
+        kuro::vec4 b = {0.1f, 12.0f, -13.0f, 4.0f};
+
+        kuro::vec4a aa = kuro::vec4a_from(a);
+        kuro::vec4a ba = kuro::vec4a_from(b);
+        CHECK(alignof(kuro::vec4a) == 16);
+        CHECK(sizeof(kuro::vec4a) == sizeof(kuro::vec4));
+
+        CHECK(kuro::vec4_from(aa + ba) == a + b);
+        CHECK(kuro::vec4_from(aa - ba) == a - b);
+        CHECK(kuro::vec4_from(-aa) == -a);
+        CHECK(kuro::vec4_from(aa * 3.0f) == a * 3.0f);
+        CHECK(kuro::vec4_from(aa / 3.0f) == a / 3.0f);
+        CHECK(kuro::dot(aa, ba) == kuro::dot(a, b));
+        CHECK(kuro::length(aa) == kuro::length(a));
+        CHECK(kuro::vec4_from(kuro::normalize(ba)) == kuro::normalize(b));
+        CHECK(kuro::vec4_from(aa * kuro::mat4a_from(A)) == a * A);
+    }
+
+    SUBCASE("mat4a")
+    {
+        kuro::mat4a Aa = kuro::mat4a_from(A);
+        kuro::mat4a Ba = kuro::mat4a_from(B);
+        CHECK(alignof(kuro::mat4a) == 16);
+        CHECK(sizeof(kuro::mat4a) == sizeof(kuro::mat4));
+
+        // everything but the inverse matches the scalar path bit by bit
+        CHECK(kuro::mat4_from(Aa) == A);
+        CHECK(kuro::mat4_from(Aa + Ba) == A + B);
+        CHECK(kuro::mat4_from(Aa - Ba) == A - B);
+        CHECK(kuro::mat4_from(-Aa) == -A);
+        CHECK(kuro::mat4_from(Aa * 0.5f) == A * 0.5f);
+        CHECK(kuro::mat4_from(Aa * Ba) == A * B);
+        CHECK(kuro::mat4_from(Ba * Aa) == B * A);
+        CHECK(kuro::mat4_from(kuro::mat4a_transpose(Aa)) == kuro::mat4_transpose(A));
+        CHECK(kuro::mat4a_identity() * Aa == Aa);
+
+        CHECK(kuro::mat4a_det(Aa) == doctest::Approx(kuro::mat4_det(A)));
+        CHECK(kuro::mat4a_det(Ba) == doctest::Approx(kuro::mat4_det(B)));
+        CHECK(kuro::mat4a_invertible(Aa));
+        CHECK(kuro::mat4a_invertible(kuro::mat4a{}) == false);
+        CHECK(kuro::mat4a_inverse(kuro::mat4a{}) == kuro::mat4a{});
+
+        for (const kuro::mat4 &M : {A, B})
+        {
+            kuro::mat4 R = kuro::mat4_from(kuro::mat4a_inverse(kuro::mat4a_from(M)));
+            kuro::mat4 S = kuro::mat4_inverse(M);
+            const kuro::f32 *r = &R.m00;
+            const kuro::f32 *s = &S.m00;
+            for (int i = 0; i < 16; ++i)
+                CHECK(r[i] == doctest::Approx(s[i]).epsilon(1e-5f).scale(1.0f));
+
+            kuro::mat4 I = kuro::mat4_from(kuro::mat4a_from(M) * kuro::mat4a_from(R));
+            const kuro::f32 *id = &I.m00;
+            for (int i = 0; i < 16; ++i)
+                CHECK(id[i] == doctest::Approx(i % 5 == 0 ? 1.0f : 0.0f).epsilon(1e-5f).scale(1.0f));
+        }
+    }
+
+    SUBCASE("f32x8")
+    {
+        kuro::f32 values[8] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f};
+        kuro::f32x8 a = kuro::f32x8_loadu(values);
+        kuro::f32x8 b = kuro::f32x8_splat(2.0f);
+
+        kuro::f32 result[8];
+        kuro::f32x8_storeu(result, (a + b) * b - a / b);
+        for (int i = 0; i < 8; ++i)
+            CHECK(result[i] == (values[i] + 2.0f) * 2.0f - values[i] / 2.0f);
+
+        CHECK(kuro::f32x8_lane(kuro::f32x8_min(a, b), 7) == 2.0f);
+        CHECK(kuro::f32x8_lane(kuro::f32x8_max(a, b), 0) == 2.0f);
+        CHECK(kuro::f32x8_lane(kuro::f32x8_sqrt(a * a), 5) == 6.0f);
+        CHECK(kuro::f32x8_lane(-a, 4) == -5.0f);
+    }
+
+    SUBCASE("transcendentals")
+    {
+        // every lane matches the f32 version
+        for (kuro::f32 theta = -20.0f; theta < 20.0f; theta += 0.37f)
+        {
+            INFO("theta: ", theta);
+            kuro::f32x4 a = kuro::f32x4_set(theta, -theta, 0.5f * theta, theta + 0.1f);
+            kuro::f32x8 b = kuro::f32x8_splat(theta);
+
+            kuro::f32x4 s4, c4;
+            kuro::sincos(a, s4, c4);
+            CHECK(kuro::f32x4_lane(s4, 0) == kuro::sin(theta));
+            CHECK(kuro::f32x4_lane(c4, 1) == kuro::cos(-theta));
+            CHECK(kuro::f32x4_lane(kuro::sin(a), 2) == kuro::sin(0.5f * theta));
+            CHECK(kuro::f32x4_lane(kuro::cos(a), 3) == kuro::cos(theta + 0.1f));
+            CHECK(kuro::f32x4_lane(kuro::tan(a), 0) == kuro::tan(theta));
+
+            CHECK(kuro::f32x8_lane(kuro::sin(b), 5) == kuro::sin(theta));
+            CHECK(kuro::f32x8_lane(kuro::cos(b), 6) == kuro::cos(theta));
+            CHECK(kuro::f32x8_lane(kuro::tan(b), 7) == kuro::tan(theta));
+
+            kuro::f32 f = theta / 20.0f;
+            CHECK(kuro::f32x4_lane(kuro::asin(kuro::f32x4_splat(f)), 1) == kuro::asin(f));
+            CHECK(kuro::f32x8_lane(kuro::asin(kuro::f32x8_splat(f)), 4) == kuro::asin(f));
+            CHECK(kuro::f32x4_lane(kuro::atan2(a, kuro::f32x4_splat(-2.0f)), 1) == kuro::atan2(-theta, -2.0f));
+            CHECK(kuro::f32x8_lane(kuro::atan2(b, kuro::f32x8_splat(3.0f)), 2) == kuro::atan2(theta, 3.0f));
+        }
+
+        kuro::f32x4 zero = kuro::f32x4_splat(0.0f);
+        kuro::f32x4 y = kuro::f32x4_set(1.0f, -1.0f, 0.0f, 0.0f);
+        kuro::f32x4 x = kuro::f32x4_set(0.0f, 0.0f, 0.0f, -1.0f);
+        kuro::f32x4 r = kuro::atan2(y, x);
+        CHECK(kuro::f32x4_lane(r, 0) == kuro::atan2(1.0f, 0.0f));
+        CHECK(kuro::f32x4_lane(r, 1) == kuro::atan2(-1.0f, 0.0f));
+        CHECK(kuro::f32x4_lane(r, 2) == 0.0f);
+        CHECK(kuro::f32x4_lane(r, 3) == kuro::atan2(0.0f, -1.0f));
+        CHECK(kuro::bitmask(kuro::atan2(zero, zero) == zero) == 0xF);
+    }
+
+    SUBCASE("batch transform")
+    {
+        // 37 covers the 16, 8, 4 and scalar loops
+        const kuro::u32 count = 37;
+        kuro::f32 xs[count], ys[count], zs[count];
+        kuro::f32 rx[count], ry[count], rz[count], rw[count];
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            xs[i] = 0.5f * i - 3.0f;
+            ys[i] = 1.25f * i;
+            zs[i] = 7.0f - 0.75f * i;
+        }
+
+        kuro::transform_points(B, xs, ys, zs, rx, ry, rz, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::vec4 p = kuro::vec4{xs[i], ys[i], zs[i], 1.0f} * B;
+            CHECK(rx[i] == p.x);
+            CHECK(ry[i] == p.y);
+            CHECK(rz[i] == p.z);
+        }
+
+        kuro::transform_vectors(B, xs, ys, zs, rx, ry, rz, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::vec4 v = kuro::vec4{xs[i], ys[i], zs[i], 0.0f} * B;
+            CHECK(rx[i] == v.x);
+            CHECK(ry[i] == v.y);
+            CHECK(rz[i] == v.z);
+        }
+
+        kuro::transform_points_homogeneous(A, xs, ys, zs, rx, ry, rz, rw, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::vec4 p = kuro::vec4{xs[i], ys[i], zs[i], 1.0f} * A;
+            CHECK(rx[i] == p.x);
+            CHECK(ry[i] == p.y);
+            CHECK(rz[i] == p.z);
+            CHECK(rw[i] == p.w);
+        }
+
+        // in place through the soa view
+        kuro::vec3 aos[count];
+        kuro::vec3_soa points = {xs, ys, zs, count};
+        kuro::vec3_soa_to_aos(points, aos);
+        kuro::transform_points(B, points, points);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::vec4 p = kuro::vec4{aos[i].x, aos[i].y, aos[i].z, 1.0f} * B;
+            CHECK(kuro::vec3_soa_get(points, i) == kuro::vec3{p.x, p.y, p.z});
+        }
+
+        kuro::vec3_soa_from_aos(points, aos, count);
+        CHECK(kuro::vec3_soa_get(points, 5) == aos[5]);
+
+        // a shorter copy narrows the view to it
+        kuro::vec3_soa_from_aos(points, aos + 1, 3);
+        CHECK(points.count == 3);
+        CHECK(kuro::vec3_soa_get(points, 2) == aos[3]);
+    }
+}
+
+// =================================================================================================
+// == BOUNDS =======================================================================================
+// =================================================================================================
+static bool
+_aabb3_contains(const kuro::aabb3 &box, const kuro::vec3 &p, kuro::f32 eps)
+{
+    return p.x >= box.min.x - eps && p.y >= box.min.y - eps && p.z >= box.min.z - eps &&
+           p.x <= box.max.x + eps && p.y <= box.max.y + eps && p.z <= box.max.z + eps;
+}
+
+static bool
+_obb3_contains(const kuro::obb3 &box, const kuro::vec3 &p, kuro::f32 eps)
+{
+    kuro::vec3 d = p - box.center;
+    kuro::vec3 l = {
+        kuro::dot(d, {box.axes.m00, box.axes.m01, box.axes.m02}),
+        kuro::dot(d, {box.axes.m10, box.axes.m11, box.axes.m12}),
+        kuro::dot(d, {box.axes.m20, box.axes.m21, box.axes.m22})};
+    return (l.x < 0.0f ? -l.x : l.x) <= box.extents.x + eps &&
+           (l.y < 0.0f ? -l.y : l.y) <= box.extents.y + eps &&
+           (l.z < 0.0f ? -l.z : l.z) <= box.extents.z + eps;
+}
+
+TEST_CASE("[kuro_math]: bounds")
+{
+    kuro::u32 seed = 777;
+    auto random = [&seed](kuro::f32 lo, kuro::f32 hi) {
+        seed = seed * 1664525u + 1013904223u;
+        return lo + (hi - lo) * (kuro::f32)(seed >> 8) / (kuro::f32)(1u << 24);
+    };
+
+    SUBCASE("aabb")
+    {
+        kuro::aabb3 box = kuro::aabb3_empty();
+        CHECK(kuro::aabb3_is_empty(box));
+        box = kuro::aabb3_merge(box, kuro::vec3{1.0f, 2.0f, 3.0f});
+        box = kuro::aabb3_merge(box, kuro::aabb3{{-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 5.0f}});
+        CHECK_FALSE(kuro::aabb3_is_empty(box));
+        CHECK(box.min == kuro::vec3{-1.0f, 0.0f, 0.0f});
+        CHECK(box.max == kuro::vec3{1.0f, 2.0f, 5.0f});
+        CHECK(kuro::aabb3_center(box) == kuro::vec3{0.0f, 1.0f, 2.5f});
+        CHECK(kuro::aabb3_extents(box) == kuro::vec3{1.0f, 1.0f, 2.5f});
+
+        // Arvo gives the box of the 8 transformed corners
+        for (int n = 0; n < 20; ++n)
+        {
+            kuro::mat4 M = kuro::mat4_scaling(random(0.5f, 2.0f), random(0.5f, 2.0f), random(0.5f, 2.0f)) *
+                           kuro::mat4_euler(random(-3.0f, 3.0f), random(-3.0f, 3.0f), random(-3.0f, 3.0f)) *
+                           kuro::mat4_translation(random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(-10.0f, 10.0f));
+            kuro::aabb3 transformed = kuro::aabb3_transform(box, M);
+
+            kuro::aabb3 corners = kuro::aabb3_empty();
+            for (int c = 0; c < 8; ++c)
+            {
+                kuro::vec4 p = kuro::vec4{c & 1 ? box.max.x : box.min.x, c & 2 ? box.max.y : box.min.y, c & 4 ? box.max.z : box.min.z, 1.0f} * M;
+                corners = kuro::aabb3_merge(corners, kuro::vec3{p.x, p.y, p.z});
+            }
+            CHECK(transformed.min.x == doctest::Approx(corners.min.x));
+            CHECK(transformed.min.y == doctest::Approx(corners.min.y));
+            CHECK(transformed.min.z == doctest::Approx(corners.min.z));
+            CHECK(transformed.max.x == doctest::Approx(corners.max.x));
+            CHECK(transformed.max.y == doctest::Approx(corners.max.y));
+            CHECK(transformed.max.z == doctest::Approx(corners.max.z));
+        }
+        CHECK(kuro::aabb3_is_empty(kuro::aabb3_transform(kuro::aabb3_empty(), kuro::mat4_scaling(2.0f, 2.0f, 2.0f))));
+
+        // the batch refit matches one box at a time
+        const kuro::u32 count = 37;
+        kuro::aabb3 boxes[count], refit[count];
+        kuro::mat4 Ms[count];
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::vec3 c = {random(-5.0f, 5.0f), random(-5.0f, 5.0f), random(-5.0f, 5.0f)};
+            kuro::vec3 e = {random(0.0f, 2.0f), random(0.0f, 2.0f), random(0.0f, 2.0f)};
+            boxes[i] = i == 3 ? kuro::aabb3_empty() : kuro::aabb3{c - e, c + e};
+            Ms[i] = kuro::mat4_euler(random(-3.0f, 3.0f), random(-3.0f, 3.0f), random(-3.0f, 3.0f)) *
+                    kuro::mat4_translation(random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(-10.0f, 10.0f));
+        }
+        kuro::aabb3_transform(boxes, Ms, refit, count);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::aabb3 expected = kuro::aabb3_transform(boxes[i], Ms[i]);
+            CHECK(refit[i].min == expected.min);
+            CHECK(refit[i].max == expected.max);
+        }
+    }
+
+    SUBCASE("sphere")
+    {
+        kuro::sphere3 a = {{0.0f, 0.0f, 0.0f}, 1.0f};
+        kuro::sphere3 inside = {{0.5f, 0.0f, 0.0f}, 0.25f};
+        CHECK(kuro::sphere3_merge(a, inside).radius == 1.0f);
+        CHECK(kuro::sphere3_merge(inside, a).radius == 1.0f);
+
+        kuro::sphere3 merged = kuro::sphere3_merge(a, {{4.0f, 0.0f, 0.0f}, 2.0f});
+        CHECK(merged.radius == doctest::Approx(3.5f));
+        CHECK(merged.center.x == doctest::Approx(2.5f));
+        CHECK(merged.center.y == doctest::Approx(0.0f));
+
+        kuro::sphere3 moved = kuro::sphere3_transform({{1.0f, 0.0f, 0.0f}, 1.0f},
+            kuro::mat4_scaling(1.0f, 3.0f, 2.0f) * kuro::mat4_rotation_z((kuro::f32)kuro::PI_DIV_2) * kuro::mat4_translation(0.0f, 0.0f, 5.0f));
+        CHECK(moved.radius == doctest::Approx(3.0f));
+        CHECK(moved.center.x == doctest::Approx(0.0f).epsilon(1e-5));
+        CHECK(moved.center.y == doctest::Approx(1.0f));
+        CHECK(moved.center.z == doctest::Approx(5.0f));
+
+        kuro::aabb3 box = kuro::aabb3_from(kuro::sphere3{{1.0f, 2.0f, 3.0f}, 2.0f});
+        CHECK(box.min == kuro::vec3{-1.0f, 0.0f, 1.0f});
+        CHECK(box.max == kuro::vec3{3.0f, 4.0f, 5.0f});
+        CHECK(kuro::sphere3_from(kuro::aabb3{{0.0f, 0.0f, 0.0f}, {2.0f, 2.0f, 2.0f}}).radius == doctest::Approx(1.7320508f));
+    }
+
+    SUBCASE("obb")
+    {
+        kuro::aabb3 box = {{-1.0f, -2.0f, -3.0f}, {3.0f, 2.0f, 1.0f}};
+        kuro::obb3 obb = kuro::obb3_from(box);
+        kuro::aabb3 back = kuro::aabb3_from(obb);
+        CHECK(back.min == box.min);
+        CHECK(back.max == box.max);
+
+        // for rigid transforms the box of the moved obb is the Arvo box
+        kuro::mat4 M = kuro::mat4_euler(0.3f, -1.1f, 2.0f) * kuro::mat4_translation(4.0f, -2.0f, 1.0f);
+        kuro::aabb3 expected = kuro::aabb3_transform(box, M);
+        back = kuro::aabb3_from(kuro::obb3_transform(obb, M));
+        CHECK(back.min.x == doctest::Approx(expected.min.x));
+        CHECK(back.min.y == doctest::Approx(expected.min.y));
+        CHECK(back.min.z == doctest::Approx(expected.min.z));
+        CHECK(back.max.x == doctest::Approx(expected.max.x));
+        CHECK(back.max.y == doctest::Approx(expected.max.y));
+        CHECK(back.max.z == doctest::Approx(expected.max.z));
+
+        kuro::obb3 scaled = kuro::obb3_transform(obb, kuro::mat4_scaling(2.0f, 2.0f, 2.0f) * M);
+        CHECK(scaled.extents.x == doctest::Approx(4.0f));
+        CHECK(scaled.extents.y == doctest::Approx(4.0f));
+        CHECK(scaled.extents.z == doctest::Approx(4.0f));
+        CHECK(kuro::length(kuro::vec3{scaled.axes.m00, scaled.axes.m01, scaled.axes.m02}) == doctest::Approx(1.0f));
+
+        // a scale of 0 flattens the box instead of filling it with NaNs
+        kuro::obb3 flat = kuro::obb3_transform(obb, kuro::mat4_scaling(1.0f, 0.0f, 1.0f));
+        CHECK(flat.extents == kuro::vec3{2.0f, 0.0f, 2.0f});
+        CHECK(kuro::vec3{flat.axes.m10, flat.axes.m11, flat.axes.m12} == kuro::vec3{0.0f, 1.0f, 0.0f});
+        back = kuro::aabb3_from(flat);
+        CHECK(back.min == kuro::vec3{-1.0f, 0.0f, -3.0f});
+        CHECK(back.max == kuro::vec3{3.0f, 0.0f, 1.0f});
+    }
+
+    SUBCASE("fit")
+    {
+        // points of a rotated 8x4x2 box, its corners included, 1003 is 8 wide packets and a tail
+        const kuro::u32 count = 1003;
+        kuro::f32 xs[count], ys[count], zs[count];
+        kuro::mat4 R = kuro::mat4_euler(0.4f, 0.9f, -0.3f) * kuro::mat4_translation(10.0f, -3.0f, 7.0f);
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::vec4 local = i < 8
+                ? kuro::vec4{i & 1 ? 4.0f : -4.0f, i & 2 ? 2.0f : -2.0f, i & 4 ? 1.0f : -1.0f, 1.0f}
+                : kuro::vec4{random(-4.0f, 4.0f), random(-2.0f, 2.0f), random(-1.0f, 1.0f), 1.0f};
+            kuro::vec4 p = local * R;
+            xs[count - 1 - i] = p.x; ys[count - 1 - i] = p.y; zs[count - 1 - i] = p.z;
+        }
+        kuro::vec3_soa points = {xs, ys, zs, count};
+
+        kuro::aabb3 expected = kuro::aabb3_empty();
+        for (kuro::u32 i = 0; i < count; ++i)
+            expected = kuro::aabb3_merge(expected, kuro::vec3_soa_get(points, i));
+        kuro::aabb3 box = kuro::aabb3_fit(points);
+        CHECK(box.min == expected.min);
+        CHECK(box.max == expected.max);
+        CHECK(kuro::aabb3_is_empty(kuro::aabb3_fit({xs, ys, zs, 0})));
+
+        // the union of the boxes around every point is the box of the points
+        kuro::aabb3 merged = kuro::aabb3_merge(points, points);
+        CHECK(merged.min == expected.min);
+        CHECK(merged.max == expected.max);
+
+        kuro::sphere3 sphere = kuro::sphere3_fit(points);
+        kuro::f32 farthest = 0.0f;
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::f32 d = kuro::length(kuro::vec3_soa_get(points, i) - sphere.center);
+            farthest = d > farthest ? d : farthest;
+        }
+        CHECK(sphere.radius == doctest::Approx(farthest));
+
+        // the covariance of the corners alone is diagonal in the box frame, the principal axes find
+        // the box back
+        kuro::obb3 obb = kuro::obb3_fit({xs + count - 8, ys + count - 8, zs + count - 8, 8});
+        kuro::f32 extents[3] = {obb.extents.x, obb.extents.y, obb.extents.z};
+        for (int a = 0; a < 2; ++a)
+            for (int b = a + 1; b < 3; ++b)
+                if (extents[b] < extents[a])
+                {
+                    kuro::f32 t = extents[a];
+                    extents[a] = extents[b];
+                    extents[b] = t;
+                }
+        CHECK(extents[0] == doctest::Approx(1.0f).epsilon(1e-4));
+        CHECK(extents[1] == doctest::Approx(2.0f).epsilon(1e-4));
+        CHECK(extents[2] == doctest::Approx(4.0f).epsilon(1e-4));
+
+        // a sampled cloud is only close, but every point is inside
+        obb = kuro::obb3_fit(points);
+        CHECK(obb.extents.x * obb.extents.y * obb.extents.z < 8.0f * 1.3f);
+        for (kuro::u32 i = 0; i < count; ++i)
+            REQUIRE(_obb3_contains(obb, kuro::vec3_soa_get(points, i), 1e-3f));
+        for (kuro::u32 i = 0; i < count; ++i)
+            REQUIRE(_aabb3_contains(kuro::aabb3_from(obb), kuro::vec3_soa_get(points, i), 1e-3f));
+
+        // a single point
+        kuro::obb3 point = kuro::obb3_fit({xs, ys, zs, 1});
+        CHECK(point.center.x == doctest::Approx(xs[0]));
+        CHECK(point.extents.x == 0.0f);
+    }
+}
+
 // =================================================================================================
 // == INTERSECTIONS ================================================================================
-// =================================================================================================
\ No newline at end of file
+// =================================================================================================
+TEST_CASE("[kuro_math]: intersections")
+{
+    SUBCASE("ray aabb")
+    {
+        kuro::aabb3 box = {{-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}};
+        kuro::f32 t = -1.0f;
+
+        CHECK(kuro::ray_aabb_intersect({{-5.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}}, box, kuro::F32_MAX, t));
+        CHECK(t == doctest::Approx(4.0f));
+
+        // axis aligned ray grazing the slab plane
+        CHECK(kuro::ray_aabb_intersect({{0.0f, -1.0f, -5.0f}, {0.0f, 0.0f, 1.0f}}, box, kuro::F32_MAX, t));
+        CHECK(t == doctest::Approx(4.0f));
+
+        // origin inside
+        CHECK(kuro::ray_aabb_intersect({{0.5f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}}, box, kuro::F32_MAX, t));
+        CHECK(t == 0.0f);
+
+        CHECK_FALSE(kuro::ray_aabb_intersect({{-5.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}}, box, kuro::F32_MAX, t));
+        CHECK_FALSE(kuro::ray_aabb_intersect({{-5.0f, 2.0f, 0.0f}, {1.0f, 0.0f, 0.0f}}, box, kuro::F32_MAX, t));
+
+        kuro::aabb3 empty = {{1.0f, 1.0f, 1.0f}, {-1.0f, -1.0f, -1.0f}};
+        CHECK_FALSE(kuro::ray_aabb_intersect({{-5.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}}, empty, kuro::F32_MAX, t));
+
+        // entered past t_max
+        CHECK_FALSE(kuro::ray_aabb_intersect({{-5.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}}, box, 3.0f, t));
+        CHECK(kuro::ray_aabb_intersect({{-5.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}}, box, 4.5f, t));
+    }
+
+    SUBCASE("ray triangle")
+    {
+        kuro::vec3 v0 = {0.0f, 0.0f, 0.0f};
+        kuro::vec3 v1 = {1.0f, 0.0f, 0.0f};
+        kuro::vec3 v2 = {0.0f, 1.0f, 0.0f};
+        kuro::f32 t = -1.0f, u = -1.0f, v = -1.0f;
+
+        CHECK(kuro::ray_triangle_intersect({{0.25f, 0.5f, 2.0f}, {0.0f, 0.0f, -1.0f}}, v0, v1, v2, t, u, v));
+        CHECK(t == doctest::Approx(2.0f));
+        CHECK(u == doctest::Approx(0.25f));
+        CHECK(v == doctest::Approx(0.5f));
+
+        // back face
+        CHECK(kuro::ray_triangle_intersect({{0.25f, 0.25f, -3.0f}, {0.0f, 0.0f, 1.0f}}, v0, v1, v2, t));
+        CHECK(t == doctest::Approx(3.0f));
+
+        CHECK_FALSE(kuro::ray_triangle_intersect({{0.75f, 0.75f, 2.0f}, {0.0f, 0.0f, -1.0f}}, v0, v1, v2, t));
+        CHECK_FALSE(kuro::ray_triangle_intersect({{0.25f, 0.25f, 2.0f}, {0.0f, 0.0f, 1.0f}}, v0, v1, v2, t));
+        CHECK_FALSE(kuro::ray_triangle_intersect({{0.25f, 0.25f, 2.0f}, {1.0f, 0.0f, 0.0f}}, v0, v1, v2, t));
+
+        // the parallel bound is relative, a tiny triangle is hit and a grazing ray still misses
+        kuro::f32 s = 1e-5f;
+        CHECK(kuro::ray_triangle_intersect({{0.25f * s, 0.25f * s, 2.0f}, {0.0f, 0.0f, -1.0f}}, v0, v1 * s, v2 * s, t));
+        CHECK(t == doctest::Approx(2.0f));
+        CHECK_FALSE(kuro::ray_triangle_intersect({{-0.75f, 0.25f, 1e-9f}, {1.0f, 0.0f, -1e-9f}}, v0, v1, v2, t));
+    }
+
+    SUBCASE("ray sphere")
+    {
+        kuro::sphere3 sphere = {{0.0f, 0.0f, 5.0f}, 2.0f};
+        kuro::f32 t = -1.0f;
+
+        CHECK(kuro::ray_sphere_intersect({{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, sphere, t));
+        CHECK(t == doctest::Approx(3.0f));
+
+        // direction does not need to be normalized
+        CHECK(kuro::ray_sphere_intersect({{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 2.0f}}, sphere, t));
+        CHECK(t == doctest::Approx(1.5f));
+
+        CHECK(kuro::ray_sphere_intersect({{0.0f, 1.0f, 5.0f}, {1.0f, 0.0f, 0.0f}}, sphere, t));
+        CHECK(t == 0.0f);
+
+        CHECK_FALSE(kuro::ray_sphere_intersect({{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}, sphere, t));
+        CHECK_FALSE(kuro::ray_sphere_intersect({{0.0f, 3.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}, sphere, t));
+    }
+
+    SUBCASE("ray plane")
+    {
+        kuro::plane3 plane = {{0.0f, 1.0f, 0.0f}, -2.0f};
+        kuro::f32 t = -1.0f;
+
+        CHECK(kuro::ray_plane_intersect({{1.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}}, plane, t));
+        CHECK(t == doctest::Approx(2.0f));
+
+        CHECK(kuro::ray_plane_intersect({{1.0f, 5.0f, 1.0f}, {0.0f, -2.0f, 0.0f}}, plane, t));
+        CHECK(t == doctest::Approx(1.5f));
+
+        CHECK_FALSE(kuro::ray_plane_intersect({{1.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f}}, plane, t));
+        CHECK_FALSE(kuro::ray_plane_intersect({{1.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}}, plane, t));
+    }
+
+    SUBCASE("packets")
+    {
+        kuro::ray3 rays[] = {
+            {{-6.0f, 0.3f, 0.2f}, {1.0f, 0.05f, -0.02f}},
+            {{0.1f, 0.2f, 0.3f}, {-0.3f, 1.0f, 0.4f}},
+            {{2.0f, -7.0f, 1.0f}, {0.0f, 1.0f, 0.0f}},
+        };
+
+        kuro::aabb3 boxes[8];
+        kuro::vec3 triangles[8][3];
+        kuro::sphere3 spheres[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            kuro::f32 o = (kuro::f32)i - 3.5f;
+            boxes[i] = {{o - 0.6f, -1.0f + 0.1f * i, -1.0f}, {o + 0.6f, 1.0f, 1.5f - 0.2f * i}};
+            triangles[i][0] = {o, -2.0f, -1.0f};
+            triangles[i][1] = {o + 1.0f, 2.0f, 0.5f * i - 2.0f};
+            triangles[i][2] = {o - 1.0f, 1.0f, 2.0f};
+            spheres[i] = {{o, 0.5f * (i % 3), 0.2f * i}, 0.3f + 0.1f * i};
+        }
+        // unused lanes of the last packet
+        boxes[7] = {{1.0f, 1.0f, 1.0f}, {-1.0f, -1.0f, -1.0f}};
+        triangles[7][1] = triangles[7][0];
+        triangles[7][2] = triangles[7][0];
+
+        kuro::aabb3_x4 boxes_x4[2];
+        kuro::triangle3_x4 triangles_x4[2];
+        kuro::sphere3_x4 spheres_x4[2];
+        kuro::aabb3_x8 boxes_x8;
+        kuro::triangle3_x8 triangles_x8;
+        kuro::sphere3_x8 spheres_x8;
+        for (kuro::u32 i = 0; i < 8; ++i)
+        {
+            kuro::aabb3_x4_set(boxes_x4[i / 4], i % 4, boxes[i]);
+            kuro::triangle3_x4_set(triangles_x4[i / 4], i % 4, triangles[i][0], triangles[i][1], triangles[i][2]);
+            kuro::sphere3_x4_set(spheres_x4[i / 4], i % 4, spheres[i]);
+            kuro::aabb3_x8_set(boxes_x8, i, boxes[i]);
+            kuro::triangle3_x8_set(triangles_x8, i, triangles[i][0], triangles[i][1], triangles[i][2]);
+            kuro::sphere3_x8_set(spheres_x8, i, spheres[i]);
+        }
+
+        kuro::f32 t_maxs[] = {kuro::F32_MAX, 4.0f};
+        for (const kuro::ray3 &ray : rays)
+        {
+            for (kuro::f32 t_max : t_maxs)
+            {
+                kuro::f32 t4[8], t8[8];
+                kuro::u32 mask4, mask8, expected;
+
+                mask4 = kuro::ray_aabb_intersect_x4(ray, boxes_x4[0], t_max, t4) | (kuro::ray_aabb_intersect_x4(ray, boxes_x4[1], t_max, t4 + 4) << 4);
+                mask8 = kuro::ray_aabb_intersect_x8(ray, boxes_x8, t_max, t8);
+                expected = 0;
+                for (kuro::u32 i = 0; i < 8; ++i)
+                {
+                    kuro::f32 t = 0.0f;
+                    bool hit = kuro::ray_aabb_intersect(ray, boxes[i], t_max, t);
+                    expected |= (hit ? 1u : 0u) << i;
+                    CHECK(t4[i] == (hit ? doctest::Approx(t) : doctest::Approx(kuro::F32_MAX)));
+                    CHECK(t8[i] == t4[i]);
+                }
+                CHECK(mask4 == expected);
+                CHECK(mask8 == expected);
+
+                mask4 = kuro::ray_triangle_intersect_x4(ray, triangles_x4[0], t_max, t4) | (kuro::ray_triangle_intersect_x4(ray, triangles_x4[1], t_max, t4 + 4) << 4);
+                mask8 = kuro::ray_triangle_intersect_x8(ray, triangles_x8, t_max, t8);
+                expected = 0;
+                for (kuro::u32 i = 0; i < 8; ++i)
+                {
+                    kuro::f32 t = 0.0f;
+                    bool hit = kuro::ray_triangle_intersect(ray, triangles[i][0], triangles[i][1], triangles[i][2], t) && t <= t_max;
+                    expected |= (hit ? 1u : 0u) << i;
+                    CHECK(t4[i] == (hit ? doctest::Approx(t) : doctest::Approx(kuro::F32_MAX)));
+                    CHECK(t8[i] == t4[i]);
+                }
+                CHECK(mask4 == expected);
+                CHECK(mask8 == expected);
+
+                mask4 = kuro::ray_sphere_intersect_x4(ray, spheres_x4[0], t_max, t4) | (kuro::ray_sphere_intersect_x4(ray, spheres_x4[1], t_max, t4 + 4) << 4);
+                mask8 = kuro::ray_sphere_intersect_x8(ray, spheres_x8, t_max, t8);
+                expected = 0;
+                for (kuro::u32 i = 0; i < 8; ++i)
+                {
+                    kuro::f32 t = 0.0f;
+                    bool hit = kuro::ray_sphere_intersect(ray, spheres[i], t) && t <= t_max;
+                    expected |= (hit ? 1u : 0u) << i;
+                    CHECK(t4[i] == (hit ? doctest::Approx(t) : doctest::Approx(kuro::F32_MAX)));
+                    CHECK(t8[i] == t4[i]);
+                }
+                CHECK(mask4 == expected);
+                CHECK(mask8 == expected);
+            }
+        }
+    }
+}
+
+// =================================================================================================
+// == CULLING ======================================================================================
+// =================================================================================================
+TEST_CASE("[kuro_math]: culling")
+{
+    // looking down -z from (0, 0, 5) with a 90 degrees field of view, the side planes go through
+    // the eye at 45 degrees
+    kuro::mat4 view = kuro::mat4_look_at({0.0f, 0.0f, 5.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+    kuro::frustum F = kuro::frustum_from(view * kuro::mat4_prespective((kuro::f32)kuro::PI_DIV_2, 1.0f, 0.1f, 100.0f));
+
+    SUBCASE("frustum")
+    {
+        for (const kuro::plane3 &plane : F.planes)
+            CHECK(kuro::length(plane.normal) == doctest::Approx(1.0f));
+
+        // distances are in world units
+        kuro::vec3 origin = {0.0f, 0.0f, 0.0f};
+        CHECK(kuro::dot(F.planes[0].normal, origin) + F.planes[0].d == doctest::Approx(5.0f * 0.70710678f));
+        CHECK(kuro::dot(F.planes[3].normal, origin) + F.planes[3].d == doctest::Approx(5.0f * 0.70710678f));
+        CHECK(kuro::dot(F.planes[4].normal, origin) + F.planes[4].d == doctest::Approx(4.9f));
+        CHECK(kuro::dot(F.planes[5].normal, origin) + F.planes[5].d == doctest::Approx(95.0f));
+
+        CHECK(kuro::frustum_sphere_visible(F, {{0.0f, 0.0f, 0.0f}, 1.0f}));
+        CHECK_FALSE(kuro::frustum_sphere_visible(F, {{0.0f, 0.0f, 10.0f}, 1.0f}));
+        CHECK_FALSE(kuro::frustum_sphere_visible(F, {{0.0f, 0.0f, -200.0f}, 1.0f}));
+        CHECK_FALSE(kuro::frustum_sphere_visible(F, {{0.0f, 0.0f, 4.95f}, 0.01f}));
+        CHECK_FALSE(kuro::frustum_sphere_visible(F, {{7.0f, 0.0f, 0.0f}, 1.0f}));
+        CHECK(kuro::frustum_sphere_visible(F, {{7.0f, 0.0f, 0.0f}, 3.0f}));
+
+        CHECK(kuro::frustum_aabb_visible(F, {{-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}}));
+        CHECK_FALSE(kuro::frustum_aabb_visible(F, {{-1.0f, 7.0f, -1.0f}, {1.0f, 8.0f, 1.0f}}));
+        CHECK(kuro::frustum_aabb_visible(F, {{-1.0f, 4.0f, -1.0f}, {1.0f, 7.0f, 1.0f}}));
+        CHECK_FALSE(kuro::frustum_aabb_visible(F, {{-1.0f, -1.0f, 6.0f}, {1.0f, 1.0f, 7.0f}}));
+        // a box around the camera is always visible
+        CHECK(kuro::frustum_aabb_visible(F, {{-1.0f, -1.0f, 4.0f}, {1.0f, 1.0f, 6.0f}}));
+
+        // the box of an orthographic projection
+        kuro::frustum O = kuro::frustum_from(kuro::mat4_ortho(-2.0f, 2.0f, -1.0f, 1.0f, 0.5f, 10.0f));
+        CHECK(kuro::frustum_aabb_visible(O, {{1.5f, -0.5f, -5.0f}, {3.0f, 0.5f, -4.0f}}));
+        CHECK_FALSE(kuro::frustum_aabb_visible(O, {{2.5f, -0.5f, -5.0f}, {3.0f, 0.5f, -4.0f}}));
+        CHECK_FALSE(kuro::frustum_aabb_visible(O, {{-1.0f, -0.5f, -0.4f}, {1.0f, 0.5f, 1.0f}}));
+        CHECK_FALSE(kuro::frustum_aabb_visible(O, {{-1.0f, -0.5f, -12.0f}, {1.0f, 0.5f, -11.0f}}));
+        CHECK(kuro::frustum_sphere_visible(O, {{0.0f, 1.5f, -5.0f}, 0.6f}));
+        CHECK_FALSE(kuro::frustum_sphere_visible(O, {{0.0f, 1.5f, -5.0f}, 0.4f}));
+    }
+
+    SUBCASE("batch")
+    {
+        // 8 wide packets and a scalar tail, shapes spread from far outside to well inside
+        const kuro::u32 count = 1021;
+        kuro::u32 seed = 12345;
+        auto random = [&seed](kuro::f32 lo, kuro::f32 hi) {
+            seed = seed * 1664525u + 1013904223u;
+            return lo + (hi - lo) * (kuro::f32)(seed >> 8) / (kuro::f32)(1u << 24);
+        };
+
+        kuro::f32 min_x[count], min_y[count], min_z[count], max_x[count], max_y[count], max_z[count], radii[count];
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            kuro::f32 x = random(-60.0f, 60.0f), y = random(-60.0f, 60.0f), z = random(-120.0f, 20.0f);
+            kuro::f32 size = random(0.0f, 4.0f);
+            min_x[i] = x - size; max_x[i] = x + size;
+            min_y[i] = y - size; max_y[i] = y + size;
+            min_z[i] = z - size; max_z[i] = z + size;
+            radii[i] = size;
+        }
+        kuro::vec3_soa mins = {min_x, min_y, min_z, count};
+        kuro::vec3_soa maxs = {max_x, max_y, max_z, count};
+
+        kuro::u32 boxes[(count + 31) / 32], spheres[(count + 31) / 32];
+        for (kuro::u32 &word : boxes)
+            word = 0xFFFFFFFF;
+        kuro::frustum_cull_aabbs(F, mins, maxs, boxes);
+        kuro::frustum_cull_spheres(F, mins, radii, spheres);
+        CHECK((boxes[count / 32] >> (count % 32)) == 0);
+
+        kuro::u32 box_indices[count], sphere_indices[count];
+        kuro::u32 box_count = kuro::visibility_compact(boxes, count, box_indices);
+        kuro::u32 sphere_count = kuro::visibility_compact(spheres, count, sphere_indices);
+
+        kuro::u32 expected_boxes = 0, expected_spheres = 0;
+        for (kuro::u32 i = 0; i < count; ++i)
+        {
+            bool box = kuro::frustum_aabb_visible(F, {kuro::vec3_soa_get(mins, i), kuro::vec3_soa_get(maxs, i)});
+            bool sphere = kuro::frustum_sphere_visible(F, {kuro::vec3_soa_get(mins, i), radii[i]});
+            REQUIRE(((boxes[i / 32] >> (i % 32)) & 1u) == (box ? 1u : 0u));
+            REQUIRE(((spheres[i / 32] >> (i % 32)) & 1u) == (sphere ? 1u : 0u));
+            if (box)
+                REQUIRE(box_indices[expected_boxes++] == i);
+            if (sphere)
+                REQUIRE(sphere_indices[expected_spheres++] == i);
+        }
+        CHECK(box_count == expected_boxes);
+        CHECK(sphere_count == expected_spheres);
+        // the scene is neither all in nor all out
+        CHECK(box_count > 20);
+        CHECK(box_count < count / 2);
+
+        // a prefix of the mask
+        kuro::u32 prefix = 0;
+        while (prefix < box_count && box_indices[prefix] < 40)
+            ++prefix;
+        CHECK(kuro::visibility_compact(boxes, 40, box_indices) == prefix);
+    }
+}